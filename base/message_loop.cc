@@ -80,6 +80,7 @@ MessageLoop::MessageLoop(Type type)
     : type_(type),
       nestable_tasks_allowed_(true),
       exception_restoration_(false),
+      incoming_queue_(0),
       state_(NULL),
       next_sequence_num_(0) {
   DCHECK(!current()) << "should only have one message loop per thread";
@@ -265,21 +266,28 @@ void MessageLoop::PostTask_Helper(
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  scoped_refptr<base::MessagePump> pump;
-  {
-    AutoLock locked(incoming_queue_lock_);
+  IncomingTask* incoming_task = new IncomingTask(pending_task);
 
-    bool was_empty = incoming_queue_.empty();
-    incoming_queue_.push(pending_task);
-    if (!was_empty)
-      return;  // Someone else should have started the sub-pump.
+  // Since the incoming_queue_ may contain a task that destroys this message
+  // loop, we cannot touch |this| once our task is in it.  We use a stack-based
+  // reference to the message pump so that we can call ScheduleWork after
+  // pushing the task.
+  scoped_refptr<base::MessagePump> pump = pump_;
 
-    pump = pump_;
+  base::subtle::AtomicWord head =
+      base::subtle::NoBarrier_Load(&incoming_queue_);
+  for (;;) {
+    incoming_task->next = reinterpret_cast<IncomingTask*>(head);
+    // The release barrier publishes the task to ReloadWorkQueue.
+    base::subtle::AtomicWord old_head = base::subtle::Release_CompareAndSwap(
+        &incoming_queue_, head,
+        reinterpret_cast<base::subtle::AtomicWord>(incoming_task));
+    if (old_head == head)
+      break;
+    head = old_head;
   }
-  // Since the incoming_queue_ may contain a task that destroys this message
-  // loop, we cannot exit incoming_queue_lock_ until we are done with |this|.
-  // We use a stack-based reference to the message pump so that we can call
-  // ScheduleWork outside of incoming_queue_lock_.
+  if (head)
+    return;  // Someone else should have started the sub-pump.
 
   pump->ScheduleWork();
 }
@@ -343,18 +351,38 @@ void MessageLoop::AddToDelayedWorkQueue(const PendingTask& pending_task) {
 void MessageLoop::ReloadWorkQueue() {
   // We can improve performance of our loading tasks from incoming_queue_ to
   // work_queue_ by waiting until the last minute (work_queue_ is empty) to
-  // load.  That reduces the number of locks-per-task significantly when our
-  // queues get large.
+  // load.  That reduces the number of atomic operations per task
+  // significantly when our queues get large.
   if (!work_queue_.empty())
-    return;  // Wait till we *really* need to lock and load.
+    return;  // Wait till we *really* need to load.
+
+  // Acquire all we can from the inter-thread queue at once.  Only this thread
+  // removes tasks, so a compare-and-swap with the head we read can only fail
+  // because another task was pushed in the meantime.
+  base::subtle::AtomicWord head =
+      base::subtle::NoBarrier_Load(&incoming_queue_);
+  while (head) {
+    base::subtle::AtomicWord old_head =
+        base::subtle::Acquire_CompareAndSwap(&incoming_queue_, head, 0);
+    if (old_head == head)
+      break;
+    head = old_head;
+  }
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  {
-    AutoLock lock(incoming_queue_lock_);
-    if (incoming_queue_.empty())
-      return;
-    std::swap(incoming_queue_, work_queue_);
-    DCHECK(incoming_queue_.empty());
+  // The list is newest first, so reverse it to keep the posting order.
+  IncomingTask* incoming_task = reinterpret_cast<IncomingTask*>(head);
+  IncomingTask* oldest_task = NULL;
+  while (incoming_task) {
+    IncomingTask* next = incoming_task->next;
+    incoming_task->next = oldest_task;
+    oldest_task = incoming_task;
+    incoming_task = next;
+  }
+  while (oldest_task) {
+    work_queue_.push(oldest_task->pending_task);
+    IncomingTask* next = oldest_task->next;
+    delete oldest_task;
+    oldest_task = next;
   }
 }
 
@@ -8,6 +8,7 @@
 #include <queue>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/histogram.h"
 #include "base/message_pump.h"
 #include "base/observer_list.h"
@@ -273,6 +274,16 @@ class MessageLoop : public base::MessagePump::Delegate {
     bool operator<(const PendingTask& other) const;
   };
 
+  // A task in incoming_queue_.
+  struct IncomingTask {
+    PendingTask pending_task;
+    IncomingTask* next;
+
+    explicit IncomingTask(const PendingTask& pending_task)
+        : pending_task(pending_task), next(NULL) {
+    }
+  };
+
   typedef std::queue<PendingTask> TaskQueue;
   typedef std::priority_queue<PendingTask> DelayedTaskQueue;
 
@@ -323,8 +334,8 @@ class MessageLoop : public base::MessagePump::Delegate {
   void AddToDelayedWorkQueue(const PendingTask& pending_task);
 
   // Load tasks from the incoming_queue_ into work_queue_ if the latter is
-  // empty.  The former requires a lock to access, while the latter is directly
-  // accessible on this thread.
+  // empty.  The former is shared with the posting threads, while the latter is
+  // directly accessible on this thread.
   void ReloadWorkQueue();
 
   // Delete tasks that haven't run yet without running them.  Used in the
@@ -381,13 +392,12 @@ class MessageLoop : public base::MessagePump::Delegate {
   // A profiling histogram showing the counts of various messages and events.
   scoped_ptr<LinearHistogram> message_histogram_;
 
-  // A null terminated list which creates an incoming_queue of tasks that are
-  // aquired under a mutex for processing on this instance's thread. These tasks
-  // have not yet been sorted out into items for our work_queue_ vs items that
-  // will be handled by the TimerManager.
-  TaskQueue incoming_queue_;
-  // Protect access to incoming_queue_.
-  Lock incoming_queue_lock_;
+  // A null terminated list of the IncomingTasks posted from any thread, newest
+  // first, which have not yet been sorted out into items for our work_queue_
+  // vs items that will be handled by the TimerManager.  It is lock-free:
+  // posting threads push a task with a compare-and-swap, and this instance's
+  // thread takes the whole list at once.
+  base::subtle::AtomicWord incoming_queue_;
 
   RunState* state_;
 
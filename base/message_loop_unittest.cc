@@ -2,11 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <vector>
+
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
 #include "base/thread.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 #if defined(OS_WIN)
@@ -1269,6 +1274,108 @@ void RunTest_WaitForIO() {
 
 #endif  // defined(OS_WIN)
 
+// Checks that the tasks of each producer thread run in order, and quits once
+// all of them have run.
+class ProducerTaskCounter {
+ public:
+  ProducerTaskCounter(int num_producers, int tasks_per_producer)
+      : next_task_(num_producers, 0),
+        total_tasks_(num_producers * tasks_per_producer),
+        tasks_run_(0) {
+  }
+
+  void OnTask(int producer, int sequence_number) {
+    EXPECT_EQ(next_task_[producer], sequence_number);
+    next_task_[producer] = sequence_number + 1;
+    if (++tasks_run_ == total_tasks_)
+      MessageLoop::current()->Quit();
+  }
+
+  int tasks_run() const { return tasks_run_; }
+
+ private:
+  std::vector<int> next_task_;
+  int total_tasks_;
+  int tasks_run_;
+};
+
+class ProducerTask : public Task {
+ public:
+  ProducerTask(ProducerTaskCounter* counter, int producer, int sequence_number)
+      : counter_(counter),
+        producer_(producer),
+        sequence_number_(sequence_number) {
+  }
+
+  virtual void Run() {
+    counter_->OnTask(producer_, sequence_number_);
+  }
+
+ private:
+  ProducerTaskCounter* counter_;
+  int producer_;
+  int sequence_number_;
+};
+
+// Runs on a producer thread, and posts its tasks to |target_loop|.
+class PostProducerTasksTask : public Task {
+ public:
+  PostProducerTasksTask(MessageLoop* target_loop,
+                        ProducerTaskCounter* counter,
+                        int producer,
+                        int num_tasks)
+      : target_loop_(target_loop),
+        counter_(counter),
+        producer_(producer),
+        num_tasks_(num_tasks) {
+  }
+
+  virtual void Run() {
+    for (int i = 0; i < num_tasks_; ++i) {
+      target_loop_->PostTask(FROM_HERE,
+                             new ProducerTask(counter_, producer_, i));
+    }
+  }
+
+ private:
+  MessageLoop* target_loop_;
+  ProducerTaskCounter* counter_;
+  int producer_;
+  int num_tasks_;
+};
+
+// Posts tasks from many threads at once, which is what the I/O thread gets,
+// and logs how many tasks per second get through.
+void RunTest_PostTaskFromManyThreads(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumProducers = 8;
+  const int kTasksPerProducer = 20000;
+  ProducerTaskCounter counter(kNumProducers, kTasksPerProducer);
+
+  scoped_ptr<Thread> producers[kNumProducers];
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i].reset(new Thread("Producer"));
+    ASSERT_TRUE(producers[i]->Start());
+  }
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i]->message_loop()->PostTask(FROM_HERE,
+        new PostProducerTasksTask(&loop, &counter, i, kTasksPerProducer));
+  }
+  MessageLoop::current()->Run();
+  TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  for (int i = 0; i < kNumProducers; ++i)
+    producers[i]->Stop();
+
+  EXPECT_EQ(kNumProducers * kTasksPerProducer, counter.tasks_run());
+  LOG(INFO) << kNumProducers << " producers: "
+            << counter.tasks_run() / std::max(elapsed.InSecondsF(), 0.001)
+            << " tasks/s";
+}
+
 }  // namespace
 
 //-----------------------------------------------------------------------------
@@ -1282,6 +1389,12 @@ TEST(MessageLoopTest, PostTask) {
   RunTest_PostTask(MessageLoop::TYPE_IO);
 }
 
+TEST(MessageLoopTest, PostTaskFromManyThreads) {
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_DEFAULT);
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_UI);
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_IO);
+}
+
 TEST(MessageLoopTest, PostTask_SEH) {
   RunTest_PostTask_SEH(MessageLoop::TYPE_DEFAULT);
   RunTest_PostTask_SEH(MessageLoop::TYPE_UI);
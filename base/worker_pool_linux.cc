@@ -5,12 +5,16 @@
 #include "base/worker_pool.h"
 #include "base/worker_pool_linux.h"
 
+#include <algorithm>
+
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
 #include "base/string_util.h"
+#include "base/sys_info.h"
 #include "base/task.h"
+#include "base/thread_local.h"
 
 namespace {
 
@@ -18,6 +22,11 @@ const int kIdleSecondsBeforeExit = 10 * 60;
 // A stack size of 64 KB is too small for the CERT_PKIXVerifyCert
 // function of NSS because of NSS bug 439169.
 const int kWorkerThreadStackSize = 128 * 1024;
+// The number of times an idle worker thread yields, looking for tasks, before
+// it goes to sleep.
+const int kIdleSpinCount = 64;
+// The maximum number of task queues of a pool.
+const int kMaxQueues = 16;
 
 class WorkerPoolImpl {
  public:
@@ -49,37 +58,47 @@ base::LazyInstance<WorkerPoolImpl> g_lazy_worker_pool(base::LINKER_INITIALIZED);
 
 class WorkerThread : public PlatformThread::Delegate {
  public:
-  WorkerThread(const std::string& name_prefix, int idle_seconds_before_exit,
+  WorkerThread(const std::string& name_prefix, int home_queue,
                base::LinuxDynamicThreadPool* pool)
       : name_prefix_(name_prefix),
-        idle_seconds_before_exit_(idle_seconds_before_exit),
+        home_queue_(home_queue),
         pool_(pool) {}
 
   virtual void ThreadMain();
 
+  base::LinuxDynamicThreadPool* pool() const { return pool_.get(); }
+  int home_queue() const { return home_queue_; }
+
  private:
   const std::string name_prefix_;
-  const int idle_seconds_before_exit_;
+  const int home_queue_;
   scoped_refptr<base::LinuxDynamicThreadPool> pool_;
 
   DISALLOW_COPY_AND_ASSIGN(WorkerThread);
 };
 
+// The WorkerThread of the current thread, if it is a worker thread.
+base::LazyInstance<base::ThreadLocalPointer<WorkerThread> >
+    g_current_worker_thread(base::LINKER_INITIALIZED);
+
 void WorkerThread::ThreadMain() {
   const std::string name =
       StringPrintf("%s/%d", name_prefix_.c_str(),
                    IntToString(PlatformThread::CurrentId()).c_str());
   PlatformThread::SetName(name.c_str());
+  g_current_worker_thread.Pointer()->Set(this);
 
   for (;;) {
-    Task* task = pool_->WaitForTask();
+    Task* task = pool_->WaitForTask(home_queue_);
     if (!task)
       break;
     task->Run();
     delete task;
+    pool_->DidRunTask();
   }
 
   // The WorkerThread is non-joinable, so it deletes itself.
+  g_current_worker_thread.Pointer()->Set(NULL);
   delete this;
 }
 
@@ -98,72 +117,149 @@ LinuxDynamicThreadPool::LinuxDynamicThreadPool(
     int idle_seconds_before_exit)
     : name_prefix_(name_prefix),
       idle_seconds_before_exit_(idle_seconds_before_exit),
+      num_queues_(std::max(1, std::min(SysInfo::NumberOfProcessors(),
+                                       kMaxQueues))),
+      queues_(new TaskQueue[num_queues_]),
+      num_pending_tasks_(0),
+      num_free_threads_(0),
+      next_queue_(0),
       tasks_available_cv_(&lock_),
       num_idle_threads_(0),
-      terminated_(false),
+      terminated_(0),
       num_idle_threads_cv_(NULL) {}
 
 LinuxDynamicThreadPool::~LinuxDynamicThreadPool() {
-  while (!tasks_.empty()) {
-    Task* task = tasks_.front();
-    tasks_.pop();
-    delete task;
+  for (int i = 0; i < num_queues_; ++i) {
+    std::deque<Task*>& tasks = queues_[i].tasks;
+    while (!tasks.empty()) {
+      Task* task = tasks.front();
+      tasks.pop_front();
+      delete task;
+    }
   }
 }
 
 void LinuxDynamicThreadPool::Terminate() {
   {
     AutoLock locked(lock_);
-    DCHECK(!terminated_) << "Thread pool is already terminated.";
-    terminated_ = true;
+    DCHECK(!subtle::NoBarrier_Load(&terminated_)) <<
+        "Thread pool is already terminated.";
+    subtle::Release_Store(&terminated_, 1);
   }
   tasks_available_cv_.Broadcast();
 }
 
 void LinuxDynamicThreadPool::PostTask(Task* task) {
-  AutoLock locked(lock_);
-  DCHECK(!terminated_) <<
+  DCHECK(!subtle::NoBarrier_Load(&terminated_)) <<
       "This thread pool is already terminated.  Do not post new tasks.";
 
-  tasks_.push(task);
+  // The tasks posted by a task likely work on the same data, so they stay with
+  // its worker thread, unless other threads are free to steal them.
+  WorkerThread* current_worker = g_current_worker_thread.Pointer()->Get();
+  const int queue_index = current_worker && current_worker->pool() == this ?
+      current_worker->home_queue() : NextQueue();
+  {
+    TaskQueue& queue = queues_[queue_index];
+    AutoLock locked(queue.lock);
+    queue.tasks.push_back(task);
+  }
 
-  // We have enough worker threads.
-  if (static_cast<size_t>(num_idle_threads_) >= tasks_.size()) {
+  // The barrier pairs with the ones in WaitForTask: either we see the idle or
+  // leaving worker thread, or it sees our task.
+  const subtle::Atomic32 num_pending_tasks =
+      subtle::Barrier_AtomicIncrement(&num_pending_tasks_, 1);
+  if (subtle::Acquire_Load(&num_idle_threads_) > 0) {
+    AutoLock locked(lock_);
     tasks_available_cv_.Signal();
-  } else {
+  }
+
+  // We don't have enough worker threads.
+  if (num_pending_tasks > subtle::Acquire_Load(&num_free_threads_)) {
+    subtle::Barrier_AtomicIncrement(&num_free_threads_, 1);
     // The new PlatformThread will take ownership of the WorkerThread object,
     // which will delete itself on exit.
-    WorkerThread* worker =
-        new WorkerThread(name_prefix_, idle_seconds_before_exit_, this);
+    WorkerThread* worker = new WorkerThread(name_prefix_, NextQueue(), this);
     PlatformThread::CreateNonJoinable(kWorkerThreadStackSize, worker);
   }
 }
 
-Task* LinuxDynamicThreadPool::WaitForTask() {
-  AutoLock locked(lock_);
+Task* LinuxDynamicThreadPool::WaitForTask(int home_queue) {
+  for (;;) {
+    if (subtle::Acquire_Load(&terminated_))
+      break;
 
-  if (terminated_)
-    return NULL;
+    Task* task = TakeTask(home_queue);
+    if (task) {
+      subtle::Barrier_AtomicIncrement(&num_free_threads_, -1);
+      return task;
+    }
+
+    // Tasks often come in bursts, so look again for a little while before
+    // going to sleep.
+    for (int i = 0; i < kIdleSpinCount &&
+         subtle::NoBarrier_Load(&num_pending_tasks_) <= 0; ++i) {
+      PlatformThread::YieldCurrentThread();
+    }
+    if (subtle::Acquire_Load(&num_pending_tasks_) > 0)
+      continue;
 
-  if (tasks_.empty()) {  // No work available, wait for work.
-    num_idle_threads_++;
+    AutoLock locked(lock_);
+    if (subtle::NoBarrier_Load(&terminated_))
+      break;
+
+    subtle::Barrier_AtomicIncrement(&num_idle_threads_, 1);
     if (num_idle_threads_cv_.get())
       num_idle_threads_cv_->Signal();
-    tasks_available_cv_.TimedWait(
-        TimeDelta::FromSeconds(kIdleSecondsBeforeExit));
-    num_idle_threads_--;
+    if (subtle::Acquire_Load(&num_pending_tasks_) <= 0) {
+      tasks_available_cv_.TimedWait(
+          TimeDelta::FromSeconds(idle_seconds_before_exit_));
+    }
+    subtle::Barrier_AtomicIncrement(&num_idle_threads_, -1);
     if (num_idle_threads_cv_.get())
       num_idle_threads_cv_->Signal();
-    if (tasks_.empty()) {
-      // We waited for work, but there's still no work.  Return NULL to signal
-      // the thread to terminate.
-      return NULL;
+
+    if (subtle::Acquire_Load(&num_pending_tasks_) <= 0) {
+      // We waited for work, but there's still no work.  Leave the pool,
+      // unless a task came in before PostTask could see us leave.
+      subtle::Barrier_AtomicIncrement(&num_free_threads_, -1);
+      if (subtle::Acquire_Load(&num_pending_tasks_) <= 0)
+        return NULL;
+      subtle::Barrier_AtomicIncrement(&num_free_threads_, 1);
+    }
+  }
+
+  // The pool is terminated.
+  subtle::Barrier_AtomicIncrement(&num_free_threads_, -1);
+  return NULL;
+}
+
+void LinuxDynamicThreadPool::DidRunTask() {
+  subtle::Barrier_AtomicIncrement(&num_free_threads_, 1);
+}
+
+Task* LinuxDynamicThreadPool::TakeTask(int home_queue) {
+  for (int i = 0; i < num_queues_; ++i) {
+    TaskQueue& queue = queues_[(home_queue + i) % num_queues_];
+    Task* task = NULL;
+    {
+      AutoLock locked(queue.lock);
+      if (!queue.tasks.empty()) {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+      }
+    }
+    if (task) {
+      subtle::Barrier_AtomicIncrement(&num_pending_tasks_, -1);
+      return task;
     }
   }
+  return NULL;
+}
 
-  Task* task = tasks_.front();
-  tasks_.pop();
-  return task;
+int LinuxDynamicThreadPool::NextQueue() {
+  // The counter wraps around, so use its unsigned value.
+  return static_cast<uint32>(
+      subtle::NoBarrier_AtomicIncrement(&next_queue_, 1)) % num_queues_;
 }
 
 }  // namespace base
@@ -5,17 +5,23 @@
 // The thread pool used in the Linux implementation of WorkerPool dynamically
 // adds threads as necessary to handle all tasks.  It keeps old threads around
 // for a period of time to allow them to be reused.  After this waiting period,
-// the threads exit.  This thread pool uses non-joinable threads, therefore
-// worker threads are not joined during process shutdown.  This means that
-// potentially long running tasks (such as DNS lookup) do not block process
-// shutdown, but also means that process shutdown may "leak" objects.  Note that
-// although LinuxDynamicThreadPool spawns the worker threads and manages the
-// task queue, it does not own the worker threads.  The worker threads ask the
-// LinuxDynamicThreadPool for work and eventually clean themselves up.  The
-// worker threads all maintain scoped_refptrs to the LinuxDynamicThreadPool
-// instance, which prevents LinuxDynamicThreadPool from disappearing before all
-// worker threads exit.  The owner of LinuxDynamicThreadPool should likewise
-// maintain a scoped_refptr to the LinuxDynamicThreadPool instance.
+// the threads exit.  The tasks are spread over one queue per processor, each
+// with its own lock, so that posting threads and worker threads rarely contend.
+// A worker thread takes tasks from its own queue first, and steals from the
+// other queues when its own is empty.  Tasks posted from a worker thread go to
+// its own queue.  Before sleeping, an idle worker thread spins for a little
+// while, since tasks often come in bursts.  This thread pool uses non-joinable
+// threads, therefore worker threads are not joined during process shutdown.
+// This means that potentially long running tasks (such as DNS lookup) do not
+// block process shutdown, but also means that process shutdown may "leak"
+// objects.  Note that although LinuxDynamicThreadPool spawns the worker threads
+// and manages the task queues, it does not own the worker threads.  The worker
+// threads ask the LinuxDynamicThreadPool for work and eventually clean
+// themselves up.  The worker threads all maintain scoped_refptrs to the
+// LinuxDynamicThreadPool instance, which prevents LinuxDynamicThreadPool from
+// disappearing before all worker threads exit.  The owner of
+// LinuxDynamicThreadPool should likewise maintain a scoped_refptr to the
+// LinuxDynamicThreadPool instance.
 //
 // NOTE: The classes defined in this file are only meant for use by the Linux
 // implementation of WorkerPool.  No one else should be using these classes.
@@ -24,9 +30,10 @@
 #ifndef BASE_WORKER_POOL_LINUX_H_
 #define BASE_WORKER_POOL_LINUX_H_
 
-#include <queue>
+#include <deque>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/condition_variable.h"
 #include "base/lock.h"
@@ -58,24 +65,49 @@ class LinuxDynamicThreadPool
   void PostTask(Task* task);
 
   // Worker thread method to wait for up to |idle_seconds_before_exit| for more
-  // work from the thread pool.  Returns NULL if no work is available.
-  Task* WaitForTask();
+  // work from the thread pool.  The worker thread takes tasks from queue
+  // |home_queue| first.  Returns NULL if no work is available.
+  Task* WaitForTask(int home_queue);
+
+  // Called by a worker thread when it has run a task from WaitForTask.
+  void DidRunTask();
 
  private:
   friend class LinuxDynamicThreadPoolPeer;
 
+  struct TaskQueue {
+    Lock lock;
+    std::deque<Task*> tasks;
+  };
+
+  // Takes a task from queue |home_queue| or, if it is empty, from one of the
+  // other queues.  Returns NULL if all the queues are empty.
+  Task* TakeTask(int home_queue);
+
+  // Returns the index of the next queue, in turn.
+  int NextQueue();
+
   const std::string name_prefix_;
   const int idle_seconds_before_exit_;
 
-  Lock lock_;  // Protects all the variables below.
+  const int num_queues_;
+  scoped_array<TaskQueue> queues_;
+  // Incremented after a task is added to a queue, and decremented after it is
+  // taken, so that it may briefly be negative.
+  subtle::Atomic32 num_pending_tasks_;
+  // The number of worker threads that are not running a task.
+  subtle::Atomic32 num_free_threads_;
+  subtle::Atomic32 next_queue_;
+
+  Lock lock_;  // Protects the variables below, and the waiting for tasks.
 
   // Signal()s worker threads to let them know more tasks are available.
   // Also used for Broadcast()'ing to worker threads to let them know the pool
   // is being deleted and they can exit.
   ConditionVariable tasks_available_cv_;
-  int num_idle_threads_;
-  std::queue<Task*> tasks_;
-  bool terminated_;
+  // These two are only changed with |lock_| held, but also read without it.
+  subtle::Atomic32 num_idle_threads_;
+  subtle::Atomic32 terminated_;
   // Only used for tests to ensure correct thread ordering.  It will always be
   // NULL in non-test code.
   scoped_ptr<ConditionVariable> num_idle_threads_cv_;
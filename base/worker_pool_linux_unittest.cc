@@ -4,12 +4,16 @@
 
 #include "base/worker_pool_linux.h"
 
+#include <algorithm>
 #include <set>
 
 #include "base/condition_variable.h"
 #include "base/lock.h"
+#include "base/atomicops.h"
+#include "base/logging.h"
 #include "base/platform_thread.h"
 #include "base/task.h"
+#include "base/time.h"
 #include "base/waitable_event.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -25,8 +29,12 @@ class LinuxDynamicThreadPool::LinuxDynamicThreadPoolPeer {
   ConditionVariable* tasks_available_cv() {
     return &pool_->tasks_available_cv_;
   }
-  const std::queue<Task*>& tasks() const { return pool_->tasks_; }
-  int num_idle_threads() const { return pool_->num_idle_threads_; }
+  int num_pending_tasks() const {
+    return subtle::NoBarrier_Load(&pool_->num_pending_tasks_);
+  }
+  int num_idle_threads() const {
+    return subtle::NoBarrier_Load(&pool_->num_idle_threads_);
+  }
   ConditionVariable* num_idle_threads_cv() {
     return pool_->num_idle_threads_cv_.get();
   }
@@ -120,6 +128,27 @@ class BlockingIncrementingTask : public Task {
   DISALLOW_COPY_AND_ASSIGN(BlockingIncrementingTask);
 };
 
+// CountingTask counts down the number of remaining tasks, and signals a
+// WaitableEvent when it has run the last one.  It is cheap enough to measure
+// the overhead of the thread pool itself.
+class CountingTask : public Task {
+ public:
+  CountingTask(base::subtle::Atomic32* num_remaining, base::WaitableEvent* done)
+      : num_remaining_(num_remaining),
+        done_(done) {}
+
+  virtual void Run() {
+    if (base::subtle::Barrier_AtomicIncrement(num_remaining_, -1) == 0)
+      done_->Signal();
+  }
+
+ private:
+  base::subtle::Atomic32* num_remaining_;
+  base::WaitableEvent* done_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingTask);
+};
+
 class LinuxDynamicThreadPoolTest : public testing::Test {
  protected:
   LinuxDynamicThreadPoolTest()
@@ -180,7 +209,7 @@ class LinuxDynamicThreadPoolTest : public testing::Test {
 TEST_F(LinuxDynamicThreadPoolTest, Basic) {
   EXPECT_EQ(0, peer_.num_idle_threads());
   EXPECT_EQ(0U, unique_threads_.size());
-  EXPECT_EQ(0U, peer_.tasks().size());
+  EXPECT_EQ(0, peer_.num_pending_tasks());
 
   // Add one task and wait for it to be completed.
   pool_->PostTask(CreateNewIncrementingTask());
@@ -265,4 +294,37 @@ TEST_F(LinuxDynamicThreadPoolTest, Complex) {
   EXPECT_EQ(4, counter_);
 }
 
+TEST_F(LinuxDynamicThreadPoolTest, FanOutThroughput) {
+  const int kNumTasks = 100000;
+  base::subtle::Atomic32 num_remaining = kNumTasks;
+  base::WaitableEvent done(false, false);
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumTasks; ++i)
+    pool_->PostTask(new CountingTask(&num_remaining, &done));
+  done.Wait();
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(0, base::subtle::NoBarrier_Load(&num_remaining));
+  LOG(INFO) << "Ran " << kNumTasks << " tasks in " <<
+      elapsed.InMilliseconds() << " ms, " <<
+      kNumTasks / std::max(elapsed.InSecondsF(), 0.001) << " tasks/s.";
+}
+
+TEST_F(LinuxDynamicThreadPoolTest, PostLatency) {
+  const int kNumTasks = 1000;
+  base::WaitableEvent done(false, false);
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumTasks; ++i) {
+    base::subtle::Atomic32 num_remaining = 1;
+    pool_->PostTask(new CountingTask(&num_remaining, &done));
+    done.Wait();
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  LOG(INFO) << "Average round trip of a task: " <<
+      elapsed.InMicroseconds() / kNumTasks << " us.";
+}
+
 }  // namespace
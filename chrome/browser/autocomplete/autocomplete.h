@@ -53,6 +53,7 @@
 // HistoryURL (inexact match)                                          |  900++
 // Search Primary Provider (navigational suggestion)                   |  800++
 // HistoryContents (any match in title of nonstarred page)             |  700++
+// HistoryURL (substring match)                                        |  650++
 // Search Primary Provider (suggestion)                                |  600++
 // HistoryContents (any match in body of starred page)                 |  550++
 // HistoryContents (any match in body of nonstarred page)              |  500++
@@ -74,6 +75,7 @@
 // HistoryURL (inexact match)                                          |  900++
 // Search Primary Provider (navigational suggestion)                   |  800++
 // HistoryContents (any match in title of nonstarred page)             |  700++
+// HistoryURL (substring match)                                        |  650++
 // Search Primary Provider (suggestion)                                |  600++
 // HistoryContents (any match in body of starred page)                 |  550++
 // HistoryContents (any match in body of nonstarred page)              |  500++
@@ -94,6 +96,7 @@
 // Search Primary Provider (navigational suggestion)                   |  800++
 // Search Primary Provider (past query in history)                     |  750--
 // Keyword (inexact match)                                             |  700
+// HistoryURL (substring match)                                        |  650++
 // Search Primary Provider (suggestion)                                |  300++
 // Search Secondary Provider (what you typed)                          |  250
 // Search Secondary Provider (past query in history)                   |  200--
@@ -13,6 +13,7 @@
 #include "chrome/browser/history/history.h"
 #include "chrome/browser/history/history_backend.h"
 #include "chrome/browser/history/history_database.h"
+#include "chrome/browser/history/in_memory_url_index.h"
 #include "chrome/browser/net/url_fixer_upper.h"
 #include "chrome/browser/profile.h"
 #include "chrome/common/pref_names.h"
@@ -28,6 +29,18 @@ using base::Time;
 using base::TimeDelta;
 using base::TimeTicks;
 
+namespace {
+
+// The in-memory URL index is queried on the main thread as the user types.
+// While its recent queries take longer than this on average, it is skipped.
+const int kMaxIndexQueryTimeMs = 20;
+
+// Each query of the index makes up this fraction of the average query time.
+// The queries the index is skipped for count as instant ones.
+const int kIndexQueryTimeWeight = 4;  // 1/4
+
+}  // namespace
+
 HistoryURLProviderParams::HistoryURLProviderParams(
     const AutocompleteInput& input,
     bool trim_http,
@@ -229,6 +242,7 @@ void HistoryURLProvider::QueryComplete(
     return;  // Already set done_ when we canceled, no need to set it again.
 
   done_ = true;
+  AppendIndexMatches(params->index_matches, &params->matches);
   matches_.swap(params->matches);
   UpdateStarredStateOfMatches();
   listener_->OnProviderUpdate(true);
@@ -473,6 +487,9 @@ int HistoryURLProvider::CalculateRelevance(AutocompleteInput::Type input_type,
     case WHAT_YOU_TYPED:
       return (input_type == AutocompleteInput::REQUESTED_URL) ? 1300 : 1200;
 
+    case SUBSTRING:
+      return 650 + static_cast<int>(match_number);
+
     default:
       return 900 + static_cast<int>(match_number);
   }
@@ -594,6 +611,24 @@ void HistoryURLProvider::EnsureMatchPresent(
     matches->push_back(match);
 }
 
+// static
+void HistoryURLProvider::AppendIndexMatches(const ACMatches& index_matches,
+                                            ACMatches* matches) {
+  for (ACMatches::const_iterator i(index_matches.begin());
+       i != index_matches.end(); ++i) {
+    bool found = false;
+    for (ACMatches::const_iterator j(matches->begin()); j != matches->end();
+         ++j) {
+      if (j->destination_url == i->destination_url) {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      matches->push_back(*i);
+  }
+}
+
 void HistoryURLProvider::RunAutocompletePasses(
     const AutocompleteInput& input,
     bool fixup_input_and_run_pass_1) {
@@ -652,6 +687,21 @@ void HistoryURLProvider::RunAutocompletePasses(
     // tries to type immediately.
     if (url_db) {
       DoAutocomplete(NULL, url_db, params.get());
+
+      // The index is only there when it is enabled, and is looked up with the
+      // original input, since fixup is about URL prefixes.
+      history::InMemoryURLIndex* url_index =
+          history_service->in_memory_url_index();
+      if (url_index) {
+        if (index_query_time_ <=
+            TimeDelta::FromMilliseconds(kMaxIndexQueryTimeMs)) {
+          FindIndexMatches(url_index, input.text(), params.get());
+        } else {
+          index_query_time_ -= index_query_time_ / kIndexQueryTimeWeight;
+        }
+      }
+      AppendIndexMatches(params->index_matches, &params->matches);
+
       // params->matches now has the matches we should expose to the provider.
       // Pass 2 expects a "clean slate" set of matches.
       matches_.clear();
@@ -839,3 +889,47 @@ AutocompleteMatch HistoryURLProvider::HistoryMatchToACMatch(
 
   return match;
 }
+
+void HistoryURLProvider::FindIndexMatches(history::InMemoryURLIndex* index,
+                                          const std::wstring& text,
+                                          HistoryURLProviderParams* params) {
+  TimeTicks beginning_time = TimeTicks::Now();
+
+  std::vector<history::URLRow> url_matches;
+  index->FindURLsContaining(text, max_matches(), &url_matches);
+
+  TimeDelta query_time = TimeTicks::Now() - beginning_time;
+  HISTOGRAM_TIMES("Autocomplete.HistoryIndexQueryTime", query_time);
+  index_query_time_ += (query_time - index_query_time_) / kIndexQueryTimeWeight;
+
+  for (size_t i = 0; i < url_matches.size(); ++i) {
+    params->index_matches.push_back(IndexMatchToACMatch(params,
+        url_matches[i], url_matches.size() - 1 - i));
+  }
+}
+
+AutocompleteMatch HistoryURLProvider::IndexMatchToACMatch(
+    HistoryURLProviderParams* params,
+    const history::URLRow& info,
+    size_t match_number) {
+  AutocompleteMatch match(this,
+      CalculateRelevance(params->input.type(), SUBSTRING, match_number),
+      !!info.visit_count(), AutocompleteMatch::HISTORY_URL);
+  match.destination_url = info.url();
+  DCHECK(match.destination_url.is_valid());
+  match.fill_into_edit = net::FormatUrl(info.url(), params->languages);
+  if (params->trim_http)
+    TrimHttpPrefix(&match.fill_into_edit);
+
+  match.contents = match.fill_into_edit;
+  AutocompleteMatch::ClassifyMatchInString(params->input.text(),
+                                           match.contents,
+                                           ACMatchClassification::URL,
+                                           &match.contents_class);
+  match.description = info.title();
+  AutocompleteMatch::ClassifyMatchInString(params->input.text(), info.title(),
+                                           ACMatchClassification::NONE,
+                                           &match.description_class);
+
+  return match;
+}
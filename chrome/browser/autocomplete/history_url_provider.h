@@ -17,6 +17,7 @@ class Profile;
 
 namespace history {
 class HistoryBackend;
+class InMemoryURLIndex;
 }  // namespace history
 
 
@@ -34,6 +35,7 @@ class HistoryBackend;
 //         [params_ allocated]
 //         -> DoAutocomplete (for inline autocomplete)
 //           -> URLDatabase::AutocompleteForPrefix (on in-memory DB)
+//         -> FindIndexMatches (if the in-memory URL index is enabled)
 //         -> HistoryService::ScheduleAutocomplete
 //         (return to controller) ----
 //                                   /
@@ -58,6 +60,11 @@ class HistoryBackend;
 // two passes, so we can't just decide to use this pass' matches as the final
 // results.
 //
+// When the --enable-in-memory-url-index switch is given, the first pass also
+// looks up the URLs which contain the input anywhere in the in-memory URL
+// index.  These are kept aside and added after the prefix matches of both
+// passes, with a lower relevance.
+//
 // The second autocomplete pass uses the full history database, which must be
 // queried on the history thread.  Start() asks the history service schedule to
 // callback on the history thread with a pointer to the main database.  When we
@@ -107,6 +114,11 @@ struct HistoryURLProviderParams {
   // to matches_ on the main thread in QueryComplete().
   ACMatches matches;
 
+  // Matches found by the first pass in the in-memory URL index, which contain
+  // the input rather than start with it.  These are added after |matches| in
+  // both passes.
+  ACMatches index_matches;
+
   // Languages we should pass to gfx::GetCleanStringFromUrl.
   std::wstring languages;
 
@@ -237,7 +249,8 @@ class HistoryURLProvider : public AutocompleteProvider {
   enum MatchType {
     NORMAL,
     WHAT_YOU_TYPED,
-    INLINE_AUTOCOMPLETE
+    INLINE_AUTOCOMPLETE,
+    SUBSTRING
   };
 
   // Fixes up user URL input to make it more possible to match against.  Among
@@ -266,7 +279,8 @@ class HistoryURLProvider : public AutocompleteProvider {
   // Determines the relevance for some input, given its type and which match it
   // is.  If |match_type| is NORMAL, |match_number| is a number
   // [0, kMaxSuggestions) indicating the relevance of the match (higher == more
-  // relevant).  For other values of |match_type|, |match_number| is ignored.
+  // relevant).  The same goes for SUBSTRING.  For other values of
+  // |match_type|, |match_number| is ignored.
   static int CalculateRelevance(AutocompleteInput::Type input_type,
                                 MatchType match_type,
                                 size_t match_number);
@@ -304,6 +318,10 @@ class HistoryURLProvider : public AutocompleteProvider {
                                  HistoryMatches* matches,
                                  bool promote);
 
+  // Appends the matches of |index_matches| which are not in |matches| yet.
+  static void AppendIndexMatches(const ACMatches& index_matches,
+                                 ACMatches* matches);
+
   // Helper function that actually launches the two autocomplete passes.
   void RunAutocompletePasses(const AutocompleteInput& input,
                              bool fixup_input_and_run_pass_1);
@@ -370,6 +388,19 @@ class HistoryURLProvider : public AutocompleteProvider {
                                           MatchType match_type,
                                           size_t match_number);
 
+  // Fills params->index_matches with the URLs of |index| which contain the
+  // words of |text| anywhere.  Called on the main thread by the first pass.
+  void FindIndexMatches(history::InMemoryURLIndex* index,
+                        const std::wstring& text,
+                        HistoryURLProviderParams* params);
+
+  // Converts a URL found in the in-memory URL index into an autocomplete
+  // match.  Since the input is not a prefix of the URL, it is never inline
+  // autocompleted.
+  AutocompleteMatch IndexMatchToACMatch(HistoryURLProviderParams* params,
+                                        const history::URLRow& info,
+                                        size_t match_number);
+
   // This is only non-null for testing, otherwise the HistoryService from the
   // Profile is used.
   HistoryService* history_service_;
@@ -382,6 +413,12 @@ class HistoryURLProvider : public AutocompleteProvider {
   // parameter itself is freed once it's no longer needed.  The only reason we
   // keep this member is so we can set the cancel bit on it.
   HistoryURLProviderParams* params_;
+
+  // Moving average of the query times of the in-memory URL index.  The index
+  // is skipped while it is too high, so that a large history doesn't slow
+  // down typing, and it decays meanwhile, so that one slow query doesn't
+  // turn the index off for good.
+  base::TimeDelta index_query_time_;
 };
 
 #endif  // CHROME_BROWSER_AUTOCOMPLETE_HISTORY_URL_PROVIDER_H_
@@ -58,6 +58,7 @@
 #include "net/base/cookie_monster.h"
 #include "net/base/net_module.h"
 #include "net/http/http_network_session.h"
+#include "net/http/http_pipeline_manager.h"
 
 #if defined(OS_POSIX)
 // TODO(port): get rid of this include. It's used just to provide declarations
@@ -477,6 +478,9 @@ int BrowserMain(const MainFunctionParams& parameters) {
     net::CookieMonster::EnableFileScheme();
   }
 
+  if (parsed_command_line.HasSwitch(switches::kEnableHttpPipelining))
+    net::HttpPipelineManager::set_enabled(true);
+
   // Initialize histogram statistics gathering system.
   StatisticsRecorder statistics;
 
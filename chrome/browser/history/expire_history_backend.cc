@@ -9,6 +9,8 @@
 
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
+#include "base/histogram.h"
+#include "base/message_loop.h"
 #include "chrome/browser/bookmarks/bookmark_service.h"
 #include "chrome/browser/history/archived_database.h"
 #include "chrome/browser/history/history_database.h"
@@ -19,6 +21,7 @@
 
 using base::Time;
 using base::TimeDelta;
+using base::TimeTicks;
 
 namespace history {
 
@@ -122,6 +125,11 @@ const int kExpirationDelaySec = 30;
 // iteration, so we want to wait longer before checking to avoid wasting CPU.
 const int kExpirationEmptyDelayMin = 5;
 
+// The number of visits expired by each slice of a user requested expiration.
+// Each slice deletes everything related to its visits with a few statements,
+// so this bounds the time the history thread is blocked by each of them.
+const int kNumExpirePerSlice = 500;
+
 }  // namespace
 
 ExpireHistoryBackend::ExpireHistoryBackend(
@@ -133,10 +141,13 @@ ExpireHistoryBackend::ExpireHistoryBackend(
       thumb_db_(NULL),
       text_db_(NULL),
       ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(expiration_factory_(this)),
       bookmark_service_(bookmark_service) {
 }
 
 ExpireHistoryBackend::~ExpireHistoryBackend() {
+  for (size_t i = 0; i < expirations_.size(); i++)
+    delete expirations_[i].callback;
 }
 
 void ExpireHistoryBackend::SetDatabases(HistoryDatabase* main_db,
@@ -194,27 +205,53 @@ void ExpireHistoryBackend::ExpireHistoryBetween(Time begin_time,
   if (text_db_)
     text_db_->DeleteFromUncommitted(begin_time, end_time);
 
-  // Find the affected visits and delete them.
-  // TODO(brettw): bug 1171164: We should query the archived database here, too.
-  VisitVector visits;
-  main_db_->GetAllVisitsInRange(begin_time, end_time, 0, &visits);
-  if (visits.empty())
-    return;
+  // Expire the range in slices anyway, so that the memory used is bounded.
+  Expiration expiration;
+  expiration.begin_time = begin_time;
+  expiration.end_time = end_time;
+  expiration.next_time = begin_time;
+  while (DoExpirationSlice(&expiration, kNumExpirePerSlice)) {
+  }
 
-  DeleteDependencies dependencies;
-  DeleteVisitRelatedInfo(visits, &dependencies);
+  // Pick up any bits possibly left over.
+  ParanoidExpireHistory();
+}
 
-  // Delete or update the URLs affected. We want to update the visit counts
-  // since this is called by the user who wants to delete their recent history,
-  // and we don't want to leave any evidence.
-  ExpireURLsForVisits(visits, &dependencies);
-  DeleteFaviconsIfPossible(dependencies.affected_favicons);
+void ExpireHistoryBackend::ExpireHistoryBetweenIncrementally(Time begin_time,
+                                                             Time end_time,
+                                                             Task* callback) {
+  DCHECK(callback);
 
-  // An is_null begin time means that all history should be deleted.
-  BroadcastDeleteNotifications(&dependencies);
+  // A null |end_time| means no end. The other tasks run between the slices,
+  // so the range is bounded by the time of the request, to keep the visits
+  // added while it is being expired.
+  if (end_time.is_null())
+    end_time = Time::Now();
 
-  // Pick up any bits possibly left over.
-  ParanoidExpireHistory();
+  // The temporary cache of the text database manager is cleared right away,
+  // so that nothing from the range gets committed while the visits are being
+  // expired.
+  if (text_db_)
+    text_db_->DeleteFromUncommitted(begin_time, end_time);
+
+  Expiration expiration;
+  expiration.begin_time = begin_time;
+  expiration.end_time = end_time;
+  expiration.next_time = begin_time;
+  expiration.callback = callback;
+  expirations_.push_back(expiration);
+
+  // The first slice is done right away, so that small ranges are expired
+  // before the requests which follow. Otherwise, the slices of the expiration
+  // in progress will get to this one.
+  if (expirations_.size() == 1)
+    DoNextExpirationSlice();
+}
+
+void ExpireHistoryBackend::FinishIncrementalExpirations() {
+  while (!expirations_.empty())
+    DoNextExpirationSlice();
+  expiration_factory_.RevokeAll();
 }
 
 void ExpireHistoryBackend::ArchiveHistoryBefore(Time end_time) {
@@ -315,10 +352,10 @@ void ExpireHistoryBackend::BroadcastDeleteNotifications(
 void ExpireHistoryBackend::DeleteVisitRelatedInfo(
     const VisitVector& visits,
     DeleteDependencies* dependencies) {
-  for (size_t i = 0; i < visits.size(); i++) {
-    // Delete the visit itself.
-    main_db_->DeleteVisit(visits[i]);
+  // Delete the visits themselves.
+  main_db_->DeleteVisits(visits);
 
+  for (size_t i = 0; i < visits.size(); i++) {
     // Add the URL row to the affected URL list.
     std::map<URLID, URLRow>::const_iterator found =
         dependencies->affected_urls.find(visits[i].url_id);
@@ -334,7 +371,7 @@ void ExpireHistoryBackend::DeleteVisitRelatedInfo(
     }
 
     // Delete any associated full-text indexed data.
-    if (visits[i].is_indexed && text_db_) {
+    if (visits[i].is_indexed && text_db_ && !dependencies->text_deleted) {
       text_db_->DeletePageData(visits[i].visit_time, cur_row->url(),
                                &dependencies->text_db_changes);
     }
@@ -367,6 +404,38 @@ void ExpireHistoryBackend::DeleteOneURL(
   }
 }
 
+void ExpireHistoryBackend::DeleteURLs(const std::vector<URLRow>& urls,
+                                      DeleteDependencies* dependencies) {
+  if (urls.empty())
+    return;
+
+  std::vector<URLID> url_ids;
+  url_ids.reserve(urls.size());
+  for (size_t i = 0; i < urls.size(); i++) {
+    const URLRow& url_row = urls[i];
+
+    // Segments are deleted along with their usage, one URL at a time.
+    main_db_->DeleteSegmentForURL(url_row.id());
+
+    // The URL may be in the text database manager's temporary cache.
+    if (text_db_)
+      text_db_->DeleteURLFromUncommitted(url_row.url());
+
+    dependencies->deleted_urls.push_back(url_row);
+
+    // Collect shared information.
+    if (url_row.favicon_id())
+      dependencies->affected_favicons.insert(url_row.favicon_id());
+
+    url_ids.push_back(url_row.id());
+  }
+
+  // Delete stuff that references these URLs, and last, the URL entries.
+  if (thumb_db_)
+    thumb_db_->DeleteThumbnails(url_ids);
+  main_db_->DeleteURLRows(url_ids);
+}
+
 URLID ExpireHistoryBackend::ArchiveOneURL(const URLRow& url_row) {
   if (!archived_db_)
     return 0;
@@ -418,7 +487,9 @@ void ExpireHistoryBackend::ExpireURLsForVisits(
       cur.typed_count++;
   }
 
-  // Check each unique URL with deleted visits.
+  // Check each unique URL with deleted visits. The URLs to delete are deleted
+  // all at once at the end.
+  std::vector<URLRow> deleted_urls;
   BookmarkService* bookmark_service = GetBookmarkService();
   for (std::map<URLID, ChangedURL>::const_iterator i = changed_urls.begin();
        i != changed_urls.end(); ++i) {
@@ -441,7 +512,7 @@ void ExpireHistoryBackend::ExpireURLsForVisits(
         (bookmark_service && bookmark_service->IsBookmarked(url_row.url()));
     if (!is_bookmarked && url_row.last_visit().is_null()) {
       // Not bookmarked and no more visits. Nuke the url.
-      DeleteOneURL(url_row, is_bookmarked, dependencies);
+      deleted_urls.push_back(url_row);
     } else {
       // NOTE: The calls to std::max() below are a backstop, but they should
       // never actually be needed unless the database is corrupt (I think).
@@ -454,6 +525,7 @@ void ExpireHistoryBackend::ExpireURLsForVisits(
       main_db_->UpdateURLRow(url_row.id(), url_row);
     }
   }
+  DeleteURLs(deleted_urls, dependencies);
 }
 
 void ExpireHistoryBackend::ArchiveURLsAndVisits(
@@ -502,6 +574,141 @@ void ExpireHistoryBackend::ArchiveURLsAndVisits(
   }
 }
 
+bool ExpireHistoryBackend::ExpireSomeHistoryBetween(Expiration* expiration,
+                                                    int max_visits) {
+  DCHECK(max_visits > 0) << "slices have to be bounded";
+
+  VisitVector visits;
+  main_db_->GetAllVisitsInRange(expiration->next_time, expiration->end_time,
+                                max_visits, &visits);
+  bool more_to_expire = static_cast<int>(visits.size()) == max_visits;
+
+  // The full text index of the whole slice is deleted at once, rather than the
+  // data of each visit. When there are more visits, the slice ends with the
+  // time of the last visit, included.
+  Time text_end_time = expiration->end_time;
+  if (more_to_expire) {
+    text_end_time = Time::FromInternalValue(
+        visits.back().visit_time.ToInternalValue() + 1);
+  }
+  DeleteDependencies dependencies;
+  if (text_db_) {
+    text_db_->DeletePageDataBetween(expiration->next_time, text_end_time,
+                                    &dependencies.text_db_changes);
+    dependencies.text_deleted = true;
+  }
+  DeleteVisitRelatedInfo(visits, &dependencies);
+
+  // Delete or update the URLs affected. We want to update the visit counts
+  // since this is called by the user who wants to delete their recent history,
+  // and we don't want to leave any evidence.
+  ExpireURLsForVisits(visits, &dependencies);
+  DeleteFaviconsIfPossible(dependencies.affected_favicons);
+
+  BroadcastDeleteNotifications(&dependencies);
+
+  // Other visits may have the time of the last one, so the next slice begins
+  // at that time.
+  if (more_to_expire)
+    expiration->next_time = visits.back().visit_time;
+  expiration->progress.visits_deleted += static_cast<int>(visits.size());
+  expiration->progress.urls_deleted +=
+      static_cast<int>(dependencies.deleted_urls.size());
+  return more_to_expire;
+}
+
+bool ExpireHistoryBackend::ExpireSomeArchivedHistoryBetween(
+    Expiration* expiration,
+    int max_visits) {
+  VisitVector visits;
+  archived_db_->GetAllVisitsInRange(expiration->next_time,
+                                    expiration->end_time, max_visits, &visits);
+  bool more_to_expire = static_cast<int>(visits.size()) == max_visits;
+  archived_db_->DeleteVisits(visits);
+
+  // Archived URLs don't have thumbnails, favicons or a full text index, so we
+  // only have to delete the ones which don't have any visit left.
+  std::set<URLID> affected_url_ids;
+  for (size_t i = 0; i < visits.size(); i++)
+    affected_url_ids.insert(visits[i].url_id);
+  std::vector<URLID> deleted_url_ids;
+  for (std::set<URLID>::const_iterator i = affected_url_ids.begin();
+       i != affected_url_ids.end(); ++i) {
+    if (!archived_db_->GetMostRecentVisitForURL(*i, NULL))
+      deleted_url_ids.push_back(*i);
+  }
+  archived_db_->DeleteURLRows(deleted_url_ids);
+
+  if (more_to_expire)
+    expiration->next_time = visits.back().visit_time;
+  expiration->progress.visits_deleted += static_cast<int>(visits.size());
+  return more_to_expire;
+}
+
+bool ExpireHistoryBackend::DoExpirationSlice(Expiration* expiration,
+                                             int max_visits) {
+  TimeTicks begin_ticks = TimeTicks::Now();
+
+  bool more_to_expire = false;
+  if (!expiration->archived) {
+    more_to_expire = ExpireSomeHistoryBetween(expiration, max_visits);
+    if (!more_to_expire) {
+      // Continue with the archived database, from the beginning of the range.
+      // It rarely has visits in the range, so this is done in the same slice.
+      expiration->archived = true;
+      expiration->next_time = expiration->begin_time;
+    }
+  }
+  if (expiration->archived && !more_to_expire && archived_db_)
+    more_to_expire = ExpireSomeArchivedHistoryBetween(expiration, max_visits);
+
+  TimeDelta slice_time = TimeTicks::Now() - begin_ticks;
+  HISTOGRAM_TIMES("History.ExpireBetween.SliceTime", slice_time);
+  expiration->progress.slices++;
+  expiration->progress.time_spent += slice_time;
+  return more_to_expire;
+}
+
+void ExpireHistoryBackend::ScheduleExpirationSlice() {
+  MessageLoop::current()->PostTask(FROM_HERE,
+      expiration_factory_.NewRunnableMethod(
+          &ExpireHistoryBackend::DoNextExpirationSlice));
+}
+
+void ExpireHistoryBackend::DoNextExpirationSlice() {
+  DCHECK(!expirations_.empty()) << "no expiration in progress";
+
+  Expiration& expiration = expirations_.front();
+  if (main_db_ && DoExpirationSlice(&expiration, kNumExpirePerSlice)) {
+    // Let the other tasks run before the next slice.
+    ScheduleExpirationSlice();
+    return;
+  }
+
+  // Pick up any bits possibly left over.
+  if (main_db_)
+    ParanoidExpireHistory();
+
+  const ExpirationProgress& progress = expiration.progress;
+  HISTOGRAM_COUNTS("History.ExpireBetween.Slices", progress.slices);
+  HISTOGRAM_COUNTS("History.ExpireBetween.Visits", progress.visits_deleted);
+  HISTOGRAM_TIMES("History.ExpireBetween.Time", progress.time_spent);
+  if (progress.time_spent.InMilliseconds() > 0) {
+    HISTOGRAM_COUNTS("History.ExpireBetween.VisitsPerSecond",
+        static_cast<int>(progress.visits_deleted * 1000 /
+                         progress.time_spent.InMilliseconds()));
+  }
+  last_expiration_progress_ = progress;
+
+  Task* callback = expiration.callback;
+  expirations_.pop_front();
+  if (!expirations_.empty())
+    ScheduleExpirationSlice();
+
+  callback->Run();
+  delete callback;
+}
+
 void ExpireHistoryBackend::ScheduleArchive() {
   TimeDelta delay;
   if (work_queue_.empty()) {
@@ -5,6 +5,7 @@
 #ifndef CHROME_BROWSER_HISTORY_EXPIRE_HISTORY_BACKEND_H__
 #define CHROME_BROWSER_HISTORY_EXPIRE_HISTORY_BACKEND_H__
 
+#include <deque>
 #include <queue>
 #include <set>
 #include <vector>
@@ -50,6 +51,23 @@ class ExpiringVisitsReader {
 
 typedef std::vector<const ExpiringVisitsReader*> ExpiringVisitsReaders;
 
+// Counts the work done by an incremental expiration, see
+// ExpireHistoryBackend::ExpireHistoryBetweenIncrementally.
+struct ExpirationProgress {
+  ExpirationProgress() : slices(0), visits_deleted(0), urls_deleted(0) {}
+
+  // The number of tasks the expiration has been split into so far.
+  int slices;
+
+  // The visits deleted from the main and archived databases, and the URLs
+  // deleted from the main database.
+  int visits_deleted;
+  int urls_deleted;
+
+  // The time spent expiring, not counting the time between the slices.
+  base::TimeDelta time_spent;
+};
+
 // Helper component to HistoryBackend that manages expiration and deleting of
 // history, as well as moving data from the main database to the archived
 // database as it gets old.
@@ -82,6 +100,32 @@ class ExpireHistoryBackend {
   // Removes all visits in the given time range, updating the URLs accordingly.
   void ExpireHistoryBetween(base::Time begin_time, base::Time end_time);
 
+  // Like ExpireHistoryBetween, but removes a bounded number of visits per
+  // task, letting the other tasks of the history thread run in between,
+  // so that expiring a large range doesn't block autocomplete and the visited
+  // links for seconds. Expirations requested while another one is in progress
+  // are done after it. A null |end_time| stands for the time of the request,
+  // so that the visits added meanwhile are kept. Takes ownership of
+  // |callback|, which is run once the whole range is expired (it is deleted
+  // without being run if this class is deleted first).
+  void ExpireHistoryBetweenIncrementally(base::Time begin_time,
+                                         base::Time end_time,
+                                         Task* callback);
+
+  // Does all the remaining work of the incremental expirations right away, and
+  // runs their callbacks. This is used when the history is shutting down.
+  void FinishIncrementalExpirations();
+
+  // Returns true while an incremental expiration is in progress.
+  bool IsExpiringIncrementally() const { return !expirations_.empty(); }
+
+  // Returns the progress of the current incremental expiration, or of the last
+  // one if none is in progress.
+  const ExpirationProgress& expiration_progress() const {
+    return expirations_.empty() ? last_expiration_progress_ :
+                                  expirations_.front().progress;
+  }
+
   // Archives all visits before and including the given time, updating the URLs
   // accordingly. This function is intended for migrating old databases
   // (which encompased all time) to the tiered structure and testing, and
@@ -101,9 +145,12 @@ class ExpireHistoryBackend {
   FRIEND_TEST(ExpireHistoryTest, DeleteFaviconsIfPossible);
   FRIEND_TEST(ExpireHistoryTest, ArchiveSomeOldHistory);
   FRIEND_TEST(ExpireHistoryTest, ExpiringVisitsReader);
+  FRIEND_TEST(ExpireHistoryTest, ExpireSomeHistoryBetween);
   friend class ::TestingProfile;
 
   struct DeleteDependencies {
+    DeleteDependencies() : text_deleted(false) {}
+
     // The time range affected. These can be is_null() to be unbounded in one
     // or both directions.
     base::Time begin_time, end_time;
@@ -127,6 +174,31 @@ class ExpireHistoryBackend {
     // Tracks the set of databases that have changed so we can optimize when
     // when we're done.
     TextDatabaseManager::ChangeSet text_db_changes;
+
+    // Set when the full text index of the affected time range was already
+    // deleted at once, so DeleteVisitRelatedInfo doesn't delete it per visit.
+    bool text_deleted;
+  };
+
+  // An expiration requested by ExpireHistoryBetweenIncrementally.
+  struct Expiration {
+    Expiration() : archived(false), callback(NULL) {}
+
+    // The time range to expire. Either time can be is_null() to be unbounded.
+    base::Time begin_time, end_time;
+
+    // The beginning of the next slice. It advances from |begin_time| as the
+    // visits are expired.
+    base::Time next_time;
+
+    // Set once the main database is done, when the visits of the archived
+    // database are expired (if there is an archived database).
+    bool archived;
+
+    // Run when done, owned by us.
+    Task* callback;
+
+    ExpirationProgress progress;
   };
 
   // Removes the data from the full text index associated with the given URL
@@ -181,8 +253,9 @@ class ExpireHistoryBackend {
   // Assumes the archived database is not NULL.
   URLID ArchiveOneURL(const URLRow& url_row);
 
-  // Deletes all the URLs in the given vector and handles their dependencies.
-  // This will delete starred URLs
+  // Deletes all the URLs in the given vector and handles their dependencies,
+  // like DeleteOneURL for unbookmarked URLs, but deleting the rows of all of
+  // them at once. This will delete starred URLs.
   void DeleteURLs(const std::vector<URLRow>& urls,
                   DeleteDependencies* dependencies);
 
@@ -222,6 +295,29 @@ class ExpireHistoryBackend {
   // Broadcast the URL deleted notification.
   void BroadcastDeleteNotifications(DeleteDependencies* dependencies);
 
+  // Expires the oldest |max_visits| visits remaining in the time range of
+  // |expiration|, from the main database, and advances its next slice time.
+  // The full text index, URLs, thumbnails and favicons of the visits are
+  // deleted with a few statements for the whole slice. Returns true if there
+  // might be more visits to expire in the range.
+  bool ExpireSomeHistoryBetween(Expiration* expiration, int max_visits);
+
+  // Same as ExpireSomeHistoryBetween for the archived database. The archived
+  // URLs are deleted when they have no more visits.
+  bool ExpireSomeArchivedHistoryBetween(Expiration* expiration,
+                                        int max_visits);
+
+  // Expires the next slice of |expiration| from the main database, and then
+  // from the archived one. Returns true if there might be more to expire.
+  bool DoExpirationSlice(Expiration* expiration, int max_visits);
+
+  // Posts a task to call DoNextExpirationSlice.
+  void ScheduleExpirationSlice();
+
+  // Expires the next slice of the first expiration of the queue, and schedules
+  // another slice, or runs its callback when it is done.
+  void DoNextExpirationSlice();
+
   // Schedules a call to DoArchiveIteration.
   void ScheduleArchive();
 
@@ -271,6 +367,16 @@ class ExpireHistoryBackend {
   // automatically canceled when this class is deleted.
   ScopedRunnableMethodFactory<ExpireHistoryBackend> factory_;
 
+  // Same as factory_ for the slices of the incremental expirations. It is
+  // separate since ScheduleArchive revokes the tasks of factory_.
+  ScopedRunnableMethodFactory<ExpireHistoryBackend> expiration_factory_;
+
+  // The incremental expirations, the first one being in progress.
+  std::deque<Expiration> expirations_;
+
+  // The progress of the last incremental expiration that completed.
+  ExpirationProgress last_expiration_progress_;
+
   // The threshold for "old" history where we will automatically expire it to
   // the archived database.
   base::TimeDelta expiration_threshold_;
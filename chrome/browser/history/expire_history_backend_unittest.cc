@@ -740,6 +740,105 @@ TEST_F(ExpireHistoryTest, ExpiringVisitsReader) {
   EXPECT_EQ(1U, visits.size());
 }
 
+// Tests that ExpireSomeHistoryBetween expires the oldest visits of the range
+// and advances it, and deletes everything related to them.
+TEST_F(ExpireHistoryTest, ExpireSomeHistoryBetween) {
+  URLID url_ids[3];
+  Time visit_times[4];
+  AddExampleData(url_ids, visit_times);
+
+  URLRow url_row0, url_row1;
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[0], &url_row0));
+  ASSERT_TRUE(main_db_->GetURLRow(url_ids[1], &url_row1));
+
+  ExpireHistoryBackend::Expiration expiration;
+  expiration.begin_time = visit_times[0];
+  expiration.end_time = visit_times[3];
+  expiration.next_time = visit_times[0];
+
+  // The first slice deletes the first visit and its URL.
+  EXPECT_TRUE(expirer_.ExpireSomeHistoryBetween(&expiration, 1));
+  EXPECT_TRUE(expiration.next_time == visit_times[0]);
+  EnsureURLInfoGone(url_row0);
+
+  // Its favicon is kept, since the middle URL uses it too.
+  EXPECT_TRUE(HasFavIcon(url_row0.favicon_id()));
+
+  // The next one deletes the first visit of the middle URL, which stays.
+  EXPECT_TRUE(expirer_.ExpireSomeHistoryBetween(&expiration, 1));
+  EXPECT_TRUE(expiration.next_time == visit_times[1]);
+  VisitVector visits;
+  main_db_->GetVisitsForURL(url_ids[1], &visits);
+  EXPECT_EQ(1U, visits.size());
+
+  // Then the last visit in the range, and the middle URL.
+  ClearLastNotifications();
+  EXPECT_FALSE(expirer_.ExpireSomeHistoryBetween(&expiration, 2));
+  EnsureURLInfoGone(url_row1);
+  EXPECT_FALSE(HasFavIcon(url_row1.favicon_id()));
+
+  // The last visit is out of the range.
+  visits.clear();
+  main_db_->GetVisitsForURL(url_ids[2], &visits);
+  EXPECT_EQ(1U, visits.size());
+
+  EXPECT_EQ(3, expiration.progress.visits_deleted);
+  EXPECT_EQ(2, expiration.progress.urls_deleted);
+}
+
+// Tests that ExpireHistoryBetweenIncrementally expires large ranges over
+// several tasks, from the main and the archived databases.
+TEST_F(ExpireHistoryTest, ExpireHistoryBetweenIncrementally) {
+  // More visits than there are in two slices, all to the same URL.
+  const int kVisitCount = 1200;
+  URLRow url_row(GURL("http://www.google.com/"));
+  url_row.set_visit_count(kVisitCount);
+  URLID url_id = main_db_->AddURL(url_row);
+  Time begin_time = now_ - TimeDelta::FromDays(1);
+  main_db_->BeginTransaction();
+  for (int i = 0; i < kVisitCount; i++) {
+    VisitRow visit(url_id, begin_time + TimeDelta::FromSeconds(i), 0,
+                   PageTransition::LINK, 0);
+    main_db_->AddVisit(&visit);
+  }
+  main_db_->CommitTransaction();
+
+  // And one archived visit in the range.
+  URLID archived_url_id = archived_db_->AddURL(url_row);
+  VisitRow archived_visit(archived_url_id, begin_time, 0,
+                          PageTransition::TYPED, 0);
+  archived_db_->AddVisit(&archived_visit);
+
+  // The first slice is done right away, and the others later.
+  expirer_.ExpireHistoryBetweenIncrementally(begin_time, Time(),
+                                             new MessageLoop::QuitTask);
+  EXPECT_TRUE(expirer_.IsExpiringIncrementally());
+  EXPECT_EQ(1, expirer_.expiration_progress().slices);
+  VisitVector visits;
+  main_db_->GetVisitsForURL(url_id, &visits);
+  EXPECT_LT(0U, visits.size());
+  EXPECT_GT(static_cast<size_t>(kVisitCount), visits.size());
+
+  MessageLoop::current()->Run();
+  EXPECT_FALSE(expirer_.IsExpiringIncrementally());
+
+  // Everything is gone.
+  visits.clear();
+  main_db_->GetVisitsForURL(url_id, &visits);
+  EXPECT_EQ(0U, visits.size());
+  URLRow temp_row;
+  EXPECT_FALSE(main_db_->GetURLRow(url_id, &temp_row));
+  visits.clear();
+  archived_db_->GetVisitsForURL(archived_url_id, &visits);
+  EXPECT_EQ(0U, visits.size());
+  EXPECT_FALSE(archived_db_->GetURLRow(archived_url_id, &temp_row));
+
+  const ExpirationProgress& progress = expirer_.expiration_progress();
+  EXPECT_EQ(3, progress.slices);
+  EXPECT_EQ(kVisitCount + 1, progress.visits_deleted);
+  EXPECT_EQ(1, progress.urls_deleted);
+}
+
 // TODO(brettw) add some visits with no URL to make sure everything is updated
 // properly. Have the visits also refer to nonexistant FTS rows.
 //
@@ -40,6 +40,7 @@
 #include "chrome/browser/history/history_types.h"
 #include "chrome/browser/history/in_memory_database.h"
 #include "chrome/browser/history/in_memory_history_backend.h"
+#include "chrome/browser/history/in_memory_url_index.h"
 #include "chrome/browser/profile.h"
 #include "chrome/browser/visitedlink_master.h"
 #include "chrome/common/chrome_constants.h"
@@ -185,6 +186,12 @@ history::URLDatabase* HistoryService::in_memory_database() const {
   return NULL;
 }
 
+history::InMemoryURLIndex* HistoryService::in_memory_url_index() const {
+  if (in_memory_backend_.get())
+    return in_memory_backend_->index();
+  return NULL;
+}
+
 void HistoryService::SetSegmentPresentationIndex(int64 segment_id, int index) {
   ScheduleAndForget(PRIORITY_UI,
                     &HistoryBackend::SetSegmentPresentationIndex,
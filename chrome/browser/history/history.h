@@ -48,6 +48,7 @@ class InMemoryHistoryBackend;
 class HistoryBackend;
 class HistoryDatabase;
 class HistoryQueryTest;
+class InMemoryURLIndex;
 class URLDatabase;
 
 }  // namespace history
@@ -133,6 +134,12 @@ class HistoryService : public CancelableRequestProvider,
   // TODO(brettw) this should return the InMemoryHistoryBackend.
   history::URLDatabase* in_memory_database() const;
 
+  // Returns the word index of the in-memory URL database, which finds URLs
+  // containing some text anywhere in their URL or title. The same rules as
+  // for in_memory_database() apply, and it is NULL unless the
+  // --enable-in-memory-url-index switch is given.
+  history::InMemoryURLIndex* in_memory_url_index() const;
+
   // Navigation ----------------------------------------------------------------
 
   // Adds the given canonical URL to history with the current time as the visit
@@ -229,6 +229,10 @@ void HistoryBackend::Closing() {
   // release that reference before we can be destroyed.
   CancelScheduledCommit();
 
+  // Finish deleting the history the user asked to delete, rather than leaving
+  // it on disk. This also releases the references the expirations have.
+  expirer_.FinishIncrementalExpirations();
+
   // Release our reference to the delegate, this reference will be keeping the
   // history service alive.
   delegate_.reset();
@@ -1704,15 +1708,27 @@ void HistoryBackend::ExpireHistoryBetween(
       // possibility of an information leak.
       DeleteAllHistory();
     } else {
-      // Clearing parts of history, have the expirer do the depend
-      expirer_.ExpireHistoryBetween(begin_time, end_time);
-
-      // Force a commit, if the user is deleting something for privacy reasons,
-      // we want to get it on disk ASAP.
-      Commit();
+      // Clearing parts of history, have the expirer do the depend. A large
+      // range is deleted a slice at a time, so that the other requests aren't
+      // blocked meanwhile.
+      expirer_.ExpireHistoryBetweenIncrementally(begin_time, end_time,
+          NewRunnableMethod(this, &HistoryBackend::OnHistoryBetweenExpired,
+                            request, begin_time, end_time));
+      return;
     }
   }
 
+  OnHistoryBetweenExpired(request, begin_time, end_time);
+}
+
+void HistoryBackend::OnHistoryBetweenExpired(
+    scoped_refptr<ExpireHistoryRequest> request,
+    Time begin_time,
+    Time end_time) {
+  // Force a commit, if the user is deleting something for privacy reasons, we
+  // want to get it on disk ASAP.
+  Commit();
+
   if (begin_time <= first_recorded_time_)
     db_->GetStartDate(&first_recorded_time_);
 
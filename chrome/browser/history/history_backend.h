@@ -108,8 +108,8 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   void Init();
 
   // Notification that the history system is shutting down. This will break
-  // the refs owned by the delegate and any pending transaction so it will
-  // actually be deleted.
+  // the refs owned by the delegate, any pending transaction and any pending
+  // expiration so it will actually be deleted.
   void Closing();
 
   // See NotifyRenderProcessHostDestruction.
@@ -249,7 +249,8 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
 
   void DeleteURL(const GURL& url);
 
-  // Calls ExpireHistoryBackend::ExpireHistoryBetween and commits the change.
+  // Calls ExpireHistoryBackend::ExpireHistoryBetweenIncrementally, and
+  // commits the change and replies to the request once it is done.
   void ExpireHistoryBetween(scoped_refptr<ExpireHistoryRequest> request,
                             base::Time begin_time,
                             base::Time end_time);
@@ -412,6 +413,12 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   // so we need to handle this type of operation to keep the pointers in sync.
   void DeleteAllHistory();
 
+  // Called when the history between the given times has been deleted by
+  // ExpireHistoryBetween, to commit the change and reply to the request.
+  void OnHistoryBetweenExpired(scoped_refptr<ExpireHistoryRequest> request,
+                               base::Time begin_time,
+                               base::Time end_time);
+
   // Given a vector of all URLs that we will keep, removes all thumbnails
   // referenced by any URL, and also all favicons that aren't used by those
   // URLs. The favicon IDs will change, so this will update the url rows in the
@@ -477,6 +477,50 @@ TEST_F(HistoryBackendTest, KeywordGenerated) {
   ASSERT_EQ(0, backend_->db()->GetRowForURL(url, &row));
 }
 
+// Tests that the pages added while a range without an end is being expired
+// incrementally are kept.
+TEST_F(HistoryBackendTest, ExpireIncrementallyKeepsNewVisits) {
+  ASSERT_TRUE(backend_.get());
+
+  // More visits than there are in a slice.
+  const int kVisitCount = 1200;
+  URLRow old_row(GURL("http://www.google.com/"));
+  old_row.set_visit_count(kVisitCount);
+  URLID old_url_id = backend_->db()->AddURL(old_row);
+  Time begin_time = Time::Now() - base::TimeDelta::FromDays(1);
+  for (int i = 0; i < kVisitCount; i++) {
+    VisitRow visit(old_url_id, begin_time + base::TimeDelta::FromSeconds(i),
+                   0, PageTransition::LINK, 0);
+    backend_->db()->AddVisit(&visit);
+  }
+
+  backend_->expire_backend()->ExpireHistoryBetweenIncrementally(
+      begin_time, Time(), new MessageLoop::QuitTask);
+  ASSERT_TRUE(backend_->expire_backend()->IsExpiringIncrementally());
+
+  // A page visited between the slices.
+  GURL new_url("http://www.example.com/");
+  scoped_refptr<HistoryAddPageArgs> request(
+      new HistoryAddPageArgs(new_url, Time::Now(), NULL, 0, GURL(),
+                             history::RedirectList(), PageTransition::TYPED,
+                             false));
+  backend_->AddPage(request);
+
+  MessageLoop::current()->Run();
+  EXPECT_FALSE(backend_->expire_backend()->IsExpiringIncrementally());
+
+  // The old visits are gone, the new one is kept.
+  VisitVector visits;
+  backend_->db()->GetVisitsForURL(old_url_id, &visits);
+  EXPECT_TRUE(visits.empty());
+  URLRow new_row;
+  URLID new_url_id = backend_->db()->GetRowForURL(new_url, &new_row);
+  ASSERT_NE(0, new_url_id);
+  visits.clear();
+  backend_->db()->GetVisitsForURL(new_url_id, &visits);
+  EXPECT_EQ(1U, visits.size());
+}
+
 TEST_F(HistoryBackendTest, ClientRedirect) {
   ASSERT_TRUE(backend_.get());
 
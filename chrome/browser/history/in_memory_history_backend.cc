@@ -4,10 +4,13 @@
 
 #include "chrome/browser/history/in_memory_history_backend.h"
 
+#include "base/command_line.h"
 #include "chrome/browser/browser_process.h"
 #include "chrome/browser/history/history_notifications.h"
 #include "chrome/browser/history/in_memory_database.h"
+#include "chrome/browser/history/in_memory_url_index.h"
 #include "chrome/browser/profile.h"
+#include "chrome/common/chrome_switches.h"
 #include "chrome/common/notification_service.h"
 
 namespace history {
@@ -25,7 +28,18 @@ InMemoryHistoryBackend::~InMemoryHistoryBackend() {
 
 bool InMemoryHistoryBackend::Init(const std::wstring& history_filename) {
   db_.reset(new InMemoryDatabase);
-  return db_->InitFromDisk(history_filename);
+  if (!db_->InitFromDisk(history_filename))
+    return false;
+
+  // Index the URLs which were just loaded, if substring matching is enabled.
+  // On failure, it is just not available.
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kEnableInMemoryURLIndex)) {
+    index_.reset(new InMemoryURLIndex);
+    if (!index_->Init(db_.get()))
+      index_.reset();
+  }
+  return true;
 }
 
 void InMemoryHistoryBackend::AttachToHistoryService(Profile* profile) {
@@ -93,7 +107,10 @@ void InMemoryHistoryBackend::OnTypedURLsModified(
     if (id)
       db_->UpdateURLRow(id, *i);
     else
-      db_->AddURL(*i);
+      id = db_->AddURL(*i);
+
+    if (index_.get() && id)
+      index_->UpdateURL(id, *i);
   }
 }
 
@@ -106,6 +123,8 @@ void InMemoryHistoryBackend::OnURLsDeleted(const URLsDeletedDetails& details) {
     db_.reset(new InMemoryDatabase);
     if (!db_->InitFromScratch())
       db_.reset();
+    if (index_.get() && (!db_.get() || !index_->Init(db_.get())))
+      index_.reset();
     return;
   }
 
@@ -117,6 +136,8 @@ void InMemoryHistoryBackend::OnURLsDeleted(const URLsDeletedDetails& details) {
       // We typically won't have most of them since we only have a subset of
       // history, so ignore errors.
       db_->DeleteURLRow(id);
+      if (index_.get())
+        index_->DeleteURL(id);
     }
   }
 }
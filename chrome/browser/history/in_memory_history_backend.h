@@ -4,7 +4,8 @@
 
 // Contains the history backend wrapper around the in-memory URL database. This
 // object maintains an in-memory cache of the subset of history required to do
-// in-line autocomplete.
+// in-line autocomplete, and an index of the words of its URLs and titles for
+// substring matching.
 //
 // It is created on the history thread and passed to the main thread where
 // operations can be completed synchronously. It listenes for notifications
@@ -27,6 +28,7 @@ class Profile;
 namespace history {
 
 class InMemoryDatabase;
+class InMemoryURLIndex;
 
 class InMemoryHistoryBackend : public NotificationObserver {
  public:
@@ -48,6 +50,13 @@ class InMemoryHistoryBackend : public NotificationObserver {
     return db_.get();
   }
 
+  // Returns the word index of the URLs of the database. This is kept in sync
+  // with the database and MAY BE NULL in the same cases, or when it is not
+  // enabled.
+  InMemoryURLIndex* index() const {
+    return index_.get();
+  }
+
   // Notification callback.
   virtual void Observe(NotificationType type,
                        const NotificationSource& source,
@@ -66,6 +75,8 @@ class InMemoryHistoryBackend : public NotificationObserver {
 
   scoped_ptr<InMemoryDatabase> db_;
 
+  scoped_ptr<InMemoryURLIndex> index_;
+
   // The profile that this object is attached. May be NULL before
   // initialization.
   Profile* profile_;
@@ -0,0 +1,292 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/in_memory_url_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "app/l10n_util.h"
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/word_iterator.h"
+#include "chrome/browser/history/url_database.h"
+
+namespace history {
+
+namespace {
+
+// Inserts |word_id| into the sorted |word_ids|.
+void InsertWordID(int word_id, std::vector<int>* word_ids) {
+  word_ids->insert(
+      std::lower_bound(word_ids->begin(), word_ids->end(), word_id), word_id);
+}
+
+// Removes |word_id| from the sorted |word_ids|.
+void EraseWordID(int word_id, std::vector<int>* word_ids) {
+  std::vector<int>::iterator found =
+      std::lower_bound(word_ids->begin(), word_ids->end(), word_id);
+  if (found != word_ids->end() && *found == word_id)
+    word_ids->erase(found);
+}
+
+// Orders the word lists by size, so that the smallest are intersected first.
+bool CompareWordIDsSize(const std::vector<int>* a,
+                        const std::vector<int>* b) {
+  return a->size() < b->size();
+}
+
+}  // namespace
+
+InMemoryURLIndex::InMemoryURLIndex() : db_(NULL) {
+}
+
+InMemoryURLIndex::~InMemoryURLIndex() {
+}
+
+bool InMemoryURLIndex::Init(URLDatabase* db) {
+  Clear();
+  db_ = db;
+
+  URLDatabase::URLEnumerator enumerator;
+  if (!db->InitURLEnumeratorForEverything(&enumerator))
+    return false;
+
+  URLRow row;
+  while (enumerator.GetNextURL(&row))
+    UpdateURL(row.id(), row);
+  return true;
+}
+
+void InMemoryURLIndex::UpdateURL(URLID url_id, const URLRow& row) {
+  DeleteURL(url_id);
+  if (row.hidden())
+    return;  // Like AutocompleteForPrefix, never return hidden URLs.
+
+  IndexedURL& indexed_url = urls_[url_id];
+  indexed_url.id = url_id;
+  indexed_url.typed_count = row.typed_count();
+  indexed_url.visit_count = row.visit_count();
+  indexed_url.last_visit = row.last_visit();
+
+  std::set<std::wstring> words;
+  ExtractWords(UTF8ToWide(row.url().spec()), &words);
+  ExtractWords(row.title(), &words);
+
+  indexed_url.word_ids.reserve(words.size());
+  for (std::set<std::wstring>::const_iterator i = words.begin();
+       i != words.end(); ++i) {
+    WordID word_id = GetOrAddWord(*i);
+    word_urls_[word_id].insert(url_id);
+    indexed_url.word_ids.push_back(word_id);
+  }
+}
+
+void InMemoryURLIndex::DeleteURL(URLID url_id) {
+  base::hash_map<URLID, IndexedURL>::iterator found = urls_.find(url_id);
+  if (found == urls_.end())
+    return;
+
+  const WordIDs& word_ids = found->second.word_ids;
+  for (WordIDs::const_iterator i = word_ids.begin(); i != word_ids.end();
+       ++i) {
+    word_urls_[*i].erase(url_id);
+    if (word_urls_[*i].empty())
+      RemoveWord(*i);
+  }
+  urls_.erase(found);
+}
+
+void InMemoryURLIndex::Clear() {
+  words_.clear();
+  word_ids_.clear();
+  free_word_ids_.clear();
+  ngram_words_.clear();
+  word_urls_.clear();
+  urls_.clear();
+}
+
+void InMemoryURLIndex::FindURLsContaining(const std::wstring& terms,
+                                          size_t max_results,
+                                          std::vector<URLRow>* results) const {
+  results->clear();
+
+  std::set<std::wstring> term_words;
+  ExtractWords(terms, &term_words);
+  if (term_words.empty())
+    return;
+
+  // Intersect the URLs of each term. The one character terms are only checked
+  // against the URLs found for the others, since gathering the URLs matching
+  // them would go through most of the index.
+  std::wstring initials;
+  URLIDSet url_ids;
+  bool first_term = true;
+  for (std::set<std::wstring>::const_iterator i = term_words.begin();
+       i != term_words.end(); ++i) {
+    if (i->length() == 1) {
+      initials.append(*i);
+      continue;
+    }
+    URLIDSet term_url_ids;
+    FindURLsForTerm(*i, &term_url_ids);
+    if (first_term) {
+      url_ids.swap(term_url_ids);
+      first_term = false;
+    } else {
+      URLIDSet both;
+      std::set_intersection(url_ids.begin(), url_ids.end(),
+                            term_url_ids.begin(), term_url_ids.end(),
+                            std::inserter(both, both.begin()));
+      url_ids.swap(both);
+    }
+    if (url_ids.empty())
+      return;
+  }
+
+  // Only the rows of the best URLs are read from the database.
+  std::vector<const IndexedURL*> urls;
+  urls.reserve(url_ids.size());
+  for (URLIDSet::const_iterator i = url_ids.begin(); i != url_ids.end(); ++i) {
+    base::hash_map<URLID, IndexedURL>::const_iterator url = urls_.find(*i);
+    DCHECK(url != urls_.end());
+    if (HasWordsStartingWith(url->second, initials))
+      urls.push_back(&url->second);
+  }
+
+  size_t result_count = std::min(max_results, urls.size());
+  std::partial_sort(urls.begin(), urls.begin() + result_count, urls.end(),
+                    &CompareIndexedURLs);
+  results->reserve(result_count);
+  for (size_t i = 0; i < result_count; i++) {
+    URLRow row;
+    if (db_->GetURLRow(urls[i]->id, &row))
+      results->push_back(row);
+  }
+}
+
+// static
+bool InMemoryURLIndex::CompareIndexedURLs(const IndexedURL* a,
+                                          const IndexedURL* b) {
+  if (a->typed_count != b->typed_count)
+    return a->typed_count > b->typed_count;
+  if (a->visit_count != b->visit_count)
+    return a->visit_count > b->visit_count;
+  return a->last_visit > b->last_visit;
+}
+
+// static
+void InMemoryURLIndex::ExtractWords(const std::wstring& text,
+                                    std::set<std::wstring>* words) {
+  std::wstring lower_text(l10n_util::ToLower(text));
+  WordIterator iter(lower_text, WordIterator::BREAK_WORD);
+  if (!iter.Init())
+    return;
+
+  while (iter.Advance()) {
+    // Just found a span between 'prev' (inclusive) and 'pos' (exclusive). It
+    // is not necessarily a word, but could also be a sequence of punctuation
+    // or whitespace.
+    if (iter.IsWord()) {
+      std::wstring word = iter.GetWord();
+      if (!word.empty())
+        words->insert(word);
+    }
+  }
+}
+
+InMemoryURLIndex::WordID InMemoryURLIndex::GetOrAddWord(
+    const std::wstring& word) {
+  base::hash_map<std::wstring, WordID>::const_iterator found =
+      word_ids_.find(word);
+  if (found != word_ids_.end())
+    return found->second;
+
+  WordID word_id;
+  if (free_word_ids_.empty()) {
+    word_id = static_cast<WordID>(words_.size());
+    words_.push_back(word);
+    word_urls_.push_back(URLIDSet());
+  } else {
+    word_id = free_word_ids_.back();
+    free_word_ids_.pop_back();
+    words_[word_id] = word;
+  }
+  word_ids_[word] = word_id;
+
+  std::set<std::wstring> ngrams;
+  for (size_t i = 0; i + 1 < word.length(); i++)
+    ngrams.insert(word.substr(i, 2));
+  for (std::set<std::wstring>::const_iterator i = ngrams.begin();
+       i != ngrams.end(); ++i)
+    InsertWordID(word_id, &ngram_words_[*i]);
+  return word_id;
+}
+
+void InMemoryURLIndex::RemoveWord(WordID word_id) {
+  const std::wstring& word = words_[word_id];
+
+  for (size_t i = 0; i + 1 < word.length(); i++) {
+    base::hash_map<std::wstring, WordIDs>::iterator ngram =
+        ngram_words_.find(word.substr(i, 2));
+    if (ngram == ngram_words_.end())
+      continue;  // Already removed for an earlier occurrence of the bigram.
+    EraseWordID(word_id, &ngram->second);
+    if (ngram->second.empty())
+      ngram_words_.erase(ngram);
+  }
+
+  word_ids_.erase(word);
+  words_[word_id].clear();
+  free_word_ids_.push_back(word_id);
+}
+
+void InMemoryURLIndex::FindURLsForTerm(const std::wstring& term,
+                                       URLIDSet* url_ids) const {
+  WordIDs word_ids;
+  FindCandidateWords(term, &word_ids);
+  for (WordIDs::const_iterator i = word_ids.begin(); i != word_ids.end(); ++i) {
+    if (words_[*i].find(term) != std::wstring::npos)
+      url_ids->insert(word_urls_[*i].begin(), word_urls_[*i].end());
+  }
+}
+
+void InMemoryURLIndex::FindCandidateWords(const std::wstring& term,
+                                          WordIDs* word_ids) const {
+  DCHECK(term.length() > 1);
+
+  std::vector<const WordIDs*> ngram_lists;
+  for (size_t i = 0; i + 1 < term.length(); i++) {
+    base::hash_map<std::wstring, WordIDs>::const_iterator found =
+        ngram_words_.find(term.substr(i, 2));
+    if (found == ngram_words_.end())
+      return;  // No word has this bigram.
+    ngram_lists.push_back(&found->second);
+  }
+
+  std::sort(ngram_lists.begin(), ngram_lists.end(), &CompareWordIDsSize);
+  *word_ids = *ngram_lists[0];
+  for (size_t i = 1; i < ngram_lists.size() && !word_ids->empty(); i++) {
+    WordIDs both;
+    std::set_intersection(word_ids->begin(), word_ids->end(),
+                          ngram_lists[i]->begin(), ngram_lists[i]->end(),
+                          std::back_inserter(both));
+    word_ids->swap(both);
+  }
+}
+
+bool InMemoryURLIndex::HasWordsStartingWith(
+    const IndexedURL& url,
+    const std::wstring& initials) const {
+  for (size_t i = 0; i < initials.length(); i++) {
+    WordIDs::const_iterator word = url.word_ids.begin();
+    while (word != url.word_ids.end() && words_[*word][0] != initials[i])
+      ++word;
+    if (word == url.word_ids.end())
+      return false;
+  }
+  return true;
+}
+
+}  // namespace history
@@ -0,0 +1,145 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_H_
+#define CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_H_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/time.h"
+#include "chrome/browser/history/history_types.h"
+#include "testing/gtest/include/gtest/gtest_prod.h"
+
+class GURL;
+
+namespace history {
+
+class URLDatabase;
+
+// An in-memory index of the words of the URLs and titles of the in-memory
+// history database, which finds the URLs containing some text anywhere, not
+// only as a prefix like URLDatabase::AutocompleteForPrefix. It is small and
+// fast enough to be queried synchronously as the user is typing.
+//
+// The text of each URL is broken into lower case words. Each word is indexed
+// under each of its character bigrams. To find a term, the word lists of its
+// bigrams are intersected, and the resulting words are checked for actually
+// containing the term. The URLs of the matching words are then intersected
+// across the terms.
+//
+// A one character term, like "h" on the first keystroke, would match a word
+// of nearly every URL, such as "http" or "www", so it only matches the start
+// of words, and only narrows down the URLs found for the longer terms. A
+// query of one character terms alone finds nothing.
+//
+// Only the words and the ranking of the URLs are kept. The rows of the
+// results are read back from the database, which must outlive the index.
+// Words are removed once no URL contains them anymore, and their IDs reused.
+//
+// The index is only built with --enable-in-memory-url-index.
+//
+// This class is not thread safe.
+class InMemoryURLIndex {
+ public:
+  InMemoryURLIndex();
+  ~InMemoryURLIndex();
+
+  // Indexes all the URLs of |db|, which the results are then read from.
+  // Returns false if they couldn't be read.
+  bool Init(URLDatabase* db);
+
+  // Adds or replaces the URL with the given ID in the database. Hidden URLs
+  // are not indexed.
+  void UpdateURL(URLID url_id, const URLRow& row);
+
+  // Removes the URL with the given ID from the index.
+  void DeleteURL(URLID url_id);
+
+  // Removes all the URLs from the index.
+  void Clear();
+
+  // Fills |results| with the URLs whose URL or title contains all of the
+  // words of |terms|, ignoring case. Words of one character must start a word
+  // of the URL, and at least one word of |terms| must be longer. The results
+  // are sorted like the ones of URLDatabase::AutocompleteForPrefix, up to
+  // |max_results|.
+  void FindURLsContaining(const std::wstring& terms,
+                          size_t max_results,
+                          std::vector<URLRow>* results) const;
+
+  // Returns the number of URLs in the index.
+  size_t url_count() const { return urls_.size(); }
+
+ private:
+  FRIEND_TEST(InMemoryURLIndexTest, RemoveWords);
+
+  typedef int WordID;
+  typedef std::vector<WordID> WordIDs;
+  typedef std::set<URLID> URLIDSet;
+
+  // What the index keeps of each URL: its words, and what the results are
+  // sorted by.
+  struct IndexedURL {
+    IndexedURL() : id(0), typed_count(0), visit_count(0) {}
+
+    URLID id;
+    WordIDs word_ids;
+    int typed_count;
+    int visit_count;
+    base::Time last_visit;
+  };
+
+  // Sorts the URLs like URLDatabase::AutocompleteForPrefix.
+  static bool CompareIndexedURLs(const IndexedURL* a, const IndexedURL* b);
+
+  // Breaks |text| into lower case words, and adds them to |words|.
+  static void ExtractWords(const std::wstring& text,
+                           std::set<std::wstring>* words);
+
+  // Returns the ID of |word|, adding it to the index if it's new.
+  WordID GetOrAddWord(const std::wstring& word);
+
+  // Removes the word with the given ID, which no URL contains anymore.
+  void RemoveWord(WordID word_id);
+
+  // Fills |url_ids| with the URLs which have a word containing |term|, which
+  // must be at least two characters long.
+  void FindURLsForTerm(const std::wstring& term, URLIDSet* url_ids) const;
+
+  // Fills |word_ids| with the words containing the bigrams of |term|. The
+  // words still need to be checked for containing the term itself.
+  void FindCandidateWords(const std::wstring& term, WordIDs* word_ids) const;
+
+  // Returns true if |url| has a word starting with each of |initials|.
+  bool HasWordsStartingWith(const IndexedURL& url,
+                            const std::wstring& initials) const;
+
+  // The database the results are read from.
+  URLDatabase* db_;
+
+  // The words, indexed by WordID, and the reverse map. Removed words are
+  // empty, and their IDs are listed in |free_word_ids_|.
+  std::vector<std::wstring> words_;
+  base::hash_map<std::wstring, WordID> word_ids_;
+  WordIDs free_word_ids_;
+
+  // The words containing each character bigram, sorted by WordID.
+  base::hash_map<std::wstring, WordIDs> ngram_words_;
+
+  // The URLs containing each word, indexed by WordID.
+  std::vector<URLIDSet> word_urls_;
+
+  // The indexed URLs.
+  base::hash_map<URLID, IndexedURL> urls_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemoryURLIndex);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_H_
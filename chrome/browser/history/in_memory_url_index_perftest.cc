@@ -0,0 +1,106 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/perftimer.h"
+#include "base/rand_util.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "chrome/browser/history/in_memory_database.h"
+#include "chrome/browser/history/in_memory_url_index.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+// The size of the synthetic history.
+const int kURLCount = 100000;
+
+// The number of times each query is run.
+const int kQueryCount = 100;
+
+const size_t kMaxResults = 10;
+
+// Words the synthetic URLs and titles are made of.
+const char* const kWords[] = {
+  "news", "mail", "search", "video", "photos", "maps", "shopping", "travel",
+  "weather", "sports", "finance", "music", "games", "books", "forum", "blog",
+  "wiki", "docs", "calendar", "reader", "images", "groups", "translate",
+  "product", "review", "download", "support", "account", "settings", "help",
+};
+
+std::string RandomWord() {
+  return kWords[base::RandInt(0, arraysize(kWords) - 1)];
+}
+
+// Returns a URL like the ones people type: a host, and a couple of path
+// components.
+URLRow RandomURLRow(int i) {
+  std::string host = StringPrintf("www.%s%d.com", RandomWord().c_str(),
+                                  base::RandInt(0, kURLCount / 10));
+  GURL url(StringPrintf("http://%s/%s/%s?id=%d", host.c_str(),
+                        RandomWord().c_str(), RandomWord().c_str(), i));
+  URLRow row(url);
+  row.set_title(ASCIIToWide(RandomWord() + " " + RandomWord() + " - " + host));
+  row.set_visit_count(base::RandInt(1, 100));
+  row.set_typed_count(base::RandInt(1, 10));
+  row.set_last_visit(base::Time::Now() -
+                     base::TimeDelta::FromHours(base::RandInt(0, 24 * 90)));
+  return row;
+}
+
+}  // namespace
+
+// Compares the per keystroke latency of prefix matching in the in-memory
+// database with substring matching in the index, over a 100K URL history.
+TEST(InMemoryURLIndexPerfTest, Autocomplete) {
+  scoped_ptr<InMemoryDatabase> db(new InMemoryDatabase);
+  ASSERT_TRUE(db->InitFromScratch());
+  for (int i = 0; i < kURLCount; i++)
+    ASSERT_TRUE(db->AddURL(RandomURLRow(i)));
+
+  InMemoryURLIndex index;
+  PerfTimeLogger init_timer("InMemoryURLIndex_init_100K");
+  ASSERT_TRUE(index.Init(db.get()));
+  init_timer.Done();
+  EXPECT_EQ(static_cast<size_t>(kURLCount), index.url_count());
+
+  // What the user has typed so far, one keystroke at a time.
+  const wchar_t* const kQueries[] = {
+    L"w", L"we", L"wea", L"weat", L"weather", L"weather 12",
+    L"s", L"sh", L"sho", L"shop", L"shopping", L"shopping rev",
+  };
+
+  std::vector<URLRow> results;
+  size_t prefix_results = 0;
+  PerfTimeLogger prefix_timer("AutocompleteForPrefix_100K");
+  for (int i = 0; i < kQueryCount; i++) {
+    for (size_t j = 0; j < arraysize(kQueries); j++) {
+      db->AutocompleteForPrefix(std::wstring(L"http://www.") + kQueries[j],
+                                kMaxResults, &results);
+      prefix_results += results.size();
+    }
+  }
+  prefix_timer.Done();
+
+  size_t index_results = 0;
+  PerfTimeLogger index_timer("InMemoryURLIndex_query_100K");
+  for (int i = 0; i < kQueryCount; i++) {
+    for (size_t j = 0; j < arraysize(kQueries); j++) {
+      index.FindURLsContaining(kQueries[j], kMaxResults, &results);
+      index_results += results.size();
+    }
+  }
+  index_timer.Done();
+
+  // Substrings match at least as much as prefixes.
+  EXPECT_GE(index_results, prefix_results);
+}
+
+}  // namespace history
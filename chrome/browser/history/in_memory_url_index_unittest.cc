@@ -0,0 +1,154 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/scoped_ptr.h"
+#include "base/time.h"
+#include "chrome/browser/history/in_memory_database.h"
+#include "chrome/browser/history/in_memory_url_index.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Time;
+using base::TimeDelta;
+
+namespace history {
+
+class InMemoryURLIndexTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    db_.reset(new InMemoryDatabase);
+    ASSERT_TRUE(db_->InitFromScratch());
+
+    AddURL("http://www.google.com/", L"Google", 10, 3);
+    AddURL("http://news.google.com/", L"Google News", 5, 1);
+    AddURL("http://www.example.com/Mail/inbox", L"Example mail", 2, 0);
+    AddURL("http://www.mozilla.org/", L"Firefox web browser", 20, 0);
+
+    ASSERT_TRUE(index_.Init(db_.get()));
+  }
+
+  URLID AddURL(const char* url, const wchar_t* title, int visit_count,
+               int typed_count) {
+    URLRow row((GURL(url)));
+    row.set_title(title);
+    row.set_visit_count(visit_count);
+    row.set_typed_count(typed_count);
+    row.set_last_visit(Time::Now() - TimeDelta::FromDays(1));
+    return db_->AddURL(row);
+  }
+
+  // Returns the URLs found for |terms|, in order, separated by spaces.
+  std::string Find(const std::wstring& terms) {
+    std::vector<URLRow> results;
+    index_.FindURLsContaining(terms, 10, &results);
+    std::string urls;
+    for (size_t i = 0; i < results.size(); i++) {
+      if (i)
+        urls.append(" ");
+      urls.append(results[i].url().spec());
+    }
+    return urls;
+  }
+
+  scoped_ptr<InMemoryDatabase> db_;
+  InMemoryURLIndex index_;
+};
+
+TEST_F(InMemoryURLIndexTest, Substrings) {
+  EXPECT_EQ(4U, index_.url_count());
+
+  // Matches in the URL, anywhere in a word, sorted by typed count.
+  EXPECT_EQ("http://www.google.com/ http://news.google.com/",
+            Find(L"oogl"));
+  EXPECT_EQ("http://www.example.com/Mail/inbox", Find(L"box"));
+
+  // Matches in the title, ignoring case.
+  EXPECT_EQ("http://www.mozilla.org/", Find(L"FIREF"));
+  EXPECT_EQ("http://www.example.com/Mail/inbox", Find(L"mail"));
+
+  // Single characters only match the start of words, and only narrow down
+  // the URLs found for the longer terms.
+  EXPECT_EQ("http://www.mozilla.org/", Find(L"www f"));
+  EXPECT_EQ("", Find(L"www z"));
+  EXPECT_EQ("", Find(L"f"));
+
+  // All of the terms must match, in the URL or the title.
+  EXPECT_EQ("http://news.google.com/", Find(L"goo news"));
+  EXPECT_EQ("", Find(L"google firefox"));
+  EXPECT_EQ("", Find(L"nothing"));
+  EXPECT_EQ("", Find(L""));
+}
+
+TEST_F(InMemoryURLIndexTest, MaxResults) {
+  std::vector<URLRow> results;
+  index_.FindURLsContaining(L"www", 2, &results);
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ(GURL("http://www.google.com/"), results[0].url());
+  EXPECT_EQ(GURL("http://www.mozilla.org/"), results[1].url());
+}
+
+TEST_F(InMemoryURLIndexTest, UpdateAndDelete) {
+  // Changing the title replaces its words.
+  URLRow row;
+  URLID id = db_->GetRowForURL(GURL("http://www.mozilla.org/"), &row);
+  ASSERT_TRUE(id);
+  row.set_title(L"Mozilla");
+  index_.UpdateURL(id, row);
+  EXPECT_EQ("", Find(L"firefox"));
+  EXPECT_EQ("http://www.mozilla.org/", Find(L"zilla"));
+
+  // Hidden URLs are not indexed.
+  row.set_hidden(true);
+  index_.UpdateURL(id, row);
+  EXPECT_EQ("", Find(L"zilla"));
+
+  // New URLs are found.
+  URLRow new_row(GURL("http://www.chromium.org/"));
+  new_row.set_title(L"The Chromium Projects");
+  index_.UpdateURL(AddURL("http://www.chromium.org/", L"", 1, 1), new_row);
+  EXPECT_EQ("http://www.chromium.org/", Find(L"project"));
+
+  // Deleted URLs are not.
+  id = db_->GetRowForURL(GURL("http://news.google.com/"), NULL);
+  ASSERT_TRUE(id);
+  index_.DeleteURL(id);
+  EXPECT_EQ("http://www.google.com/", Find(L"google"));
+  EXPECT_EQ("", Find(L"news"));
+  EXPECT_EQ(3U, index_.url_count());
+
+  index_.Clear();
+  EXPECT_EQ(0U, index_.url_count());
+  EXPECT_EQ("", Find(L"google"));
+}
+
+TEST_F(InMemoryURLIndexTest, RemoveWords) {
+  // "news" is only in news.google.com, and is the only word with "ew".
+  URLID id = db_->GetRowForURL(GURL("http://news.google.com/"), NULL);
+  ASSERT_TRUE(id);
+  ASSERT_TRUE(index_.word_ids_.find(L"news") != index_.word_ids_.end());
+  InMemoryURLIndex::WordID news_id = index_.word_ids_[L"news"];
+  index_.DeleteURL(id);
+  EXPECT_TRUE(index_.word_ids_.find(L"news") == index_.word_ids_.end());
+  EXPECT_TRUE(index_.ngram_words_.find(L"ew") == index_.ngram_words_.end());
+  EXPECT_TRUE(index_.words_[news_id].empty());
+  EXPECT_FALSE(index_.free_word_ids_.empty());
+
+  // Words shared with other URLs stay.
+  EXPECT_EQ("http://www.google.com/", Find(L"google"));
+
+  // The IDs of the removed words are reused by the new ones.
+  const wchar_t kTitle[] = L"The Chromium Projects home";
+  URLRow row(GURL("http://www.chromium.org/"));
+  row.set_title(kTitle);
+  index_.UpdateURL(AddURL("http://www.chromium.org/", kTitle, 1, 1), row);
+  EXPECT_TRUE(index_.free_word_ids_.empty());
+  EXPECT_FALSE(index_.words_[news_id].empty());
+  EXPECT_EQ("http://www.chromium.org/", Find(L"romi"));
+  EXPECT_EQ("http://www.chromium.org/", Find(L"romi p"));
+}
+
+}  // namespace history
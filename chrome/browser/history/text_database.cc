@@ -303,6 +303,32 @@ void TextDatabase::DeletePageData(Time time, const std::string& url) {
   }
 }
 
+void TextDatabase::DeletePageDataBetween(Time begin, Time end) {
+  int64 effective_begin_time = begin.is_null() ? 0 : begin.ToInternalValue();
+  int64 effective_end_time = end.is_null() ?
+      std::numeric_limits<int64>::max() : end.ToInternalValue();
+
+  // Delete from the pages table, selecting the rows on time in the info table,
+  // which has an index.
+  SQLITE_UNIQUE_STATEMENT(delete_pages, *statement_cache_,
+      "DELETE FROM pages WHERE rowid IN "
+      "(SELECT rowid FROM info WHERE time >= ? AND time < ?)");
+  if (!delete_pages.is_valid())
+    return;
+  delete_pages->bind_int64(0, effective_begin_time);
+  delete_pages->bind_int64(1, effective_end_time);
+  delete_pages->step();
+
+  // Delete from the info table.
+  SQLITE_UNIQUE_STATEMENT(delete_info, *statement_cache_,
+      "DELETE FROM info WHERE time >= ? AND time < ?");
+  if (!delete_info.is_valid())
+    return;
+  delete_info->bind_int64(0, effective_begin_time);
+  delete_info->bind_int64(1, effective_end_time);
+  delete_info->step();
+}
+
 void TextDatabase::Optimize() {
   SQLITE_UNIQUE_STATEMENT(statement, *statement_cache_,
       "SELECT OPTIMIZE(pages) FROM pages LIMIT 1");
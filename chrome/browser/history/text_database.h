@@ -107,6 +107,10 @@ class TextDatabase {
   // Deletes the indexed data exactly matching the given URL/time pair.
   void DeletePageData(base::Time time, const std::string& url);
 
+  // Deletes all the indexed data in the time range [begin, end). Either time
+  // can be is_null() to be unbounded in that direction.
+  void DeletePageDataBetween(base::Time begin, base::Time end);
+
   // Optimizes the tree inside the database. This will, in addition to making
   // access faster, remove any deleted data from the database (normally it is
   // added again as "removed" and it is manually cleaned up when it decides to
@@ -337,6 +337,34 @@ void TextDatabaseManager::DeletePageData(Time time, const GURL& url,
   db->DeletePageData(time, URLDatabase::GURLToDatabaseURL(url));
 }
 
+void TextDatabaseManager::DeletePageDataBetween(Time begin, Time end,
+                                                ChangeSet* change_set) {
+  InitDBList();
+  if (present_databases_.empty())
+    return;
+
+  TextDatabase::DBIdent min_ident = begin.is_null() ?
+      *present_databases_.begin() : TimeToID(begin);
+  TextDatabase::DBIdent max_ident = end.is_null() ?
+      *present_databases_.rbegin() : TimeToID(end);
+
+  for (DBIdentSet::const_iterator i = present_databases_.begin();
+       i != present_databases_.end(); ++i) {
+    if (*i < min_ident)
+      continue;  // Haven't gotten to the time range yet.
+    if (*i > max_ident)
+      break;  // Covered all the time range.
+
+    TextDatabase* db = GetDB(*i, true);
+    if (!db)
+      continue;  // The file may have changed or something.
+
+    if (change_set)
+      change_set->Add(*i);
+    db->DeletePageDataBetween(begin, end);
+  }
+}
+
 void TextDatabaseManager::DeleteFromUncommitted(Time begin, Time end) {
   // First find the beginning of the range to delete. Recall that the list
   // has the most recent item at the beginning. There won't normally be very
@@ -120,6 +120,12 @@ class TextDatabaseManager {
   void DeletePageData(base::Time time, const GURL& url,
                       ChangeSet* change_set);
 
+  // Deletes all the indexed data in the time range [begin, end), from all the
+  // databases covering it. Either time can be is_null() to be unbounded in that
+  // direction. Changes are tracked like DeletePageData.
+  void DeletePageDataBetween(base::Time begin, base::Time end,
+                             ChangeSet* change_set);
+
   // The text database manager keeps a list of changes that are made to the
   // file AddPageURL/Title/Body that may not be committed to the database yet.
   // This function removes entires from this list happening between the given
@@ -309,6 +309,11 @@ bool ThumbnailDatabase::DeleteThumbnail(URLID id) {
   return statement->step() == SQLITE_DONE;
 }
 
+bool ThumbnailDatabase::DeleteThumbnails(const std::vector<URLID>& ids) {
+  return ExecuteSqliteForIDs(db_, "DELETE FROM thumbnails WHERE url_id IN ",
+                             ids);
+}
+
 bool ThumbnailDatabase::ThumbnailScoreForId(
     URLID id,
     ThumbnailScore* score) {
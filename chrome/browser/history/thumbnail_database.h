@@ -71,6 +71,10 @@ class ThumbnailDatabase {
   // Delete the thumbnail with the provided id. Returns false on failure
   bool DeleteThumbnail(URLID id);
 
+  // Deletes the thumbnails of all the given URLs at once. Returns true on
+  // success.
+  bool DeleteThumbnails(const std::vector<URLID>& ids);
+
   // If there is a thumbnail score for the id provided, retrieves the
   // current thumbnail score and places it in |score| and returns
   // true. Returns false otherwise.
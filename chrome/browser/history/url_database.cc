@@ -167,6 +167,17 @@ bool URLDatabase::DeleteURLRow(URLID id) {
   return (del_keyword_visit->step() == SQLITE_DONE);
 }
 
+bool URLDatabase::DeleteURLRows(const std::vector<URLID>& ids) {
+  if (!ExecuteSqliteForIDs(GetDB(), "DELETE FROM urls WHERE id IN ", ids))
+    return false;
+
+  // And delete any keyword visits.
+  if (!has_keyword_search_terms_)
+    return true;
+  return ExecuteSqliteForIDs(GetDB(),
+      "DELETE FROM keyword_search_terms WHERE url_id IN ", ids);
+}
+
 bool URLDatabase::CreateTemporaryURLTable() {
   return CreateURLTable(true);
 }
@@ -134,6 +134,10 @@ class URLDatabase {
   // the row existed and was deleted.
   bool DeleteURLRow(URLID id);
 
+  // Deletes the rows of all the given URLs at once, like DeleteURLRow. Returns
+  // true on success.
+  bool DeleteURLRows(const std::vector<URLID>& ids);
+
   // URL mass-deleting ---------------------------------------------------------
 
   // Begins the mass-deleting operation by creating a temporary URL table.
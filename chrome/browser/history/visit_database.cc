@@ -9,6 +9,7 @@
 
 #include "chrome/browser/history/visit_database.h"
 
+#include "base/string_util.h"
 #include "chrome/browser/history/url_database.h"
 #include "chrome/common/page_transition_types.h"
 #include "chrome/common/url_constants.h"
@@ -143,6 +144,49 @@ void VisitDatabase::DeleteVisit(const VisitRow& visit) {
   del->step();
 }
 
+void VisitDatabase::DeleteVisits(const VisitVector& visits) {
+  if (visits.empty())
+    return;
+
+  std::map<VisitID, VisitID> referring_visits;
+  for (size_t i = 0; i < visits.size(); i++)
+    referring_visits[visits[i].visit_id] = visits[i].referring_visit;
+
+  // The visits that went to a deleted visit will now have their source be the
+  // first visit of the chain which is not deleted. The deleted visits are
+  // grouped by that source so that each group is patched at once. The length
+  // of the walk is bounded in case the chain is looping.
+  std::map<VisitID, std::vector<int64> > ids_by_source;
+  for (size_t i = 0; i < visits.size(); i++) {
+    VisitID source = visits[i].referring_visit;
+    for (size_t steps = 0; steps < visits.size(); steps++) {
+      std::map<VisitID, VisitID>::const_iterator found =
+          referring_visits.find(source);
+      if (found == referring_visits.end())
+        break;
+      source = found->second;
+    }
+    if (referring_visits.find(source) != referring_visits.end())
+      source = 0;
+    ids_by_source[source].push_back(visits[i].visit_id);
+  }
+
+  std::vector<int64> ids;
+  ids.reserve(visits.size());
+  for (std::map<VisitID, std::vector<int64> >::const_iterator i =
+           ids_by_source.begin(); i != ids_by_source.end(); ++i) {
+    ExecuteSqliteForIDs(GetDB(),
+        StringPrintf("UPDATE visits SET from_visit=%s WHERE from_visit IN ",
+                     Int64ToString(i->first).c_str()),
+        i->second);
+    ids.insert(ids.end(), i->second.begin(), i->second.end());
+  }
+
+  // Now delete the actual visits. The chains inside of the deleted visits were
+  // patched too, but that doesn't matter.
+  ExecuteSqliteForIDs(GetDB(), "DELETE FROM visits WHERE id IN ", ids);
+}
+
 bool VisitDatabase::GetRowForVisit(VisitID visit_id, VisitRow* out_visit) {
   SQLITE_UNIQUE_STATEMENT(statement, GetStatementCache(),
       "SELECT" HISTORY_VISIT_ROW_FIELDS "FROM visits WHERE id=?");
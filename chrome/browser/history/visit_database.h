@@ -39,6 +39,11 @@ class VisitDatabase {
   // doesn't exist, it will not do anything.
   void DeleteVisit(const VisitRow& visit);
 
+  // Deletes all the given visits, patching the chains around them like
+  // DeleteVisit, using a few statements for all of them instead of two per
+  // visit. This is used for expiring many visits at once.
+  void DeleteVisits(const VisitVector& visits);
+
   // Query a VisitInfo giving an visit id, filling the given VisitRow.
   // Returns true on success.
   bool GetRowForVisit(VisitID visit_id, VisitRow* out_visit);
@@ -144,6 +144,47 @@ TEST_F(VisitDatabaseTest, Delete) {
               IsVisitInfoEqual(matches[1], visit_info3));
 }
 
+TEST_F(VisitDatabaseTest, DeleteVisits) {
+  // Add four visits that form a chain of navigation, and then delete the
+  // middle two at once. The chain should link the outer two.
+  VisitRow visit_info1(1, Time::FromInternalValue(1000), 0,
+                       PageTransition::LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info1));
+  VisitRow visit_info2(1, Time::FromInternalValue(1001),
+                       visit_info1.visit_id, PageTransition::LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info2));
+  VisitRow visit_info3(1, Time::FromInternalValue(1002),
+                       visit_info2.visit_id, PageTransition::LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info3));
+  VisitRow visit_info4(1, Time::FromInternalValue(1003),
+                       visit_info3.visit_id, PageTransition::LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info4));
+
+  // The order of the deleted visits doesn't matter.
+  VisitVector deleted;
+  deleted.push_back(visit_info3);
+  deleted.push_back(visit_info2);
+  DeleteVisits(deleted);
+
+  visit_info4.referring_visit = visit_info1.visit_id;
+  std::vector<VisitRow> matches;
+  EXPECT_TRUE(GetVisitsForURL(visit_info1.url_id, &matches));
+  ASSERT_EQ(static_cast<size_t>(2), matches.size());
+  EXPECT_TRUE(IsVisitInfoEqual(matches[0], visit_info1) &&
+              IsVisitInfoEqual(matches[1], visit_info4));
+
+  // Deleting the first one unlinks the last one.
+  deleted.clear();
+  deleted.push_back(visit_info1);
+  DeleteVisits(deleted);
+
+  visit_info4.referring_visit = 0;
+  matches.clear();
+  EXPECT_TRUE(GetVisitsForURL(visit_info1.url_id, &matches));
+  ASSERT_EQ(static_cast<size_t>(1), matches.size());
+  EXPECT_TRUE(IsVisitInfoEqual(matches[0], visit_info4));
+}
+
 TEST_F(VisitDatabaseTest, Update) {
   // Make something in the database.
   VisitRow original(1, Time::Now(), 23, 22, 19);
@@ -7,6 +7,7 @@
 #include <map>
 #include <string>
 
+#include "base/command_line.h"
 #include "base/singleton.h"
 #include "base/stats_counters.h"
 #include "base/string_util.h"
@@ -18,11 +19,15 @@
 #include "chrome/browser/net/referrer.h"
 #include "chrome/browser/profile.h"
 #include "chrome/browser/session_startup_pref.h"
+#include "chrome/common/chrome_switches.h"
 #include "chrome/common/notification_registrar.h"
 #include "chrome/common/notification_service.h"
 #include "chrome/common/pref_names.h"
 #include "chrome/common/pref_service.h"
 #include "net/base/host_resolver.h"
+#if defined(OS_LINUX)
+#include "net/base/dns_transaction.h"
+#endif
 
 using base::Time;
 using base::TimeDelta;
@@ -30,6 +35,7 @@ using base::TimeDelta;
 namespace chrome_browser_net {
 
 static void DiscardAllPrefetchState();
+static void EnablePreconnect(bool enable);
 static void DnsMotivatedPrefetch(const std::string& hostname,
                                  DnsHostInfo::ResolutionMotivation motivation);
 static void DnsPrefetchMotivatedList(
@@ -67,6 +73,8 @@ void OnTheRecord(bool enable) {
   on_the_record_switch = enable;
   if (on_the_record_switch)
     DiscardAllPrefetchState();  // Destroy all evidence of our OTR session.
+  // Sockets connected ahead of time would only be used by the main profile.
+  EnablePreconnect(on_the_record_switch);
 }
 
 void RegisterPrefs(PrefService* local_state) {
@@ -98,6 +106,15 @@ static void DnsPrefetchMotivatedList(
   dns_master->ResolveList(hostnames, motivation);
 }
 
+void DnsPrefetchPreconnectThrough(URLRequestContext* context) {
+  if (NULL == dns_master)
+    return;
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kDnsPreconnectDisable))
+    return;
+  dns_master->SetPreconnectContext(context);
+}
+
 // This API is used by the autocomplete popup box (where URLs are typed).
 void DnsPrefetchUrl(const GURL& url) {
   if (!dns_prefetch_enabled  || NULL == dns_master)
@@ -106,6 +123,16 @@ void DnsPrefetchUrl(const GURL& url) {
     DnsMotivatedPrefetch(url.host(), DnsHostInfo::OMNIBOX_MOTIVATED);
 }
 
+// This API is used by the ResourceDispatcherHost when a frame starts loading.
+// When we navigate, we may know in advance some other domains that will need to
+// be resolved.  This function initiates those side effects.
+void DnsPrefetchNavigatingTo(const GURL& url) {
+  if (!dns_prefetch_enabled || NULL == dns_master)
+    return;
+  if (url.is_valid() && url.has_host())
+    dns_master->NavigatingTo(url.host());
+}
+
 static void DnsMotivatedPrefetch(const std::string& hostname,
                                  DnsHostInfo::ResolutionMotivation motivation) {
   if (!dns_prefetch_enabled || NULL == dns_master || !hostname.size())
@@ -129,14 +156,6 @@ static bool AccruePrefetchBenefits(const GURL& referrer,
   return dns_master->AccruePrefetchBenefits(referrer, navigation_info);
 }
 
-// When we navigate, we may know in advance some other domains that will need to
-// be resolved.  This function initiates those side effects.
-static void NavigatingTo(const std::string& host_name) {
-  if (!dns_prefetch_enabled || NULL == dns_master)
-    return;
-  dns_master->NavigatingTo(host_name);
-}
-
 // The observer class needs to connect starts and finishes of HTTP network
 // resolutions.  We use the following type for that map.
 typedef std::map<int, DnsHostInfo> ObservedResolutionMap;
@@ -210,8 +229,6 @@ void PrefetchObserver::OnStartResolution(
   navigation_info.SetHostname(request_info.hostname());
   navigation_info.SetStartedState();
 
-  NavigatingTo(request_info.hostname());
-
   AutoLock auto_lock(*lock);
   // This entry will be deleted either by OnFinishResolutionWithStatus(), or
   // by  OnCancelResolution().
@@ -471,6 +488,12 @@ static void DiscardAllPrefetchState() {
   dns_master->DiscardAllResults();
 }
 
+static void EnablePreconnect(bool enable) {
+  if (!dns_master)
+    return;
+  dns_master->EnablePreconnect(enable);
+}
+
 //------------------------------------------------------------------------------
 
 net::HostResolver* GetGlobalHostResolver() {
@@ -481,6 +504,15 @@ net::HostResolver* GetGlobalHostResolver() {
 
     global_host_resolver = new net::HostResolver(
         kMaxHostCacheEntries, kHostCacheExpirationSeconds * 1000);
+
+#if defined(OS_LINUX)
+    net::AddressList nameserver;
+    if (CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kEnableAsyncDns) &&
+        net::GetSystemNameserver(&nameserver)) {
+      global_host_resolver->set_async_dns_server(nameserver);
+    }
+#endif
   }
   return global_host_resolver;
 }
@@ -19,6 +19,7 @@
 #include "chrome/browser/net/dns_master.h"
 
 class PrefService;
+class URLRequestContext;
 
 namespace net {
 class HostResolver;
@@ -52,6 +53,12 @@ void RegisterUserPrefs(PrefService* user_prefs);
 void DnsPrefetchList(const NameList& hostnames);
 // This API is used by the autocomplete popup box (as user types).
 void DnsPrefetchUrl(const GURL& url);
+// This API is used by the ResourceDispatcherHost when a frame starts loading
+// |url|, to prefetch the hosts that the frame is expected to need.
+void DnsPrefetchNavigatingTo(const GURL& url);
+// Connect sockets ahead of time, in the HTTP connection pool of |context|, to
+// the hosts that a navigation is expected to need.
+void DnsPrefetchPreconnectThrough(URLRequestContext* context);
 void DnsPrefetchGetHtmlInfo(std::string* output);
 
 //------------------------------------------------------------------------------
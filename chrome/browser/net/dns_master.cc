@@ -19,11 +19,46 @@
 #include "net/base/completion_callback.h"
 #include "net/base/host_resolver.h"
 #include "net/base/net_errors.h"
+#include "net/http/http_cache.h"
+#include "net/http/http_network_layer.h"
+#include "net/http/http_network_session.h"
+#include "net/proxy/proxy_info.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/client_socket.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/url_request/url_request_context.h"
 
 using base::TimeDelta;
 
 namespace chrome_browser_net {
 
+namespace {
+
+// How many connections a navigation is expected to make to a host before we
+// connect a socket to it ahead of time.  Below that, the name is only
+// resolved.
+const double kPreconnectWorthyExpectedValue = 0.8;
+
+// The most sockets we connect ahead of time to a host for one navigation.
+const int kMaxPreconnectsPerHost = 2;
+
+// The most sockets being connected ahead of time at once.
+const size_t kMaxPendingPreconnects = 8;
+
+// Returns the HTTP connection pool of |context|, or NULL if it has none.
+net::ClientSocketPool* GetConnectionPool(URLRequestContext* context) {
+  net::HttpCache* cache = context->http_transaction_factory()->GetCache();
+  if (!cache)
+    return NULL;
+  // Like the media request context, assume that the network layer of the
+  // cache is an HttpNetworkLayer.
+  net::HttpNetworkLayer* network_layer =
+      static_cast<net::HttpNetworkLayer*>(cache->network_layer());
+  return network_layer->GetSession()->connection_pool();
+}
+
+}  // namespace
+
 class DnsMaster::LookupRequest {
  public:
   LookupRequest(DnsMaster* master,
@@ -68,12 +103,168 @@ class DnsMaster::LookupRequest {
   DISALLOW_COPY_AND_ASSIGN(LookupRequest);
 };
 
+// Wraps a socket that was connected ahead of time, while it waits in the
+// connection pool, to report to the master whether a request ends up using it.
+class DnsMaster::PreconnectedSocket : public net::ClientSocket {
+ public:
+  PreconnectedSocket(DnsMaster* master, net::ClientSocket* socket)
+      : master_(master),
+        socket_(socket),
+        connect_time_(base::TimeTicks::Now()),
+        was_used_(false) {
+  }
+
+  virtual ~PreconnectedSocket() {
+    if (!was_used_)
+      master_->OnPreconnectWasted(base::TimeTicks::Now() - connect_time_);
+  }
+
+  // ClientSocket methods:
+  virtual int Connect(net::CompletionCallback* callback) {
+    return socket_->Connect(callback);
+  }
+  virtual void Disconnect() { socket_->Disconnect(); }
+  virtual bool IsConnected() const { return socket_->IsConnected(); }
+  virtual bool IsConnectedAndIdle() const {
+    return socket_->IsConnectedAndIdle();
+  }
+#if defined(OS_LINUX)
+  virtual int GetPeerName(struct sockaddr* name, socklen_t* namelen) {
+    return socket_->GetPeerName(name, namelen);
+  }
+#endif
+
+  // Socket methods:
+  virtual int Read(net::IOBuffer* buf, int buf_len,
+                   net::CompletionCallback* callback) {
+    RecordUse();
+    return socket_->Read(buf, buf_len, callback);
+  }
+  virtual int Write(net::IOBuffer* buf, int buf_len,
+                    net::CompletionCallback* callback) {
+    RecordUse();
+    return socket_->Write(buf, buf_len, callback);
+  }
+
+ private:
+  void RecordUse() {
+    if (was_used_)
+      return;
+    was_used_ = true;
+    master_->OnPreconnectUsed(base::TimeTicks::Now() - connect_time_);
+  }
+
+  // The socket may outlive the master's shutdown while it is idle in the pool.
+  scoped_refptr<DnsMaster> master_;
+  scoped_ptr<net::ClientSocket> socket_;
+  const base::TimeTicks connect_time_;
+  bool was_used_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreconnectedSocket);
+};
+
+// Connects a socket to a host in the HTTP connection pool of a context, and
+// leaves it there, idle, for the requests of the coming navigation.  Only
+// direct connections are made, since a connection to a proxy is not made for
+// a particular host.
+class DnsMaster::PreconnectRequest {
+ public:
+  PreconnectRequest(DnsMaster* master,
+                    net::ProxyService* proxy_service,
+                    net::ClientSocketPool* pool,
+                    const std::string& hostname)
+      : ALLOW_THIS_IN_INITIALIZER_LIST(
+          proxy_callback_(this, &PreconnectRequest::OnProxyResolved)),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+          connect_callback_(this, &PreconnectRequest::OnConnectComplete)),
+        master_(master),
+        proxy_service_(proxy_service),
+        url_("http://" + hostname + "/"),
+        pac_request_(NULL),
+        connection_(pool) {
+  }
+
+  ~PreconnectRequest() {
+    if (pac_request_)
+      proxy_service_->CancelPacRequest(pac_request_);
+  }
+
+  // Returns net::ERR_IO_PENDING if the master will be called back when the
+  // request is done.  Anything else means that the request is done.
+  int Start() {
+    if (!url_.is_valid())
+      return net::ERR_INVALID_URL;
+    int rv = proxy_service_->ResolveProxy(url_, &proxy_info_, &proxy_callback_,
+                                          &pac_request_);
+    if (rv != net::OK)
+      return rv;
+    return Connect();
+  }
+
+ private:
+  int Connect() {
+    if (!proxy_info_.is_direct())
+      return net::OK;
+
+    net::HostResolver::RequestInfo resolve_info(url_.HostNoBrackets(),
+                                                url_.EffectiveIntPort());
+    // Keep the DnsMaster from seeing this resolution as a navigation.
+    resolve_info.set_is_speculative(true);
+    // Use the lowest priority, and the connection group of a direct HTTP
+    // connection to the host.
+    int rv = connection_.Init(url_.GetOrigin().spec(), resolve_info, 0,
+                              &connect_callback_);
+    if (rv == net::OK)
+      ReleaseToPool();
+    return rv;
+  }
+
+  void ReleaseToPool() {
+    // A reused socket was already idle in the pool, and is not ours.
+    if (!connection_.is_reused())
+      connection_.set_socket(
+          new PreconnectedSocket(master_, connection_.release_socket()));
+    connection_.Reset();
+  }
+
+  void OnProxyResolved(int result) {
+    pac_request_ = NULL;
+    if (result == net::OK)
+      result = Connect();
+    if (result != net::ERR_IO_PENDING)
+      master_->OnPreconnectFinished(this);
+  }
+
+  void OnConnectComplete(int result) {
+    if (result == net::OK)
+      ReleaseToPool();
+    master_->OnPreconnectFinished(this);
+  }
+
+  net::CompletionCallbackImpl<PreconnectRequest> proxy_callback_;
+  net::CompletionCallbackImpl<PreconnectRequest> connect_callback_;
+
+  DnsMaster* master_;  // Master which started us.
+
+  net::ProxyService* proxy_service_;
+  const GURL url_;
+  net::ProxyInfo proxy_info_;
+  net::ProxyService::PacRequest* pac_request_;
+  net::ClientSocketHandle connection_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreconnectRequest);
+};
+
 DnsMaster::DnsMaster(net::HostResolver* host_resolver,
                      MessageLoop* host_resolver_loop,
                      TimeDelta max_queue_delay,
                      size_t max_concurrent)
   : peak_pending_lookups_(0),
     shutdown_(false),
+    preconnect_proxy_service_(NULL),
+    preconnect_enabled_(true),
+    preconnect_hits_(0),
+    preconnect_waste_(0),
     max_concurrent_lookups_(max_concurrent),
     max_queue_delay_(max_queue_delay),
     host_resolver_(host_resolver),
@@ -93,6 +284,15 @@ void DnsMaster::Shutdown() {
   std::set<LookupRequest*>::iterator it;
   for (it = pending_lookups_.begin(); it != pending_lookups_.end(); ++it)
     delete *it;
+
+  std::set<PreconnectRequest*>::iterator preconnect_it;
+  for (preconnect_it = pending_preconnects_.begin();
+       preconnect_it != pending_preconnects_.end(); ++preconnect_it)
+    delete *preconnect_it;
+  pending_preconnects_.clear();
+  preconnect_pool_ = NULL;
+  preconnect_proxy_service_ = NULL;
+  preconnect_context_ = NULL;
 }
 
 // Overloaded Resolve() to take a vector of names.
@@ -199,6 +399,41 @@ void DnsMaster::NonlinkNavigation(const GURL& referrer,
     return;
 
   referrers_[referring_host].SuggestHost(navigation_info->hostname());
+  referrers_[referring_host].SubresourceIsNeeded(navigation_info->hostname());
+}
+
+void DnsMaster::SetPreconnectContext(URLRequestContext* context) {
+  AutoLock auto_lock(lock_);
+
+  // The connection pool of the context may only be used on
+  // |host_resolver_loop_|.
+  if (MessageLoop::current() != host_resolver_loop_) {
+    host_resolver_loop_->PostTask(FROM_HERE, NewRunnableMethod(this,
+        &DnsMaster::SetPreconnectContext, context));
+    return;
+  }
+
+  if (shutdown_)
+    return;
+  net::ClientSocketPool* pool = GetConnectionPool(context);
+  if (!pool)
+    return;
+  preconnect_context_ = context;
+  preconnect_proxy_service_ = context->proxy_service();
+  preconnect_pool_ = pool;
+}
+
+void DnsMaster::SetPreconnectPoolForTest(net::ProxyService* proxy_service,
+                                         net::ClientSocketPool* pool) {
+  AutoLock auto_lock(lock_);
+  DCHECK(MessageLoop::current() == host_resolver_loop_);
+  preconnect_proxy_service_ = proxy_service;
+  preconnect_pool_ = pool;
+}
+
+void DnsMaster::EnablePreconnect(bool enable) {
+  AutoLock auto_lock(lock_);
+  preconnect_enabled_ = enable;
 }
 
 void DnsMaster::NavigatingTo(const std::string& host_name) {
@@ -218,11 +453,14 @@ void DnsMaster::NavigatingTo(const std::string& host_name) {
   Referrer* referrer = &(it->second);
   for (Referrer::iterator future_host = referrer->begin();
        future_host != referrer->end(); ++future_host) {
+    future_host->second.ReferrerWasObserved();
     DnsHostInfo* queued_info = PreLockedResolve(
         future_host->first,
         DnsHostInfo::LEARNED_REFERAL_MOTIVATED);
     if (queued_info)
       queued_info->SetReferringHostname(host_name);
+    if (preconnect_pool_ && preconnect_enabled_)
+      PreLockedPreconnect(future_host->first, future_host->second);
   }
 }
 
@@ -446,6 +684,51 @@ void DnsMaster::PreLockedScheduleLookups() {
   }
 }
 
+void DnsMaster::PreLockedPreconnect(const std::string& hostname,
+                                    const ReferrerValue& referrer_value) {
+  DCHECK_EQ(MessageLoop::current(), host_resolver_loop_);
+
+  double expected_connections = referrer_value.subresource_use_rate();
+  if (expected_connections < kPreconnectWorthyExpectedValue)
+    return;
+
+  int count = std::min(kMaxPreconnectsPerHost,
+                       std::max(1, static_cast<int>(expected_connections)));
+  for (int i = 0; i < count; ++i) {
+    if (pending_preconnects_.size() >= kMaxPendingPreconnects)
+      return;
+    PreconnectRequest* request = new PreconnectRequest(
+        this, preconnect_proxy_service_, preconnect_pool_, hostname);
+    if (request->Start() == net::ERR_IO_PENDING)
+      pending_preconnects_.insert(request);  // Will complete asynchronously.
+    else
+      delete request;
+  }
+}
+
+void DnsMaster::OnPreconnectFinished(PreconnectRequest* request) {
+  DCHECK_EQ(MessageLoop::current(), host_resolver_loop_);
+
+  AutoLock auto_lock(lock_);
+  pending_preconnects_.erase(request);
+  delete request;
+}
+
+// The pool may destroy a preconnected socket while |lock_| is held, for
+// instance when a preconnect request replaces a stale idle socket, so the
+// counters are kept on |host_resolver_loop_| without the lock.
+void DnsMaster::OnPreconnectUsed(TimeDelta idle_time) {
+  DCHECK_EQ(MessageLoop::current(), host_resolver_loop_);
+  UMA_HISTOGRAM_LONG_TIMES("Net.PreconnectHit", idle_time);
+  preconnect_hits_++;
+}
+
+void DnsMaster::OnPreconnectWasted(TimeDelta idle_time) {
+  DCHECK_EQ(MessageLoop::current(), host_resolver_loop_);
+  UMA_HISTOGRAM_LONG_TIMES("Net.PreconnectWaste", idle_time);
+  preconnect_waste_++;
+}
+
 bool DnsMaster::PreLockedCongestionControlPerformed(DnsHostInfo* info) {
   // Note: queue_duration is ONLY valid after we go to assigned state.
   if (info->queue_duration() < max_queue_delay_)
@@ -29,10 +29,13 @@
 using base::TimeDelta;
 
 namespace net {
+class ClientSocketPool;
 class HostResolver;
+class ProxyService;
 }
 
 class MessageLoop;
+class URLRequestContext;
 
 namespace chrome_browser_net {
 
@@ -69,13 +72,23 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
                               DnsHostInfo* navigation_info);
 
   // Instigate prefetch of any domains we predict will be needed after this
-  // navigation.
+  // navigation.  Called when a frame starts loading from |host_name|, and not
+  // for every resolution of the name.
   void NavigatingTo(const std::string& host_name);
 
   // Record details of a navigation so that we can preresolve the host name
   // ahead of time the next time the users navigates to the indicated host.
   void NonlinkNavigation(const GURL& referrer, DnsHostInfo* navigation_info);
 
+  // Have NavigatingTo() also connect TCP sockets, in the HTTP connection pool
+  // of |context|, to the hosts that a navigation is expected to need with
+  // high confidence.  The context is held until Shutdown().
+  void SetPreconnectContext(URLRequestContext* context);
+
+  // Suspend or resume the preconnection of sockets, for instance while an
+  // OffTheRecord window is open.
+  void EnablePreconnect(bool enable);
+
   // Dump HTML table containing list of referrers for about:dns.
   void GetHtmlReferrerLists(std::string* output);
 
@@ -102,6 +115,12 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   // For unit test code only.
   size_t max_concurrent_lookups() const { return max_concurrent_lookups_; }
 
+  // For unit test code only: preconnect through |proxy_service|, which must
+  // outlive this object, and |pool| rather than a URLRequestContext.  Must be
+  // called on |host_resolver_loop_|.
+  void SetPreconnectPoolForTest(net::ProxyService* proxy_service,
+                                net::ClientSocketPool* pool);
+
  private:
   FRIEND_TEST(DnsMasterTest, BenefitLookupTest);
   FRIEND_TEST(DnsMasterTest, ShutdownWhenResolutionIsPendingTest);
@@ -110,9 +129,15 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   FRIEND_TEST(DnsMasterTest, DISABLED_MassiveConcurrentLookupTest);
   FRIEND_TEST(DnsMasterTest, PriorityQueuePushPopTest);
   FRIEND_TEST(DnsMasterTest, PriorityQueueReorderTest);
+  FRIEND_TEST(DnsMasterTest, ReferrerUseRateTest);
+  FRIEND_TEST(DnsMasterPreconnectTest, PreconnectHitTest);
+  FRIEND_TEST(DnsMasterPreconnectTest, PreconnectWasteTest);
+  FRIEND_TEST(DnsMasterPreconnectTest, PreconnectWorthinessTest);
   friend class WaitForResolutionHelper;  // For testing.
 
   class LookupRequest;
+  class PreconnectRequest;
+  class PreconnectedSocket;
 
   // A simple priority queue for handling host names.
   // Some names that are queued up have |motivation| that requires very rapid
@@ -200,6 +225,20 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   // asynchronously, provided we don't exceed concurrent resolution limit.
   void PreLockedScheduleLookups();
 
+  // Connect as many sockets to |hostname| as |referrer_value| shows a
+  // navigation is expected to need, within the limit of pending preconnects.
+  void PreLockedPreconnect(const std::string& hostname,
+                           const ReferrerValue& referrer_value);
+
+  // Access method for use by async preconnect request to report completion.
+  void OnPreconnectFinished(PreconnectRequest* request);
+
+  // Access methods for use by a preconnected socket to report whether a
+  // request used it, |idle_time| after it was connected, or it was closed
+  // unused, |idle_time| after it was connected.
+  void OnPreconnectUsed(TimeDelta idle_time);
+  void OnPreconnectWasted(TimeDelta idle_time);
+
   // Synchronize access to variables listed below.
   Lock lock_;
 
@@ -222,6 +261,23 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   // When true, we don't make new lookup requests.
   bool shutdown_;
 
+  // The context through which sockets are preconnected, or NULL when
+  // preconnection is not done.  It keeps alive the proxy service and the
+  // connection pool below.  Only used on |host_resolver_loop_|.
+  scoped_refptr<URLRequestContext> preconnect_context_;
+  net::ProxyService* preconnect_proxy_service_;
+  scoped_refptr<net::ClientSocketPool> preconnect_pool_;
+
+  std::set<PreconnectRequest*> pending_preconnects_;
+
+  // Cleared while preconnection is suspended.
+  bool preconnect_enabled_;
+
+  // The number of preconnected sockets that a request used, and the number
+  // that were closed unused.
+  int preconnect_hits_;
+  int preconnect_waste_;
+
   // A list of successful events resulting from pre-fetching.
   DnsHostInfo::DnsInfoTable cache_hits_;
   // A map of hosts that were evicted from our cache (after we prefetched them)
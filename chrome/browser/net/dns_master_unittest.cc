@@ -17,7 +17,14 @@
 #include "net/base/address_list.h"
 #include "net/base/host_resolver.h"
 #include "net/base/host_resolver_unittest.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
 #include "net/base/winsock_init.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/socket_test_util.h"
+#include "net/socket/tcp_client_socket_pool.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::Time;
@@ -566,6 +573,175 @@ TEST_F(DnsMasterTest, ReferrerSerializationTrimTest) {
   master->Shutdown();
 }
 
+// Make sure that the use rate of a subresource host, which decides whether we
+// preconnect to it, follows how often the navigations to its referrer needed
+// it.
+TEST_F(DnsMasterTest, ReferrerUseRateTest) {
+  mapper_->AddRule("icons.google.com", "127.0.0.1");
+  scoped_refptr<DnsMaster> master = new DnsMaster(new net::HostResolver,
+      MessageLoop::current(), default_max_queueing_delay_,
+      DnsPrefetcherInit::kMaxConcurrentLookups);
+  const GURL referrer_url("http://www.google.com/");
+  DnsHostInfo subresource_info;
+  subresource_info.SetHostname("icons.google.com");
+
+  // The first navigation only teaches us about the subresource.
+  master->NonlinkNavigation(referrer_url, &subresource_info);
+  const ReferrerValue& value =
+      master->referrers_["www.google.com"]["icons.google.com"];
+  EXPECT_DOUBLE_EQ(0, value.subresource_use_rate());
+
+  // The next navigation needs it again.
+  master->NavigatingTo("www.google.com");
+  EXPECT_DOUBLE_EQ(1, value.subresource_use_rate());
+  master->NonlinkNavigation(referrer_url, &subresource_info);
+
+  // The one after that doesn't.
+  master->NavigatingTo("www.google.com");
+  EXPECT_DOUBLE_EQ(1, value.subresource_use_rate());
+
+  master->NavigatingTo("www.google.com");
+  EXPECT_DOUBLE_EQ(2.0 / 3, value.subresource_use_rate());
+
+  master->Shutdown();
+}
+
+// The connection group of a direct HTTP connection to icons.google.com.
+static const char kPreconnectGroup[] = "http://icons.google.com/";
+
+// Resolve |hostname| ahead of time, so that the preconnects through
+// |host_resolver| only wait for the (mock) connect.
+static void CacheHostResolution(net::HostResolver* host_resolver,
+                                const std::string& hostname) {
+  net::AddressList addresses;
+  net::HostResolver::RequestInfo info(hostname, 80);
+  EXPECT_EQ(net::OK, host_resolver->Resolve(info, &addresses, NULL, NULL));
+}
+
+class DnsMasterPreconnectTest : public DnsMasterTest {
+ protected:
+  DnsMasterPreconnectTest()
+      : proxy_service_(net::ProxyService::CreateNull()) {
+  }
+
+  // Creates a master which preconnects sockets through |pool_|.  The first
+  // socket connected to icons.google.com gets the data of |socket_data|.
+  DnsMaster* CreatePreconnectingMaster(net::MockSocket* socket_data) {
+    mapper_->AddRule("icons.google.com", "127.0.0.1");
+    scoped_refptr<net::HostResolver> host_resolver = new net::HostResolver;
+    CacheHostResolution(host_resolver, "icons.google.com");
+    socket_factory_.AddMockSocket(socket_data);
+    pool_ = new net::TCPClientSocketPool(6, 6, host_resolver, &socket_factory_);
+
+    DnsMaster* master = new DnsMaster(host_resolver,
+        MessageLoop::current(), default_max_queueing_delay_,
+        DnsPrefetcherInit::kMaxConcurrentLookups);
+    master->SetPreconnectPoolForTest(proxy_service_.get(), pool_);
+    return master;
+  }
+
+  net::MockClientSocketFactory socket_factory_;
+  scoped_ptr<net::ProxyService> proxy_service_;
+  scoped_refptr<net::ClientSocketPool> pool_;
+};
+
+// Make sure that sockets are only preconnected to a host that navigations to
+// the referrer needed often enough.
+TEST_F(DnsMasterPreconnectTest, PreconnectWorthinessTest) {
+  net::StaticMockSocket socket_data;
+  scoped_refptr<DnsMaster> master = CreatePreconnectingMaster(&socket_data);
+
+  // Nothing was learned about the referrer yet.
+  master->NavigatingTo("www.google.com");
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, pool_->IdleSocketCount());
+
+  // The first navigation only teaches us about the subresource.
+  const GURL referrer_url("http://www.google.com/");
+  DnsHostInfo subresource_info;
+  subresource_info.SetHostname("icons.google.com");
+  master->NonlinkNavigation(referrer_url, &subresource_info);
+
+  // The next navigation is expected to need it once.
+  master->NavigatingTo("www.google.com");
+  MessageLoop::current()->RunAllPending();
+  EXPECT_TRUE(master->pending_preconnects_.empty());
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup(kPreconnectGroup));
+
+  // The one after that only half of the time, which is not worth a socket.
+  pool_->CloseIdleSockets();
+  master->NavigatingTo("www.google.com");
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, pool_->IdleSocketCount());
+
+  master->Shutdown();
+}
+
+// Make sure that a request that uses a preconnected socket counts as a hit.
+TEST_F(DnsMasterPreconnectTest, PreconnectHitTest) {
+  net::MockRead reads[] = {
+    net::MockRead(false, "HTTP/1.0 200 OK\r\n\r\n"),
+    net::MockRead(false, net::OK),
+  };
+  net::StaticMockSocket socket_data(reads, NULL);
+  scoped_refptr<DnsMaster> master = CreatePreconnectingMaster(&socket_data);
+
+  const GURL referrer_url("http://www.google.com/");
+  DnsHostInfo subresource_info;
+  subresource_info.SetHostname("icons.google.com");
+  master->NonlinkNavigation(referrer_url, &subresource_info);
+  master->NavigatingTo("www.google.com");
+  // The connect of the mock socket completes asynchronously.
+  EXPECT_EQ(1U, master->pending_preconnects_.size());
+  MessageLoop::current()->RunAllPending();
+  EXPECT_TRUE(master->pending_preconnects_.empty());
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup(kPreconnectGroup));
+
+  // A request for the host reuses the preconnected socket.
+  net::ClientSocketHandle handle(pool_);
+  TestCompletionCallback callback;
+  net::HostResolver::RequestInfo info("icons.google.com", 80);
+  EXPECT_EQ(net::OK, handle.Init(kPreconnectGroup, info, 0, &callback));
+  EXPECT_TRUE(handle.is_reused());
+  EXPECT_EQ(0, master->preconnect_hits_);
+
+  // It is a hit once the request reads from it, and only once.
+  scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(1);
+  EXPECT_EQ(1, handle.socket()->Read(buf, 1, &callback));
+  EXPECT_EQ(1, handle.socket()->Read(buf, 1, &callback));
+  EXPECT_EQ(1, master->preconnect_hits_);
+
+  // Closing a socket that was used is not waste.
+  handle.socket()->Disconnect();
+  handle.Reset();
+  MessageLoop::current()->RunAllPending();
+  pool_->CloseIdleSockets();
+  EXPECT_EQ(1, master->preconnect_hits_);
+  EXPECT_EQ(0, master->preconnect_waste_);
+
+  master->Shutdown();
+}
+
+// Make sure that a preconnected socket that is closed unused counts as waste.
+TEST_F(DnsMasterPreconnectTest, PreconnectWasteTest) {
+  net::StaticMockSocket socket_data;
+  scoped_refptr<DnsMaster> master = CreatePreconnectingMaster(&socket_data);
+
+  const GURL referrer_url("http://www.google.com/");
+  DnsHostInfo subresource_info;
+  subresource_info.SetHostname("icons.google.com");
+  master->NonlinkNavigation(referrer_url, &subresource_info);
+  master->NavigatingTo("www.google.com");
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup(kPreconnectGroup));
+
+  // The socket still reports to the master after the master shuts down, since
+  // it holds a reference to the master.
+  master->Shutdown();
+  pool_->CloseIdleSockets();
+  EXPECT_EQ(0, master->preconnect_hits_);
+  EXPECT_EQ(1, master->preconnect_waste_);
+}
 
 TEST_F(DnsMasterTest, PriorityQueuePushPopTest) {
   DnsMaster::HostNameQueue queue;
@@ -72,6 +72,12 @@ void Referrer::AccrueValue(const base::TimeDelta& delta,
     it->second.AccrueValue(delta);
 }
 
+void Referrer::SubresourceIsNeeded(const std::string& host) {
+  HostNameMap::iterator it = find(host);
+  if (it != end())
+    it->second.SubresourceIsNeeded();
+}
+
 bool Referrer::Trim() {
   bool has_some_latency_left = false;
   for (HostNameMap::iterator it = begin(); it != end(); ++it)
@@ -80,9 +86,19 @@ bool Referrer::Trim() {
   return has_some_latency_left;
 }
 
+double ReferrerValue::subresource_use_rate() const {
+  if (!navigation_count_)
+    return 0;
+  return static_cast<double>(subresource_use_count_) / navigation_count_;
+}
+
 bool ReferrerValue::Trim() {
   int64 latency_ms = latency_.InMilliseconds() / 2;
   latency_ = base::TimeDelta::FromMilliseconds(latency_ms);
+  // Scale the counts down together, so that the use rate follows the recent
+  // navigations without changing right away.
+  navigation_count_ /= 2;
+  subresource_use_count_ /= 2;
   return latency_ms > 0;
 }
 
@@ -30,19 +30,35 @@ namespace chrome_browser_net {
 // entry.
 class ReferrerValue {
  public:
-  ReferrerValue() : birth_time_(base::Time::Now()) {}
+  ReferrerValue()
+      : birth_time_(base::Time::Now()),
+        navigation_count_(0),
+        subresource_use_count_(0) {}
 
   base::TimeDelta latency() const { return latency_; }
   base::Time birth_time() const { return birth_time_; }
   void AccrueValue(const base::TimeDelta& delta) { latency_ += delta; }
 
-  // Reduce the latency figure by a factor of 2, and return true if any latency
-  // remains.
+  // Record a navigation to the referrer, after which this host may be needed.
+  void ReferrerWasObserved() { ++navigation_count_; }
+
+  // Record that a page of the referrer needed (a connection to) this host.
+  void SubresourceIsNeeded() { ++subresource_use_count_; }
+
+  // The number of times this host was needed per navigation to the referrer,
+  // which is the expected number of connections a navigation will make to it.
+  // Returns 0 until a navigation to the referrer has been observed.
+  double subresource_use_rate() const;
+
+  // Reduce the latency figure, and the use counts, by a factor of 2, and
+  // return true if any latency remains.
   bool Trim();
 
  private:
   base::TimeDelta latency_;  // Accumulated latency savings.
   const base::Time birth_time_;
+  int navigation_count_;  // Navigations to the referrer since birth.
+  int subresource_use_count_;  // Times this host was needed since birth.
 };
 
 //------------------------------------------------------------------------------
@@ -71,6 +87,9 @@ class Referrer : public HostNameMap {
   // Value is expressed as positive latency of amount delta.
   void AccrueValue(const base::TimeDelta& delta, const std::string host);
 
+  // Record that a page of this referrer needed the indicated host.
+  void SubresourceIsNeeded(const std::string& host);
+
   // Trim the Referrer, by first diminishing (scaling down) the latency for each
   // ReferredValue.
   // Returns true if there are any referring names with some latency left.
@@ -11,6 +11,14 @@
 
 SharedIOBuffer* AsyncResourceHandler::spare_read_buffer_;
 
+namespace {
+
+// The size of the shared memory buffer of a request.
+const int kBufferSize = AsyncResourceHandler::kReadBufSize *
+                        AsyncResourceHandler::kNumReadChunks;
+
+}  // namespace
+
 // Our version of IOBuffer that uses shared memory.
 class SharedIOBuffer : public net::IOBuffer {
  public:
@@ -44,7 +52,9 @@ AsyncResourceHandler::AsyncResourceHandler(
       process_id_(process_id),
       routing_id_(routing_id),
       process_handle_(process_handle),
-      rdh_(resource_dispatcher_host) {
+      rdh_(resource_dispatcher_host),
+      next_chunk_(0),
+      sent_read_buffer_(false) {
 }
 
 bool AsyncResourceHandler::OnUploadProgress(int request_id,
@@ -72,16 +82,23 @@ bool AsyncResourceHandler::OnResponseStarted(int request_id,
 bool AsyncResourceHandler::OnWillRead(int request_id, net::IOBuffer** buf,
                                       int* buf_size, int min_size) {
   DCHECK(min_size == -1);
-  static const int kReadBufSize = 32768;
-  if (spare_read_buffer_) {
-    DCHECK(!read_buffer_);
-    read_buffer_.swap(&spare_read_buffer_);
-  } else {
-    read_buffer_ = new SharedIOBuffer(kReadBufSize);
-    if (!read_buffer_->ok())
-      return false;
+  if (!read_buffer_.get()) {
+    if (spare_read_buffer_) {
+      read_buffer_.swap(&spare_read_buffer_);
+    } else {
+      read_buffer_ = new SharedIOBuffer(kBufferSize);
+      if (!read_buffer_->ok())
+        return false;
+    }
+    read_chunk_ = new net::ReusedIOBuffer(read_buffer_, kBufferSize);
+
+    // Only the chunks the renderer has yet to acknowledge count against the
+    // memory it may tie up in the browser, so that a slow response does not
+    // cost as much as one that the renderer fails to keep up with.
+    rdh_->SetDataMessageCost(process_id_, request_id, kReadBufSize);
   }
-  *buf = read_buffer_.get();
+  read_chunk_->SetOffset(next_chunk_ * kReadBufSize);
+  *buf = read_chunk_.get();
   *buf_size = kReadBufSize;
   return true;
 }
@@ -96,22 +113,24 @@ bool AsyncResourceHandler::OnReadCompleted(int request_id, int* bytes_read) {
     return true;
   }
 
-  base::SharedMemoryHandle handle;
-  if (!read_buffer_->shared_memory()->GiveToProcess(process_handle_, &handle)) {
-    // We wrongfully incremented the pending data count. Fake an ACK message
-    // to fix this. We can't move this call above the WillSendData because
-    // it's killing our read_buffer_, and we don't want that when we pause
-    // the request.
-    rdh_->DataReceivedACK(process_id_, request_id);
-    // We just unmapped the memory.
-    read_buffer_ = NULL;
-    return false;
+  if (!sent_read_buffer_) {
+    base::SharedMemoryHandle handle;
+    if (!read_buffer_->shared_memory()->ShareToProcess(process_handle_,
+                                                       &handle)) {
+      // We wrongfully incremented the pending data count. Fake an ACK message
+      // to fix this. We can't move this call above the WillSendData because
+      // we don't want to share the buffer when we pause the request.
+      rdh_->DataReceivedACK(process_id_, request_id);
+      return false;
+    }
+    receiver_->Send(new ViewMsg_Resource_SetDataBuffer(
+        routing_id_, request_id, handle, kBufferSize));
+    sent_read_buffer_ = true;
   }
-  // We just unmapped the memory.
-  read_buffer_ = NULL;
 
   receiver_->Send(new ViewMsg_Resource_DataReceived(
-      routing_id_, request_id, handle, *bytes_read));
+      routing_id_, request_id, next_chunk_ * kReadBufSize, *bytes_read));
+  next_chunk_ = (next_chunk_ + 1) % kNumReadChunks;
 
   return true;
 }
@@ -125,8 +144,10 @@ bool AsyncResourceHandler::OnResponseCompleted(
                                                        status,
                                                        security_info));
 
-  // If we still have a read buffer, then see about caching it for later...
-  if (spare_read_buffer_) {
+  // If we still have a read buffer the renderer never saw, then see about
+  // caching it for later...
+  read_chunk_ = NULL;
+  if (spare_read_buffer_ || sent_read_buffer_) {
     read_buffer_ = NULL;
   } else if (read_buffer_.get()) {
     read_buffer_.swap(&spare_read_buffer_);
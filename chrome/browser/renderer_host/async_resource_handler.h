@@ -11,6 +11,10 @@
 #include "chrome/browser/renderer_host/resource_dispatcher_host.h"
 #include "chrome/browser/renderer_host/resource_handler.h"
 
+namespace net {
+class ReusedIOBuffer;
+}
+
 class SharedIOBuffer;
 
 // Used to complete an asynchronous resource request in response to resource
@@ -37,6 +41,18 @@ class AsyncResourceHandler : public ResourceHandler {
 
   static void GlobalCleanup();
 
+  // The response data is read into chunks of a shared memory buffer, which
+  // is given to the renderer once. Reading goes round the buffer one chunk
+  // at a time, and a chunk is not reused before the renderer acknowledges the
+  // data message that points to it. As the ResourceDispatcherHost pauses the
+  // request when too many data messages are pending, one more chunk than that
+  // is enough for reads to never block on the renderer.  Each chunk the
+  // renderer has not acknowledged yet is added to the memory cost of the
+  // request.
+  static const int kReadBufSize = 32768;
+  static const int kNumReadChunks =
+      ResourceDispatcherHost::kMaxPendingDataMessages + 1;
+
  private:
   // When reading, we don't know if we are going to get EOF (0 bytes read), so
   // we typically have a buffer that we allocated but did not use.  We keep
@@ -44,6 +60,14 @@ class AsyncResourceHandler : public ResourceHandler {
   static SharedIOBuffer* spare_read_buffer_;
 
   scoped_refptr<SharedIOBuffer> read_buffer_;
+
+  // The chunk of |read_buffer_| the next read goes to.
+  scoped_refptr<net::ReusedIOBuffer> read_chunk_;
+  int next_chunk_;
+
+  // Whether |read_buffer_| was already sent to the renderer.
+  bool sent_read_buffer_;
+
   ResourceDispatcherHost::Receiver* receiver_;
   int process_id_;
   int routing_id_;
@@ -252,6 +252,7 @@ bool BufferedResourceHandler::CompleteResponseStarted(int request_id,
     }
 
     info->is_download = true;
+    host_->UnscheduleRequest(request_);
 
     scoped_refptr<DownloadThrottlingResourceHandler> download_handler =
         new DownloadThrottlingResourceHandler(host_,
@@ -9,8 +9,10 @@
 #include <vector>
 
 #include "base/command_line.h"
+#include "base/histogram.h"
 #include "base/message_loop.h"
 #include "base/scoped_ptr.h"
+#include "base/stats_counters.h"
 #include "base/stl_util-inl.h"
 #include "base/time.h"
 #include "chrome/browser/cert_store.h"
@@ -22,6 +24,7 @@
 #include "chrome/browser/download/save_file_manager.h"
 #include "chrome/browser/external_protocol_handler.h"
 #include "chrome/browser/in_process_webkit/webkit_thread.h"
+#include "chrome/browser/net/dns_global.h"
 #include "chrome/browser/plugin_service.h"
 #include "chrome/browser/privacy_blacklist/blacklist.h"
 #include "chrome/browser/profile.h"
@@ -100,13 +103,11 @@ namespace {
 // The interval for calls to ResourceDispatcherHost::UpdateLoadStates
 const int kUpdateLoadStatesIntervalMsec = 100;
 
-// Maximum number of pending data messages sent to the renderer at any
-// given time for a given request.
-const int kMaxPendingDataMessages = 20;
-
 // Maximum byte "cost" of all the outstanding requests for a renderer.
 // See delcaration of |max_outstanding_requests_cost_per_process_| for details.
-// This bound is 25MB, which allows for around 6000 outstanding requests.
+// This bound is 25MB, which allows for around 6000 outstanding requests, or
+// around 50 requests that are reading their responses at the same time, since
+// each of those holds a data buffer (see AsyncResourceHandler).
 const int kMaxOutstandingRequestsCostPerProcess = 26214400;
 
 // A NotificationTask proxies a resource dispatcher notification from the IO
@@ -238,6 +239,8 @@ ResourceDispatcherHost::~ResourceDispatcherHost() {
        iter != ids.end(); ++iter) {
     CancelBlockedRequestsForRoute(iter->first, iter->second);
   }
+
+  DeleteDelayedRequests();
 }
 
 void ResourceDispatcherHost::Initialize() {
@@ -255,6 +258,7 @@ void ResourceDispatcherHost::OnShutdown() {
   DCHECK(MessageLoop::current() == io_loop_);
   is_shutdown_ = true;
   STLDeleteValues(&pending_requests_);
+  DeleteDelayedRequests();
   // Make sure we shutdown the timer now, otherwise by the time our destructor
   // runs if the timer is still running the Task is deleted twice (once by
   // the MessageLoop and the second time by RepeatingTimer).
@@ -476,8 +480,14 @@ void ResourceDispatcherHost::BeginRequest(
                            upload_size);
   extra_info->allow_download =
       ResourceType::IsFrame(request_data.resource_type);
+  extra_info->is_sync_load = sync_result != NULL;
   SetExtraInfoForRequest(request, extra_info);  // request takes ownership
 
+  // A frame load is where a navigation really starts, so prefetch the hosts
+  // that its subresources are expected to come from.
+  if (ResourceType::IsFrame(request_data.resource_type))
+    chrome_browser_net::DnsPrefetchNavigatingTo(request_data.url);
+
   BeginRequestInternal(request);
 }
 
@@ -496,6 +506,11 @@ void ResourceDispatcherHost::DataReceivedACK(int process_id, int request_id) {
   // Decrement the number of pending data messages.
   info->pending_data_count--;
 
+  // The renderer is done with the data, so its buffer may be reused.
+  info->memory_cost -= info->data_message_cost;
+  IncrementOutstandingRequestsMemoryCost(-1 * info->data_message_cost,
+                                         process_id);
+
   // If the pending data count was higher than the max, resume the request.
   if (info->pending_data_count == kMaxPendingDataMessages) {
     // Decrement the pending data count one more time because we also
@@ -684,6 +699,10 @@ void ResourceDispatcherHost::CancelRequest(int process_id,
   PendingRequestList::iterator i = pending_requests_.find(
       GlobalRequestID(process_id, request_id));
   if (i == pending_requests_.end()) {
+    // A request that waits for higher priority requests was never started.
+    if (CancelDelayedRequest(process_id, request_id))
+      return;
+
     // We probably want to remove this warning eventually, but I wanted to be
     // able to notice when this happens during initial development since it
     // should be rare and may indicate a bug.
@@ -740,9 +759,27 @@ bool ResourceDispatcherHost::WillSendData(int process_id,
     return false;
   }
 
+  // The data stays in the browser until the renderer acknowledges it.
+  info->memory_cost += info->data_message_cost;
+  IncrementOutstandingRequestsMemoryCost(info->data_message_cost, process_id);
   return true;
 }
 
+void ResourceDispatcherHost::SetDataMessageCost(int process_id,
+                                                int request_id,
+                                                int cost) {
+  PendingRequestList::iterator i = pending_requests_.find(
+      GlobalRequestID(process_id, request_id));
+  if (i == pending_requests_.end()) {
+    NOTREACHED() << L"SetDataMessageCost for invalid request";
+    return;
+  }
+
+  ExtraRequestInfo* info = ExtraInfoForRequest(i->second);
+  DCHECK_EQ(0, info->pending_data_count);
+  info->data_message_cost = cost;
+}
+
 void ResourceDispatcherHost::PauseRequest(int process_id,
                                           int request_id,
                                           bool pause) {
@@ -826,6 +863,17 @@ void ResourceDispatcherHost::CancelRequestsForRoute(
       RemovePendingRequest(iter);
   }
 
+  // The delayed requests were never started.
+  CancelDelayedRequestsForRoute(process_id, route_id);
+  if (route_id == -1) {
+    // The process is gone.  The requests it still has in flight are not
+    // counted anymore.
+    scheduler_states_.erase(
+        scheduler_states_.lower_bound(ProcessRouteIDs(process_id, kint32min)),
+        scheduler_states_.upper_bound(ProcessRouteIDs(process_id,
+                                                      kint32max)));
+  }
+
   // Now deal with blocked requests if any.
   if (route_id != -1) {
     if (blocked_requests_map_.find(std::pair<int, int>(process_id, route_id)) !=
@@ -875,6 +923,9 @@ void ResourceDispatcherHost::RemovePendingRequest(
   if (info && info->login_handler)
     info->login_handler->OnRequestCancelled();
 
+  // Let the delayed requests of the process use the room of this request.
+  UnscheduleRequest(iter->second);
+
   delete iter->second;
   pending_requests_.erase(iter);
 
@@ -905,6 +956,10 @@ void ResourceDispatcherHost::OnReceivedRedirect(URLRequest* request,
 
   NotifyReceivedRedirect(request, info->process_id, new_url);
 
+  // A redirected frame load navigates to |new_url| instead.
+  if (ResourceType::IsFrame(info->resource_type))
+    chrome_browser_net::DnsPrefetchNavigatingTo(new_url);
+
   if (HandleExternalProtocol(info->request_id, info->process_id,
                              info->route_id, new_url,
                              info->resource_type, info->resource_handler)) {
@@ -1118,6 +1173,121 @@ void ResourceDispatcherHost::BeginRequestInternal(URLRequest* request) {
     return;
   }
 
+  ScheduleRequest(request);
+}
+
+// static
+ResourceDispatcherHost::SchedulingPriority
+ResourceDispatcherHost::SchedulingPriorityForResourceType(
+    ResourceType::Type type) {
+  switch (type) {
+    case ResourceType::MAIN_FRAME:
+    case ResourceType::SUB_FRAME:
+      return HIGH_PRIORITY;
+    case ResourceType::SUB_RESOURCE:
+      return MEDIUM_PRIORITY;
+    default:
+      return LOW_PRIORITY;
+  }
+}
+
+int ResourceDispatcherHost::GetDelayedRequestsCount(int process_id,
+                                                    int route_id) const {
+  SchedulerStateMap::const_iterator iter =
+      scheduler_states_.find(ProcessRouteIDs(process_id, route_id));
+  if (iter == scheduler_states_.end())
+    return 0;
+  return static_cast<int>(iter->second.delayed_requests.size());
+}
+
+// static
+bool ResourceDispatcherHost::HasRoomForLowPriorityRequest(
+    const SchedulerState& state) {
+  return !state.high_priority_in_flight ||
+      state.low_priority_in_flight <
+          kMaxLowPriorityRequestsWhileHighPriorityInFlight;
+}
+
+void ResourceDispatcherHost::ScheduleRequest(URLRequest* request) {
+  ExtraRequestInfo* info = ExtraInfoForRequest(request);
+  SchedulingPriority priority =
+      SchedulingPriorityForResourceType(info->resource_type);
+
+  // Downloads belong to the browser, and are never delayed.  Neither are
+  // synchronous loads, since the frames can't complete while the child
+  // process waits for them.
+  if (info->is_download || info->is_sync_load || priority >= HIGH_PRIORITY ||
+      !IsHttpPrioritizationEnabled()) {
+    StartRequest(request);
+    return;
+  }
+
+  SchedulerState& state =
+      scheduler_states_[ProcessRouteIDs(info->process_id, info->route_id)];
+  if (state.delayed_requests.empty() && HasRoomForLowPriorityRequest(state)) {
+    StartRequest(request);
+    return;
+  }
+
+  // Wait behind the requests of the same or a higher priority.
+  DelayedRequestList::iterator iter = state.delayed_requests.begin();
+  while (iter != state.delayed_requests.end() &&
+         SchedulingPriorityForResourceType(
+             ExtraInfoForRequest(*iter)->resource_type) >= priority) {
+    ++iter;
+  }
+  state.delayed_requests.insert(iter, request);
+  info->delay_start_ticks = TimeTicks::Now();
+
+  static StatsCounter delayed_requests("ResourceDispatcherHost.Delayed");
+  delayed_requests.Increment();
+}
+
+void ResourceDispatcherHost::UnscheduleRequest(URLRequest* request) {
+  ExtraRequestInfo* info = ExtraInfoForRequest(request);
+  if (!info->is_scheduled)
+    return;
+  info->is_scheduled = false;
+
+  SchedulerStateMap::iterator state_iter =
+      scheduler_states_.find(ProcessRouteIDs(info->process_id, info->route_id));
+  if (state_iter == scheduler_states_.end())
+    return;
+
+  SchedulerState& state = state_iter->second;
+  if (SchedulingPriorityForResourceType(info->resource_type) >=
+      HIGH_PRIORITY) {
+    state.high_priority_in_flight--;
+  } else {
+    state.low_priority_in_flight--;
+  }
+  DCHECK_GE(state.high_priority_in_flight, 0);
+  DCHECK_GE(state.low_priority_in_flight, 0);
+
+  // Start them asynchronously, to avoid recursion problems.
+  if (!state.delayed_requests.empty() && HasRoomForLowPriorityRequest(state)) {
+    MessageLoop::current()->PostTask(FROM_HERE,
+        method_runner_.NewRunnableMethod(
+            &ResourceDispatcherHost::StartDelayedRequests,
+            info->process_id, info->route_id));
+  }
+  RemoveSchedulerStateIfIdle(state_iter);
+}
+
+void ResourceDispatcherHost::StartRequest(URLRequest* request) {
+  ExtraRequestInfo* info = ExtraInfoForRequest(request);
+  if (!info->is_download && !info->is_sync_load) {
+    SchedulerState& state =
+        scheduler_states_[ProcessRouteIDs(info->process_id, info->route_id)];
+    if (SchedulingPriorityForResourceType(info->resource_type) >=
+        HIGH_PRIORITY) {
+      state.high_priority_in_flight++;
+    } else {
+      state.low_priority_in_flight++;
+    }
+    info->is_scheduled = true;
+  }
+
   GlobalRequestID global_id(info->process_id, info->request_id);
   pending_requests_[global_id] = request;
   if (!SSLManager::ShouldStartRequest(this, request, ui_loop_)) {
@@ -1550,6 +1720,95 @@ void ResourceDispatcherHost::MaybeUpdateUploadProgress(ExtraRequestInfo *info,
   }
 }
 
+void ResourceDispatcherHost::StartDelayedRequests(int process_id,
+                                                  int route_id) {
+  SchedulerStateMap::iterator iter =
+      scheduler_states_.find(ProcessRouteIDs(process_id, route_id));
+  if (iter == scheduler_states_.end())
+    return;
+
+  SchedulerState& state = iter->second;
+  while (!state.delayed_requests.empty() &&
+         HasRoomForLowPriorityRequest(state)) {
+    URLRequest* request = state.delayed_requests.front();
+    state.delayed_requests.pop_front();
+    UMA_HISTOGRAM_TIMES("Net.ResourceDispatcherHost_SchedulingDelay",
+        TimeTicks::Now() - ExtraInfoForRequest(request)->delay_start_ticks);
+    StartRequest(request);
+  }
+}
+
+bool ResourceDispatcherHost::CancelDelayedRequest(int process_id,
+                                                  int request_id) {
+  // The request ID doesn't tell the view, so look in all of the process.
+  SchedulerStateMap::iterator iter =
+      scheduler_states_.lower_bound(ProcessRouteIDs(process_id, kint32min));
+  for (; iter != scheduler_states_.end() && iter->first.first == process_id;
+       ++iter) {
+    DelayedRequestList& requests = iter->second.delayed_requests;
+    for (DelayedRequestList::iterator req_iter = requests.begin();
+         req_iter != requests.end(); ++req_iter) {
+      ExtraRequestInfo* info = ExtraInfoForRequest(*req_iter);
+      if (info->request_id == request_id) {
+        IncrementOutstandingRequestsMemoryCost(-1 * info->memory_cost,
+                                               info->process_id);
+        delete *req_iter;
+        requests.erase(req_iter);
+        RemoveSchedulerStateIfIdle(iter);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ResourceDispatcherHost::CancelDelayedRequestsForRoute(int process_id,
+                                                           int route_id) {
+  SchedulerStateMap::iterator iter;
+  SchedulerStateMap::iterator end;
+  if (route_id == -1) {
+    iter = scheduler_states_.lower_bound(ProcessRouteIDs(process_id,
+                                                         kint32min));
+    end = scheduler_states_.upper_bound(ProcessRouteIDs(process_id,
+                                                        kint32max));
+  } else {
+    iter = scheduler_states_.find(ProcessRouteIDs(process_id, route_id));
+    if (iter == scheduler_states_.end())
+      return;
+    end = iter;
+    ++end;
+  }
+
+  while (iter != end) {
+    DelayedRequestList& requests = iter->second.delayed_requests;
+    for (DelayedRequestList::iterator req_iter = requests.begin();
+         req_iter != requests.end(); ++req_iter) {
+      ExtraRequestInfo* info = ExtraInfoForRequest(*req_iter);
+      IncrementOutstandingRequestsMemoryCost(-1 * info->memory_cost,
+                                             info->process_id);
+      delete *req_iter;
+    }
+    requests.clear();
+    RemoveSchedulerStateIfIdle(iter++);
+  }
+}
+
+void ResourceDispatcherHost::DeleteDelayedRequests() {
+  for (SchedulerStateMap::iterator iter = scheduler_states_.begin();
+       iter != scheduler_states_.end(); ++iter) {
+    STLDeleteElements(&iter->second.delayed_requests);
+  }
+  scheduler_states_.clear();
+}
+
+void ResourceDispatcherHost::RemoveSchedulerStateIfIdle(
+    SchedulerStateMap::iterator iter) {
+  const SchedulerState& state = iter->second;
+  if (!state.high_priority_in_flight && !state.low_priority_in_flight &&
+      state.delayed_requests.empty())
+    scheduler_states_.erase(iter);
+}
+
 void ResourceDispatcherHost::BlockRequestsForRoute(
     int process_id,
     int route_id) {
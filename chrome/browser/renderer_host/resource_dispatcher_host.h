@@ -12,6 +12,7 @@
 #ifndef CHROME_BROWSER_RENDERER_HOST_RESOURCE_DISPATCHER_HOST_H_
 #define CHROME_BROWSER_RENDERER_HOST_RESOURCE_DISPATCHER_HOST_H_
 
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
@@ -92,7 +93,9 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
           route_id(route_id),
           request_id(request_id),
           pending_data_count(0),
+          data_message_cost(0),
           is_download(false),
+          is_sync_load(false),
           pause_count(0),
           frame_origin(frame_origin),
           main_frame_origin(main_frame_origin),
@@ -105,7 +108,8 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
           memory_cost(0),
           is_paused(false),
           has_started_reading(false),
-          paused_read_bytes(0) {
+          paused_read_bytes(0),
+          is_scheduled(false) {
     }
 
     // Top-level ResourceHandler servicing this request.
@@ -130,12 +134,20 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
 
     int pending_data_count;
 
+    // The bytes of browser memory each data message ties up until the
+    // renderer acknowledges it.  Added to |memory_cost| for every data
+    // message in flight.
+    int data_message_cost;
+
     // Downloads allowed only as a top level request.
     bool allow_download;
 
     // Whether this is a download.
     bool is_download;
 
+    // Whether the child process is blocked until this request completes.
+    bool is_sync_load;
+
     // The number of clients that have called pause on this request.
     int pause_count;
 
@@ -179,6 +191,13 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
 
     // How many bytes have been read while this request has been paused.
     int paused_read_bytes;
+
+    // Whether the request is counted in the requests in flight of its process
+    // by the scheduler.
+    bool is_scheduled;
+
+    // When the request started to wait for higher priority requests.
+    base::TimeTicks delay_start_ticks;
   };
 
   class Observer {
@@ -254,6 +273,11 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   // case the caller should not send the data.
   bool WillSendData(int process_id, int request_id);
 
+  // Sets the bytes of browser memory that each data message of a request
+  // ties up until the renderer acknowledges it.  Only the messages that are
+  // in flight count against the memory cost of the request.
+  void SetDataMessageCost(int process_id, int request_id, int cost);
+
   // Pauses or resumes network activity for a particular request.
   void PauseRequest(int process_id, int request_id, bool pause);
 
@@ -275,6 +299,32 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   // request. Experimentally obtained.
   static const int kAvgBytesPerOutstandingRequest = 4400;
 
+  // The priorities used to schedule the requests of a view (a route of a
+  // child process).  While a view has high priority requests in flight, at
+  // most kMaxLowPriorityRequestsWhileHighPriorityInFlight of its other
+  // requests are in flight, so that they don't compete with the frames for
+  // connections and bandwidth.  The other requests wait, most urgent first.
+  // The views of the same process are scheduled independently.
+  enum SchedulingPriority {
+    LOW_PRIORITY,     // Plugin objects and media.
+    MEDIUM_PRIORITY,  // Sub-resources: style sheets, scripts, images...
+    HIGH_PRIORITY,    // Frames.
+  };
+  static const int kMaxLowPriorityRequestsWhileHighPriorityInFlight = 2;
+
+  // Returns the scheduling priority of a request for a resource of |type|.
+  static SchedulingPriority SchedulingPriorityForResourceType(
+      ResourceType::Type type);
+
+  // Intended for unit-tests only. Returns the number of requests of the view
+  // |route_id| of |process_id| that wait for its high priority requests.
+  int GetDelayedRequestsCount(int process_id, int route_id) const;
+
+  // Maximum number of data messages sent to the renderer and not yet
+  // acknowledged for a given request. Each of them holds a chunk of the
+  // request's shared memory buffer, see AsyncResourceHandler.
+  static const int kMaxPendingDataMessages = 15;
+
   DownloadFileManager* download_file_manager() const {
     return download_file_manager_;
   }
@@ -351,6 +401,11 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   bool ShouldDownload(const std::string& mime_type,
                       const std::string& content_disposition);
 
+  // Called when |request| turns into a download.  Downloads are not
+  // scheduled, so the request stops holding back the other requests of its
+  // process right away, instead of when it completes.
+  void UnscheduleRequest(URLRequest* request);
+
   // Notifies our observers that a request has been cancelled.
   void NotifyResponseCompleted(URLRequest* request, int process_id);
 
@@ -368,9 +423,9 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   // Cancels any blocked request for the specified route id.
   void CancelBlockedRequestsForRoute(int process_id, int route_id);
 
-  // Decrements the pending_data_count for the request and resumes
-  // the request if it was paused due to too many pending data
-  // messages sent.
+  // Decrements the pending_data_count for the request, releases the memory
+  // cost of the acknowledged message and resumes the request if it was
+  // paused due to too many pending data messages sent.
   void DataReceivedACK(int process_id, int request_id);
 
   // Needed for the sync IPC message dispatcher macros.
@@ -393,6 +448,7 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
               IncrementOutstandingRequestsMemoryCost);
   FRIEND_TEST(ResourceDispatcherHostTest,
               CalculateApproximateMemoryCost);
+  FRIEND_TEST(ResourceDispatcherHostTest, ViewsScheduledIndependently);
 
   class ShutdownTask;
 
@@ -436,6 +492,57 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   // Helper function for regular and download requests.
   void BeginRequestInternal(URLRequest* request);
 
+  typedef std::pair<int, int> ProcessRouteIDs;
+
+  // The requests of a view, for scheduling.
+  typedef std::list<URLRequest*> DelayedRequestList;
+  struct SchedulerState {
+    SchedulerState()
+        : high_priority_in_flight(0),
+          low_priority_in_flight(0) {
+    }
+
+    // The number of requests in flight, that is in pending_requests_.
+    int high_priority_in_flight;
+    int low_priority_in_flight;
+
+    // The requests that wait, most urgent first.
+    DelayedRequestList delayed_requests;
+  };
+  typedef std::map<ProcessRouteIDs, SchedulerState> SchedulerStateMap;
+
+  // Returns true if another request below HIGH_PRIORITY can be in flight.
+  static bool HasRoomForLowPriorityRequest(const SchedulerState& state);
+
+  // Starts the request, or delays it if its view has high priority requests
+  // in flight.  Downloads and synchronous loads are never delayed: the child
+  // process stops acknowledging the data of the high priority requests while
+  // it waits for a synchronous load.  The memory cost of the request is
+  // already counted.
+  void ScheduleRequest(URLRequest* request);
+
+  // Adds the request to pending_requests_ and starts it.
+  void StartRequest(URLRequest* request);
+
+  // Starts the delayed requests of the view |route_id| of |process_id| that
+  // no longer need to wait.
+  void StartDelayedRequests(int process_id, int route_id);
+
+  // Removes a delayed request, and its memory cost, and deletes it.  Returns
+  // false if the request is not delayed.
+  bool CancelDelayedRequest(int process_id, int request_id);
+
+  // Removes and deletes the delayed requests of |route_id|, or of all the
+  // routes of the process if |route_id| is -1.
+  void CancelDelayedRequestsForRoute(int process_id, int route_id);
+
+  // Deletes all the delayed requests, without updating their memory cost.
+  void DeleteDelayedRequests();
+
+  // Removes the scheduler state at |iter| if its view has no request in
+  // flight or delayed.
+  void RemoveSchedulerStateIfIdle(SchedulerStateMap::iterator iter);
+
   // Updates the "cost" of outstanding requests for |process_id|.
   // The "cost" approximates how many bytes are consumed by all the in-memory
   // data structures supporting this request (URLRequest object,
@@ -553,10 +660,14 @@ class ResourceDispatcherHost : public URLRequest::Delegate {
   bool is_shutdown_;
 
   typedef std::vector<URLRequest*> BlockedRequestsList;
-  typedef std::pair<int, int> ProcessRouteIDs;
   typedef std::map<ProcessRouteIDs, BlockedRequestsList*> BlockedRequestMap;
   BlockedRequestMap blocked_requests_map_;
 
+  // Maps the views to their scheduler state.  The entry of a view is removed
+  // once it has no request in flight or delayed, and those of a process when
+  // all its requests are cancelled.
+  SchedulerStateMap scheduler_states_;
+
   // Maps the process_ids to the approximate number of bytes
   // being used to service its resource requests. No entry implies 0 cost.
   typedef std::map<int, int> OutstandingRequestsMemoryCostMap;
@@ -0,0 +1,168 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/process_util.h"
+#include "base/scoped_ptr.h"
+#include "base/task.h"
+#include "chrome/browser/child_process_security_policy.h"
+#include "chrome/browser/renderer_host/resource_dispatcher_host.h"
+#include "chrome/common/render_messages.h"
+#include "chrome/common/resource_dispatcher.h"
+#include "net/url_request/url_request.h"
+#include "net/url_request/url_request_test_job.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/glue/resource_loader_bridge.h"
+#include "webkit/glue/webappcachecontext.h"
+
+using webkit_glue::ResourceLoaderBridge;
+
+namespace {
+
+const int kResponseSize = 64 * 1024 * 1024;
+
+// The body of the large responses, built before the timers start.
+const std::string* response_data = NULL;
+
+URLRequestJob* LargeResponseJobFactory(URLRequest* request,
+                                       const std::string& scheme) {
+  return new URLRequestTestJob(request, URLRequestTestJob::test_headers(),
+                               *response_data, true);
+}
+
+// Counts the response data the renderer gets, and quits the message loop once
+// the request is complete.
+class CountingPeer : public ResourceLoaderBridge::Peer {
+ public:
+  CountingPeer() : bytes_received_(0) {}
+
+  virtual void OnUploadProgress(uint64 position, uint64 size) {}
+  virtual void OnReceivedRedirect(const GURL& new_url) {}
+  virtual void OnReceivedResponse(
+      const ResourceLoaderBridge::ResponseInfo& info,
+      bool content_filtered) {}
+  virtual void OnReceivedData(const char* data, int len) {
+    bytes_received_ += len;
+  }
+  virtual void OnCompletedRequest(const URLRequestStatus& status,
+                                  const std::string& security_info) {
+    MessageLoop::current()->Quit();
+  }
+  virtual std::string GetURLForDebugging() { return std::string(); }
+
+  int bytes_received() const { return bytes_received_; }
+
+ private:
+  int bytes_received_;
+};
+
+// Plays both the browser and the renderer: the messages between the
+// ResourceDispatcherHost and the ResourceDispatcher go through the message
+// loop, like they would through the IPC channel.
+class ResourceDispatcherHostPerfTest : public testing::Test,
+                                       public ResourceDispatcherHost::Receiver {
+ public:
+  ResourceDispatcherHostPerfTest()
+      : Receiver(ChildProcessInfo::RENDER_PROCESS),
+        host_(NULL),
+        renderer_channel_(this),
+        dispatcher_(&renderer_channel_),
+        method_factory_(this) {
+    set_handle(base::GetCurrentProcessHandle());
+  }
+
+  // ResourceDispatcherHost::Receiver implementation, for the messages to the
+  // renderer.
+  virtual bool Send(IPC::Message* msg) {
+    MessageLoop::current()->PostTask(FROM_HERE,
+        method_factory_.NewRunnableMethod(
+            &ResourceDispatcherHostPerfTest::DeliverToRenderer, msg));
+    return true;
+  }
+
+  URLRequestContext* GetRequestContext(
+      uint32 request_id,
+      const ViewHostMsg_Resource_Request& request_data) {
+    return NULL;
+  }
+
+  virtual int GetProcessId() const { return 0; }
+
+ protected:
+  // Sends the messages of the ResourceDispatcher to the browser.
+  class RendererChannel : public IPC::Message::Sender {
+   public:
+    explicit RendererChannel(ResourceDispatcherHostPerfTest* test)
+        : test_(test) {}
+
+    virtual bool Send(IPC::Message* msg) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          test_->method_factory_.NewRunnableMethod(
+              &ResourceDispatcherHostPerfTest::DeliverToBrowser, msg));
+      return true;
+    }
+
+   private:
+    ResourceDispatcherHostPerfTest* test_;
+  };
+
+  virtual void SetUp() {
+    ChildProcessSecurityPolicy::GetInstance()->Add(0);
+    ChildProcessSecurityPolicy::GetInstance()->RegisterWebSafeScheme("test");
+    URLRequest::RegisterProtocolFactory("test", &LargeResponseJobFactory);
+    response_data = new std::string(kResponseSize, 'x');
+  }
+
+  virtual void TearDown() {
+    URLRequest::RegisterProtocolFactory("test", NULL);
+    ChildProcessSecurityPolicy::GetInstance()->Remove(0);
+    message_loop_.RunAllPending();
+    delete response_data;
+    response_data = NULL;
+  }
+
+  void DeliverToBrowser(IPC::Message* msg) {
+    bool msg_was_ok;
+    host_.OnMessageReceived(*msg, this, &msg_was_ok);
+    delete msg;
+  }
+
+  void DeliverToRenderer(IPC::Message* msg) {
+    dispatcher_.OnMessageReceived(*msg);
+    delete msg;
+  }
+
+  // Loads a large response through the renderer path, and returns the number
+  // of bytes the renderer got.
+  int LoadLargeResponse() {
+    GURL url("test:large");
+    scoped_ptr<ResourceLoaderBridge> bridge(dispatcher_.CreateBridge(
+        "GET", url, url, GURL(), "null", "null", std::string(), 0, 0,
+        ResourceType::SUB_RESOURCE, 0,
+        WebAppCacheContext::kNoAppCacheContextId, MSG_ROUTING_CONTROL));
+    CountingPeer peer;
+    EXPECT_TRUE(bridge->Start(&peer));
+    MessageLoop::current()->Run();
+    return peer.bytes_received();
+  }
+
+  MessageLoopForIO message_loop_;
+  ResourceDispatcherHost host_;
+  RendererChannel renderer_channel_;
+  ResourceDispatcher dispatcher_;
+  ScopedRunnableMethodFactory<ResourceDispatcherHostPerfTest> method_factory_;
+};
+
+}  // namespace
+
+// The throughput of a large download, from the URLRequest in the browser to
+// the peer in the renderer.
+TEST_F(ResourceDispatcherHostPerfTest, LargeDownload) {
+  PerfTimeLogger timer("Resource_dispatcher_host_large_download");
+  EXPECT_EQ(kResponseSize, LoadLargeResponse());
+  timer.Done();
+}
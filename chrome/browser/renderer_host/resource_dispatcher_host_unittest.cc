@@ -8,6 +8,7 @@
 #include "base/message_loop.h"
 #include "base/process_util.h"
 #include "chrome/browser/child_process_security_policy.h"
+#include "chrome/browser/renderer_host/async_resource_handler.h"
 #include "chrome/browser/renderer_host/resource_dispatcher_host.h"
 #include "chrome/common/chrome_plugin_lib.h"
 #include "chrome/common/render_messages.h"
@@ -24,6 +25,7 @@ static int RequestIDForMessage(const IPC::Message& msg) {
     case ViewMsg_Resource_UploadProgress::ID:
     case ViewMsg_Resource_ReceivedResponse::ID:
     case ViewMsg_Resource_ReceivedRedirect::ID:
+    case ViewMsg_Resource_SetDataBuffer::ID:
     case ViewMsg_Resource_DataReceived::ID:
     case ViewMsg_Resource_RequestComplete::ID:
       request_id = IPC::MessageIterator(msg).NextInt();
@@ -49,6 +51,21 @@ static ViewHostMsg_Resource_Request CreateResourceRequest(const char* method,
   return request;
 }
 
+// Returns a response several times the size of the data buffer of a request,
+// with each chunk of it filled with its own letter.
+static std::string LargeResponseData() {
+  std::string data;
+  for (int i = 0; i < AsyncResourceHandler::kNumReadChunks + 3; ++i)
+    data.append(AsyncResourceHandler::kReadBufSize, 'a' + i);
+  return data;
+}
+
+static URLRequestJob* LargeResponseJobFactory(URLRequest* request,
+                                              const std::string& scheme) {
+  return new URLRequestTestJob(request, URLRequestTestJob::test_headers(),
+                               LargeResponseData(), true);
+}
+
 // We may want to move this to a shared space if it is useful for something else
 class ResourceIPCAccumulator {
  public:
@@ -138,6 +155,13 @@ class ResourceDispatcherHostTest : public testing::Test,
                        int render_view_id,
                        int request_id,
                        const GURL& url);
+  void MakeTestRequestWithResourceType(
+      ResourceDispatcherHost::Receiver* receiver,
+      int render_process_id,
+      int render_view_id,
+      int request_id,
+      const GURL& url,
+      ResourceType::Type type);
   void MakeCancelRequest(int request_id);
 
   void EnsureTestSchemeIsAllowed() {
@@ -173,8 +197,20 @@ void ResourceDispatcherHostTest::MakeTestRequest(
     int render_view_id,
     int request_id,
     const GURL& url) {
+  MakeTestRequestWithResourceType(receiver, render_process_id, render_view_id,
+                                  request_id, url, ResourceType::SUB_RESOURCE);
+}
+
+void ResourceDispatcherHostTest::MakeTestRequestWithResourceType(
+    ResourceDispatcherHost::Receiver* receiver,
+    int render_process_id,
+    int render_view_id,
+    int request_id,
+    const GURL& url,
+    ResourceType::Type type) {
   pid_ = render_process_id;
   ViewHostMsg_Resource_Request request = CreateResourceRequest("GET", url);
+  request.resource_type = type;
   ViewHostMsg_RequestResource msg(render_view_id, request_id, request);
   bool msg_was_ok;
   host_.OnMessageReceived(msg, receiver, &msg_was_ok);
@@ -190,40 +226,51 @@ void CheckSuccessfulRequest(const std::vector<IPC::Message>& messages,
                             const std::string& reference_data) {
   // A successful request will have received 4 messages:
   //     ReceivedResponse    (indicates headers received)
+  //     SetDataBuffer       (the shared memory the data is in)
   //     DataReceived        (data)
   //    XXX DataReceived        (0 bytes remaining from a read)
   //     RequestComplete     (request is done)
   //
   // This function verifies that we received 4 messages and that they
   // are appropriate.
-  ASSERT_EQ(messages.size(), 3U);
+  ASSERT_EQ(messages.size(), 4U);
 
   // The first messages should be received response
   ASSERT_EQ(ViewMsg_Resource_ReceivedResponse::ID, messages[0].type());
 
-  // followed by the data, currently we only do the data in one chunk, but
-  // should probably test multiple chunks later
-  ASSERT_EQ(ViewMsg_Resource_DataReceived::ID, messages[1].type());
+  // followed by the data buffer and the data, currently we only do the data
+  // in one chunk, but should probably test multiple chunks later
+  ASSERT_EQ(ViewMsg_Resource_SetDataBuffer::ID, messages[1].type());
 
   void* iter = NULL;
   int request_id;
   ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &request_id));
   base::SharedMemoryHandle shm_handle;
   ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &shm_handle));
-  size_t data_len;
-  ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &data_len));
+  int shm_size;
+  ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &shm_size));
+
+  ASSERT_EQ(ViewMsg_Resource_DataReceived::ID, messages[2].type());
 
-  ASSERT_EQ(reference_data.size(), data_len);
+  iter = NULL;
+  ASSERT_TRUE(IPC::ReadParam(&messages[2], &iter, &request_id));
+  int data_offset;
+  ASSERT_TRUE(IPC::ReadParam(&messages[2], &iter, &data_offset));
+  int data_len;
+  ASSERT_TRUE(IPC::ReadParam(&messages[2], &iter, &data_len));
+
+  ASSERT_EQ(reference_data.size(), static_cast<size_t>(data_len));
+  ASSERT_LE(data_offset + data_len, shm_size);
   base::SharedMemory shared_mem(shm_handle, true);  // read only
-  shared_mem.Map(data_len);
-  const char* data = static_cast<char*>(shared_mem.memory());
+  ASSERT_TRUE(shared_mem.Map(shm_size));
+  const char* data = static_cast<char*>(shared_mem.memory()) + data_offset;
   ASSERT_EQ(0, memcmp(reference_data.c_str(), data, data_len));
 
   // followed by a 0-byte read
-  //ASSERT_EQ(ViewMsg_Resource_DataReceived::ID, messages[2].type());
+  //ASSERT_EQ(ViewMsg_Resource_DataReceived::ID, messages[3].type());
 
   // the last message should be all data received
-  ASSERT_EQ(ViewMsg_Resource_RequestComplete::ID, messages[2].type());
+  ASSERT_EQ(ViewMsg_Resource_RequestComplete::ID, messages[3].type());
 }
 
 // Tests whether many messages get dispatched properly.
@@ -251,6 +298,155 @@ TEST_F(ResourceDispatcherHostTest, TestMany) {
   CheckSuccessfulRequest(msgs[2], URLRequestTestJob::test_data_3());
 }
 
+// Tests that the sub-resource and object requests of a process wait while it
+// loads a frame, and start once the frame is loaded.
+TEST_F(ResourceDispatcherHostTest, DelayLowPriorityRequests) {
+  ASSERT_EQ(2,
+      ResourceDispatcherHost::kMaxLowPriorityRequestsWhileHighPriorityInFlight);
+
+  MakeTestRequestWithResourceType(this, 0, 0, 1,
+                                  URLRequestTestJob::test_url_1(),
+                                  ResourceType::SUB_FRAME);
+  MakeTestRequest(0, 0, 2, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 0, 3, URLRequestTestJob::test_url_3());
+  MakeTestRequestWithResourceType(this, 0, 0, 4,
+                                  URLRequestTestJob::test_url_1(),
+                                  ResourceType::OBJECT);
+  MakeTestRequest(0, 0, 5, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 0, 6, URLRequestTestJob::test_url_3());
+
+  // The frame and two sub-resources are in flight.
+  EXPECT_EQ(3, host_.pending_requests());
+  EXPECT_EQ(3, host_.GetDelayedRequestsCount(0, 0));
+
+  // A delayed request can be cancelled before it starts.
+  MakeCancelRequest(6);
+  EXPECT_EQ(2, host_.GetDelayedRequestsCount(0, 0));
+
+  // Flush all the pending requests, and the delayed ones they let start.
+  while (host_.pending_requests()) {
+    while (URLRequestTestJob::ProcessOnePendingMessage());
+    MessageLoop::current()->RunAllPending();
+  }
+  EXPECT_EQ(0, host_.GetDelayedRequestsCount(0, 0));
+  EXPECT_EQ(0, host_.GetOutstandingRequestsMemoryCost(0));
+
+  ResourceIPCAccumulator::ClassifiedMessages msgs;
+  accum_.GetClassifiedMessages(&msgs);
+
+  // The sub-resource started before the object, and the cancelled request
+  // never started.
+  ASSERT_EQ(5U, msgs.size());
+  CheckSuccessfulRequest(msgs[0], URLRequestTestJob::test_data_1());
+  CheckSuccessfulRequest(msgs[1], URLRequestTestJob::test_data_2());
+  CheckSuccessfulRequest(msgs[2], URLRequestTestJob::test_data_3());
+  EXPECT_EQ(5, RequestIDForMessage(msgs[3][0]));
+  CheckSuccessfulRequest(msgs[3], URLRequestTestJob::test_data_2());
+  EXPECT_EQ(4, RequestIDForMessage(msgs[4][0]));
+  CheckSuccessfulRequest(msgs[4], URLRequestTestJob::test_data_1());
+}
+
+// Tests that a frame loading in a view doesn't delay the requests of the other
+// views of the same process.
+TEST_F(ResourceDispatcherHostTest, ViewsScheduledIndependently) {
+  MakeTestRequestWithResourceType(this, 0, 0, 1,
+                                  URLRequestTestJob::test_url_1(),
+                                  ResourceType::SUB_FRAME);
+  MakeTestRequest(0, 0, 2, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 0, 3, URLRequestTestJob::test_url_3());
+  MakeTestRequest(0, 0, 4, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 1, 5, URLRequestTestJob::test_url_1());
+  MakeTestRequest(0, 1, 6, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 1, 7, URLRequestTestJob::test_url_3());
+  EXPECT_EQ(6, host_.pending_requests());
+  EXPECT_EQ(1, host_.GetDelayedRequestsCount(0, 0));
+  EXPECT_EQ(0, host_.GetDelayedRequestsCount(0, 1));
+
+  // Closing the view cancels its delayed request too.
+  host_.CancelRequestsForRoute(0, 0);
+  EXPECT_EQ(3, host_.pending_requests());
+  EXPECT_EQ(0, host_.GetDelayedRequestsCount(0, 0));
+
+  while (host_.pending_requests()) {
+    while (URLRequestTestJob::ProcessOnePendingMessage());
+    MessageLoop::current()->RunAllPending();
+  }
+  EXPECT_EQ(0, host_.GetOutstandingRequestsMemoryCost(0));
+  EXPECT_TRUE(host_.scheduler_states_.empty());
+}
+
+// Tests that a frame request that turns into a download lets the delayed
+// requests of its process start right away.
+TEST_F(ResourceDispatcherHostTest, DownloadReleasesSchedulerSlot) {
+  MakeTestRequestWithResourceType(this, 0, 0, 1,
+                                  URLRequestTestJob::test_url_1(),
+                                  ResourceType::SUB_FRAME);
+  MakeTestRequest(0, 0, 2, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 0, 3, URLRequestTestJob::test_url_3());
+  MakeTestRequest(0, 0, 4, URLRequestTestJob::test_url_2());
+  EXPECT_EQ(3, host_.pending_requests());
+  EXPECT_EQ(1, host_.GetDelayedRequestsCount(0, 0));
+
+  URLRequest* request = host_.GetURLRequest(
+      ResourceDispatcherHost::GlobalRequestID(0, 1));
+  ASSERT_TRUE(request != NULL);
+  ResourceDispatcherHost::ExtraInfoForRequest(request)->is_download = true;
+  host_.UnscheduleRequest(request);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(4, host_.pending_requests());
+  EXPECT_EQ(0, host_.GetDelayedRequestsCount(0, 0));
+
+  // Releasing the slot again when the request completes has no effect.
+  while (host_.pending_requests()) {
+    while (URLRequestTestJob::ProcessOnePendingMessage());
+    MessageLoop::current()->RunAllPending();
+  }
+  EXPECT_EQ(0, host_.GetOutstandingRequestsMemoryCost(0));
+}
+
+// Tests that a synchronous load starts right away while a frame is loading,
+// since the frame can't complete until the child process gets the response.
+TEST_F(ResourceDispatcherHostTest, SyncLoadNotDelayed) {
+  MakeTestRequestWithResourceType(this, 0, 0, 1,
+                                  URLRequestTestJob::test_url_1(),
+                                  ResourceType::SUB_FRAME);
+  MakeTestRequest(0, 0, 2, URLRequestTestJob::test_url_2());
+  MakeTestRequest(0, 0, 3, URLRequestTestJob::test_url_3());
+  MakeTestRequest(0, 0, 4, URLRequestTestJob::test_url_2());
+  EXPECT_EQ(3, host_.pending_requests());
+  EXPECT_EQ(1, host_.GetDelayedRequestsCount(0, 0));
+
+  ViewHostMsg_Resource_Request request =
+      CreateResourceRequest("GET", URLRequestTestJob::test_url_3());
+  SyncLoadResult result;
+  ViewHostMsg_SyncLoad msg(0, 5, request, &result);
+  pid_ = 0;
+  bool msg_was_ok;
+  host_.OnMessageReceived(msg, this, &msg_was_ok);
+  KickOffRequest();
+  pid_ = -1;
+  EXPECT_EQ(4, host_.pending_requests());
+  EXPECT_EQ(1, host_.GetDelayedRequestsCount(0, 0));
+
+  // The synchronous load is not counted against the frame: it completes with
+  // the requests in flight, before the delayed one starts.
+  while (URLRequestTestJob::ProcessOnePendingMessage());
+  int sync_replies = 0;
+  for (size_t i = 0; i < accum_.messages_.size(); ++i) {
+    if (accum_.messages_[i].is_reply())
+      sync_replies++;
+  }
+  EXPECT_EQ(1, sync_replies);
+  EXPECT_EQ(1, host_.GetDelayedRequestsCount(0, 0));
+
+  while (host_.pending_requests()) {
+    while (URLRequestTestJob::ProcessOnePendingMessage());
+    MessageLoop::current()->RunAllPending();
+  }
+  EXPECT_EQ(0, host_.GetDelayedRequestsCount(0, 0));
+  EXPECT_EQ(0, host_.GetOutstandingRequestsMemoryCost(0));
+}
+
 // Tests whether messages get canceled properly. We issue three requests,
 // cancel one of them, and make sure that each sent the proper notifications.
 TEST_F(ResourceDispatcherHostTest, Cancel) {
@@ -649,3 +845,82 @@ TEST_F(ResourceDispatcherHostTest, TooManyOutstandingRequests) {
   CheckSuccessfulRequest(msgs[kMaxRequests + 3],
                          URLRequestTestJob::test_data_2());
 }
+
+// Tests that a response larger than the data buffer goes round the buffer,
+// and that a chunk is not written again before the data message pointing to
+// it is acknowledged.
+TEST_F(ResourceDispatcherHostTest, DataBufferFlowControl) {
+  URLRequest::RegisterProtocolFactory("test", &LargeResponseJobFactory);
+  MakeTestRequest(0, 0, 1, GURL("test:large"));
+  MessageLoop::current()->RunAllPending();
+
+  std::vector<IPC::Message> messages;
+  messages.swap(accum_.messages_);
+  ASSERT_LE(2U, messages.size());
+  ASSERT_EQ(ViewMsg_Resource_ReceivedResponse::ID, messages[0].type());
+  ASSERT_EQ(ViewMsg_Resource_SetDataBuffer::ID, messages[1].type());
+
+  void* iter = NULL;
+  int request_id;
+  ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &request_id));
+  base::SharedMemoryHandle shm_handle;
+  ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &shm_handle));
+  int shm_size;
+  ASSERT_TRUE(IPC::ReadParam(&messages[1], &iter, &shm_size));
+  EXPECT_EQ(AsyncResourceHandler::kReadBufSize *
+                AsyncResourceHandler::kNumReadChunks,
+            shm_size);
+
+  base::SharedMemory shared_mem(shm_handle, true);  // read only
+  ASSERT_TRUE(shared_mem.Map(shm_size));
+  const char* buffer = static_cast<char*>(shared_mem.memory());
+  messages.erase(messages.begin(), messages.begin() + 2);
+
+  std::string data;
+  bool complete = false;
+  while (!complete) {
+    ASSERT_FALSE(messages.empty());
+
+    // Without acknowledgements, the request stops after sending as many data
+    // messages as it may have pending.
+    int data_messages = 0;
+    for (size_t i = 0; i < messages.size(); ++i) {
+      if (messages[i].type() == ViewMsg_Resource_RequestComplete::ID) {
+        complete = true;
+        continue;
+      }
+      ASSERT_EQ(ViewMsg_Resource_DataReceived::ID, messages[i].type());
+      data_messages++;
+
+      iter = NULL;
+      ASSERT_TRUE(IPC::ReadParam(&messages[i], &iter, &request_id));
+      int data_offset;
+      ASSERT_TRUE(IPC::ReadParam(&messages[i], &iter, &data_offset));
+      int data_len;
+      ASSERT_TRUE(IPC::ReadParam(&messages[i], &iter, &data_len));
+      ASSERT_LE(data_offset + data_len, shm_size);
+      data.append(buffer + data_offset, data_len);
+
+      // Each data message is charged to the request until it is
+      // acknowledged, rather than the whole buffer.
+      int cost = host_.GetOutstandingRequestsMemoryCost(0);
+      pid_ = 0;
+      ViewHostMsg_DataReceived_ACK ack(0, request_id);
+      bool msg_was_ok;
+      host_.OnMessageReceived(ack, this, &msg_was_ok);
+      pid_ = -1;
+      if (host_.pending_requests()) {
+        EXPECT_EQ(cost - AsyncResourceHandler::kReadBufSize,
+                  host_.GetOutstandingRequestsMemoryCost(0));
+      }
+    }
+    EXPECT_GE(ResourceDispatcherHost::kMaxPendingDataMessages, data_messages);
+
+    MessageLoop::current()->RunAllPending();
+    messages.clear();
+    messages.swap(accum_.messages_);
+  }
+
+  EXPECT_TRUE(LargeResponseData() == data);
+  EXPECT_EQ(0, host_.GetOutstandingRequestsMemoryCost(0));
+}
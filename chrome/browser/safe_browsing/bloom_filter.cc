@@ -34,46 +34,113 @@ uint32 HashMix(uint64 hash_key, uint32 c) {
 
 }  // namespace
 
-BloomFilter::BloomFilter(int bit_size) {
+BloomFilter::BloomFilter(int bit_size) : layout_(LAYOUT_CLASSIC) {
   for (int i = 0; i < kNumHashKeys; ++i)
     hash_keys_.push_back(base::RandUint64());
-  byte_size_ = bit_size / 8 + 1;
-  bit_size_ = byte_size_ * 8;
-  data_.reset(new char[byte_size_]);
-  memset(data_.get(), 0, byte_size_);
+  AllocateData(bit_size / 8 + 1);
+}
+
+BloomFilter::BloomFilter(Layout layout, int bit_size) : layout_(layout) {
+  int byte_size = bit_size / 8 + 1;
+  int num_keys = kNumHashKeys;
+  if (layout_ == LAYOUT_BLOCKED) {
+    // Round up to whole blocks, without going over kBloomFilterMaxSize.
+    byte_size = (bit_size / 8 + kBlockSize - 1) / kBlockSize * kBlockSize;
+    num_keys = kNumBlockedHashKeys;
+  }
+  for (int i = 0; i < num_keys; ++i)
+    hash_keys_.push_back(base::RandUint64());
+  AllocateData(byte_size);
 }
 
 BloomFilter::BloomFilter(char* data, int size, const std::vector<uint64>& keys)
-    : hash_keys_(keys) {
+    : layout_(LAYOUT_CLASSIC),
+      storage_(data),
+      data_(data),
+      hash_keys_(keys) {
   byte_size_ = size;
   bit_size_ = byte_size_ * 8;
-  data_.reset(data);
+}
+
+BloomFilter::BloomFilter(Layout layout,
+                         int byte_size,
+                         const std::vector<uint64>& keys)
+    : layout_(layout),
+      hash_keys_(keys) {
+  AllocateData(byte_size);
 }
 
 BloomFilter::~BloomFilter() {
 }
 
+void BloomFilter::AllocateData(int byte_size) {
+  DCHECK(layout_ == LAYOUT_CLASSIC || byte_size % kBlockSize == 0);
+  byte_size_ = byte_size;
+  bit_size_ = byte_size_ * 8;
+  storage_.reset(new char[byte_size_ + kBlockSize]);
+  uintptr_t offset = reinterpret_cast<uintptr_t>(storage_.get()) %
+                     kBlockSize;
+  data_ = storage_.get() + (offset ? kBlockSize - offset : 0);
+  memset(data_, 0, byte_size_);
+}
+
+const uint64* BloomFilter::GetBlock(uint32 hash, uint64* masks) const {
+  DCHECK_EQ(kNumBlockedHashKeys, static_cast<int>(hash_keys_.size()));
+  int num_blocks = byte_size_ / kBlockSize;
+  uint32 block = HashMix(hash_keys_[0], hash) % num_blocks;
+
+  // Each of the other keys gives the bits of two words, from four 6 bit
+  // indexes of its mix.
+  for (int i = 0; i < kWordsPerBlock; i += kBitsPerWord) {
+    uint32 mix = HashMix(hash_keys_[1 + i / kBitsPerWord], hash);
+    masks[i] = (GG_UINT64_C(1) << (mix & 63)) |
+               (GG_UINT64_C(1) << ((mix >> 6) & 63));
+    masks[i + 1] = (GG_UINT64_C(1) << ((mix >> 12) & 63)) |
+                   (GG_UINT64_C(1) << ((mix >> 18) & 63));
+  }
+  return reinterpret_cast<const uint64*>(data_ + block * kBlockSize);
+}
+
 void BloomFilter::Insert(int hash_int) {
   uint32 hash;
   memcpy(&hash, &hash_int, sizeof(hash));
+  if (layout_ == LAYOUT_BLOCKED) {
+    uint64 masks[kWordsPerBlock];
+    uint64* block = const_cast<uint64*>(GetBlock(hash, masks));
+    for (int i = 0; i < kWordsPerBlock; ++i)
+      block[i] |= masks[i];
+    return;
+  }
+
   for (int i = 0; i < static_cast<int>(hash_keys_.size()); ++i) {
     uint32 mix = HashMix(hash_keys_[i], hash);
     uint32 index = mix % bit_size_;
     int byte = index / 8;
     int bit = index % 8;
-    data_.get()[byte] |= 1 << bit;
+    data_[byte] |= 1 << bit;
   }
 }
 
 bool BloomFilter::Exists(int hash_int) const {
   uint32 hash;
   memcpy(&hash, &hash_int, sizeof(hash));
+  if (layout_ == LAYOUT_BLOCKED) {
+    // Test all the words of the block without branching, so that the compiler
+    // can keep the loop in vector registers.
+    uint64 masks[kWordsPerBlock];
+    const uint64* block = GetBlock(hash, masks);
+    uint64 missing = 0;
+    for (int i = 0; i < kWordsPerBlock; ++i)
+      missing |= masks[i] & ~block[i];
+    return missing == 0;
+  }
+
   for (int i = 0; i < static_cast<int>(hash_keys_.size()); ++i) {
     uint32 mix = HashMix(hash_keys_[i], hash);
     uint32 index = mix % bit_size_;
     int byte = index / 8;
     int bit = index % 8;
-    char data = data_.get()[byte];
+    char data = data_[byte];
     if (!(data & (1 << bit)))
       return false;
   }
@@ -94,7 +161,14 @@ BloomFilter* BloomFilter::LoadFile(const FilePath& filter_name) {
   int file_version;
   int bytes_read = filter.Read(reinterpret_cast<char*>(&file_version),
                                sizeof(file_version), NULL);
-  if (bytes_read != sizeof(file_version) || file_version != kFileVersion)
+  if (bytes_read != sizeof(file_version))
+    return NULL;
+  Layout layout;
+  if (file_version == kClassicFileVersion)
+    layout = LAYOUT_CLASSIC;
+  else if (file_version == kBlockedFileVersion)
+    layout = LAYOUT_BLOCKED;
+  else
     return NULL;
 
   // Get all the random hash keys.
@@ -103,6 +177,8 @@ BloomFilter* BloomFilter::LoadFile(const FilePath& filter_name) {
                            sizeof(num_keys), NULL);
   if (bytes_read != sizeof(num_keys) || num_keys < 1 || num_keys > kNumHashKeys)
     return NULL;
+  if (layout == LAYOUT_BLOCKED && num_keys != kNumBlockedHashKeys)
+    return NULL;
 
   std::vector<uint64> hash_keys;
   for (int i = 0; i < num_keys; ++i) {
@@ -119,13 +195,17 @@ BloomFilter* BloomFilter::LoadFile(const FilePath& filter_name) {
     return NULL;
 
   int byte_size = static_cast<int>(remaining64);
-  scoped_array<char> data(new char[byte_size]);
-  bytes_read = filter.Read(data.get(), byte_size, NULL);
+  if (layout == LAYOUT_BLOCKED && byte_size % kBlockSize != 0)
+    return NULL;
+
+  scoped_ptr<BloomFilter> bloom_filter(
+      new BloomFilter(layout, byte_size, hash_keys));
+  bytes_read = filter.Read(bloom_filter->data_, byte_size, NULL);
   if (bytes_read != byte_size)
     return NULL;
 
   // We've read everything okay, commit the data.
-  return new BloomFilter(data.release(), byte_size, hash_keys);
+  return bloom_filter.release();
 }
 
 bool BloomFilter::WriteFile(const FilePath& filter_name) {
@@ -137,7 +217,8 @@ bool BloomFilter::WriteFile(const FilePath& filter_name) {
     return false;
 
   // Write the version information.
-  int version = kFileVersion;
+  int version = layout_ == LAYOUT_BLOCKED ? kBlockedFileVersion :
+                                           kClassicFileVersion;
   int bytes_written = filter.Write(reinterpret_cast<char*>(&version),
                                    sizeof(version), NULL);
   if (bytes_written != sizeof(version))
@@ -158,7 +239,7 @@ bool BloomFilter::WriteFile(const FilePath& filter_name) {
   }
 
   // Write the filter data.
-  bytes_written = filter.Write(data_.get(), byte_size_, NULL);
+  bytes_written = filter.Write(data_, byte_size_, NULL);
   if (bytes_written != byte_size_)
     return false;
 
@@ -118,3 +118,79 @@ TEST(SafeBrowsingBloomFilter, BloomFilterFile) {
   file_util::Delete(filter_path, false);
 }
 
+TEST(SafeBrowsingBloomFilter, BlockedBloomFilterUse) {
+  uint32 count = 1000;
+  scoped_refptr<BloomFilter> filter =
+      new BloomFilter(BloomFilter::LAYOUT_BLOCKED,
+                      count * BloomFilter::kBloomFilterSizeRatio);
+  EXPECT_EQ(BloomFilter::LAYOUT_BLOCKED, filter->layout());
+  EXPECT_EQ(0, filter->size() % 64);
+
+  typedef std::set<int> Values;
+  Values values;
+  for (uint32 i = 0; i < count; ++i) {
+    uint32 value = GenHash();
+    values.insert(value);
+    filter->Insert(value);
+  }
+
+  for (Values::iterator i = values.begin(); i != values.end(); ++i)
+    EXPECT_TRUE(filter->Exists(*i));
+
+  uint32 found_count = 0;
+  uint32 checked = 0;
+  while (checked < count) {
+    uint32 value = GenHash();
+    if (values.find(value) != values.end())
+      continue;
+    if (filter->Exists(value))
+      found_count++;
+    checked++;
+  }
+
+  double fp_rate = found_count * 100.0 / count;
+  CHECK(fp_rate < 5.0);
+
+  LOG(INFO) << "For safe browsing blocked bloom filter of size " << count <<
+      ", the FP rate was " << fp_rate << " %";
+}
+
+// Test that a blocked filter keeps its layout through its file.
+TEST(SafeBrowsingBloomFilter, BlockedBloomFilterFile) {
+  const int kTestEntries = BloomFilter::kBloomFilterMinSize;
+  scoped_refptr<BloomFilter> filter_write =
+      new BloomFilter(BloomFilter::LAYOUT_BLOCKED,
+                      kTestEntries * BloomFilter::kBloomFilterSizeRatio);
+
+  std::vector<int> values;
+  for (int i = 0; i < kTestEntries; ++i) {
+    values.push_back(GenHash());
+    filter_write->Insert(values.back());
+  }
+
+  FilePath filter_path;
+  PathService::Get(base::DIR_TEMP, &filter_path);
+  filter_path = filter_path.AppendASCII("SafeBrowsingTestBlockedFilter");
+  file_util::Delete(filter_path, false);
+  ASSERT_FALSE(file_util::PathExists(filter_path));
+  ASSERT_TRUE(filter_write->WriteFile(filter_path));
+
+  BloomFilter* filter = BloomFilter::LoadFile(filter_path);
+  ASSERT_TRUE(filter != NULL);
+  scoped_refptr<BloomFilter> filter_read = filter;
+
+  EXPECT_EQ(BloomFilter::LAYOUT_BLOCKED, filter_read->layout());
+  ASSERT_EQ(filter_write->hash_keys_.size(), filter_read->hash_keys_.size());
+  for (int i = 0; i < static_cast<int>(filter_write->hash_keys_.size()); ++i)
+    EXPECT_EQ(filter_write->hash_keys_[i], filter_read->hash_keys_[i]);
+
+  ASSERT_EQ(filter_write->size(), filter_read->size());
+  EXPECT_TRUE(memcmp(filter_write->data(),
+                     filter_read->data(),
+                     filter_read->size()) == 0);
+
+  for (int i = 0; i < kTestEntries; ++i)
+    EXPECT_TRUE(filter_read->Exists(values[i]));
+
+  file_util::Delete(filter_path, false);
+}
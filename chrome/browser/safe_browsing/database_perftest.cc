@@ -5,8 +5,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <limits>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -17,6 +20,9 @@
 #include "base/scoped_ptr.h"
 #include "base/string_util.h"
 #include "base/test_file_util.h"
+#include "chrome/browser/safe_browsing/bloom_filter.h"
+#include "chrome/browser/safe_browsing/chunk_range.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
 #include "chrome/browser/safe_browsing/safe_browsing_database.h"
 #include "chrome/common/chrome_paths.h"
 #include "chrome/common/sqlite_compiled_statement.h"
@@ -400,29 +406,9 @@ class SafeBrowsingDatabaseTest {
     database->SetSynchronous();
     EXPECT_TRUE(database->Init(path_, NULL));
 
-    int chunk_id = 0;
-    int total_host_keys = size;
-    int host_keys_per_chunk = 100;
-
-    std::deque<SBChunk>* chunks = new std::deque<SBChunk>;
-
-    for (int i = 0; i < total_host_keys / host_keys_per_chunk; ++i) {
-      chunks->push_back(SBChunk());
-      chunks->back().chunk_number = ++chunk_id;
-
-      for (int j = 0; j < host_keys_per_chunk; ++j) {
-        SBChunkHost host;
-        host.host = base::RandInt(std::numeric_limits<int>::min(),
-                                  std::numeric_limits<int>::max());
-        host.entry = SBEntry::Create(SBEntry::ADD_PREFIX, 2);
-        host.entry->SetPrefixAt(0, 0x2425525);
-        host.entry->SetPrefixAt(1, 0x1536366);
-
-        chunks->back().hosts.push_back(host);
-      }
-    }
-
-    database->InsertChunks("goog-malware", chunks);
+    EXPECT_TRUE(database->UpdateStarted());
+    InsertChunks(database.get(), 1, size);
+    database->UpdateFinished(true);
   }
 
   void Read(bool use_bloom_filter) {
@@ -471,26 +457,135 @@ class SafeBrowsingDatabaseTest {
         db_ms / keys_from_db << " ms";
   }
 
+  // Times an update of a few chunks, which merges them into the add prefixes
+  // and builds the prefix set used for lookups.
   void BuildBloomFilter() {
     file_util::EvictFileFromSystemCache(path_);
-    file_util::Delete(SafeBrowsingDatabase::BloomFilterFilename(path_), false);
-
-    PerfTimer total_timer;
 
     scoped_ptr<SafeBrowsingDatabase> database(SafeBrowsingDatabase::Create());
     database->SetSynchronous();
     EXPECT_TRUE(database->Init(path_, NULL));
 
+    std::vector<SBListChunkRanges> lists;
+    PerfTimer total_timer;
+    EXPECT_TRUE(database->UpdateStarted());
+    database->GetListsInfo(&lists);
+    std::vector<ChunkRange> ranges;
+    EXPECT_TRUE(StringToRanges(lists[0].adds, &ranges));
+    InsertChunks(database.get(), ranges.empty() ? 1 : ranges.back().stop() + 1,
+                 1000);
+    database->UpdateFinished(true);
+
     int64 total_ms = total_timer.Elapsed().InMilliseconds();
 
     DLOG(INFO) << path_.BaseName().value() <<
-        " built bloom filter in " << total_ms << " ms.";
+        " built prefix set in " << total_ms << " ms.";
   }
 
  private:
+  // Adds chunks of 100 host keys with random prefixes, starting at
+  // |first_chunk_id|.
+  void InsertChunks(SafeBrowsingDatabase* database,
+                    int first_chunk_id,
+                    int total_host_keys) {
+    const int kHostKeysPerChunk = 100;
+    int chunk_id = first_chunk_id;
+
+    std::deque<SBChunk>* chunks = new std::deque<SBChunk>;
+
+    for (int i = 0; i < total_host_keys / kHostKeysPerChunk; ++i) {
+      chunks->push_back(SBChunk());
+      chunks->back().chunk_number = chunk_id++;
+      chunks->back().is_add = true;
+
+      for (int j = 0; j < kHostKeysPerChunk; ++j) {
+        SBChunkHost host;
+        host.host = base::RandInt(std::numeric_limits<int>::min(),
+                                  std::numeric_limits<int>::max());
+        host.entry = SBEntry::Create(SBEntry::ADD_PREFIX, 2);
+        host.entry->SetPrefixAt(0, base::RandInt(
+            std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+        host.entry->SetPrefixAt(1, base::RandInt(
+            std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+
+        chunks->back().hosts.push_back(host);
+      }
+    }
+
+    database->InsertChunks("goog-malware", chunks);
+  }
+
   FilePath path_;
 };
 
+namespace {
+
+// Fills a bloom filter of each layout with |num_prefixes| random prefixes,
+// sized like the database did, and a prefix set, and logs their size, false
+// positive rate and time of a lookup of random prefixes.
+void CompareBloomFilterLayouts(const char* name, int num_prefixes) {
+  const int kNumChecks = 1000000;
+  std::set<SBPrefix> prefixes;
+  while (static_cast<int>(prefixes.size()) < num_prefixes)
+    prefixes.insert(static_cast<SBPrefix>(base::RandUint64()));
+  std::vector<SBPrefix> checks;
+  while (static_cast<int>(checks.size()) < kNumChecks) {
+    SBPrefix prefix = static_cast<SBPrefix>(base::RandUint64());
+    if (prefixes.find(prefix) == prefixes.end())
+      checks.push_back(prefix);
+  }
+
+  const int filter_size = std::max(num_prefixes,
+                                   BloomFilter::kBloomFilterMinSize) *
+                          BloomFilter::kBloomFilterSizeRatio;
+  const BloomFilter::Layout kLayouts[] = {
+    BloomFilter::LAYOUT_CLASSIC,
+    BloomFilter::LAYOUT_BLOCKED,
+  };
+  const char* const kLayoutNames[] = { "classic", "blocked" };
+  for (size_t l = 0; l < arraysize(kLayouts); ++l) {
+    scoped_refptr<BloomFilter> filter(
+        new BloomFilter(kLayouts[l], filter_size));
+    for (std::set<SBPrefix>::const_iterator it = prefixes.begin();
+         it != prefixes.end(); ++it) {
+      filter->Insert(*it);
+    }
+
+    int false_positives = 0;
+    PerfTimer timer;
+    for (int i = 0; i < kNumChecks; ++i) {
+      if (filter->Exists(checks[i]))
+        ++false_positives;
+    }
+    double ns = timer.Elapsed().InMicroseconds() * 1000.0;
+
+    std::string test_name = StringPrintf("SafeBrowsing_bloom_%s_%s", name,
+                                         kLayoutNames[l]);
+    LogPerfResult((test_name + "_lookup").c_str(), ns / kNumChecks, "ns/op");
+    LogPerfResult((test_name + "_false_positives").c_str(),
+                  false_positives * 100.0 / kNumChecks, "%");
+    LogPerfResult((test_name + "_size").c_str(), filter->size(), "bytes");
+  }
+
+  // The exact set which replaced the bloom filter in the database.
+  std::vector<SBPrefix> sorted(prefixes.begin(), prefixes.end());
+  scoped_refptr<PrefixSet> prefix_set(new PrefixSet(sorted));
+  int false_positives = 0;
+  PerfTimer timer;
+  for (int i = 0; i < kNumChecks; ++i) {
+    if (prefix_set->Exists(checks[i]))
+      ++false_positives;
+  }
+  double ns = timer.Elapsed().InMicroseconds() * 1000.0;
+  EXPECT_EQ(0, false_positives);
+
+  std::string test_name = StringPrintf("SafeBrowsing_prefix_set_%s", name);
+  LogPerfResult((test_name + "_lookup").c_str(), ns / kNumChecks, "ns/op");
+  LogPerfResult((test_name + "_size").c_str(), prefix_set->size(), "bytes");
+}
+
+}  // namespace
+
 // Adds 100K host records.
 TEST(SafeBrowsingDatabase, DISABLED_FillUp100K) {
   SafeBrowsingDatabaseTest db(FilePath(FILE_PATH_LITERAL("SafeBrowsing100K")));
@@ -531,7 +626,7 @@ TEST(SafeBrowsingDatabase, DISABLED_BloomReadFrom500K) {
   db.Read(true);
 }
 
-// Test how long bloom filter creation takes.
+// Test how long an update, and the prefix set creation, takes.
 TEST(SafeBrowsingDatabase, DISABLED_BuildBloomFilter250K) {
   SafeBrowsingDatabaseTest db(FilePath(FILE_PATH_LITERAL("SafeBrowsing250K")));
   db.BuildBloomFilter();
@@ -541,3 +636,13 @@ TEST(SafeBrowsingDatabase, DISABLED_BuildBloomFilter500K) {
   SafeBrowsingDatabaseTest db(FilePath(FILE_PATH_LITERAL("SafeBrowsing500K")));
   db.BuildBloomFilter();
 }
+
+// Compares the false positive rate, the size and the lookup time of the bloom
+// filter layouts and the prefix set.
+TEST(SafeBrowsingDatabase, DISABLED_BloomLayouts250K) {
+  CompareBloomFilterLayouts("250K", 250000);
+}
+
+TEST(SafeBrowsingDatabase, DISABLED_BloomLayouts500K) {
+  CompareBloomFilterLayouts("500K", 500000);
+}
@@ -16,6 +16,9 @@
 // SafeBrowsing data, we can check a known set of URLs against the filter and
 // determine the false positive rate.
 //
+// Both tests report their results for the classic and the blocked layouts of
+// the bloom filter.
+//
 // False positive calculation usage:
 //   $ ./perf_tests.exe --gtest_filter=SafeBrowsingBloomFilter.FalsePositives
 //                      --filter-start=<integer>
@@ -114,15 +117,21 @@ FilePath GetFullDataPath() {
   return full_path;
 }
 
+// Returns a name for |layout| in the results.
+const char* LayoutName(BloomFilter::Layout layout) {
+  return layout == BloomFilter::LAYOUT_BLOCKED ? "blocked" : "classic";
+}
+
 // Constructs a bloom filter of the appropriate size from the provided prefixes.
-void BuildBloomFilter(int size_multiplier,
+void BuildBloomFilter(BloomFilter::Layout layout,
+                      int size_multiplier,
                       const std::vector<SBPrefix>& prefixes,
                       BloomFilter** bloom_filter) {
   // Create a BloomFilter with the specified size.
   const int key_count = std::max(static_cast<int>(prefixes.size()),
                                  BloomFilter::kBloomFilterMinSize);
   const int filter_size = key_count * size_multiplier;
-  *bloom_filter = new BloomFilter(filter_size);
+  *bloom_filter = new BloomFilter(layout, filter_size);
 
   // Add the prefixes to it.
   for (size_t i = 0; i < prefixes.size(); ++i)
@@ -229,11 +238,12 @@ bool IsPrefixInDatabase(SBPrefix prefix,
 // Construct a bloom filter with the given prefixes and multiplier, and test the
 // false positive rate (misses) against a URL list.
 void CalculateBloomFilterFalsePositives(
+    BloomFilter::Layout layout,
     int size_multiplier,
     const FilePath& data_dir,
     const std::vector<SBPrefix>& prefix_list) {
   BloomFilter* bloom_filter = NULL;
-  BuildBloomFilter(size_multiplier, prefix_list, &bloom_filter);
+  BuildBloomFilter(layout, size_multiplier, prefix_list, &bloom_filter);
   scoped_refptr<BloomFilter> scoped_filter(bloom_filter);
 
   // Read in data file line at a time.
@@ -293,7 +303,9 @@ void CalculateBloomFilterFalsePositives(
   }
 
   // Print out the results for this test.
-  std::cout << "URLs checked: "      << url_count
+  std::cout << "Layout: "            << LayoutName(layout)
+            << ", bits per prefix: " << size_multiplier
+            << ", URLs checked: "    << url_count
             << ", prefix compares: " << prefix_count
             << ", hits: "            << hits
             << ", misses: "          << misses;
@@ -327,8 +339,12 @@ TEST(SafeBrowsingBloomFilter, FalsePositives) {
 
   int stop = start + steps;
 
-  for (int multiplier = start; multiplier < stop; ++multiplier)
-    CalculateBloomFilterFalsePositives(multiplier, data_dir, prefix_list);
+  for (int multiplier = start; multiplier < stop; ++multiplier) {
+    CalculateBloomFilterFalsePositives(BloomFilter::LAYOUT_CLASSIC,
+                                       multiplier, data_dir, prefix_list);
+    CalculateBloomFilterFalsePositives(BloomFilter::LAYOUT_BLOCKED,
+                                       multiplier, data_dir, prefix_list);
+  }
 }
 
 // Computes the time required for performing a number of look ups in a bloom
@@ -345,34 +361,47 @@ TEST(SafeBrowsingBloomFilter, HashTime) {
       CommandLine::ForCurrentProcess()->GetSwitchValue(kFilterNumChecks));
   }
 
-  // Populate the bloom filter and measure the time.
-  BloomFilter* bloom_filter = NULL;
-  Time populate_before = Time::Now();
-  BuildBloomFilter(BloomFilter::kBloomFilterSizeRatio,
-                   prefix_list, &bloom_filter);
-  TimeDelta populate = Time::Now() - populate_before;
-
-  // Check a large number of random prefixes against the filter.
-  int hits = 0;
-  Time check_before = Time::Now();
-  for (int i = 0; i < num_checks; ++i) {
-    uint32 prefix = static_cast<uint32>(base::RandUint64());
-    if (bloom_filter->Exists(prefix))
-      ++hits;
+  // Use the same random prefixes for both layouts, and keep their generation
+  // out of the timings.
+  std::vector<uint32> checks;
+  checks.reserve(num_checks);
+  for (int i = 0; i < num_checks; ++i)
+    checks.push_back(static_cast<uint32>(base::RandUint64()));
+
+  const BloomFilter::Layout kLayouts[] = {
+    BloomFilter::LAYOUT_CLASSIC,
+    BloomFilter::LAYOUT_BLOCKED,
+  };
+  for (size_t l = 0; l < arraysize(kLayouts); ++l) {
+    // Populate the bloom filter and measure the time.
+    BloomFilter* bloom_filter = NULL;
+    Time populate_before = Time::Now();
+    BuildBloomFilter(kLayouts[l], BloomFilter::kBloomFilterSizeRatio,
+                     prefix_list, &bloom_filter);
+    TimeDelta populate = Time::Now() - populate_before;
+    scoped_refptr<BloomFilter> scoped_filter(bloom_filter);
+
+    // Check a large number of random prefixes against the filter.
+    int hits = 0;
+    Time check_before = Time::Now();
+    for (int i = 0; i < num_checks; ++i) {
+      if (bloom_filter->Exists(checks[i]))
+        ++hits;
+    }
+    TimeDelta check = Time::Now() - check_before;
+
+    int64 time_per_insert = populate.InMicroseconds() /
+                            static_cast<int>(prefix_list.size());
+    int64 ns_per_check = check.InMicroseconds() * 1000 / num_checks;
+
+    std::cout << "Time results for layout: " << LayoutName(kLayouts[l])
+              << ", checks: "                << num_checks
+              << ", prefixes: "              << prefix_list.size()
+              << ", populate time (ms): "    << populate.InMilliseconds()
+              << ", check time (ms): "       << check.InMilliseconds()
+              << ", hits: "                  << hits
+              << ", per-populate (us): "     << time_per_insert
+              << ", per-check (ns): "        << ns_per_check
+              << std::endl;
   }
-  TimeDelta check = Time::Now() - check_before;
-
-  int64 time_per_insert = populate.InMicroseconds() /
-                          static_cast<int>(prefix_list.size());
-  int64 time_per_check = check.InMicroseconds() / num_checks;
-
-  std::cout << "Time results for checks: " << num_checks
-            << ", prefixes: "              << prefix_list.size()
-            << ", populate time (ms): "    << populate.InMilliseconds()
-            << ", check time (ms): "       << check.InMilliseconds()
-            << ", hits: "                  << hits
-            << ", per-populate (us): "     << time_per_insert
-            << ", per-check (us): "        << time_per_check
-            << std::endl;
 }
-
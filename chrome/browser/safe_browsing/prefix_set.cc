@@ -0,0 +1,178 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/safe_browsing/prefix_set.h"
+
+#include "base/logging.h"
+#include "base/scoped_ptr.h"
+#include "net/base/file_stream.h"
+#include "net/base/net_errors.h"
+
+namespace {
+
+// Sanity limit on the number of prefixes of a file, well above the size of the
+// Safe Browsing lists.
+const int kMaxFilePrefixes = 16 * 1024 * 1024;
+
+// Reads |count| items of |items| from |file|.  Returns false on a short read.
+template <typename T>
+bool ReadItems(net::FileStream* file, int count, std::vector<T>* items) {
+  items->resize(count);
+  if (!count)
+    return true;
+  int size = count * sizeof(T);
+  return file->Read(reinterpret_cast<char*>(&(*items)[0]), size, NULL) == size;
+}
+
+template <typename T>
+bool WriteItems(net::FileStream* file, const std::vector<T>& items) {
+  if (items.empty())
+    return true;
+  int size = static_cast<int>(items.size() * sizeof(T));
+  return file->Write(reinterpret_cast<const char*>(&items[0]), size,
+                     NULL) == size;
+}
+
+}  // namespace
+
+PrefixSet::PrefixSet() {
+}
+
+PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
+  uint32 previous = 0;
+  int run_length = 0;
+  for (size_t i = 0; i < sorted_prefixes.size(); ++i) {
+    DCHECK(i == 0 || sorted_prefixes[i - 1] <= sorted_prefixes[i]);
+    // Deltas are computed unsigned, which is exact since the prefixes are
+    // sorted.
+    uint32 prefix = static_cast<uint32>(sorted_prefixes[i]);
+    uint32 delta = prefix - previous;
+    if (!index_.empty() && delta == 0)
+      continue;  // A duplicate.
+
+    if (index_.empty() || delta > kuint16max || run_length == kMaxRun) {
+      IndexEntry entry;
+      entry.prefix = sorted_prefixes[i];
+      entry.offset = static_cast<uint32>(deltas_.size());
+      index_.push_back(entry);
+      run_length = 0;
+    } else {
+      deltas_.push_back(static_cast<uint16>(delta));
+      ++run_length;
+    }
+    previous = prefix;
+  }
+}
+
+PrefixSet::~PrefixSet() {
+}
+
+bool PrefixSet::Exists(SBPrefix prefix) const {
+  if (index_.empty() || prefix < index_[0].prefix)
+    return false;
+
+  // Find the last run which starts at or before |prefix|.
+  size_t low = 0;
+  size_t high = index_.size();
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (index_[mid].prefix <= prefix)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  uint32 current = static_cast<uint32>(index_[low].prefix);
+  uint32 target = static_cast<uint32>(prefix);
+  size_t end = low + 1 < index_.size() ? index_[low + 1].offset :
+                                         deltas_.size();
+  // All the prefixes of the run are at least the first one, so the distance
+  // to |target| can be compared unsigned.
+  uint32 distance = target - current;
+  for (size_t i = index_[low].offset; i < end && distance > 0; ++i) {
+    if (deltas_[i] > distance)
+      return false;
+    distance -= deltas_[i];
+  }
+  return distance == 0;
+}
+
+int PrefixSet::count() const {
+  return static_cast<int>(index_.size() + deltas_.size());
+}
+
+int PrefixSet::size() const {
+  return static_cast<int>(index_.size() * sizeof(IndexEntry) +
+                          deltas_.size() * sizeof(uint16));
+}
+
+// static
+PrefixSet* PrefixSet::LoadFile(const FilePath& prefix_set_name,
+                               int generation) {
+  net::FileStream file;
+
+  if (file.Open(prefix_set_name,
+                base::PLATFORM_FILE_OPEN |
+                base::PLATFORM_FILE_READ) != net::OK)
+    return NULL;
+
+  int header[4];  // version, generation, index entries, deltas
+  int bytes_read = file.Read(reinterpret_cast<char*>(header), sizeof(header),
+                             NULL);
+  if (bytes_read != sizeof(header) || header[0] != kFileVersion ||
+      header[1] != generation)
+    return NULL;
+
+  // Each count is checked on its own first, so that their sum can't overflow.
+  int num_index = header[2];
+  int num_deltas = header[3];
+  if (num_index < 0 || num_index > kMaxFilePrefixes ||
+      num_deltas < 0 || num_deltas > kMaxFilePrefixes - num_index)
+    return NULL;
+
+  // The rest of the file must be exactly the index and the deltas.
+  int64 expected = num_index * sizeof(IndexEntry) +
+                   num_deltas * sizeof(uint16);
+  if (file.Available() != expected)
+    return NULL;
+
+  scoped_ptr<PrefixSet> prefix_set(new PrefixSet);
+  if (!ReadItems(&file, num_index, &prefix_set->index_) ||
+      !ReadItems(&file, num_deltas, &prefix_set->deltas_))
+    return NULL;
+
+  // Check that the runs are in order, so that lookups stay in bounds.
+  for (int i = 0; i < num_index; ++i) {
+    uint32 offset = prefix_set->index_[i].offset;
+    if ((i > 0 && (offset < prefix_set->index_[i - 1].offset ||
+                   prefix_set->index_[i].prefix <=
+                       prefix_set->index_[i - 1].prefix)) ||
+        offset > static_cast<uint32>(num_deltas))
+      return NULL;
+  }
+
+  return prefix_set.release();
+}
+
+bool PrefixSet::WriteFile(const FilePath& prefix_set_name,
+                          int generation) const {
+  net::FileStream file;
+
+  if (file.Open(prefix_set_name,
+                base::PLATFORM_FILE_WRITE |
+                base::PLATFORM_FILE_CREATE_ALWAYS) != net::OK)
+    return false;
+
+  int header[4];
+  header[0] = kFileVersion;
+  header[1] = generation;
+  header[2] = static_cast<int>(index_.size());
+  header[3] = static_cast<int>(deltas_.size());
+  int bytes_written = file.Write(reinterpret_cast<const char*>(header),
+                                 sizeof(header), NULL);
+  if (bytes_written != sizeof(header))
+    return false;
+
+  return WriteItems(&file, index_) && WriteItems(&file, deltas_);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// An exact set of 32 bit prefixes, which answers like the bloom filter but
+// without false positives, in about the same memory.
+//
+// The sorted prefixes are stored as 16 bit deltas from the previous prefix.
+// Every run of deltas starts with an index entry holding its full first prefix
+// and the offset of the run in the deltas.  A new run starts when a delta
+// doesn't fit in 16 bits, or every kMaxRun prefixes, so that a lookup is a
+// binary search of the index followed by a short scan of one run.
+//
+// The set is written to disk in the same form, so that loading it is a single
+// read with no rebuilding:
+//         4 byte version number
+//         4 byte generation of the add prefixes the set was built from
+//         4 byte number of index entries (i)
+//         4 byte number of deltas (d)
+//     i * 8 bytes of index entries (first prefix, offset of the run)
+//     d * 2 bytes of deltas
+
+#ifndef CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
+#define CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/ref_counted.h"
+#include "chrome/browser/safe_browsing/safe_browsing_util.h"
+
+class PrefixSet : public base::RefCountedThreadSafe<PrefixSet> {
+ public:
+  // |sorted_prefixes| must be sorted, and may contain duplicates.
+  explicit PrefixSet(const std::vector<SBPrefix>& sorted_prefixes);
+  ~PrefixSet();
+
+  bool Exists(SBPrefix prefix) const;
+
+  // Returns the number of distinct prefixes in the set.
+  int count() const;
+
+  // Returns the memory used by the set, in bytes.
+  int size() const;
+
+  // Loading and storing the set from / to disk.  |generation| identifies the
+  // add prefixes the set was built from, and a file of another generation is
+  // not loaded.
+  static PrefixSet* LoadFile(const FilePath& prefix_set_name, int generation);
+  bool WriteFile(const FilePath& prefix_set_name, int generation) const;
+
+  // The maximum number of deltas that follow an index entry.
+  static const int kMaxRun = 100;
+
+ private:
+  // Constructs an empty set, for LoadFile.
+  PrefixSet();
+
+  static const int kFileVersion = 2;
+
+  // The first prefix of each run and the offset of its deltas in |deltas_|.
+  struct IndexEntry {
+    SBPrefix prefix;
+    uint32 offset;
+  };
+  std::vector<IndexEntry> index_;
+  std::vector<uint16> deltas_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrefixSet);
+};
+
+#endif  // CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
@@ -0,0 +1,143 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/safe_browsing/prefix_set.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/path_service.h"
+#include "base/rand_util.h"
+#include "base/ref_counted.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+SBPrefix GenPrefix() {
+  return static_cast<SBPrefix>(base::RandUint64());
+}
+
+// Checks that |prefix_set| holds exactly |prefixes|, by checking them and
+// their neighbours.
+void CheckPrefixes(const PrefixSet& prefix_set,
+                   const std::set<SBPrefix>& prefixes) {
+  EXPECT_EQ(static_cast<int>(prefixes.size()), prefix_set.count());
+  for (std::set<SBPrefix>::const_iterator it = prefixes.begin();
+       it != prefixes.end(); ++it) {
+    EXPECT_TRUE(prefix_set.Exists(*it));
+    SBPrefix before = static_cast<SBPrefix>(static_cast<uint32>(*it) - 1);
+    SBPrefix after = static_cast<SBPrefix>(static_cast<uint32>(*it) + 1);
+    EXPECT_EQ(prefixes.count(before) > 0, prefix_set.Exists(before));
+    EXPECT_EQ(prefixes.count(after) > 0, prefix_set.Exists(after));
+  }
+}
+
+}  // namespace
+
+TEST(SafeBrowsingPrefixSet, Empty) {
+  std::vector<SBPrefix> prefixes;
+  scoped_refptr<PrefixSet> prefix_set = new PrefixSet(prefixes);
+  EXPECT_EQ(0, prefix_set->count());
+  EXPECT_FALSE(prefix_set->Exists(0));
+  EXPECT_FALSE(prefix_set->Exists(GenPrefix()));
+}
+
+TEST(SafeBrowsingPrefixSet, PrefixSetUse) {
+  std::set<SBPrefix> prefixes;
+  while (prefixes.size() < 10000)
+    prefixes.insert(GenPrefix());
+  // Runs which end on a delta that doesn't fit in 16 bits, and the extremes.
+  prefixes.insert(kint32min);
+  prefixes.insert(kint32min + 70000);
+  prefixes.insert(kint32max);
+
+  // Duplicates are dropped.
+  std::vector<SBPrefix> sorted(prefixes.begin(), prefixes.end());
+  sorted.insert(sorted.begin() + sorted.size() / 2, sorted[sorted.size() / 2]);
+  scoped_refptr<PrefixSet> prefix_set = new PrefixSet(sorted);
+
+  CheckPrefixes(*prefix_set, prefixes);
+
+  // Random lookups are never false positives.
+  for (int i = 0; i < 10000; ++i) {
+    SBPrefix prefix = GenPrefix();
+    EXPECT_EQ(prefixes.count(prefix) > 0, prefix_set->Exists(prefix));
+  }
+}
+
+// Dense prefixes use one index entry per run of kMaxRun deltas.
+TEST(SafeBrowsingPrefixSet, DensePrefixes) {
+  std::set<SBPrefix> prefixes;
+  for (int i = 0; i < 10 * PrefixSet::kMaxRun; ++i)
+    prefixes.insert(i * 3);
+  std::vector<SBPrefix> sorted(prefixes.begin(), prefixes.end());
+  scoped_refptr<PrefixSet> prefix_set = new PrefixSet(sorted);
+
+  CheckPrefixes(*prefix_set, prefixes);
+  EXPECT_LT(prefix_set->size(),
+            static_cast<int>(prefixes.size() * sizeof(SBPrefix)) * 3 / 4);
+}
+
+// Test that we can read and write the prefix set file.
+TEST(SafeBrowsingPrefixSet, PrefixSetFile) {
+  std::set<SBPrefix> prefixes;
+  while (prefixes.size() < 10000)
+    prefixes.insert(GenPrefix());
+  std::vector<SBPrefix> sorted(prefixes.begin(), prefixes.end());
+  scoped_refptr<PrefixSet> prefix_set_write = new PrefixSet(sorted);
+
+  FilePath path;
+  PathService::Get(base::DIR_TEMP, &path);
+  path = path.AppendASCII("SafeBrowsingTestPrefixSet");
+  file_util::Delete(path, false);
+  ASSERT_FALSE(file_util::PathExists(path));
+  ASSERT_TRUE(prefix_set_write->WriteFile(path, 7));
+
+  PrefixSet* prefix_set = PrefixSet::LoadFile(path, 7);
+  ASSERT_TRUE(prefix_set != NULL);
+  scoped_refptr<PrefixSet> prefix_set_read = prefix_set;
+  EXPECT_EQ(prefix_set_write->size(), prefix_set_read->size());
+  CheckPrefixes(*prefix_set_read, prefixes);
+
+  // A set built from other add prefixes is rejected.
+  EXPECT_TRUE(PrefixSet::LoadFile(path, 6) == NULL);
+
+  // A truncated file is rejected.
+  int64 size_64;
+  ASSERT_TRUE(file_util::GetFileSize(path, &size_64));
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path, &contents));
+  ASSERT_EQ(static_cast<int>(size_64 - 1),
+            file_util::WriteFile(path, contents.data(),
+                                 static_cast<int>(size_64 - 1)));
+  EXPECT_TRUE(PrefixSet::LoadFile(path, 7) == NULL);
+
+  file_util::Delete(path, false);
+}
+
+// Test that counts whose sum overflows are rejected.
+TEST(SafeBrowsingPrefixSet, PrefixSetFileOverflow) {
+  FilePath path;
+  PathService::Get(base::DIR_TEMP, &path);
+  path = path.AppendASCII("SafeBrowsingTestPrefixSet");
+
+  // Version, generation, index entries and deltas.
+  int header[4] = { 2, 1, kint32max, 2 };
+  ASSERT_EQ(static_cast<int>(sizeof(header)),
+            file_util::WriteFile(path, reinterpret_cast<char*>(header),
+                                 sizeof(header)));
+  EXPECT_TRUE(PrefixSet::LoadFile(path, 1) == NULL);
+
+  header[2] = 2;
+  header[3] = kint32max;
+  ASSERT_EQ(static_cast<int>(sizeof(header)),
+            file_util::WriteFile(path, reinterpret_cast<char*>(header),
+                                 sizeof(header)));
+  EXPECT_TRUE(PrefixSet::LoadFile(path, 1) == NULL);
+
+  file_util::Delete(path, false);
+}
@@ -4,6 +4,8 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_database_bloom.h"
 
+#include <algorithm>
+
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
 #include "base/logging.h"
@@ -13,18 +15,23 @@
 #include "base/sha2.h"
 #include "base/stats_counters.h"
 #include "base/string_util.h"
-#include "chrome/browser/safe_browsing/bloom_filter.h"
 #include "chrome/browser/safe_browsing/chunk_range.h"
 #include "chrome/common/sqlite_compiled_statement.h"
 #include "chrome/common/sqlite_utils.h"
 #include "googleurl/src/gurl.h"
 
+#if defined(OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 using base::Time;
 using base::TimeDelta;
 
 // Database version.  If this is different than what's stored on disk, the
 // database is reset.
-static const int kDatabaseVersion = 6;
+static const int kDatabaseVersion = 8;
 
 // When we awake from a low power state, we try to avoid doing expensive disk
 // operations for a few minutes to let the system page itself in and settle
@@ -38,6 +45,30 @@ static const int kMaxStalenessMinutes = 45;
 static const FilePath::CharType kBloomFilterFileSuffix[] =
     FILE_PATH_LITERAL(" Bloom");
 
+// The suffixes of the add prefix file, of the new add prefix file of an update,
+// and of the prefix set file.
+static const FilePath::CharType kAddPrefixFileSuffix[] =
+    FILE_PATH_LITERAL(" Add Prefixes");
+static const FilePath::CharType kTempFileSuffix[] =
+    FILE_PATH_LITERAL(" New");
+static const FilePath::CharType kPrefixSetFileSuffix[] =
+    FILE_PATH_LITERAL(" Prefix Set");
+
+// The version in the header of the add prefix file, which is followed by the
+// generation of the file.
+static const int kAddPrefixFileVersion = 1;
+
+// Flushes |file| to disk, so that it survives a crash.
+static bool SyncFile(FILE* file) {
+  if (fflush(file) != 0)
+    return false;
+#if defined(OS_WIN)
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
 
 // Implementation --------------------------------------------------------------
 
@@ -60,10 +91,18 @@ bool SafeBrowsingDatabaseBloom::Init(const FilePath& filename,
 
   filename_ = FilePath(filename.value() + kBloomFilterFileSuffix);
   bloom_filter_filename_ = BloomFilterFilename(filename_);
+  add_prefix_filename_ = FilePath(filename_.value() + kAddPrefixFileSuffix);
+  prefix_set_filename_ = FilePath(filename_.value() + kPrefixSetFileSuffix);
 
   hash_cache_.reset(new HashCache);
 
-  LoadBloomFilter();
+  // The bloom filter of older versions is replaced by the prefix set.
+  DeleteBloomFilter();
+
+  // The database is only needed to check the add prefix file, until the next
+  // update.
+  LoadPrefixSet();
+  Close();
 
   init_ = true;
   chunk_inserted_callback_.reset(chunk_inserted_callback);
@@ -87,7 +126,7 @@ bool SafeBrowsingDatabaseBloom::Open() {
 
   statement_cache_.reset(new SqliteStatementCache(db_));
 
-  if (!DoesSqliteTableExist(db_, "add_prefix")) {
+  if (!DoesSqliteTableExist(db_, "sub_prefix")) {
     if (!CreateTables()) {
       // Database could be corrupt, try starting from scratch.
       if (!ResetDatabase())
@@ -117,13 +156,7 @@ bool SafeBrowsingDatabaseBloom::CreateTables() {
   SQLTransaction transaction(db_);
   transaction.Begin();
 
-  // Store 32 bit add prefixes here.
-  if (sqlite3_exec(db_, "CREATE TABLE add_prefix ("
-      "chunk INTEGER,"
-      "prefix INTEGER)",
-      NULL, NULL, NULL) != SQLITE_OK) {
-    return false;
-  }
+  // The 32 bit add prefixes are stored in the add prefix file.
 
   // Store 32 bit sub prefixes here.
   if (sqlite3_exec(db_, "CREATE TABLE sub_prefix ("
@@ -177,6 +210,20 @@ bool SafeBrowsingDatabaseBloom::CreateTables() {
     return false;
   }
 
+  // The generation of the add prefix file which goes with the tables, so that
+  // a file which doesn't is detected.  There is no file before the first
+  // update.
+  if (sqlite3_exec(db_, "CREATE TABLE add_prefix_file ("
+                   "generation INTEGER)",
+                   NULL, NULL, NULL) != SQLITE_OK) {
+    return false;
+  }
+
+  if (sqlite3_exec(db_, "INSERT INTO add_prefix_file (generation) VALUES (0)",
+                   NULL, NULL, NULL) != SQLITE_OK) {
+    return false;
+  }
+
   std::string version = "PRAGMA user_version=";
   version += StringPrintf("%d", kDatabaseVersion);
 
@@ -210,9 +257,11 @@ bool SafeBrowsingDatabaseBloom::ResetDatabase() {
     return false;
   }
 
-  bloom_filter_ = new BloomFilter(BloomFilter::kBloomFilterMinSize *
-                                  BloomFilter::kBloomFilterSizeRatio);
-  file_util::Delete(bloom_filter_filename_, false);
+  file_util::Delete(add_prefix_filename_, false);
+  file_util::Delete(FilePath(add_prefix_filename_.value() + kTempFileSuffix),
+                    false);
+  prefix_set_ = new PrefixSet(std::vector<SBPrefix>());
+  file_util::Delete(prefix_set_filename_, false);
 
   // TODO(paulg): Fix potential infinite recursion between Open and Reset.
   return Open();
@@ -239,6 +288,7 @@ void SafeBrowsingDatabaseBloom::ClearUpdateCaches() {
   add_chunk_cache_.clear();
   sub_chunk_cache_.clear();
   prefix_miss_cache_.clear();
+  std::vector<SBPair>().swap(pending_adds_);
 }
 
 bool SafeBrowsingDatabaseBloom::ContainsUrl(
@@ -264,11 +314,11 @@ bool SafeBrowsingDatabaseBloom::ContainsUrl(
   std::vector<std::string> paths;
   safe_browsing_util::GeneratePathsToCheck(url, &paths);
 
-  // Lock the bloom filter and cache so that they aren't deleted on us if an
+  // Lock the prefix set and cache so that they aren't deleted on us if an
   // update is just about to finish.
   AutoLock lock(lookup_lock_);
 
-  if (!bloom_filter_.get())
+  if (!prefix_set_.get())
     return false;
 
   // TODO(erikkay): This may wind up being too many hashes on a complex page.
@@ -282,7 +332,7 @@ bool SafeBrowsingDatabaseBloom::ContainsUrl(
                              sizeof(SBFullHash));
       SBPrefix prefix;
       memcpy(&prefix, &full_hash, sizeof(SBPrefix));
-      if (bloom_filter_->Exists(prefix))
+      if (prefix_set_->Exists(prefix))
         prefix_hits->push_back(prefix);
     }
   }
@@ -309,7 +359,7 @@ bool SafeBrowsingDatabaseBloom::ContainsUrl(
 }
 
 bool SafeBrowsingDatabaseBloom::NeedToCheckUrl(const GURL& url) {
-  // Since everything is in the bloom filter, doing anything here would wind
+  // Since everything is in the prefix set, doing anything here would wind
   // up just duplicating work that would happen in ContainsURL.
   // It's possible that we may want to add a hostkey-based first-level cache
   // on the front of this to minimize hash generation, but we'll need to do
@@ -432,21 +482,10 @@ void SafeBrowsingDatabaseBloom::InsertAdd(SBPrefix host, SBEntry* entry) {
 void SafeBrowsingDatabaseBloom::InsertAddPrefix(SBPrefix prefix,
                                                 int encoded_chunk) {
   STATS_COUNTER("SB.PrefixAdd", 1);
-  std::string sql = "INSERT INTO add_prefix (chunk, prefix) VALUES (?, ?)";
-  SQLITE_UNIQUE_STATEMENT(statement, *statement_cache_, sql.c_str());
-  if (!statement.is_valid()) {
-    NOTREACHED();
-    return;
-  }
-  statement->bind_int(0, encoded_chunk);
-  statement->bind_int(1, prefix);
-  int rv = statement->step();
-  statement->reset();
-  if (rv == SQLITE_CORRUPT) {
-    HandleCorruptDatabase();
-  } else {
-    DCHECK(rv == SQLITE_DONE);
-  }
+  SBPair add;
+  add.chunk_id = encoded_chunk;
+  add.prefix = prefix;
+  pending_adds_.push_back(add);
   add_count_++;
 }
 
@@ -574,24 +613,68 @@ void SafeBrowsingDatabaseBloom::ReadFullHash(SqliteCompiledStatement& statement,
   memcpy(full_hash->full_hash, &blob[0], sizeof(SBFullHash));
 }
 
-// TODO(paulg): Look for a less expensive way to maintain add_count_? If we move
-// to a native file format, we can just cache the count in the file and not have
-// to scan at all.
 int SafeBrowsingDatabaseBloom::GetAddPrefixCount() {
-  SQLITE_UNIQUE_STATEMENT(count, *statement_cache_,
-                          "SELECT count(*) FROM add_prefix");
-  if (!count.is_valid()) {
+  int add_count = static_cast<int>(pending_adds_.size());
+  int64 size_64;
+  if (file_util::GetFileSize(add_prefix_filename_, &size_64) &&
+      size_64 >= static_cast<int64>(2 * sizeof(int))) {
+    add_count += static_cast<int>((size_64 - 2 * sizeof(int)) /
+                                  sizeof(SBPair));
+  }
+  return add_count;
+}
+
+bool SafeBrowsingDatabaseBloom::ReadGeneration(int* generation) {
+  SQLITE_UNIQUE_STATEMENT(statement, *statement_cache_,
+                          "SELECT generation FROM add_prefix_file");
+  if (!statement.is_valid()) {
     NOTREACHED();
-    return 0;
+    return false;
   }
-  int rv = count->step();
-  int add_count = 0;
-  if (rv == SQLITE_ROW)
-    add_count = count->column_int(0);
-  else if (rv == SQLITE_CORRUPT)
+
+  int rv = statement->step();
+  if (rv != SQLITE_ROW) {
+    if (rv == SQLITE_CORRUPT)
+      HandleCorruptDatabase();
+    return false;
+  }
+
+  *generation = statement->column_int(0);
+  return true;
+}
+
+bool SafeBrowsingDatabaseBloom::WriteGeneration(int generation) {
+  SQLITE_UNIQUE_STATEMENT(statement, *statement_cache_,
+                          "UPDATE add_prefix_file SET generation=?");
+  if (!statement.is_valid()) {
+    NOTREACHED();
+    return false;
+  }
+
+  statement->bind_int(0, generation);
+  int rv = statement->step();
+  if (rv == SQLITE_CORRUPT) {
     HandleCorruptDatabase();
+    return false;
+  }
+  return rv == SQLITE_DONE;
+}
 
-  return add_count;
+// static
+bool SafeBrowsingDatabaseBloom::ReadAddPrefixFileGeneration(
+    const FilePath& filename,
+    int* generation) {
+  file_util::ScopedFILE file(file_util::OpenFile(filename, "rb"));
+  if (!file.get())
+    return false;
+
+  int header[2];  // version, generation
+  if (fread(header, sizeof(header), 1, file.get()) != 1 ||
+      header[0] != kAddPrefixFileVersion)
+    return false;
+
+  *generation = header[1];
+  return true;
 }
 
 void SafeBrowsingDatabaseBloom::DeleteChunks(
@@ -793,52 +876,23 @@ bool SafeBrowsingDatabaseBloom::WriteChunkNumbers() {
   return true;
 }
 
-int SafeBrowsingDatabaseBloom::PairCompare(const void* arg1, const void* arg2) {
-  const SBPair* p1 = reinterpret_cast<const SBPair*>(arg1);
-  const SBPair* p2 = reinterpret_cast<const SBPair*>(arg2);
-  int delta = p1->chunk_id - p2->chunk_id;
-  if (delta == 0)
-    delta = p1->prefix - p2->prefix;
-  return delta;
+// static
+bool SafeBrowsingDatabaseBloom::PairLess(const SBPair& pair1,
+                                         const SBPair& pair2) {
+  if (pair1.chunk_id != pair2.chunk_id)
+    return pair1.chunk_id < pair2.chunk_id;
+  return pair1.prefix < pair2.prefix;
 }
 
-bool SafeBrowsingDatabaseBloom::BuildAddPrefixList(SBPair* adds) {
-  // Read add_prefix into memory and sort it.
-  STATS_COUNTER("SB.HostSelectForBloomFilter", 1);
-  SQLITE_UNIQUE_STATEMENT(add_prefix, *statement_cache_,
-                          "SELECT chunk, prefix FROM add_prefix");
-  if (!add_prefix.is_valid()) {
-    NOTREACHED();
-    return false;
-  }
-
-  SBPair* add = adds;
-  while (true) {
-    int rv = add_prefix->step();
-    if (rv != SQLITE_ROW) {
-      if (rv == SQLITE_CORRUPT)
-        HandleCorruptDatabase();
-      break;
-    }
-    add->chunk_id = add_prefix->column_int(0);
-    add->prefix = add_prefix->column_int(1);
-    add++;
-    if (add_count_ < (add - adds))
-      break;
-  }
-  DCHECK(add_count_ == (add - adds));
-  qsort(adds, add_count_, sizeof(SBPair),
-        &SafeBrowsingDatabaseBloom::PairCompare);
-
-  return true;
+// static
+bool SafeBrowsingDatabaseBloom::SubPairLess(const SBSubPair& sub1,
+                                            const SBSubPair& sub2) {
+  if (sub1.add_chunk_id != sub2.add_chunk_id)
+    return sub1.add_chunk_id < sub2.add_chunk_id;
+  return sub1.prefix < sub2.prefix;
 }
 
-bool SafeBrowsingDatabaseBloom::RemoveSubs(
-    SBPair* adds, std::vector<bool>* adds_removed,
-    HashCache* add_cache, HashCache* sub_cache, int* subs) {
-  DCHECK(add_cache && sub_cache && subs);
-
-  // Read through sub_prefix and zero out add_prefix entries that match.
+bool SafeBrowsingDatabaseBloom::ReadSubPrefixes(std::vector<SBSubPair>* subs) {
   SQLITE_UNIQUE_STATEMENT(sub_prefix, *statement_cache_,
                           "SELECT chunk, add_chunk, prefix FROM sub_prefix");
   if (!sub_prefix.is_valid()) {
@@ -846,39 +900,6 @@ bool SafeBrowsingDatabaseBloom::RemoveSubs(
     return false;
   }
 
-  // Create a temporary sub prefix table. We add entries to it as we scan the
-  // sub_prefix table looking for adds to remove. Only entries that don't
-  // remove an add written to this table. When we're done filtering, we replace
-  // sub_prefix with this table.
-  if (sqlite3_exec(db_, "CREATE TABLE sub_prefix_tmp ("
-                   "chunk INTEGER,"
-                   "add_chunk INTEGER,"
-                   "prefix INTEGER)",
-                   NULL, NULL, NULL) != SQLITE_OK) {
-    return false;
-  }
-
-  // Create a temporary sub full hash table, similar to the above prefix table.
-  if (sqlite3_exec(db_, "CREATE TABLE sub_full_tmp ("
-                   "chunk INTEGER,"
-                   "add_chunk INTEGER,"
-                   "prefix INTEGER,"
-                   "full_hash BLOB)",
-                   NULL, NULL, NULL) != SQLITE_OK) {
-    return false;
-  }
-
-  SQLITE_UNIQUE_STATEMENT(
-      sub_prefix_tmp,
-      *statement_cache_,
-      "INSERT INTO sub_prefix_tmp (chunk, add_chunk, prefix) VALUES (?,?,?)");
-  if (!sub_prefix_tmp.is_valid()) {
-    NOTREACHED();
-    return false;
-  }
-
-  SBPair sub;
-  int sub_count = 0;
   while (true) {
     int rv = sub_prefix->step();
     if (rv != SQLITE_ROW) {
@@ -889,52 +910,126 @@ bool SafeBrowsingDatabaseBloom::RemoveSubs(
       break;
     }
 
-    int sub_chunk = sub_prefix->column_int(0);
-    sub.chunk_id = sub_prefix->column_int(1);
+    SBSubPair sub;
+    sub.chunk_id = sub_prefix->column_int(0);
+    // Skip the subs of chunks deleted via a SubDel.
+    if (sub_del_cache_.find(sub.chunk_id) != sub_del_cache_.end())
+      continue;
+    sub.add_chunk_id = sub_prefix->column_int(1);
+    // The adds of chunks deleted via an AddDel are dropped from the merged
+    // file without being matched, so their subs would never be removed.
+    if (add_del_cache_.find(sub.add_chunk_id) != add_del_cache_.end())
+      continue;
     sub.prefix = sub_prefix->column_int(2);
+    subs->push_back(sub);
+  }
+
+  std::sort(subs->begin(), subs->end(),
+            &SafeBrowsingDatabaseBloom::SubPairLess);
+  return true;
+}
+
+bool SafeBrowsingDatabaseBloom::MergeAddPrefixes(
+    const FilePath& temp_filename,
+    int generation,
+    const std::vector<SBSubPair>& subs,
+    std::vector<bool>* subs_removed,
+    HashCache* add_cache,
+    HashCache* sub_cache,
+    std::vector<SBPrefix>* prefixes) {
+  DCHECK(subs_removed && add_cache && sub_cache && prefixes);
+
+  // The update is usually small next to the file, so it is sorted in memory,
+  // and the file is streamed through.
+  std::sort(pending_adds_.begin(), pending_adds_.end(),
+            &SafeBrowsingDatabaseBloom::PairLess);
+
+  // There is no file before the first update.
+  file_util::ScopedFILE old_file(
+      file_util::OpenFile(add_prefix_filename_, "rb"));
+  file_util::ScopedFILE new_file(file_util::OpenFile(temp_filename, "wb"));
+  if (!new_file.get())
+    return false;
 
-    // See if this sub chunk has been deleted via a SubDel, and skip doing the
-    // search or write if so.
-    if (sub_del_cache_.find(sub_chunk) != sub_del_cache_.end())
+  // The old file was checked against the database when it was loaded, so its
+  // header is only skipped.
+  int header[2];  // version, generation
+  if (old_file.get() && fread(header, sizeof(header), 1, old_file.get()) != 1)
+    return false;
+  header[0] = kAddPrefixFileVersion;
+  header[1] = generation;
+  if (fwrite(header, sizeof(header), 1, new_file.get()) != 1)
+    return false;
+
+  SBPair old_add;
+  bool has_old_add = old_file.get() &&
+      fread(&old_add, sizeof(old_add), 1, old_file.get()) == 1;
+  std::vector<SBPair>::const_iterator new_add = pending_adds_.begin();
+  size_t sub_index = 0;
+  while (has_old_add || new_add != pending_adds_.end()) {
+    SBPair add;
+    if (has_old_add &&
+        (new_add == pending_adds_.end() || !PairLess(*new_add, old_add))) {
+      add = old_add;
+      has_old_add = fread(&old_add, sizeof(old_add), 1, old_file.get()) == 1;
+    } else {
+      add = *new_add++;
+    }
+
+    // Check to see if we have an AddDel for this chunk and skip writing it
+    // if there is.
+    if (add_del_cache_.find(add.chunk_id) != add_del_cache_.end())
       continue;
 
-    void* match = bsearch(&sub, adds, add_count_, sizeof(SBPair),
-                          &SafeBrowsingDatabaseBloom::PairCompare);
-    if (match) {
-      SBPair* subbed = reinterpret_cast<SBPair*>(match);
-      (*adds_removed)[subbed - adds] = true;
+    // The subs are sorted in the order of the adds they remove, so the subs
+    // of this add are next.
+    SBSubPair key;
+    key.chunk_id = 0;
+    key.add_chunk_id = add.chunk_id;
+    key.prefix = add.prefix;
+    while (sub_index < subs.size() && SubPairLess(subs[sub_index], key))
+      ++sub_index;
+    bool removed = false;
+    for (size_t i = sub_index;
+         i < subs.size() && !SubPairLess(key, subs[i]); ++i) {
+      (*subs_removed)[i] = true;
+      removed = true;
+    }
+    if (removed) {
       // Remove any GetHash results (full hashes) that match this sub, as well
       // as removing any full subs we may have received.
-      ClearCachedEntry(sub.prefix, sub.chunk_id, add_cache);
-      ClearCachedEntry(sub.prefix, sub.chunk_id, sub_cache);
-    } else {
-      // This sub_prefix entry did not match any add, so we keep it around.
-      sub_prefix_tmp->bind_int(0, sub_chunk);
-      sub_prefix_tmp->bind_int(1, sub.chunk_id);
-      sub_prefix_tmp->bind_int(2, sub.prefix);
-      rv = sub_prefix_tmp->step();
-      if (rv == SQLITE_CORRUPT) {
-        HandleCorruptDatabase();
-        return false;
-      }
-      DCHECK(rv == SQLITE_DONE);
-      sub_prefix_tmp->reset();
-      ++sub_count;
+      ClearCachedEntry(add.prefix, add.chunk_id, add_cache);
+      ClearCachedEntry(add.prefix, add.chunk_id, sub_cache);
+      continue;
     }
+
+    if (fwrite(&add, sizeof(add), 1, new_file.get()) != 1)
+      return false;
+    prefixes->push_back(add.prefix);
   }
 
-  *subs = sub_count;
-  return true;
+  if (old_file.get() && ferror(old_file.get()))
+    return false;
+
+  // The database is about to commit to this file, so it must be on disk
+  // first.
+  if (!SyncFile(new_file.get()))
+    return false;
+  return file_util::CloseFile(new_file.release());
 }
 
-bool SafeBrowsingDatabaseBloom::UpdateTables() {
-  // Delete the old sub_prefix table and rename the temporary table.
-  SQLITE_UNIQUE_STATEMENT(del_sub, *statement_cache_, "DROP TABLE sub_prefix");
+bool SafeBrowsingDatabaseBloom::WriteSubPrefixes(
+    const std::vector<SBSubPair>& subs,
+    const std::vector<bool>& subs_removed,
+    int* sub_count) {
+  *sub_count = 0;
+
+  SQLITE_UNIQUE_STATEMENT(del_sub, *statement_cache_,
+                          "DELETE FROM sub_prefix");
   if (!del_sub.is_valid()) {
     NOTREACHED();
     return false;
   }
-
   int rv = del_sub->step();
   if (rv == SQLITE_CORRUPT) {
     HandleCorruptDatabase();
@@ -942,31 +1037,47 @@ bool SafeBrowsingDatabaseBloom::UpdateTables() {
   }
   DCHECK(rv == SQLITE_DONE);
 
-  SQLITE_UNIQUE_STATEMENT(rename_sub, *statement_cache_,
-                          "ALTER TABLE sub_prefix_tmp RENAME TO sub_prefix");
-  if (!rename_sub.is_valid()) {
+  SQLITE_UNIQUE_STATEMENT(
+      insert,
+      *statement_cache_,
+      "INSERT INTO sub_prefix (chunk, add_chunk, prefix) VALUES (?,?,?)");
+  if (!insert.is_valid()) {
     NOTREACHED();
     return false;
   }
-  rv = rename_sub->step();
-  if (rv == SQLITE_CORRUPT) {
-    HandleCorruptDatabase();
-    return false;
-  }
-  DCHECK(rv == SQLITE_DONE);
 
-  // Now blow away add_prefix. We will write the new values out later.
-  SQLITE_UNIQUE_STATEMENT(del_add, *statement_cache_, "DELETE FROM add_prefix");
-  if (!del_add.is_valid()) {
-    NOTREACHED();
-    return false;
+  // Subs which didn't match any add are kept around, for adds which may come
+  // in a later update.
+  for (size_t i = 0; i < subs.size(); ++i) {
+    if (subs_removed[i])
+      continue;
+    insert->bind_int(0, subs[i].chunk_id);
+    insert->bind_int(1, subs[i].add_chunk_id);
+    insert->bind_int(2, subs[i].prefix);
+    rv = insert->step();
+    if (rv == SQLITE_CORRUPT) {
+      HandleCorruptDatabase();
+      return false;
+    }
+    DCHECK(rv == SQLITE_DONE);
+    insert->reset();
+    ++*sub_count;
   }
-  rv = del_add->step();
-  if (rv == SQLITE_CORRUPT) {
-    HandleCorruptDatabase();
+
+  return true;
+}
+
+bool SafeBrowsingDatabaseBloom::UpdateTables() {
+  // Create a temporary sub full hash table. When we're done filtering, we
+  // replace sub_full_hash with this table.
+  if (sqlite3_exec(db_, "CREATE TABLE sub_full_tmp ("
+                   "chunk INTEGER,"
+                   "add_chunk INTEGER,"
+                   "prefix INTEGER,"
+                   "full_hash BLOB)",
+                   NULL, NULL, NULL) != SQLITE_OK) {
     return false;
   }
-  DCHECK(rv == SQLITE_DONE);
 
   // Delete the old sub_full_hash table and rename the temp full hash table.
   SQLITE_UNIQUE_STATEMENT(del_full_sub, *statement_cache_,
@@ -976,7 +1087,7 @@ bool SafeBrowsingDatabaseBloom::UpdateTables() {
     return false;
   }
 
-  rv = del_full_sub->step();
+  int rv = del_full_sub->step();
   if (rv == SQLITE_CORRUPT) {
     HandleCorruptDatabase();
     return false;
@@ -1013,62 +1124,6 @@ bool SafeBrowsingDatabaseBloom::UpdateTables() {
   return true;
 }
 
-bool SafeBrowsingDatabaseBloom::WritePrefixes(
-    SBPair* adds,
-    const std::vector<bool>& adds_removed,
-    int* new_add_count,
-    BloomFilter** filter) {
-  *filter = NULL;
-  *new_add_count = 0;
-
-  SQLITE_UNIQUE_STATEMENT(insert, *statement_cache_,
-                          "INSERT INTO add_prefix VALUES (?,?)");
-  if (!insert.is_valid()) {
-    NOTREACHED();
-    return false;
-  }
-
-  // Determine the size of the new bloom filter. We will cap the maximum size at
-  // 2 MB to prevent an error from consuming large amounts of memory.
-  const int default_min = BloomFilter::kBloomFilterMinSize;
-  int number_of_keys = std::max(add_count_, default_min);
-  int filter_size =
-      std::min(number_of_keys * BloomFilter::kBloomFilterSizeRatio,
-               BloomFilter::kBloomFilterMaxSize * 8);
-  BloomFilter* new_filter = new BloomFilter(filter_size);
-  SBPair* add = adds;
-  int new_count = 0;
-
-  while (add - adds < add_count_) {
-    if (!adds_removed[add - adds]) {
-      // Check to see if we have an AddDel for this chunk and skip writing it
-      // if there is.
-      if (add_del_cache_.find(add->chunk_id) != add_del_cache_.end()) {
-        add++;
-        continue;
-      }
-      new_filter->Insert(add->prefix);
-      insert->bind_int(0, add->chunk_id);
-      insert->bind_int(1, add->prefix);
-      int rv = insert->step();
-      if (rv == SQLITE_CORRUPT) {
-        HandleCorruptDatabase();
-        delete new_filter;  // TODO(paulg): scoped.
-        return false;
-      }
-      DCHECK(rv == SQLITE_DONE);
-      insert->reset();
-      new_count++;
-    }
-    add++;
-  }
-
-  *new_add_count = new_count;
-  *filter = new_filter;
-
-  return true;
-}
-
 void SafeBrowsingDatabaseBloom::WriteFullHashes(HashCache* hash_cache,
                                                 bool is_add) {
   DCHECK(hash_cache);
@@ -1212,7 +1267,7 @@ bool SafeBrowsingDatabaseBloom::BuildSubFullHashCache(HashCache* sub_cache) {
 // This is a pretty fast operation and it would be nice to let it finish.
 void SafeBrowsingDatabaseBloom::BuildBloomFilter() {
 #if defined(OS_WIN)
-  // For measuring the amount of IO during the bloom filter build.
+  // For measuring the amount of IO during the prefix set build.
   IoCounters io_before, io_after;
   base::ProcessHandle handle = base::Process::Current().handle();
   scoped_ptr<base::ProcessMetrics> metric;
@@ -1232,16 +1287,11 @@ void SafeBrowsingDatabaseBloom::BuildBloomFilter() {
 
   add_count_ = GetAddPrefixCount();
   if (add_count_ == 0) {
-    bloom_filter_ = NULL;
+    AutoLock lock(lookup_lock_);
+    prefix_set_ = NULL;
     return;
   }
 
-  scoped_array<SBPair> adds_array(new SBPair[add_count_]);
-  SBPair* adds = adds_array.get();
-
-  if (!BuildAddPrefixList(adds))
-    return;
-
   // Build the full add cache, which includes full hash updates and GetHash
   // results. Subs may remove some of these entries.
   scoped_ptr<HashCache> add_cache(new HashCache);
@@ -1252,56 +1302,86 @@ void SafeBrowsingDatabaseBloom::BuildBloomFilter() {
   if (!BuildSubFullHashCache(sub_cache.get()))
     return;
 
-  // Used to track which adds have been subbed out. The vector<bool> is actually
+  std::vector<SBSubPair> subs;
+  if (!ReadSubPrefixes(&subs))
+    return;
+
+  // Used to track which subs have removed an add. The vector<bool> is actually
   // a bitvector so the size is as small as we can get.
-  std::vector<bool> adds_removed;
-  adds_removed.resize(add_count_, false);
+  std::vector<bool> subs_removed;
+  subs_removed.resize(subs.size(), false);
 
-  // Flag any add as removed if there is a matching sub.
-  int subs = 0;
-  if (!RemoveSubs(adds, &adds_removed, add_cache.get(), sub_cache.get(), &subs))
+  // The update makes a new generation of the add prefix file.
+  int generation;
+  if (!ReadGeneration(&generation))
     return;
-
-  // Prepare the database for writing out our remaining add and sub prefixes.
-  if (!UpdateTables())
+  ++generation;
+
+  // Merge the update into a new add prefix file, which replaces the current
+  // one once the database has committed.
+  FilePath temp_filename(add_prefix_filename_.value() + kTempFileSuffix);
+  std::vector<SBPrefix> prefixes;
+  prefixes.reserve(add_count_);
+  if (!MergeAddPrefixes(temp_filename, generation, subs, &subs_removed,
+                        add_cache.get(), sub_cache.get(), &prefixes)) {
+    file_util::Delete(temp_filename, false);
     return;
+  }
 
-  // Write out the remaining add prefixes to the filter and database.
-  int new_count;
-  BloomFilter* filter;
-  if (!WritePrefixes(adds, adds_removed, &new_count, &filter))
+  int sub_count = 0;
+  if (!WriteSubPrefixes(subs, subs_removed, &sub_count) || !UpdateTables()) {
+    file_util::Delete(temp_filename, false);
     return;
+  }
 
   // Write out the remaining full hash adds and subs to the database.
   WriteFullHashes(add_cache.get(), true);
   WriteFullHashes(sub_cache.get(), false);
 
   // Save the chunk numbers we've received to the database for reporting in
-  // future update requests.
-  if (!WriteChunkNumbers())
+  // future update requests, and the generation of the new add prefix file.
+  if (!WriteChunkNumbers() || !WriteGeneration(generation)) {
+    file_util::Delete(temp_filename, false);
     return;
+  }
 
   // Commit all the changes to the database.
   int rv = insert_transaction_->Commit();
   if (rv != SQLITE_OK) {
     NOTREACHED() << "SafeBrowsing update transaction failed to commit.";
     UMA_HISTOGRAM_COUNTS("SB2.FailedUpdate", 1);
+    file_util::Delete(temp_filename, false);
     return;
   }
 
-  // Swap in the newly built filter and cache. If there were any matching subs,
+  // The database now refers to the new adds.  If we don't get to replace the
+  // file, LoadPrefixSet() finds the new one next time, since it was synced
+  // before the commit.  Without it, the database must be rebuilt from scratch.
+  if (!file_util::Move(temp_filename, add_prefix_filename_)) {
+    HandleCorruptDatabase();
+    return;
+  }
+
+  // The adds of the file are sorted by chunk first, so their prefixes must
+  // be sorted for the set.
+  int new_count = static_cast<int>(prefixes.size());
+  std::sort(prefixes.begin(), prefixes.end());
+  scoped_refptr<PrefixSet> prefix_set = new PrefixSet(prefixes);
+  std::vector<SBPrefix>().swap(prefixes);
+
+  // Swap in the newly built set and cache. If there were any matching subs,
   // the size (add_count_) will be smaller.
   {
     AutoLock lock(lookup_lock_);
     add_count_ = new_count;
-    bloom_filter_ = filter;
+    prefix_set_ = prefix_set;
     hash_cache_.swap(add_cache);
   }
 
   TimeDelta bloom_gen = Time::Now() - before;
 
-  // Persist the bloom filter to disk.
-  WriteBloomFilter();
+  // Persist the prefix set to disk.
+  WritePrefixSet(generation);
 
   // Gather statistics.
 #if defined(OS_WIN)
@@ -1319,16 +1399,99 @@ void SafeBrowsingDatabaseBloom::BuildBloomFilter() {
                        static_cast<int>(io_after.WriteOperationCount -
                                         io_before.WriteOperationCount));
 #endif
-  SB_DLOG(INFO) << "SafeBrowsingDatabaseImpl built bloom filter in "
+  SB_DLOG(INFO) << "SafeBrowsingDatabaseImpl built prefix set in "
                 << bloom_gen.InMilliseconds()
                 << " ms total.  prefix count: "<< add_count_;
   UMA_HISTOGRAM_LONG_TIMES("SB2.BuildFilter", bloom_gen);
   UMA_HISTOGRAM_COUNTS("SB2.AddPrefixes", add_count_);
-  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", subs);
-  UMA_HISTOGRAM_COUNTS("SB2.FilterSize", filter->size());
+  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", sub_count);
+  UMA_HISTOGRAM_COUNTS("SB2.PrefixSetBytes", prefix_set->size());
   int64 size_64;
   if (file_util::GetFileSize(filename_, &size_64))
     UMA_HISTOGRAM_COUNTS("SB2.DatabaseBytes", static_cast<int>(size_64));
+  if (file_util::GetFileSize(add_prefix_filename_, &size_64))
+    UMA_HISTOGRAM_COUNTS("SB2.AddPrefixBytes", static_cast<int>(size_64));
+}
+
+void SafeBrowsingDatabaseBloom::LoadPrefixSet() {
+  DCHECK(!prefix_set_filename_.empty());
+
+  int generation;
+  if (!Open() || !ReadGeneration(&generation))
+    return;
+
+  // An update which committed, but didn't get to replace the add prefix file,
+  // left the new file behind.
+  int file_generation;
+  if (!ReadAddPrefixFileGeneration(add_prefix_filename_, &file_generation) ||
+      file_generation != generation) {
+    FilePath temp_filename(add_prefix_filename_.value() + kTempFileSuffix);
+    if (ReadAddPrefixFileGeneration(temp_filename, &file_generation) &&
+        file_generation == generation &&
+        file_util::Move(temp_filename, add_prefix_filename_)) {
+      UMA_HISTOGRAM_COUNTS("SB2.AddPrefixFileRecovered", 1);
+    } else if (generation == 0 &&
+               !file_util::PathExists(add_prefix_filename_)) {
+      return;  // There was no update yet.
+    } else {
+      // The database refers to adds that are gone, so start from scratch.
+      UMA_HISTOGRAM_COUNTS("SB2.AddPrefixFileMismatch", 1);
+      ResetDatabase();
+      return;
+    }
+  }
+
+  Time before = Time::Now();
+  prefix_set_ = PrefixSet::LoadFile(prefix_set_filename_, generation);
+  SB_DLOG(INFO) << "SafeBrowsingDatabase read prefix set in "
+                << (Time::Now() - before).InMilliseconds() << " ms";
+  if (prefix_set_.get())
+    return;
+
+  // The prefix set is missing, damaged or older than the add prefix file, as
+  // it is written after the update commits.
+  UMA_HISTOGRAM_COUNTS("SB2.PrefixSetReadFail", 1);
+  if (RebuildPrefixSet(generation))
+    WritePrefixSet(generation);
+}
+
+bool SafeBrowsingDatabaseBloom::RebuildPrefixSet(int generation) {
+  file_util::ScopedFILE file(file_util::OpenFile(add_prefix_filename_, "rb"));
+  if (!file.get())
+    return false;
+
+  int header[2];  // version, generation
+  if (fread(header, sizeof(header), 1, file.get()) != 1 ||
+      header[0] != kAddPrefixFileVersion || header[1] != generation)
+    return false;
+
+  std::vector<SBPrefix> prefixes;
+  SBPair add;
+  while (fread(&add, sizeof(add), 1, file.get()) == 1)
+    prefixes.push_back(add.prefix);
+  if (ferror(file.get()))
+    return false;
+
+  std::sort(prefixes.begin(), prefixes.end());
+  scoped_refptr<PrefixSet> prefix_set = new PrefixSet(prefixes);
+
+  AutoLock lock(lookup_lock_);
+  add_count_ = static_cast<int>(prefixes.size());
+  prefix_set_ = prefix_set;
+  return true;
+}
+
+void SafeBrowsingDatabaseBloom::WritePrefixSet(int generation) {
+  if (!prefix_set_.get())
+    return;
+
+  Time before = Time::Now();
+  bool write_ok = prefix_set_->WriteFile(prefix_set_filename_, generation);
+  SB_DLOG(INFO) << "SafeBrowsingDatabase wrote prefix set in "
+                << (Time::Now() - before).InMilliseconds() << " ms";
+
+  if (!write_ok)
+    UMA_HISTOGRAM_COUNTS("SB2.PrefixSetWriteFail", 1);
 }
 
 void SafeBrowsingDatabaseBloom::GetCachedFullHashes(
@@ -16,6 +16,7 @@
 #include "base/lock.h"
 #include "base/scoped_ptr.h"
 #include "base/task.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
 #include "chrome/browser/safe_browsing/safe_browsing_database.h"
 #include "chrome/browser/safe_browsing/safe_browsing_util.h"
 #include "chrome/common/sqlite_compiled_statement.h"
@@ -25,7 +26,9 @@ namespace base {
   class Time;
 }
 
-// The reference implementation database using SQLite.
+// The reference implementation database.  The add prefixes are kept in a file
+// sorted by chunk, and looked up in a PrefixSet.  The sub prefixes, the full
+// hashes and the chunk numbers are kept in SQLite.
 class SafeBrowsingDatabaseBloom : public SafeBrowsingDatabase {
  public:
   SafeBrowsingDatabaseBloom();
@@ -114,29 +117,74 @@ class SafeBrowsingDatabaseBloom : public SafeBrowsingDatabase {
   // the given list and chunk type.
   void GetChunkIds(int list_id, ChunkType type, std::string* list);
 
-  // Generate a bloom filter.
+  // Merges the update into the add prefix file, and generates the prefix set
+  // used for lookups.
   virtual void BuildBloomFilter();
 
-  // Helpers for building the bloom filter.
+  // Checks that the add prefix file is the one the database refers to, and
+  // loads the prefix set from disk, or rebuilds it from the add prefix file.
+  // Resets the database if the add prefix file can't be recovered.
+  void LoadPrefixSet();
+
+  // Builds the prefix set from the add prefix file of |generation|.
+  bool RebuildPrefixSet(int generation);
+
+  // Writes the current prefix set, built from |generation|, to disk.
+  void WritePrefixSet(int generation);
+
+  // Reads and writes the generation of the add prefix file that the database
+  // refers to.  An update increments it.
+  bool ReadGeneration(int* generation);
+  bool WriteGeneration(int generation);
+
+  // Reads the generation from the header of the add prefix file |filename|.
+  static bool ReadAddPrefixFileGeneration(const FilePath& filename,
+                                          int* generation);
+
+  // Helpers for building the prefix set.
   typedef struct {
     int chunk_id;
     SBPrefix prefix;
   } SBPair;
 
-  static int PairCompare(const void* arg1, const void* arg2);
+  // A sub prefix, which removes the add of |prefix| in |add_chunk_id|.
+  typedef struct {
+    int chunk_id;
+    int add_chunk_id;
+    SBPrefix prefix;
+  } SBSubPair;
+
+  // Orders the adds by chunk and prefix, like the add prefix file, and the
+  // subs by the add they remove.
+  static bool PairLess(const SBPair& pair1, const SBPair& pair2);
+  static bool SubPairLess(const SBSubPair& sub1, const SBSubPair& sub2);
 
-  bool BuildAddPrefixList(SBPair* adds);
   bool BuildAddFullHashCache(HashCache* add_cache);
   bool BuildSubFullHashCache(HashCache* sub_cache);
-  bool RemoveSubs(SBPair* adds,
-                  std::vector<bool>* adds_removed,
-                  HashCache* add_cache,
-                  HashCache* sub_cache,
-                  int* subs);
+
+  // Reads the sub prefixes which weren't deleted, and whose add chunk wasn't
+  // deleted either, sorted with SubPairLess.
+  bool ReadSubPrefixes(std::vector<SBSubPair>* subs);
+
+  // Merges the pending adds into the add prefix file, in one pass over both,
+  // and writes the result to |temp_filename| as |generation|, synced to disk.
+  // Adds which are deleted or removed by a sub are dropped, and the matching
+  // subs are flagged in |subs_removed|.  The prefixes of the remaining adds
+  // are returned in |prefixes|.
+  bool MergeAddPrefixes(const FilePath& temp_filename,
+                        int generation,
+                        const std::vector<SBSubPair>& subs,
+                        std::vector<bool>* subs_removed,
+                        HashCache* add_cache,
+                        HashCache* sub_cache,
+                        std::vector<SBPrefix>* prefixes);
+
+  // Replaces the sub prefixes with the ones which didn't remove an add.
+  bool WriteSubPrefixes(const std::vector<SBSubPair>& subs,
+                        const std::vector<bool>& subs_removed,
+                        int* sub_count);
 
   bool UpdateTables();
-  bool WritePrefixes(SBPair* adds, const std::vector<bool>& adds_removed,
-                     int* new_add_count, BloomFilter** filter);
   void WriteFullHashes(HashCache* hash_cache, bool is_add);
   void WriteFullHashList(const HashList& hash_list, bool is_add);
 
@@ -183,14 +231,15 @@ class SafeBrowsingDatabaseBloom : public SafeBrowsingDatabase {
                     int column,
                     SBFullHash* full_hash);
 
-  // Returns the number of chunk + prefix pairs in the add prefix table.
+  // Returns the number of chunk + prefix pairs in the add prefix file and the
+  // pending adds.
   int GetAddPrefixCount();
 
   // Reads and writes chunk numbers to and from persistent store.
   void ReadChunkNumbers();
   bool WriteChunkNumbers();
 
-  // Flush in memory temporary caches.
+  // Flush in memory temporary caches, including the pending adds.
   void ClearUpdateCaches();
 
   // Encode the list id in the lower bit of the chunk.
@@ -233,10 +282,21 @@ class SafeBrowsingDatabaseBloom : public SafeBrowsingDatabase {
   base::hash_set<int> add_del_cache_;
   base::hash_set<int> sub_del_cache_;
 
-  // The number of entries in the add_prefix table. Used to pick the correct
-  // size for the bloom filter and stats gathering.
+  // The number of entries in the add prefix file.  Used for stats gathering.
   int add_count_;
 
+  // The file of add prefixes, sorted with PairLess, after a header holding
+  // its generation.
+  FilePath add_prefix_filename_;
+
+  // The add prefixes of the current update, which are merged into the add
+  // prefix file when the update finishes.
+  std::vector<SBPair> pending_adds_;
+
+  // The set of the add prefixes, for lookups, and its file.
+  scoped_refptr<PrefixSet> prefix_set_;
+  FilePath prefix_set_filename_;
+
   // Set to true if the machine just resumed out of a sleep.  When this happens,
   // we pause disk activity for some time to avoid thrashing the system while
   // it's presumably going to be pretty busy.
@@ -245,7 +305,7 @@ class SafeBrowsingDatabaseBloom : public SafeBrowsingDatabase {
   // Transaction for protecting database integrity during updates.
   scoped_ptr<SQLTransaction> insert_transaction_;
 
-  // Lock for protecting access to the bloom filter and hash cache.
+  // Lock for protecting access to the prefix set and hash cache.
   Lock lookup_lock_;
 
   // A store for GetHash results that have not yet been written to the database.
@@ -585,6 +585,248 @@ TEST(SafeBrowsingDatabase, Database) {
   TearDownTestDatabase(database);
 }
 
+// Test that a sub received before its add removes the add in a later update,
+// and that the merged adds are found after the database is reopened.
+TEST(SafeBrowsingDatabase, SubBeforeAdd) {
+  FileAutoDeleter file_deleter(CreateTestDirectory());
+  SafeBrowsingDatabase* database = SetupTestDatabase(file_deleter.path());
+
+  // An add chunk, to have an add prefix file to merge into.
+  SBChunkHost host;
+  host.host = Sha256Prefix("www.first.com/");
+  host.entry = SBEntry::Create(SBEntry::ADD_PREFIX, 1);
+  host.entry->set_chunk_id(1);
+  host.entry->SetPrefixAt(0, Sha256Prefix("www.first.com/bad.html"));
+
+  SBChunk chunk;
+  chunk.chunk_number = 1;
+  chunk.is_add = true;
+  chunk.hosts.push_back(host);
+  std::deque<SBChunk>* chunks = new std::deque<SBChunk>;
+  chunks->push_back(chunk);
+
+  // A sub of an add chunk which hasn't been received yet.
+  host.host = Sha256Prefix("www.later.com/");
+  host.entry = SBEntry::Create(SBEntry::SUB_PREFIX, 1);
+  host.entry->set_chunk_id(1);
+  host.entry->SetChunkIdAtPrefix(0, 2);
+  host.entry->SetPrefixAt(0, Sha256Prefix("www.later.com/subbed.html"));
+
+  SBChunk sub_chunk;
+  sub_chunk.chunk_number = 1;
+  sub_chunk.is_add = false;
+  sub_chunk.hosts.push_back(host);
+  std::deque<SBChunk>* sub_chunks = new std::deque<SBChunk>;
+  sub_chunks->push_back(sub_chunk);
+
+  std::vector<SBListChunkRanges> lists;
+  EXPECT_TRUE(database->UpdateStarted());
+  database->GetListsInfo(&lists);
+  database->InsertChunks(safe_browsing_util::kMalwareList, chunks);
+  database->InsertChunks(safe_browsing_util::kMalwareList, sub_chunks);
+  database->UpdateFinished(true);
+
+  // The add chunk of the sub, in the next update.
+  host.host = Sha256Prefix("www.later.com/");
+  host.entry = SBEntry::Create(SBEntry::ADD_PREFIX, 2);
+  host.entry->set_chunk_id(2);
+  host.entry->SetPrefixAt(0, Sha256Prefix("www.later.com/subbed.html"));
+  host.entry->SetPrefixAt(1, Sha256Prefix("www.later.com/bad.html"));
+
+  chunk.chunk_number = 2;
+  chunk.hosts.clear();
+  chunk.hosts.push_back(host);
+  chunks = new std::deque<SBChunk>;
+  chunks->push_back(chunk);
+
+  lists.clear();
+  EXPECT_TRUE(database->UpdateStarted());
+  database->GetListsInfo(&lists);
+  database->InsertChunks(safe_browsing_util::kMalwareList, chunks);
+  database->UpdateFinished(true);
+
+  const Time now = Time::Now();
+  std::vector<SBFullHashResult> full_hashes;
+  std::vector<SBPrefix> prefix_hits;
+  std::string matching_list;
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.first.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.later.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_FALSE(database->ContainsUrl(GURL("http://www.later.com/subbed.html"),
+                                     &matching_list, &prefix_hits,
+                                     &full_hashes, now));
+
+  // The prefix set is read back from disk.
+  delete database;
+  database = SafeBrowsingDatabase::Create();
+  database->SetSynchronous();
+  EXPECT_TRUE(database->Init(GetTestDatabaseName(file_deleter.path()), NULL));
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.first.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.later.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_FALSE(database->ContainsUrl(GURL("http://www.later.com/subbed.html"),
+                                     &matching_list, &prefix_hits,
+                                     &full_hashes, now));
+
+  lists.clear();
+  GetListsInfo(database, &lists);
+  EXPECT_EQ("1-2", lists[0].adds);
+  EXPECT_EQ("1", lists[0].subs);
+
+  TearDownTestDatabase(database);
+}
+
+// Inserts an add chunk of |host| and |path| into |database|, in an update of
+// its own.
+void InsertAddChunkInUpdate(SafeBrowsingDatabase* database,
+                            int chunk_number,
+                            const std::string& host,
+                            const std::string& path) {
+  SBChunkHost chunk_host;
+  chunk_host.host = Sha256Prefix(host);
+  chunk_host.entry = SBEntry::Create(SBEntry::ADD_PREFIX, 1);
+  chunk_host.entry->set_chunk_id(chunk_number);
+  chunk_host.entry->SetPrefixAt(0, Sha256Prefix(host + path));
+
+  SBChunk chunk;
+  chunk.chunk_number = chunk_number;
+  chunk.is_add = true;
+  chunk.hosts.push_back(chunk_host);
+  std::deque<SBChunk>* chunks = new std::deque<SBChunk>;
+  chunks->push_back(chunk);
+
+  std::vector<SBListChunkRanges> lists;
+  EXPECT_TRUE(database->UpdateStarted());
+  database->GetListsInfo(&lists);
+  database->InsertChunks(safe_browsing_util::kMalwareList, chunks);
+  database->UpdateFinished(true);
+}
+
+// Test that the add prefix file is checked against the database when the
+// database is opened, as if the browser had crashed in the middle of an update.
+TEST(SafeBrowsingDatabase, AddPrefixFileRecovery) {
+  FileAutoDeleter file_deleter(CreateTestDirectory());
+  SafeBrowsingDatabase* database = SetupTestDatabase(file_deleter.path());
+  const FilePath filename = database->filename();
+  const FilePath add_filename(filename.value() +
+                              FILE_PATH_LITERAL(" Add Prefixes"));
+  const FilePath new_add_filename(add_filename.value() +
+                                  FILE_PATH_LITERAL(" New"));
+  const FilePath prefix_set_filename(filename.value() +
+                                     FILE_PATH_LITERAL(" Prefix Set"));
+  const FilePath old_add_filename(add_filename.value() +
+                                  FILE_PATH_LITERAL(" Old"));
+  const FilePath old_prefix_set_filename(prefix_set_filename.value() +
+                                         FILE_PATH_LITERAL(" Old"));
+
+  InsertAddChunkInUpdate(database, 1, "www.first.com/", "bad.html");
+  ASSERT_TRUE(file_util::CopyFile(add_filename, old_add_filename));
+  ASSERT_TRUE(file_util::CopyFile(prefix_set_filename,
+                                  old_prefix_set_filename));
+  InsertAddChunkInUpdate(database, 2, "www.later.com/", "bad.html");
+  delete database;
+
+  // The second update committed, but the new add prefix file didn't replace
+  // the old one, and the prefix set wasn't written.  The new file is found
+  // and the prefix set is rebuilt from it.
+  ASSERT_TRUE(file_util::Move(add_filename, new_add_filename));
+  ASSERT_TRUE(file_util::CopyFile(old_add_filename, add_filename));
+  ASSERT_TRUE(file_util::CopyFile(old_prefix_set_filename,
+                                  prefix_set_filename));
+  database = SafeBrowsingDatabase::Create();
+  database->SetSynchronous();
+  EXPECT_TRUE(database->Init(GetTestDatabaseName(file_deleter.path()), NULL));
+  EXPECT_FALSE(file_util::PathExists(new_add_filename));
+
+  const Time now = Time::Now();
+  std::vector<SBFullHashResult> full_hashes;
+  std::vector<SBPrefix> prefix_hits;
+  std::string matching_list;
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.first.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.later.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  std::vector<SBListChunkRanges> lists;
+  GetListsInfo(database, &lists);
+  ASSERT_EQ(1U, lists.size());
+  EXPECT_EQ("1-2", lists[0].adds);
+  delete database;
+
+  // The add prefix file the database refers to is lost.  The database is
+  // reset, rather than answering from adds it doesn't know about.
+  ASSERT_TRUE(file_util::CopyFile(old_add_filename, add_filename));
+  database = SafeBrowsingDatabase::Create();
+  database->SetSynchronous();
+  EXPECT_TRUE(database->Init(GetTestDatabaseName(file_deleter.path()), NULL));
+  EXPECT_FALSE(database->ContainsUrl(GURL("http://www.first.com/bad.html"),
+                                     &matching_list, &prefix_hits,
+                                     &full_hashes, now));
+  lists.clear();
+  GetListsInfo(database, &lists);
+  EXPECT_TRUE(lists.empty() || lists[0].adds.empty());
+
+  file_util::Delete(old_add_filename, false);
+  file_util::Delete(old_prefix_set_filename, false);
+  TearDownTestDatabase(database);
+}
+
+// Test that a sub of an add chunk which is deleted in the same update goes
+// away with it, instead of removing the adds of the chunk if it comes again.
+TEST(SafeBrowsingDatabase, SubOfDeletedAddChunk) {
+  FileAutoDeleter file_deleter(CreateTestDirectory());
+  SafeBrowsingDatabase* database = SetupTestDatabase(file_deleter.path());
+
+  InsertAddChunkInUpdate(database, 1, "www.first.com/", "bad.html");
+  InsertAddChunkInUpdate(database, 2, "www.later.com/", "subbed.html");
+
+  SBChunkHost host;
+  host.host = Sha256Prefix("www.later.com/");
+  host.entry = SBEntry::Create(SBEntry::SUB_PREFIX, 1);
+  host.entry->set_chunk_id(1);
+  host.entry->SetChunkIdAtPrefix(0, 2);
+  host.entry->SetPrefixAt(0, Sha256Prefix("www.later.com/subbed.html"));
+
+  SBChunk sub_chunk;
+  sub_chunk.chunk_number = 1;
+  sub_chunk.is_add = false;
+  sub_chunk.hosts.push_back(host);
+  std::deque<SBChunk>* sub_chunks = new std::deque<SBChunk>;
+  sub_chunks->push_back(sub_chunk);
+
+  std::vector<SBListChunkRanges> lists;
+  EXPECT_TRUE(database->UpdateStarted());
+  database->GetListsInfo(&lists);
+  database->InsertChunks(safe_browsing_util::kMalwareList, sub_chunks);
+  AddDelChunk(database, safe_browsing_util::kMalwareList, 2);
+  database->UpdateFinished(true);
+
+  const Time now = Time::Now();
+  std::vector<SBFullHashResult> full_hashes;
+  std::vector<SBPrefix> prefix_hits;
+  std::string matching_list;
+  EXPECT_FALSE(database->ContainsUrl(GURL("http://www.later.com/subbed.html"),
+                                     &matching_list, &prefix_hits,
+                                     &full_hashes, now));
+
+  // The add chunk is received again, without the sub.
+  InsertAddChunkInUpdate(database, 2, "www.later.com/", "subbed.html");
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.first.com/bad.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+  EXPECT_TRUE(database->ContainsUrl(GURL("http://www.later.com/subbed.html"),
+                                    &matching_list, &prefix_hits,
+                                    &full_hashes, now));
+
+  TearDownTestDatabase(database);
+}
 
 // Test adding zero length chunks to the database.
 TEST(SafeBrowsingDatabase, ZeroSizeChunk) {
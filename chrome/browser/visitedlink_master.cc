@@ -39,7 +39,9 @@ const int32 VisitedLinkMaster::kFileHeaderLengthOffset = 8;
 const int32 VisitedLinkMaster::kFileHeaderUsedOffset = 12;
 const int32 VisitedLinkMaster::kFileHeaderSaltOffset = 16;
 
-const int32 VisitedLinkMaster::kFileCurrentVersion = 2;
+// Version 3 keeps the runs of the table sorted by hash value (see
+// VisitedLinkCommon). Older tables are rebuilt from history.
+const int32 VisitedLinkMaster::kFileCurrentVersion = 3;
 
 // the signature at the beginning of the URL table = "VLnk" (visited links)
 const int32 VisitedLinkMaster::kFileSignature = 0x6b6e4c56;
@@ -202,6 +204,68 @@ class VisitedLinkMaster::TableBuilder : public HistoryService::URLEnumerator,
   VisitedLinkCommon::Fingerprints fingerprints_;
 };
 
+// TableResizer ---------------------------------------------------------------
+
+// How resizing works
+// ------------------
+//
+// Rehashing a large table touches every entry of the new table in a random
+// order, which is too slow to do on the main thread. When the master has a
+// file thread, it copies the fingerprints of the current table, which is a
+// sequential scan, and hands them to a TableResizer. The resizer builds the
+// new table in new shared memory on the file thread, and marshalls it back to
+// the main thread.
+//
+// Meanwhile, the master keeps using the current table, and records the URLs
+// added and deleted like during a rebuild from history. When the new table
+// arrives, the master applies these changes to it, replaces the current table
+// and sends the new one to the listener.
+//
+// Like the TableBuilder, the resizer is disowned if the master is deleted or
+// the table is cleared before the resize completes.
+class VisitedLinkMaster::TableResizer
+    : public base::RefCountedThreadSafe<TableResizer> {
+ public:
+  // The contents of |fingerprints| are taken over by the resizer.
+  TableResizer(VisitedLinkMaster* master,
+               const uint8 salt[LINK_SALT_LENGTH],
+               int32 table_length,
+               VisitedLinkCommon::Fingerprints* fingerprints);
+  ~TableResizer();
+
+  // Called on the main thread when the master doesn't want the new table
+  // anymore.
+  void DisownMaster();
+
+  // Builds the new table. Called on the file thread.
+  void Resize();
+
+ private:
+  // Resize marshals to this function on the main thread to hand the new
+  // table to the master.
+  void OnCompleteMainThread();
+
+  // Owner of this object. MAY ONLY BE ACCESSED ON THE MAIN THREAD!
+  VisitedLinkMaster* master_;
+
+  // The thread the visited link master is on where we will notify it.
+  MessageLoop* main_message_loop_;
+
+  // Salt of the table, which is copied to the new shared memory.
+  uint8 salt_[LINK_SALT_LENGTH];
+
+  // The size of the new table.
+  int32 table_length_;
+
+  // The fingerprints to put in the new table.
+  VisitedLinkCommon::Fingerprints fingerprints_;
+
+  // The new table, owned by this object until it is handed to the master.
+  scoped_ptr<base::SharedMemory> shared_memory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TableResizer);
+};
+
 // VisitedLinkMaster ----------------------------------------------------------
 
 VisitedLinkMaster::VisitedLinkMaster(base::Thread* file_thread,
@@ -232,6 +296,8 @@ VisitedLinkMaster::~VisitedLinkMaster() {
     // builder will destroy itself when it finds we are gone.
     table_builder_->DisownMaster();
   }
+  if (table_resizer_.get())
+    table_resizer_->DisownMaster();
   FreeURLTable();
 }
 
@@ -279,7 +345,8 @@ base::SharedMemoryHandle VisitedLinkMaster::GetSharedMemoryHandle() {
   return shared_memory_->handle();
 }
 
-VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
+VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url,
+                                                       Hash* last_hash) {
   // Extra check that we are not off the record. This should not happen.
   if (profile_ && profile_->IsOffTheRecord()) {
     NOTREACHED();
@@ -292,15 +359,15 @@ VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
   Fingerprint fingerprint = ComputeURLFingerprint(url.spec().data(),
                                                   url.spec().size(),
                                                   salt_);
-  if (table_builder_) {
+  if (IsReplacingTable()) {
     // If we have a pending delete for this fingerprint, cancel it.
     std::set<Fingerprint>::iterator found =
         deleted_since_rebuild_.find(fingerprint);
     if (found != deleted_since_rebuild_.end())
         deleted_since_rebuild_.erase(found);
 
-    // A rebuild is in progress, save this addition in the temporary list so
-    // it can be added once rebuild is complete.
+    // A rebuild or resize is in progress, save this addition in the
+    // temporary list so it can be added once it is complete.
     added_since_rebuild_.insert(fingerprint);
   }
 
@@ -311,15 +378,16 @@ VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
   if (used_items_ / 8 > table_length_ / 10)
     return null_hash_;  // Table is more than 80% full.
 
-  return AddFingerprint(fingerprint, true);
+  return AddFingerprint(fingerprint, true, last_hash);
 }
 
 void VisitedLinkMaster::AddURL(const GURL& url) {
-  Hash index = TryToAddURL(url);
-  if (!table_builder_ && index != null_hash_) {
+  Hash last_hash;
+  Hash index = TryToAddURL(url, &last_hash);
+  if (!IsReplacingTable() && index != null_hash_) {
     // Not rebuilding, so we want to keep the file on disk up-to-date.
     WriteUsedItemCountToFile();
-    WriteHashRangeToFile(index, index);
+    WriteHashRangeToFile(index, last_hash);
     ResizeTableIfNecessary();
   }
 }
@@ -327,17 +395,24 @@ void VisitedLinkMaster::AddURL(const GURL& url) {
 void VisitedLinkMaster::AddURLs(const std::vector<GURL>& url) {
   for (std::vector<GURL>::const_iterator i = url.begin();
        i != url.end(); ++i) {
-    Hash index = TryToAddURL(*i);
-    if (!table_builder_ && index != null_hash_)
+    Hash last_hash;
+    Hash index = TryToAddURL(*i, &last_hash);
+    if (!IsReplacingTable() && index != null_hash_)
       ResizeTableIfNecessary();
   }
 
   // Keeps the file on disk up-to-date.
-  if (!table_builder_)
+  if (!IsReplacingTable())
     WriteFullTable();
 }
 
 void VisitedLinkMaster::DeleteAllURLs() {
+  // A pending resize would bring back the old URLs.
+  if (table_resizer_.get()) {
+    table_resizer_->DisownMaster();
+    table_resizer_ = NULL;
+  }
+
   // Any pending modifications are invalid.
   added_since_rebuild_.clear();
   deleted_since_rebuild_.clear();
@@ -360,11 +435,9 @@ void VisitedLinkMaster::DeleteURLs(const std::set<GURL>& urls) {
   if (urls.empty())
     return;
 
-  listener_->Reset();
-
-  if (table_builder_) {
-    // A rebuild is in progress, save this deletion in the temporary list so
-    // it can be added once rebuild is complete.
+  if (IsReplacingTable()) {
+    // A rebuild or resize is in progress, save this deletion in the temporary
+    // list so it can be applied once it is complete.
     for (SetIterator i = urls.begin(); i != urls.end(); ++i) {
       if (!i->is_valid())
         continue;
@@ -384,6 +457,7 @@ void VisitedLinkMaster::DeleteURLs(const std::set<GURL>& urls) {
       // to disk since it will be replaced soon.
       DeleteFingerprint(fingerprint, false);
     }
+    listener_->Reset();
     return;
   }
 
@@ -396,37 +470,63 @@ void VisitedLinkMaster::DeleteURLs(const std::set<GURL>& urls) {
         ComputeURLFingerprint(i->spec().data(), i->spec().size(), salt_));
   }
   DeleteFingerprintsFromCurrentTable(deleted_fingerprints);
+
+  // Only now that the table is final, have the renderers check their links
+  // again, which also corrects any lookup that a deletion made miss.
+  listener_->Reset();
 }
 
-// See VisitedLinkCommon::IsVisited which should be in sync with this algorithm
+// See VisitedLinkCommon::FindFingerprint which should be in sync with this
+// algorithm.
 VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprint(
     Fingerprint fingerprint,
-    bool send_notifications) {
+    bool send_notifications,
+    Hash* last_hash) {
   if (!hash_table_ || table_length_ == 0) {
     NOTREACHED();  // Not initialized.
     return null_hash_;
   }
 
-  Hash cur_hash = HashFingerprint(fingerprint);
-  Hash first_hash = cur_hash;
+  Hash index = InsertFingerprint(hash_table_, table_length_, fingerprint,
+                                 last_hash);
+  if (index == null_hash_)
+    return null_hash_;
+
+  used_items_++;
+  // If allowed, notify listener that a new visited link was added.
+  if (send_notifications)
+    listener_->Add(fingerprint);
+  return index;
+}
+
+// static
+VisitedLinkMaster::Hash VisitedLinkMaster::InsertFingerprint(
+    Fingerprint* hash_table,
+    int32 table_length,
+    Fingerprint fingerprint,
+    Hash* last_hash) {
+  // Find where the fingerprint goes: the first empty spot, or the first
+  // entry closer to its hash value than we are to ours.
+  Hash cur_hash = HashFingerprint(fingerprint, table_length);
+  int32 distance = 0;
   while (true) {
-    Fingerprint cur_fingerprint = FingerprintAt(cur_hash);
+    Fingerprint cur_fingerprint = hash_table[cur_hash];
     if (cur_fingerprint == fingerprint)
       return null_hash_;  // This fingerprint is already in there, do nothing.
 
     if (cur_fingerprint == null_fingerprint_) {
       // End of probe sequence found, insert here.
-      hash_table_[cur_hash] = fingerprint;
-      used_items_++;
-      // If allowed, notify listener that a new visited link was added.
-      if (send_notifications)
-        listener_->Add(fingerprint);
+      hash_table[cur_hash] = fingerprint;
+      *last_hash = cur_hash;
       return cur_hash;
     }
 
+    if (ProbeDistance(cur_fingerprint, cur_hash, table_length) < distance)
+      break;  // We go before this entry.
+
     // Advance in the probe sequence.
-    cur_hash = IncrementHash(cur_hash);
-    if (cur_hash == first_hash) {
+    cur_hash = (cur_hash + 1) % table_length;
+    if (++distance == table_length) {
       // This means that we've wrapped around and are about to go into an
       // infinite loop. Something was wrong with the hashtable resizing
       // logic, so stop here.
@@ -434,6 +534,21 @@ VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprint(
       return null_hash_;
     }
   }
+
+  // Move the rest of the run over by one, starting from its end, so that the
+  // readers (which don't lock) see every moved entry in at least one of its
+  // two spots. The table isn't full, so there is an empty spot.
+  Hash end_hash = cur_hash;
+  while (hash_table[end_hash] != null_fingerprint_)
+    end_hash = (end_hash + 1) % table_length;
+  for (Hash i = end_hash; i != cur_hash; ) {
+    Hash previous = i == 0 ? table_length - 1 : i - 1;
+    hash_table[i] = hash_table[previous];
+    i = previous;
+  }
+  hash_table[cur_hash] = fingerprint;
+  *last_hash = end_hash;
+  return cur_hash;
 }
 
 void VisitedLinkMaster::DeleteFingerprintsFromCurrentTable(
@@ -460,7 +575,8 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
     NOTREACHED();  // Not initialized.
     return false;
   }
-  if (!IsVisited(fingerprint))
+  Hash deleted_hash = FindFingerprint(fingerprint);
+  if (deleted_hash == null_hash_)
     return false;  // Not in the database to delete.
 
   // First update the header used count.
@@ -468,45 +584,25 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
   if (update_file)
     WriteUsedItemCountToFile();
 
-  Hash deleted_hash = HashFingerprint(fingerprint);
-
-  // Find the range of "stuff" in the hash table that is adjacent to this
-  // fingerprint. These are things that could be affected by the change in
-  // the hash table. Since we use linear probing, anything after the deleted
-  // item up until an empty item could be affected.
+  // Move the rest of the run back by one, up to an empty spot or an entry
+  // which is at its hash value. Like in InsertFingerprint, each entry is
+  // copied before its old spot is overwritten. Unlike there, the entries move
+  // against the direction of the readers, which don't lock: a lookup which
+  // has already passed the new spot of an entry when it moves there, and
+  // reaches its old spot after the next entry replaced it, misses it. This
+  // false negative only lasts until the renderers are reset, which
+  // DeleteURLs() does once the deletions are done.
   Hash end_range = deleted_hash;
   while (true) {
     Hash next_hash = IncrementHash(end_range);
-    if (next_hash == deleted_hash)
-      break;  // We wrapped around and the whole table is full.
-    if (!hash_table_[next_hash])
+    Fingerprint next_fingerprint = hash_table_[next_hash];
+    if (next_fingerprint == null_fingerprint_ ||
+        ProbeDistance(next_fingerprint, next_hash, table_length_) == 0)
       break;  // Found the last spot.
+    hash_table_[end_range] = next_fingerprint;
     end_range = next_hash;
   }
-
-  // We could get all fancy and move the affected fingerprints around, but
-  // instead we just remove them all and re-add them (minus our deleted one).
-  // This will mean there's a small window of time where the affected links
-  // won't be marked visited.
-  StackVector<Fingerprint, 32> shuffled_fingerprints;
-  Hash stop_loop = IncrementHash(end_range);  // The end range is inclusive.
-  for (Hash i = deleted_hash; i != stop_loop; i = IncrementHash(i)) {
-    if (hash_table_[i] != fingerprint) {
-      // Don't save the one we're deleting!
-      shuffled_fingerprints->push_back(hash_table_[i]);
-
-      // This will balance the increment of this value in AddFingerprint below
-      // so there is no net change.
-      used_items_--;
-    }
-    hash_table_[i] = null_fingerprint_;
-  }
-
-  if (!shuffled_fingerprints->empty()) {
-    // Need to add the new items back.
-    for (size_t i = 0; i < shuffled_fingerprints->size(); i++)
-      AddFingerprint(shuffled_fingerprints[i], false);
-  }
+  hash_table_[end_range] = null_fingerprint_;
 
   // Write the affected range to disk [deleted_hash, end_range].
   if (update_file)
@@ -690,43 +786,48 @@ bool VisitedLinkMaster::GetDatabaseFileName(FilePath* filename) {
 // Initializes the shared memory structure. The salt should already be filled
 // in so that it can be written to the shared memory
 bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
+  base::SharedMemory* shared_memory =
+      CreateSharedTable(num_entries, salt_, init_to_empty);
+  if (!shared_memory)
+    return false;
+
+  shared_memory_ = shared_memory;
+  if (init_to_empty)
+    used_items_ = 0;
+  table_length_ = num_entries;
+  hash_table_ = TableFromSharedMemory(shared_memory_);
+  return true;
+}
+
+// static
+base::SharedMemory* VisitedLinkMaster::CreateSharedTable(
+    int32 num_entries,
+    const uint8 salt[LINK_SALT_LENGTH],
+    bool init_to_empty) {
   // The table is the size of the table followed by the entries.
   int32 alloc_size = num_entries * sizeof(Fingerprint) + sizeof(SharedHeader);
 
   // Create the shared memory object.
-  shared_memory_ = new base::SharedMemory();
-  if (!shared_memory_)
-    return false;
-
-  if (!shared_memory_->Create(std::wstring() /* anonymous */,
-                              false /* read-write */, false /* create */,
-                              alloc_size)) {
-    return false;
+  scoped_ptr<base::SharedMemory> shared_memory(new base::SharedMemory());
+  if (!shared_memory->Create(std::wstring() /* anonymous */,
+                             false /* read-write */, false /* create */,
+                             alloc_size)) {
+    return NULL;
   }
 
   // Map into our process.
-  if (!shared_memory_->Map(alloc_size)) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
-    return false;
-  }
+  if (!shared_memory->Map(alloc_size))
+    return NULL;
 
-  if (init_to_empty) {
-    memset(shared_memory_->memory(), 0, alloc_size);
-    used_items_ = 0;
-  }
-  table_length_ = num_entries;
+  if (init_to_empty)
+    memset(shared_memory->memory(), 0, alloc_size);
 
   // Save the header for other processes to read.
-  SharedHeader* header = static_cast<SharedHeader*>(shared_memory_->memory());
-  header->length = table_length_;
-  memcpy(header->salt, salt_, LINK_SALT_LENGTH);
+  SharedHeader* header = static_cast<SharedHeader*>(shared_memory->memory());
+  header->length = num_entries;
+  memcpy(header->salt, salt, LINK_SALT_LENGTH);
 
-  // Our table pointer is just the data immediately following the size.
-  hash_table_ = reinterpret_cast<Fingerprint*>(
-      static_cast<char*>(shared_memory_->memory()) + sizeof(SharedHeader));
-
-  return true;
+  return shared_memory.release();
 }
 
 bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
@@ -766,6 +867,11 @@ void VisitedLinkMaster::FreeURLTable() {
 bool VisitedLinkMaster::ResizeTableIfNecessary() {
   DCHECK(table_length_ > 0) << "Must have a table";
 
+  // A pending resize will check again and write the new table out when it is
+  // done.
+  if (table_resizer_.get())
+    return true;
+
   // Load limits for good performance/space. We are pretty conservative about
   // keeping the table not very full. This is because we use linear probing
   // which increases the likelihood of clumps of entries which will reduce
@@ -789,12 +895,30 @@ bool VisitedLinkMaster::ResizeTableIfNecessary() {
 
 void VisitedLinkMaster::ResizeTable(int32 new_size) {
   DCHECK(shared_memory_ && shared_memory_->memory() && hash_table_);
+  DCHECK(!table_resizer_);
   shared_memory_serial_++;
 
 #ifndef NDEBUG
   DebugValidate();
 #endif
 
+  // While a rebuild from history is completing, the resize is done here since
+  // the changes recorded for the rebuild are being applied.
+  if (file_thread_ && !table_builder_) {
+    // Build the new table on the file thread, see the TableResizer
+    // definition.
+    Fingerprints fingerprints;
+    fingerprints.reserve(used_items_);
+    for (int32 i = 0; i < table_length_; i++) {
+      if (hash_table_[i])
+        fingerprints.push_back(hash_table_[i]);
+    }
+    table_resizer_ = new TableResizer(this, salt_, new_size, &fingerprints);
+    file_thread_->PostTask(FROM_HERE, NewRunnableMethod(
+        table_resizer_.get(), &TableResizer::Resize));
+    return;
+  }
+
   base::SharedMemory* old_shared_memory = shared_memory_;
   Fingerprint* old_hash_table = hash_table_;
   int32 old_table_length = table_length_;
@@ -825,6 +949,46 @@ void VisitedLinkMaster::ResizeTable(int32 new_size) {
   WriteFullTable();
 }
 
+void VisitedLinkMaster::OnTableResizeComplete(
+    base::SharedMemory* shared_memory,
+    int32 table_length,
+    int32 used_count) {
+  table_resizer_ = NULL;  // Will release our reference to the resizer.
+
+  if (shared_memory) {
+    delete shared_memory_;
+    shared_memory_ = shared_memory;
+    hash_table_ = TableFromSharedMemory(shared_memory_);
+    table_length_ = table_length;
+    used_items_ = used_count;
+
+    // Apply the changes made to the old table while we were resizing.
+    for (std::set<Fingerprint>::iterator i = added_since_rebuild_.begin();
+         i != added_since_rebuild_.end(); ++i)
+      AddFingerprint(*i, false);
+    for (std::set<Fingerprint>::iterator i = deleted_since_rebuild_.begin();
+         i != deleted_since_rebuild_.end(); ++i)
+      DeleteFingerprint(*i, false);
+
+#ifndef NDEBUG
+    DebugValidate();
+#endif
+
+    // Send an update notification to all child processes so they read the
+    // new table.
+    listener_->NewTable(shared_memory_);
+  }
+  added_since_rebuild_.clear();
+  deleted_since_rebuild_.clear();
+
+  // The changes made while resizing haven't been written to disk, so the
+  // table (new or old) needs to be written, unless it needs resizing again.
+  // When the new table couldn't be created, memory is likely short, so we
+  // don't try again right away: the next URL added will.
+  if (!shared_memory || !ResizeTableIfNecessary())
+    WriteFullTable();
+}
+
 uint32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
   // These table sizes are selected to be the maximum prime number less than
   // a "convenient" multiple of 1K.
@@ -888,6 +1052,7 @@ bool VisitedLinkMaster::RebuildTableFromHistory() {
 void VisitedLinkMaster::OnTableRebuildComplete(
     bool success,
     const std::vector<Fingerprint>& fingerprints) {
+  DCHECK(!table_resizer_);
   if (success) {
     // Replace the old table with a new blank one.
     shared_memory_serial_++;
@@ -964,7 +1129,7 @@ void VisitedLinkMaster::WriteHashRangeToFile(Hash first_hash, Hash last_hash) {
     // Handle wraparound at 0. This first write is first_hash->EOF
     WriteToFile(file_, first_hash * sizeof(Fingerprint) + kFileHeaderSize,
                 &hash_table_[first_hash],
-                (table_length_ - first_hash + 1) * sizeof(Fingerprint));
+                (table_length_ - first_hash) * sizeof(Fingerprint));
 
     // Now do 0->last_lash.
     WriteToFile(file_, kFileHeaderSize, hash_table_,
@@ -1036,3 +1201,48 @@ void VisitedLinkMaster::TableBuilder::OnCompleteMainThread() {
   // VisitedLinkMaster::RebuildTableFromHistory.
   Release();
 }
+
+// TableResizer ---------------------------------------------------------------
+
+VisitedLinkMaster::TableResizer::TableResizer(
+    VisitedLinkMaster* master,
+    const uint8 salt[LINK_SALT_LENGTH],
+    int32 table_length,
+    VisitedLinkCommon::Fingerprints* fingerprints)
+    : master_(master),
+      main_message_loop_(MessageLoop::current()),
+      table_length_(table_length) {
+  memcpy(salt_, salt, LINK_SALT_LENGTH);
+  fingerprints_.swap(*fingerprints);
+}
+
+VisitedLinkMaster::TableResizer::~TableResizer() {
+}
+
+void VisitedLinkMaster::TableResizer::DisownMaster() {
+  master_ = NULL;
+}
+
+void VisitedLinkMaster::TableResizer::Resize() {
+  shared_memory_.reset(CreateSharedTable(table_length_, salt_, true));
+  if (shared_memory_.get()) {
+    Fingerprint* hash_table = TableFromSharedMemory(shared_memory_.get());
+    for (size_t i = 0; i < fingerprints_.size(); i++) {
+      Hash last_hash;
+      InsertFingerprint(hash_table, table_length_, fingerprints_[i],
+                        &last_hash);
+    }
+  } else {
+    DLOG(WARNING) << "Unable to resize visited links";
+  }
+
+  main_message_loop_->PostTask(FROM_HERE, NewRunnableMethod(this,
+      &TableResizer::OnCompleteMainThread));
+}
+
+void VisitedLinkMaster::TableResizer::OnCompleteMainThread() {
+  if (master_) {
+    master_->OnTableResizeComplete(shared_memory_.release(), table_length_,
+                                   static_cast<int32>(fingerprints_.size()));
+  }
+}
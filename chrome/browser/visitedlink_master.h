@@ -32,7 +32,9 @@ class Thread;
 //
 // This class will optionally defer writing operations to another thread. This
 // means that after class destruction, the file may still be open since
-// operations are pending on another thread.
+// operations are pending on another thread. When that thread is given, the
+// table is also resized on it, so that rehashing a large table doesn't block
+// the main thread.
 class VisitedLinkMaster : public VisitedLinkCommon {
  public:
   // Listens to the link coloring database events. The master is given this
@@ -103,7 +105,7 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // Adds a set of URLs to the table.
   void AddURLs(const std::vector<GURL>& url);
 
-  // Deletes the specified URLs from the table.
+  // Deletes the specified URLs from the table, then resets the listener.
   void DeleteURLs(const std::set<GURL>& urls);
 
   // Clears the visited links table by deleting the file from disk. Used as
@@ -138,10 +140,14 @@ class VisitedLinkMaster : public VisitedLinkCommon {
  private:
   FRIEND_TEST(VisitedLinkTest, Delete);
   FRIEND_TEST(VisitedLinkTest, BigDelete);
+  FRIEND_TEST(VisitedLinkTest, ResizeOnFileThread);
 
   // Object to rebuild the table on the history thread (see the .cc file).
   class TableBuilder;
 
+  // Object to resize the table on the file thread (see the .cc file).
+  class TableResizer;
+
   // Byte offsets of values in the header.
   static const int32 kFileHeaderSignatureOffset;
   static const int32 kFileHeaderVersionOffset;
@@ -171,10 +177,19 @@ class VisitedLinkMaster : public VisitedLinkCommon {
                    Listener* listener,
                    Profile* profile);
 
-  // If a rebuild is in progress, we save the URL in the temporary list.
-  // Otherwise, we add this to the table. Returns the index of the
-  // inserted fingerprint or null_hash_ on failure.
-  Hash TryToAddURL(const GURL& url);
+  // If a rebuild or a resize is in progress, we save the URL in the temporary
+  // list. We also add this to the table. Returns the index of the inserted
+  // fingerprint or null_hash_ on failure, and the last index that changed in
+  // |last_hash| (see AddFingerprint).
+  Hash TryToAddURL(const GURL& url, Hash* last_hash);
+
+  // Returns true while the table is being rebuilt from history or resized in
+  // the background. The current table is still used for lookups, but it will
+  // be replaced and written out as a whole, so changes are not written to
+  // disk.
+  bool IsReplacingTable() const {
+    return table_builder_ || table_resizer_;
+  }
 
   // File I/O functions
   // ------------------
@@ -223,8 +238,26 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // Called to add a fingerprint to the table. If |send_notifications| is true
   // and the item is added successfully, Listener::Add will be invoked.
   // Returns the index of the inserted fingerprint or null_hash_ if there was a
-  // duplicate and this item was skippped.
-  Hash AddFingerprint(Fingerprint fingerprint, bool send_notifications);
+  // duplicate and this item was skippped. The entries after the inserted one
+  // may be moved over by one to keep the runs sorted, |last_hash| is set to
+  // the last index that changed.
+  Hash AddFingerprint(Fingerprint fingerprint,
+                      bool send_notifications,
+                      Hash* last_hash);
+  Hash AddFingerprint(Fingerprint fingerprint, bool send_notifications) {
+    Hash last_hash;
+    return AddFingerprint(fingerprint, send_notifications, &last_hash);
+  }
+
+  // Inserts |fingerprint| into |hash_table|, moving the following entries of
+  // its run over by one as needed. This is the table manipulation part of
+  // AddFingerprint, which can also be used on a table being built on another
+  // thread. Returns the index of the inserted fingerprint and sets
+  // |last_hash| like AddFingerprint.
+  static Hash InsertFingerprint(Fingerprint* hash_table,
+                                int32 table_length,
+                                Fingerprint fingerprint,
+                                Hash* last_hash);
 
   // Deletes all fingerprints from the given vector from the current hash table
   // and syncs it to disk if there are changes. This does not update the
@@ -233,9 +266,10 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   void DeleteFingerprintsFromCurrentTable(
       const std::set<Fingerprint>& fingerprints);
 
-  // Removes the indicated fingerprint from the table. If the update_file flag
-  // is set, the changes will also be written to disk. Returns true if the
-  // fingerprint was deleted, false if it was not in the table to delete.
+  // Removes the indicated fingerprint from the table, moving the following
+  // entries of its run back by one. If the update_file flag is set, the
+  // changes will also be written to disk. Returns true if the fingerprint was
+  // deleted, false if it was not in the table to delete.
   bool DeleteFingerprint(Fingerprint fingerprint, bool update_file);
 
   // Creates a new empty table, call if InitFromFile() fails. Normally, when
@@ -252,6 +286,21 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // a file).
   bool CreateURLTable(int32 num_entries, bool init_to_empty);
 
+  // Allocates and maps the shared memory for a table of |num_entries|, and
+  // fills in its header. The table itself is zeroed if |init_to_empty| is
+  // set. Returns NULL on failure. This doesn't touch the members so that it
+  // can be called on another thread.
+  static base::SharedMemory* CreateSharedTable(
+      int32 num_entries,
+      const uint8 salt[LINK_SALT_LENGTH],
+      bool init_to_empty);
+
+  // Returns the table following the header in |shared_memory|.
+  static Fingerprint* TableFromSharedMemory(base::SharedMemory* shared_memory) {
+    return reinterpret_cast<Fingerprint*>(
+        static_cast<char*>(shared_memory->memory()) + sizeof(SharedHeader));
+  }
+
   // A wrapper for CreateURLTable, this will allocate a new table, initialized
   // to empty. The caller is responsible for saving the shared memory pointer
   // and handles before this call (they will be replaced with new ones) and
@@ -272,9 +321,19 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   bool ResizeTableIfNecessary();
 
   // Resizes the table (growing or shrinking) as necessary to accomodate the
-  // current count.
+  // current count. When there is a file thread, the new table is built there
+  // from a copy of the current fingerprints, and replaces the current table
+  // in OnTableResizeComplete.
   void ResizeTable(int32 new_size);
 
+  // Callback that the table resizer uses when the new table is built.
+  // |shared_memory| holds the new table of |table_length| entries, of which
+  // |used_count| are used. It is NULL if the resize failed. This object takes
+  // ownership of it.
+  void OnTableResizeComplete(base::SharedMemory* shared_memory,
+                             int32 table_length,
+                             int32 used_count);
+
   // Returns the desired table size for |item_count| URLs.
   uint32 NewTableSizeForCount(int32 item_count) const;
 
@@ -338,7 +397,13 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // history query is running. We must only delete it when the query is done.
   scoped_refptr<TableBuilder> table_builder_;
 
-  // Indicates URLs added and deleted since we started rebuilding the table.
+  // When non-NULL, indicates we are resizing the table on the file thread and
+  // points to the class building the new table. Like the table builder, it
+  // must remain valid until the file thread is done with it.
+  scoped_refptr<TableResizer> table_resizer_;
+
+  // Indicates URLs added and deleted since we started rebuilding or resizing
+  // the table.
   std::set<Fingerprint> added_since_rebuild_;
   std::set<Fingerprint> deleted_since_rebuild_;
 
@@ -22,6 +22,8 @@ namespace {
 // how we generate URLs, note that the two strings should be the same length
 const int add_count = 10000;
 const int load_test_add_count = 250000;
+const int large_test_add_count = 1200000;
+const int large_test_batch_count = 100000;
 const char added_prefix[] = "http://www.google.com/stuff/something/foo?session=85025602345625&id=1345142319023&seq=";
 const char unadded_prefix[] = "http://www.google.org/stuff/something/foo?session=39586739476365&id=2347624314402&seq=";
 
@@ -69,6 +71,29 @@ void FillTable(VisitedLinkMaster& master, const char* prefix,
     master.AddURL(TestURL(prefix, i));
 }
 
+// Computes the fingerprints of the URLs starting with the given prefix and
+// within the given range, so that lookups can be timed on their own.
+void ComputeFingerprints(const VisitedLinkMaster& master, const char* prefix,
+                         int begin, int end,
+                         VisitedLinkCommon::Fingerprints* fingerprints) {
+  for (int i = begin; i < end; i++) {
+    std::string url = StringPrintf("%s%d", prefix, i);
+    fingerprints->push_back(
+        master.ComputeURLFingerprint(url.data(), url.size()));
+  }
+}
+
+// Returns how many of |fingerprints| the master has.
+int CountVisited(const VisitedLinkMaster& master,
+                 const VisitedLinkCommon::Fingerprints& fingerprints) {
+  int count = 0;
+  for (size_t i = 0; i < fingerprints.size(); i++) {
+    if (master.IsVisited(fingerprints[i]))
+      count++;
+  }
+  return count;
+}
+
 class VisitedLink : public testing::Test {
  protected:
   std::wstring db_name_;
@@ -115,6 +140,41 @@ TEST_F(VisitedLink, TestAddAndQuery) {
   CheckVisited(master, unadded_prefix, 0, add_count);
 }
 
+// Tests lookups in a table of over a million URLs, which is grown through all
+// of the resizes on the way. The fingerprints are computed up front so that
+// only the hash table is timed.
+TEST_F(VisitedLink, TestLargeTableQuery) {
+  VisitedLinkMaster master(NULL, DummyVisitedLinkEventListener::GetInstance(),
+                           NULL, true, FilePath(db_name_), 0);
+  ASSERT_TRUE(master.Init());
+
+  PerfTimeLogger fill_timer("Visited_link_large_table_fill");
+  for (int i = 0; i < large_test_add_count; i += large_test_batch_count) {
+    std::vector<GURL> urls;
+    for (int j = i; j < i + large_test_batch_count; j++)
+      urls.push_back(TestURL(added_prefix, j));
+    master.AddURLs(urls);
+  }
+  fill_timer.Done();
+  ASSERT_EQ(large_test_add_count, master.GetUsedCount());
+
+  VisitedLinkCommon::Fingerprints added;
+  VisitedLinkCommon::Fingerprints unadded;
+  ComputeFingerprints(master, added_prefix, 0, large_test_add_count, &added);
+  ComputeFingerprints(master, unadded_prefix, 0, large_test_add_count,
+                      &unadded);
+
+  PerfTimeLogger visited_timer("Visited_link_large_table_query_visited");
+  int visited_count = CountVisited(master, added);
+  visited_timer.Done();
+  EXPECT_EQ(large_test_add_count, visited_count);
+
+  PerfTimeLogger unvisited_timer("Visited_link_large_table_query_unvisited");
+  int unvisited_count = CountVisited(master, unadded);
+  unvisited_timer.Done();
+  EXPECT_EQ(0, unvisited_count);
+}
+
 // Tests how long it takes to write and read a large database to and from disk.
 TEST_F(VisitedLink, TestLoad) {
   // create a big DB
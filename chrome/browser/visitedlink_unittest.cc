@@ -12,6 +12,7 @@
 #include "base/process_util.h"
 #include "base/shared_memory.h"
 #include "base/string_util.h"
+#include "base/thread.h"
 #include "chrome/browser/visitedlink_master.h"
 #include "chrome/browser/visitedlink_event_listener.h"
 #include "chrome/browser/renderer_host/browser_render_process_host.h"
@@ -35,6 +36,20 @@ GURL TestURL(int i) {
 
 std::vector<VisitedLinkSlave*> g_slaves;
 
+// Quits the given message loop. This is posted to the file thread to wait
+// for the tasks posted there before it.
+class QuitLoopTask : public Task {
+ public:
+  explicit QuitLoopTask(MessageLoop* loop) : loop_(loop) {}
+
+  virtual void Run() {
+    loop_->PostTask(FROM_HERE, new MessageLoop::QuitTask);
+  }
+
+ private:
+  MessageLoop* loop_;
+};
+
 }  // namespace
 
 class TrackingVisitedLinkEventListener : public VisitedLinkMaster::Listener {
@@ -232,6 +247,54 @@ TEST_F(VisitedLinkTest, Delete) {
         "Hash table has values in it.";
 }
 
+// Records whether a URL is visited when the listener is reset.
+class ResetCheckingListener : public TrackingVisitedLinkEventListener {
+ public:
+  explicit ResetCheckingListener(const GURL& url)
+      : url_(url),
+        master_(NULL),
+        visited_at_reset_(true) {
+  }
+
+  virtual void Reset() {
+    TrackingVisitedLinkEventListener::Reset();
+    visited_at_reset_ = master_->IsVisited(url_);
+  }
+
+  void set_master(VisitedLinkMaster* master) { master_ = master; }
+  bool visited_at_reset() const { return visited_at_reset_; }
+
+ private:
+  const GURL url_;
+  VisitedLinkMaster* master_;
+  bool visited_at_reset_;
+};
+
+// Renderers read the table without a lock, and a lookup which is under way
+// when the entries after a deleted one move back can miss an entry.  Checks
+// that the listener is only reset once the table is final, so that the
+// renderers check their links again.
+TEST_F(VisitedLinkTest, ResetAfterDeletion) {
+  ASSERT_TRUE(InitHistory());
+
+  const GURL deleted_url(TestURL(0));
+  ResetCheckingListener listener(deleted_url);
+  VisitedLinkMaster master(NULL, &listener, history_service_, true,
+                           history_dir_.Append(FILE_PATH_LITERAL("Reset")),
+                           0);
+  listener.set_master(&master);
+  ASSERT_TRUE(master.Init());
+  master.AddURL(deleted_url);
+  master.AddURL(TestURL(1));
+
+  std::set<GURL> deleted_urls;
+  deleted_urls.insert(deleted_url);
+  master.DeleteURLs(deleted_urls);
+  EXPECT_EQ(1, listener.reset_count());
+  EXPECT_FALSE(listener.visited_at_reset());
+  EXPECT_TRUE(master.IsVisited(TestURL(1)));
+}
+
 // When we delete more than kBigDeleteThreshold we trigger different behavior
 // where the entire file is rewritten.
 TEST_F(VisitedLinkTest, BigDelete) {
@@ -354,6 +417,65 @@ TEST_F(VisitedLinkTest, Resizing) {
   Reload();
 }
 
+// Tests resizing the table on a file thread while URLs are being added and
+// deleted.
+TEST_F(VisitedLinkTest, ResizeOnFileThread) {
+  base::Thread file_thread("VisitedLinkTestFileThread");
+  ASSERT_TRUE(file_thread.Start());
+
+  // Create a very small database so that it is resized a few times.
+  ASSERT_TRUE(InitHistory());
+  master_.reset(new VisitedLinkMaster(&file_thread, &listener_,
+                                      history_service_, true, visited_file_,
+                                      17));
+  ASSERT_TRUE(master_->Init());
+
+  VisitedLinkSlave slave;
+  base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
+  master_->ShareToProcess(base::GetCurrentProcessHandle(), &new_handle);
+  ASSERT_TRUE(slave.Init(new_handle));
+  g_slaves.push_back(&slave);
+
+  // The URLs are visited as soon as they are added, even while the new table
+  // is being built. Every other one is deleted again.
+  for (int i = 0; i < g_test_count; i++) {
+    master_->AddURL(TestURL(i));
+    master_->AddURL(TestURL(g_test_count + i));
+    std::set<GURL> deleted_urls;
+    deleted_urls.insert(TestURL(g_test_count + i));
+    master_->DeleteURLs(deleted_urls);
+    EXPECT_TRUE(master_->IsVisited(TestURL(i)));
+    EXPECT_FALSE(master_->IsVisited(TestURL(g_test_count + i)));
+  }
+
+  // Wait for the pending resizes. Each one may start another one when it
+  // completes.
+  while (master_->table_resizer_.get()) {
+    file_thread.message_loop()->PostTask(FROM_HERE,
+        new QuitLoopTask(MessageLoop::current()));
+    MessageLoop::current()->Run();
+  }
+  master_->DebugValidate();
+  ASSERT_EQ(g_test_count, master_->GetUsedCount());
+
+  // The slave has the final table.
+  int32 table_size;
+  VisitedLinkCommon::Fingerprint* table;
+  master_->GetUsageStatistics(&table_size, &table);
+  int32 child_table_size;
+  VisitedLinkCommon::Fingerprint* child_table;
+  slave.GetUsageStatistics(&child_table_size, &child_table);
+  ASSERT_EQ(table_size, child_table_size);
+  for (int32 i = 0; i < table_size; i++)
+    ASSERT_EQ(table[i], child_table[i]);
+  g_slaves.clear();
+
+  // Let the file thread finish writing before reading the file back.
+  master_.reset(NULL);
+  file_thread.Stop();
+  Reload();
+}
+
 // Tests that if the database doesn't exist, it will be rebuilt from history.
 TEST_F(VisitedLinkTest, Rebuild) {
   ASSERT_TRUE(InitHistory());
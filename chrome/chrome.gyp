@@ -1132,6 +1132,8 @@
         'browser/history/in_memory_database.h',
         'browser/history/in_memory_history_backend.cc',
         'browser/history/in_memory_history_backend.h',
+        'browser/history/in_memory_url_index.cc',
+        'browser/history/in_memory_url_index.h',
         'browser/history/page_usage_data.cc',
         'browser/history/page_usage_data.h',
         'browser/history/query_parser.cc',
@@ -1380,6 +1382,8 @@
         'browser/safe_browsing/bloom_filter.h',
         'browser/safe_browsing/chunk_range.cc',
         'browser/safe_browsing/chunk_range.h',
+        'browser/safe_browsing/prefix_set.cc',
+        'browser/safe_browsing/prefix_set.h',
         'browser/safe_browsing/protocol_manager.cc',
         'browser/safe_browsing/protocol_manager.h',
         'browser/safe_browsing/protocol_parser.cc',
@@ -3538,6 +3542,7 @@
         'browser/history/history_querying_unittest.cc',
         'browser/history/history_types_unittest.cc',
         'browser/history/history_unittest.cc',
+        'browser/history/in_memory_url_index_unittest.cc',
         'browser/history/query_parser_unittest.cc',
         'browser/history/snippet_unittest.cc',
         'browser/history/starred_url_database_unittest.cc',
@@ -3587,6 +3592,7 @@
         'browser/rlz/rlz_unittest.cc',
         'browser/safe_browsing/bloom_filter_unittest.cc',
         'browser/safe_browsing/chunk_range_unittest.cc',
+        'browser/safe_browsing/prefix_set_unittest.cc',
         'browser/safe_browsing/protocol_manager_unittest.cc',
         'browser/safe_browsing/protocol_parser_unittest.cc',
         'browser/safe_browsing/safe_browsing_blocking_page_unittest.cc',
@@ -4126,10 +4132,13 @@
             '../webkit/webkit.gyp:glue',
           ],
           'sources': [
+            'browser/history/in_memory_url_index_perftest.cc',
+            'browser/renderer_host/resource_dispatcher_host_perftest.cc',
             'browser/safe_browsing/database_perftest.cc',
             'browser/safe_browsing/filter_false_positive_perftest.cc',
             'browser/visitedlink_perftest.cc',
             'common/json_value_serializer_perftest.cc',
+            'common/net/cookie_monster_sqlite_perftest.cc',
             'test/perf/perftests.cc',
             'test/perf/url_parse_perftest.cc',
           ],
@@ -269,6 +269,10 @@ const wchar_t kWinHttpProxyResolver[]          = L"winhttp-proxy-resolver";
 extern const wchar_t kDnsLogDetails[]          = L"dns-log-details";
 extern const wchar_t kDnsPrefetchDisable[]     = L"dns-prefetch-disable";
 
+// Don't connect sockets ahead of time to the hosts that the DNS prefetching
+// expects a navigation to need.
+const wchar_t kDnsPreconnectDisable[]          = L"dns-preconnect-disable";
+
 // Enables support to debug printing subsystem.
 const wchar_t kDebugPrint[]                    = L"debug-print";
 
@@ -307,6 +311,9 @@ const wchar_t kMemoryModel[]                   = L"memory-model";
 // testing, for example page cycler and layout tests.  See bug 1157243.
 const wchar_t kEnableFileCookies[]             = L"enable-file-cookies";
 
+// Pipeline idempotent HTTP requests on keep-alive connections.
+const wchar_t kEnableHttpPipelining[]          = L"enable-http-pipelining";
+
 // Start the browser maximized, regardless of any previous settings.
 const wchar_t kStartMaximized[]                = L"start-maximized";
 
@@ -546,4 +553,14 @@ const wchar_t kRendererCrashDump[] = L"renderer-crash-dumping";
 // Enables the new Tabstrip on Windows.
 const wchar_t kEnableTabtastic2[] = L"enable-tabtastic2";
 
+// Resolves hostnames by sending the DNS queries from the IO thread, instead of
+// calling getaddrinfo() on worker threads.  The answers are cached for the TTL
+// of their records.  Only supported on Linux now.
+const wchar_t kEnableAsyncDns[] = L"enable-async-dns";
+
+// Indexes the words of the typed URLs in memory, so that the omnibox also
+// suggests the URLs which contain what the user typed, not only the ones
+// starting with it.
+const wchar_t kEnableInMemoryURLIndex[] = L"enable-in-memory-url-index";
+
 }  // namespace switches
@@ -91,6 +91,7 @@ extern const wchar_t kPrint[];
 
 extern const wchar_t kDnsLogDetails[];
 extern const wchar_t kDnsPrefetchDisable[];
+extern const wchar_t kDnsPreconnectDisable[];
 
 extern const wchar_t kAllowAllActiveX[];
 
@@ -103,6 +104,7 @@ extern const wchar_t kMemoryProfiling[];
 extern const wchar_t kMemoryModel[];
 
 extern const wchar_t kEnableFileCookies[];
+extern const wchar_t kEnableHttpPipelining[];
 
 extern const wchar_t kStartMaximized[];
 
@@ -210,6 +212,10 @@ extern const wchar_t kRendererCrashDump[];
 
 extern const wchar_t kEnableTabtastic2[];
 
+extern const wchar_t kEnableAsyncDns[];
+
+extern const wchar_t kEnableInMemoryURLIndex[];
+
 }  // namespace switches
 
 #endif  // CHROME_COMMON_CHROME_SWITCHES_H_
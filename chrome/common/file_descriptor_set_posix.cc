@@ -4,6 +4,9 @@
 
 #include "chrome/common/file_descriptor_set_posix.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "base/eintr_wrapper.h"
 #include "base/logging.h"
 
@@ -12,6 +15,12 @@ FileDescriptorSet::FileDescriptorSet()
 }
 
 FileDescriptorSet::~FileDescriptorSet() {
+  for (std::map<unsigned, std::string>::const_iterator
+       i = read_data_.begin(); i != read_data_.end(); ++i) {
+    if (i->first < descriptors_.size() && descriptors_[i->first].auto_close)
+      HANDLE_EINTR(close(descriptors_[i->first].fd));
+  }
+
   if (consumed_descriptor_highwater_ == descriptors_.size())
     return;
 
@@ -26,7 +35,7 @@ FileDescriptorSet::~FileDescriptorSet() {
   // kernel resources.
   for (unsigned i = consumed_descriptor_highwater_;
        i < descriptors_.size(); ++i) {
-    if (descriptors_[i].auto_close)
+    if (descriptors_[i].auto_close && read_data_.count(i) == 0)
       HANDLE_EINTR(close(descriptors_[i].fd));
   }
 }
@@ -87,6 +96,37 @@ int FileDescriptorSet::GetDescriptorAt(unsigned index) const {
   return descriptors_[index].fd;
 }
 
+const char* FileDescriptorSet::ReadDataAt(unsigned index, size_t size) const {
+  const int fd = GetDescriptorAt(index);
+  if (fd < 0)
+    return NULL;
+
+  std::map<unsigned, std::string>::const_iterator i = read_data_.find(index);
+  if (i != read_data_.end())
+    return i->second.size() == size ? i->second.data() : NULL;
+
+  // Check the size of the file before allocating the buffer, so that a bogus
+  // size can't exhaust our memory.
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      static_cast<size_t>(st.st_size) < size)
+    return NULL;
+
+  std::string data(size, '\0');
+  size_t bytes_read = 0;
+  while (bytes_read < size) {
+    const ssize_t result = HANDLE_EINTR(pread(fd, &data[bytes_read],
+                                              size - bytes_read, bytes_read));
+    if (result <= 0)
+      return NULL;
+    bytes_read += result;
+  }
+
+  std::string& stored = read_data_[index];
+  stored.swap(data);
+  return stored.data();
+}
+
 void FileDescriptorSet::GetDescriptors(int* buffer) const {
   for (std::vector<base::FileDescriptor>::const_iterator
        i = descriptors_.begin(); i != descriptors_.end(); ++i) {
@@ -5,6 +5,8 @@
 #ifndef CHROME_COMMON_FILE_DESCRIPTOR_SET_POSIX_H_
 #define CHROME_COMMON_FILE_DESCRIPTOR_SET_POSIX_H_
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -60,6 +62,13 @@ class FileDescriptorSet : public base::RefCountedThreadSafe<FileDescriptorSet> {
   // support close flags.
   //   returns: file descriptor, or -1 on error
   int GetDescriptorAt(unsigned n) const;
+  // Read the first |size| bytes of the shared memory file of the nth
+  // descriptor, with the same ordering rules as GetDescriptorAt. The file is
+  // read with one copy rather than mapped, since its sender can still shrink
+  // it. The set keeps the data, and the descriptor, until it is destroyed,
+  // so that a message which is parsed again gets the same data.
+  //   returns: the data, or NULL on error
+  const char* ReadDataAt(unsigned n, size_t size) const;
 
   // ---------------------------------------------------------------------------
 
@@ -102,6 +111,10 @@ class FileDescriptorSet : public base::RefCountedThreadSafe<FileDescriptorSet> {
   // can check that they are read in order.
   mutable unsigned consumed_descriptor_highwater_;
 
+  // The data read by ReadDataAt, by descriptor index. Nobody else takes these
+  // descriptors, so the set closes them unless they were transmitted.
+  mutable std::map<unsigned, std::string> read_data_;
+
   DISALLOW_COPY_AND_ASSIGN(FileDescriptorSet);
 };
 
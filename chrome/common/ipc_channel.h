@@ -43,8 +43,12 @@ class Channel : public Message::Sender {
     // message of this size or bigger results in a channel error.
     kMaximumMessageSize = 256 * 1024 * 1024,
 
-    // Ammount of data to read at once from the pipe.
-    kReadBufferSize = 4 * 1024
+    // Ammount of data to read at once from the pipe.  On POSIX, this is the
+    // initial size of the read buffer, which grows while reads fill it.
+    kReadBufferSize = 4 * 1024,
+
+    // The size the POSIX read buffer grows to at most.
+    kMaximumReadBufferSize = 64 * 1024
   };
 
   // Initialize a Channel.
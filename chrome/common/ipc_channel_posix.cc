@@ -34,6 +34,13 @@
 
 namespace IPC {
 
+namespace {
+
+// The maximum number of queued messages that are written with one sendmsg().
+const size_t kMaxMessagesPerWrite = 64;
+
+}  // namespace
+
 // IPC channels on Windows use named pipes (CreateNamedPipe()) with
 // channel ids as the pipe names.  Channels on POSIX use anonymous
 // Unix domain sockets created via socketpair() as pipes.  These don't
@@ -256,6 +263,7 @@ Channel::ChannelImpl::ChannelImpl(const std::string& channel_id, Mode mode,
       pipe_(-1),
       client_pipe_(-1),
       listener_(listener),
+      input_buf_(Channel::kReadBufferSize),
       waiting_connect_(true),
       processing_incoming_(false),
       factory_(this) {
@@ -352,7 +360,7 @@ bool Channel::ChannelImpl::CreatePipe(const std::string& channel_id,
     return false;
   }
 
-  output_queue_.push(msg.release());
+  output_queue_.push_back(msg.release());
   return true;
 }
 
@@ -389,7 +397,7 @@ bool Channel::ChannelImpl::ProcessIncomingMessages() {
   ssize_t bytes_read = 0;
 
   struct msghdr msg = {0};
-  struct iovec iov = {input_buf_, Channel::kReadBufferSize};
+  struct iovec iov;
 
   msg.msg_iov = &iov;
   msg.msg_iovlen = 1;
@@ -402,6 +410,9 @@ bool Channel::ChannelImpl::ProcessIncomingMessages() {
       if (pipe_ == -1)
         return false;
 
+      iov.iov_base = &input_buf_[0];
+      iov.iov_len = input_buf_.size();
+
       // Read from pipe.
       // recvmsg() returns 0 if the connection has closed or EAGAIN if no data
       // is waiting on the pipe.
@@ -481,7 +492,7 @@ bool Channel::ChannelImpl::ProcessIncomingMessages() {
     const char *p;
     const char *end;
     if (input_overflow_buf_.empty()) {
-      p = input_buf_;
+      p = &input_buf_[0];
       end = p + bytes_read;
     } else {
       if (input_overflow_buf_.size() >
@@ -490,7 +501,7 @@ bool Channel::ChannelImpl::ProcessIncomingMessages() {
         LOG(ERROR) << "IPC message is too big";
         return false;
       }
-      input_overflow_buf_.append(input_buf_, bytes_read);
+      input_overflow_buf_.append(&input_buf_[0], bytes_read);
       p = input_overflow_buf_.data();
       end = p + input_overflow_buf_.size();
     }
@@ -580,6 +591,13 @@ bool Channel::ChannelImpl::ProcessIncomingMessages() {
       return false;
     }
 
+    // A read that fills the buffer likely left more messages in the pipe.
+    if (static_cast<size_t>(bytes_read) == input_buf_.size() &&
+        input_buf_.size() <
+            static_cast<size_t>(Channel::kMaximumReadBufferSize)) {
+      input_buf_.resize(input_buf_.size() * 2);
+    }
+
     bytes_read = 0;  // Get more data.
   }
 
@@ -598,19 +616,31 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
     return false;
 
   // Write out all the messages we can till the write blocks or there are no
-  // more outgoing messages.
+  // more outgoing messages.  Queued messages are written together, except
+  // that only the first message of a write may have descriptors.
   while (!output_queue_.empty()) {
     Message* msg = output_queue_.front();
 
-    size_t amt_to_write = msg->size() - message_send_bytes_written_;
-    DCHECK(amt_to_write != 0);
-    const char *out_bytes = reinterpret_cast<const char*>(msg->data()) +
-        message_send_bytes_written_;
+    struct iovec iov[kMaxMessagesPerWrite];
+    size_t num_iov = 0;
+    size_t amt_to_write = 0;
+    for (std::deque<Message*>::const_iterator i = output_queue_.begin();
+         i != output_queue_.end() && num_iov < kMaxMessagesPerWrite; ++i) {
+      if (num_iov > 0 && !(*i)->file_descriptor_set()->empty())
+        break;
+      const size_t offset = num_iov == 0 ? message_send_bytes_written_ : 0;
+      const char *out_bytes = reinterpret_cast<const char*>((*i)->data()) +
+          offset;
+      iov[num_iov].iov_base = const_cast<char*>(out_bytes);
+      iov[num_iov].iov_len = (*i)->size() - offset;
+      DCHECK(iov[num_iov].iov_len != 0);
+      amt_to_write += iov[num_iov].iov_len;
+      num_iov++;
+    }
 
     struct msghdr msgh = {0};
-    struct iovec iov = {const_cast<char*>(out_bytes), amt_to_write};
-    msgh.msg_iov = &iov;
-    msgh.msg_iovlen = 1;
+    msgh.msg_iov = iov;
+    msgh.msg_iovlen = num_iov;
     char buf[CMSG_SPACE(
         sizeof(int[FileDescriptorSet::MAX_DESCRIPTORS_PER_MESSAGE]))];
 
@@ -651,12 +681,29 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
       return false;
     }
 
-    if (static_cast<size_t>(bytes_written) != amt_to_write) {
-      if (bytes_written > 0) {
-        // If write() fails with EAGAIN then bytes_written will be -1.
-        message_send_bytes_written_ += bytes_written;
+    // Drop the messages that were completely written, and keep track of how
+    // far we got in the first one that was not.
+    size_t bytes_left = bytes_written > 0 ? bytes_written : 0;
+    while (bytes_left > 0) {
+      msg = output_queue_.front();
+      const size_t msg_bytes_left = msg->size() - message_send_bytes_written_;
+      if (bytes_left < msg_bytes_left) {
+        message_send_bytes_written_ += bytes_left;
+        break;
       }
+      bytes_left -= msg_bytes_left;
+      message_send_bytes_written_ = 0;
 
+      // Message sent OK!
+#ifdef IPC_MESSAGE_DEBUG_EXTRA
+      DLOG(INFO) << "sent message @" << msg << " on channel @" << this <<
+                    " with type " << msg->type();
+#endif
+      output_queue_.pop_front();
+      delete msg;
+    }
+
+    if (static_cast<size_t>(bytes_written) != amt_to_write) {
       // Tell libevent to call us back once things are unblocked.
       is_blocked_on_write_ = true;
       MessageLoopForIO::current()->WatchFileDescriptor(
@@ -666,16 +713,6 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
           &write_watcher_,
           this);
       return true;
-    } else {
-      message_send_bytes_written_ = 0;
-
-      // Message sent OK!
-#ifdef IPC_MESSAGE_DEBUG_EXTRA
-      DLOG(INFO) << "sent message @" << msg << " on channel @" << this <<
-                    " with type " << msg->type();
-#endif
-      output_queue_.pop();
-      delete msg;
     }
   }
   return true;
@@ -693,7 +730,7 @@ bool Channel::ChannelImpl::Send(Message* message) {
   Logging::current()->OnSendMessage(message, "");
 #endif
 
-  output_queue_.push(message);
+  output_queue_.push_back(message);
   if (!waiting_connect_) {
     if (!is_blocked_on_write_) {
       if (!ProcessOutgoingMessages())
@@ -793,7 +830,7 @@ void Channel::ChannelImpl::Close() {
 
   while (!output_queue_.empty()) {
     Message* m = output_queue_.front();
-    output_queue_.pop();
+    output_queue_.pop_front();
     delete m;
   }
 
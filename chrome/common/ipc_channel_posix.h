@@ -9,7 +9,7 @@
 
 #include <sys/socket.h>  // for CMSG macros
 
-#include <queue>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -90,14 +90,19 @@ class Channel::ChannelImpl : public MessageLoopForIO::Watcher {
   Listener* listener_;
 
   // Messages to be sent are queued here.
-  std::queue<Message*> output_queue_;
+  std::deque<Message*> output_queue_;
 
-  // We read from the pipe into this buffer
-  char input_buf_[Channel::kReadBufferSize];
+  // We read from the pipe into this buffer.  It starts at kReadBufferSize
+  // bytes, and doubles up to kMaximumReadBufferSize each time a read fills
+  // it, so that one read can drain a burst of messages.
+  std::vector<char> input_buf_;
 
   enum {
     // We assume a worst case: kReadBufferSize bytes of messages, where each
-    // message has no payload and a full complement of descriptors.
+    // message has no payload and a full complement of descriptors.  This is
+    // still plenty once the read buffer has grown: recvmsg() does not return
+    // the descriptors of more than one sendmsg(), and we send those of one
+    // message at most with each sendmsg().
     MAX_READ_FDS = (Channel::kReadBufferSize / sizeof(IPC::Message::Header)) *
                    FileDescriptorSet::MAX_DESCRIPTORS_PER_MESSAGE,
   };
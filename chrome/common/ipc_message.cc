@@ -4,15 +4,64 @@
 
 #include "chrome/common/ipc_message.h"
 
+#if defined(OS_POSIX)
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "base/logging.h"
 #include "build/build_config.h"
+#include "chrome/common/ipc_channel.h"
 
 #if defined(OS_POSIX)
+#include "base/eintr_wrapper.h"
+#include "base/file_descriptor_posix.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
 #include "chrome/common/file_descriptor_set_posix.h"
 #endif
 
 namespace IPC {
 
+namespace {
+
+// Data larger than this is passed in shared memory by WriteLargeData.
+const int kLargeDataThreshold = 64 * 1024;
+
+// Written by WriteLargeData in place of the length of data in shared memory.
+const int kSharedMemoryDataMarker = -1;
+
+#if defined(OS_POSIX)
+// Returns a descriptor of an unlinked shared memory file which holds a copy of
+// |data|, or -1 on error.
+int CreateSharedMemoryCopy(const char* data, int length) {
+  FilePath path;
+  FILE* fp = file_util::CreateAndOpenTemporaryShmemFile(&path);
+  if (!fp)
+    return -1;
+  file_util::Delete(path, false);
+  const int fd = dup(fileno(fp));
+  file_util::CloseFile(fp);
+  if (fd < 0)
+    return -1;
+
+  if (HANDLE_EINTR(ftruncate(fd, length)) == 0) {
+    void* memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                        0);
+    if (memory != MAP_FAILED) {
+      memcpy(memory, data, length);
+      munmap(memory, length);
+      return fd;
+    }
+  }
+  HANDLE_EINTR(close(fd));
+  return -1;
+}
+#endif
+
+}  // namespace
+
 //------------------------------------------------------------------------------
 
 Message::~Message() {
@@ -86,6 +135,50 @@ void Message::set_received_time(int64 time) const {
 }
 #endif
 
+bool Message::WriteLargeData(const char* data, int length) {
+#if defined(OS_POSIX)
+  if (length > kLargeDataThreshold &&
+      file_descriptor_set()->size() <
+          FileDescriptorSet::MAX_DESCRIPTORS_PER_MESSAGE) {
+    const int fd = CreateSharedMemoryCopy(data, length);
+    if (fd >= 0) {
+      return WriteInt(kSharedMemoryDataMarker) && WriteInt(length) &&
+             WriteFileDescriptor(base::FileDescriptor(fd, true));
+    }
+  }
+#endif
+  return WriteData(data, length);
+}
+
+bool Message::ReadLargeData(void** iter, const char** data,
+                            int* length) const {
+  int length_or_marker;
+  if (!ReadInt(iter, &length_or_marker))
+    return false;
+  if (length_or_marker >= 0) {
+    *length = length_or_marker;
+    return ReadBytes(iter, data, *length);
+  }
+
+#if defined(OS_POSIX)
+  int shared_length;
+  int descriptor_index;
+  if (length_or_marker != kSharedMemoryDataMarker ||
+      !ReadInt(iter, &shared_length) || shared_length <= 0 ||
+      shared_length > Channel::kMaximumMessageSize ||
+      !ReadInt(iter, &descriptor_index) || descriptor_index < 0 ||
+      !file_descriptor_set_.get()) {
+    return false;
+  }
+
+  *data = file_descriptor_set_->ReadDataAt(descriptor_index, shared_length);
+  *length = shared_length;
+  return *data != NULL;
+#else
+  return false;
+#endif
+}
+
 #if defined(OS_POSIX)
 bool Message::WriteFileDescriptor(const base::FileDescriptor& descriptor) {
   // We write the index of the descriptor so that we don't have to
@@ -165,6 +165,18 @@ class Message : public Pickle {
     return Pickle::FindNext(sizeof(Header), range_start, range_end);
   }
 
+  // Writes a block of data like Pickle::WriteData.  On POSIX, data larger than
+  // 64KB is copied once to an unlinked shared memory file that is passed as a
+  // descriptor, so that it is neither copied into the message nor through the
+  // channel.  If the file can't be created, for instance in a sandbox, the
+  // data is written inline.  Note that ParamTraits<Message> does not carry the
+  // descriptors of a message nested in another one.
+  bool WriteLargeData(const char* data, int length);
+  // Reads data written with WriteLargeData or Pickle::WriteData.  Data in
+  // shared memory is read with one copy, and stays valid as long as the
+  // message.
+  bool ReadLargeData(void** iter, const char** data, int* length) const;
+
 #if defined(OS_POSIX)
   // On POSIX, a message supports reading / writing FileDescriptor objects.
   // This is used to pass a file descriptor to the peer of an IPC channel.
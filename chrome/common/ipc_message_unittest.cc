@@ -93,6 +93,41 @@ TEST(IPCMessageTest, Bitmap) {
   EXPECT_FALSE(IPC::ParamTraits<SkBitmap>::Read(&bad_msg, &iter, &bad_output));
 }
 
+// Tests that large data, which may go through shared memory, can be read
+// back, also more than once.
+TEST(IPCMessageTest, LargeData) {
+  std::vector<char> input(1024 * 1024);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<char>(i % 251);
+
+  IPC::Message msg(1, 2, IPC::Message::PRIORITY_NORMAL);
+  IPC::WriteParam(&msg, input);
+  IPC::WriteParam(&msg, std::vector<char>(10, 'a'));
+#if defined(OS_POSIX)
+  // The data is not in the message itself.
+  EXPECT_LT(msg.size(), static_cast<uint32>(1024));
+#endif
+
+  for (int pass = 0; pass < 2; ++pass) {
+    std::vector<char> output;
+    std::vector<char> small_output;
+    void* iter = NULL;
+    EXPECT_TRUE(IPC::ReadParam(&msg, &iter, &output));
+    EXPECT_TRUE(input == output);
+    EXPECT_TRUE(IPC::ReadParam(&msg, &iter, &small_output));
+    EXPECT_EQ(std::vector<char>(10, 'a'), small_output);
+  }
+
+  // Also test the corrupt case.
+  IPC::Message bad_msg(1, 2, IPC::Message::PRIORITY_NORMAL);
+  bad_msg.WriteInt(-1);
+  bad_msg.WriteInt(1024 * 1024);
+  bad_msg.WriteInt(0);
+  std::vector<char> output;
+  void* iter = NULL;
+  EXPECT_FALSE(IPC::ReadParam(&bad_msg, &iter, &output));
+}
+
 TEST(IPCMessageTest, ListValue) {
   ListValue input;
   input.Set(0, Value::CreateRealValue(42.42));
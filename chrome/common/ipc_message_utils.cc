@@ -68,8 +68,8 @@ void ParamTraits<SkBitmap>::Write(Message* m, const SkBitmap& p) {
                static_cast<int>(fixed_size));
   size_t pixel_size = p.getSize();
   SkAutoLockPixels p_lock(p);
-  m->WriteData(reinterpret_cast<const char*>(p.getPixels()),
-               static_cast<int>(pixel_size));
+  m->WriteLargeData(reinterpret_cast<const char*>(p.getPixels()),
+                    static_cast<int>(pixel_size));
 }
 
 bool ParamTraits<SkBitmap>::Read(const Message* m, void** iter, SkBitmap* r) {
@@ -85,7 +85,7 @@ bool ParamTraits<SkBitmap>::Read(const Message* m, void** iter, SkBitmap* r) {
 
   const char* variable_data;
   int variable_data_size = 0;
-  if (!m->ReadData(iter, &variable_data, &variable_data_size) ||
+  if (!m->ReadLargeData(iter, &variable_data, &variable_data_size) ||
      (variable_data_size < 0)) {
     NOTREACHED();
     return false;
@@ -421,14 +421,14 @@ struct ParamTraits<std::vector<unsigned char> > {
     if (p.size() == 0) {
       m->WriteData(NULL, 0);
     } else {
-      m->WriteData(reinterpret_cast<const char*>(&p.front()),
-                   static_cast<int>(p.size()));
+      m->WriteLargeData(reinterpret_cast<const char*>(&p.front()),
+                        static_cast<int>(p.size()));
     }
   }
   static bool Read(const Message* m, void** iter, param_type* r) {
     const char *data;
     int data_size = 0;
-    if (!m->ReadData(iter, &data, &data_size) || data_size < 0)
+    if (!m->ReadLargeData(iter, &data, &data_size) || data_size < 0)
       return false;
     r->resize(data_size);
     if (data_size)
@@ -448,13 +448,13 @@ struct ParamTraits<std::vector<char> > {
     if (p.size() == 0) {
       m->WriteData(NULL, 0);
     } else {
-      m->WriteData(&p.front(), static_cast<int>(p.size()));
+      m->WriteLargeData(&p.front(), static_cast<int>(p.size()));
     }
   }
   static bool Read(const Message* m, void** iter, param_type* r) {
     const char *data;
     int data_size = 0;
-    if (!m->ReadData(iter, &data, &data_size) || data_size < 0)
+    if (!m->ReadLargeData(iter, &data, &data_size) || data_size < 0)
       return false;
     r->resize(data_size);
     if (data_size)
@@ -45,8 +45,6 @@ const char kFuzzerChannel[] = "F3";
 
 const size_t kLongMessageStringNumBytes = 50000;
 
-#ifndef PERFORMANCE_TEST
-
 void IPCChannelTest::SetUp() {
   MultiProcessTest::SetUp();
 
@@ -131,6 +129,8 @@ base::ProcessHandle IPCChannelTest::SpawnChild(ChildType child_type,
 }
 #endif  // defined(OS_POSIX)
 
+#ifndef PERFORMANCE_TEST
+
 TEST_F(IPCChannelTest, BasicMessageTest) {
   int v1 = 10;
   std::string v2("foobar");
@@ -302,154 +302,232 @@ MULTIPROCESS_TEST_MAIN(RunTestClient) {
   return NULL;
 }
 
+#if defined(OS_POSIX)
+
+// Checks the messages of BurstTest, and quits once they have all arrived.
+class BurstListener : public IPC::Channel::Listener {
+ public:
+  explicit BurstListener(int message_count)
+      : message_count_(message_count),
+        messages_received_(0) {
+  }
+
+  static int PayloadSize(int index) {
+    // Mix small messages with ones larger than the read buffer.
+    return (index * 1237) % 70000;
+  }
+
+  virtual void OnMessageReceived(const IPC::Message& message) {
+    IPC::MessageIterator iter(message);
+    EXPECT_EQ(messages_received_, iter.NextInt());
+    const std::string payload = iter.NextString();
+    EXPECT_EQ(static_cast<size_t>(PayloadSize(messages_received_)),
+              payload.size());
+    EXPECT_EQ(std::string(payload.size(), 'a' + messages_received_ % 26),
+              payload);
+
+    if (++messages_received_ == message_count_)
+      MessageLoop::current()->Quit();
+  }
+
+  virtual void OnChannelError() {
+    ADD_FAILURE() << "channel error after " << messages_received_
+                  << " messages";
+    MessageLoop::current()->Quit();
+  }
+
+  int messages_received() const { return messages_received_; }
+
+ private:
+  int message_count_;
+  int messages_received_;
+};
+
+// Sends many messages before the channel connects, so that they are written
+// together, and in pieces once the socket buffer fills.
+TEST_F(IPCChannelTest, BurstTest) {
+  const int kMessageCount = 500;
+
+  BurstListener server_listener(0);
+  IPC::Channel server(kTestClientChannel, IPC::Channel::MODE_SERVER,
+                      &server_listener);
+  ASSERT_TRUE(server.Connect());
+
+  // In the same process, the client gets a copy of the server's client fd.
+  BurstListener client_listener(kMessageCount);
+  IPC::Channel client(kTestClientChannel, IPC::Channel::MODE_CLIENT,
+                      &client_listener);
+  ASSERT_TRUE(client.Connect());
+
+  for (int i = 0; i < kMessageCount; ++i) {
+    IPC::Message* message = new IPC::Message(0, 2,
+                                             IPC::Message::PRIORITY_NORMAL);
+    message->WriteInt(i);
+    message->WriteString(std::string(BurstListener::PayloadSize(i),
+                                     'a' + i % 26));
+    EXPECT_TRUE(server.Send(message));
+  }
+
+  MessageLoop::current()->Run();
+  EXPECT_EQ(kMessageCount, client_listener.messages_received());
+}
+
+#endif  // defined(OS_POSIX)
+
 #endif  // !PERFORMANCE_TEST
 
 #ifdef PERFORMANCE_TEST
 
 //-----------------------------------------------------------------------------
-// Manually performance test
+// Manual performance test
 //
-//    This test times the roundtrip IPC message cycle. It is enabled with a
-//    special preprocessor define to enable it instead of the standard IPC
-//    unit tests. This works around some funny termination conditions in the
+//    These tests measure the throughput of a channel to a child process that
+//    echoes every message back, in messages and bytes per second.  They are
+//    enabled with a special preprocessor define instead of the standard IPC
+//    unit tests.  This works around some funny termination conditions in the
 //    regular unit tests.
 //
-//    This test is not automated. To test, you will want to vary the message
-//    count and message size in TEST to get the numbers you want.
-//
-//    FIXME(brettw): Automate this test and have it run by default.
+//    Several messages are kept in flight, so that the channel can batch its
+//    writes and reads like it does under load.
 
 // This channel listener just replies to all messages with the exact same
-// message. It assumes each message has one string parameter. When the string
-// "quit" is sent, it will exit.
+// message.  It assumes each message has an int and a string parameter.  When
+// the string "quit" is sent, it will exit.
 class ChannelReflectorListener : public IPC::Channel::Listener {
  public:
-  explicit ChannelReflectorListener(IPC::Channel *channel) :
-    channel_(channel),
-    count_messages_(0),
-    latency_messages_(0) {
-    std::cout << "Reflector up" << std::endl;
-  }
-
-  ~ChannelReflectorListener() {
-    std::cout << "Client Messages: " << count_messages_ << std::endl;
-    std::cout << "Client Latency: " << latency_messages_ << std::endl;
+  explicit ChannelReflectorListener(IPC::Channel* channel)
+      : channel_(channel) {
   }
 
   virtual void OnMessageReceived(const IPC::Message& message) {
-    count_messages_++;
     IPC::MessageIterator iter(message);
-    int time = iter.NextInt();
     int msgid = iter.NextInt();
-    std::string payload = iter.NextString();
-    latency_messages_ += GetTickCount() - time;
+    const std::string payload = iter.NextString();
 
-    // cout << "reflector msg received: " << msgid << endl;
-    if (payload == "quit")
+    if (payload == "quit") {
       MessageLoop::current()->Quit();
+      return;
+    }
 
     IPC::Message* msg = new IPC::Message(0,
                                          2,
                                          IPC::Message::PRIORITY_NORMAL);
-    msg->WriteInt(GetTickCount());
     msg->WriteInt(msgid);
     msg->WriteString(payload);
     channel_->Send(msg);
   }
+
+  virtual void OnChannelError() {
+    MessageLoop::current()->Quit();
+  }
+
  private:
-  IPC::Channel *channel_;
-  int count_messages_;
-  int latency_messages_;
+  IPC::Channel* channel_;
 };
 
+// Sends |msg_count| messages of |msg_size| bytes to the reflector, with
+// |window| of them outstanding at any time.
 class ChannelPerfListener : public IPC::Channel::Listener {
  public:
-  ChannelPerfListener(IPC::Channel* channel, int msg_count, int msg_size) :
-       count_down_(msg_count),
-       channel_(channel),
-       count_messages_(0),
-       latency_messages_(0) {
-    payload_.resize(msg_size);
-    for (int i = 0; i < static_cast<int>(payload_.size()); i++)
-      payload_[i] = 'a';
-    std::cout << "perflistener up" << std::endl;
+  ChannelPerfListener(IPC::Channel* channel, int msg_count, int msg_size,
+                      int window)
+      : channel_(channel),
+        payload_(msg_size, 'a'),
+        msg_count_(msg_count),
+        window_(window),
+        messages_sent_(0),
+        messages_received_(0) {
   }
 
-  ~ChannelPerfListener() {
-    std::cout << "Server Messages: " << count_messages_ << std::endl;
-    std::cout << "Server Latency: " << latency_messages_ << std::endl;
+  void Start() {
+    while (messages_sent_ < msg_count_ && messages_sent_ < window_)
+      SendNext();
   }
 
   virtual void OnMessageReceived(const IPC::Message& message) {
-    count_messages_++;
-    // decode the string so this gets counted in the total time
+    // Decode the string so this gets counted in the total time.
     IPC::MessageIterator iter(message);
-    int time = iter.NextInt();
-    int msgid = iter.NextInt();
-    std::string cur = iter.NextString();
-    latency_messages_ += GetTickCount() - time;
+    EXPECT_EQ(messages_received_, iter.NextInt());
+    EXPECT_EQ(payload_.size(), iter.NextString().size());
 
-    // cout << "perflistener got message" << endl;
-
-    count_down_--;
-    if (count_down_ == 0) {
+    if (++messages_received_ == msg_count_) {
       IPC::Message* msg = new IPC::Message(0,
                                            2,
                                            IPC::Message::PRIORITY_NORMAL);
-      msg->WriteInt(GetTickCount());
-      msg->WriteInt(count_down_);
+      msg->WriteInt(-1);
       msg->WriteString("quit");
       channel_->Send(msg);
-      SetTimer(NULL, 1, 250, (TIMERPROC) PostQuitMessage);
+      MessageLoop::current()->Quit();
       return;
     }
 
+    if (messages_sent_ < msg_count_)
+      SendNext();
+  }
+
+  virtual void OnChannelError() {
+    ADD_FAILURE() << "channel error after " << messages_received_
+                  << " messages";
+    MessageLoop::current()->Quit();
+  }
+
+ private:
+  void SendNext() {
     IPC::Message* msg = new IPC::Message(0,
                                          2,
                                          IPC::Message::PRIORITY_NORMAL);
-    msg->WriteInt(GetTickCount());
-    msg->WriteInt(count_down_);
+    msg->WriteInt(messages_sent_++);
     msg->WriteString(payload_);
     channel_->Send(msg);
   }
 
- private:
-  int count_down_;
+  IPC::Channel* channel_;
   std::string payload_;
-  IPC::Channel *channel_;
-  int count_messages_;
-  int latency_messages_;
+  int msg_count_;
+  int window_;
+  int messages_sent_;
+  int messages_received_;
 };
 
-TEST_F(IPCChannelTest, Performance) {
-  // setup IPC channel
-  IPC::Channel chan(kReflectorChannel, IPC::Channel::MODE_SERVER, NULL);
-  ChannelPerfListener perf_listener(&chan, 10000, 100000);
-  chan.set_listener(&perf_listener);
-  chan.Connect();
+class IPCChannelPerfTest : public IPCChannelTest {
+ protected:
+  // Echoes |msg_count| messages of |msg_size| bytes through a child process,
+  // and logs the number of messages and bytes per second as |test_name|.
+  void RunReflectorTest(const std::string& test_name,
+                        int msg_count, int msg_size) {
+    const int kWindow = 50;
 
-  HANDLE process = SpawnChild(TEST_REFLECTOR, &chan);
-  ASSERT_TRUE(process);
+    IPC::Channel chan(kReflectorChannel, IPC::Channel::MODE_SERVER, NULL);
+    ChannelPerfListener perf_listener(&chan, msg_count, msg_size, kWindow);
+    chan.set_listener(&perf_listener);
+    ASSERT_TRUE(chan.Connect());
 
-  PlatformThread::Sleep(1000);
+    base::ProcessHandle process = SpawnChild(TEST_REFLECTOR, &chan);
+    ASSERT_TRUE(process);
 
-  PerfTimeLogger logger("IPC_Perf");
+    PerfTimer timer;
+    perf_listener.Start();
+    MessageLoop::current()->Run();
+    double seconds = timer.Elapsed().InSecondsF();
 
-  // this initial message will kick-start the ping-pong of messages
-  IPC::Message* message = new IPC::Message(0,
-                                           2,
-                                           IPC::Message::PRIORITY_NORMAL);
-  message->WriteInt(GetTickCount());
-  message->WriteInt(-1);
-  message->WriteString("Hello");
-  chan.Send(message);
+    LogPerfResult((test_name + "_messages").c_str(), msg_count / seconds,
+                  "messages/s");
+    LogPerfResult((test_name + "_bytes").c_str(),
+                  static_cast<double>(msg_count) * msg_size / seconds,
+                  "bytes/s");
 
-  // run message loop
-  MessageLoop::current()->Run();
+    // Cleanup child process.
+    EXPECT_TRUE(base::WaitForSingleProcess(process, 5000));
+    base::CloseProcessHandle(process);
+  }
+};
+
+TEST_F(IPCChannelPerfTest, SmallMessages) {
+  RunReflectorTest("IPC_Perf_small", 100000, 100);
+}
 
-  // cleanup child process
-  WaitForSingleObject(process, 5000);
-  CloseHandle(process);
+TEST_F(IPCChannelPerfTest, LargeMessages) {
+  RunReflectorTest("IPC_Perf_large", 2000, 64 * 1024);
 }
 
 // This message loop bounces all messages back to the sender
@@ -461,7 +539,7 @@ MULTIPROCESS_TEST_MAIN(RunReflector) {
   chan.Connect();
 
   MessageLoop::current()->Run();
-  return true;
+  return 0;
 }
 
 #endif  // PERFORMANCE_TEST
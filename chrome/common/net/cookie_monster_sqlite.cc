@@ -5,10 +5,12 @@
 #include "chrome/common/net/cookie_monster_sqlite.h"
 
 #include <list>
+#include <map>
 
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "base/ref_counted.h"
+#include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/thread.h"
 #include "chrome/common/sqlite_compiled_statement.h"
@@ -16,8 +18,18 @@
 
 using base::Time;
 
+namespace {
+
+typedef std::vector<net::CookieMonster::KeyedCanonicalCookie> KeyedCookieList;
+
+// The host keys of the cookies of each domain.
+typedef std::map<std::string, std::vector<std::string> > DomainKeysMap;
+
+}  // namespace
+
 // This class is designed to be shared between any calling threads and the
-// database thread.  It batches operations and commits them on a timer.
+// database thread.  It batches operations and commits them on a timer.  It
+// also reads the cookies, one domain at a time, on the database thread.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
@@ -35,8 +47,21 @@ class SQLitePersistentCookieStore::Backend
   ~Backend() {
     DCHECK(!db_) << "Close should have already been called.";
     DCHECK(num_pending_ == 0 && pending_.empty());
+    DCHECK(read_domains_.empty());
   }
 
+  // Starts reading the cookies of |domain_keys| on the database thread.  The
+  // content of |domain_keys| is taken.
+  void StartLoading(DomainKeysMap* domain_keys);
+
+  // Hands over the cookies of |domain|, reading them right away if the
+  // database thread did not get to them yet.
+  void LoadCookiesForDomain(const std::string& domain,
+                            KeyedCookieList* cookies);
+
+  // Hands over all the cookies that were not handed over yet.
+  void LoadRemainingCookies(KeyedCookieList* cookies);
+
   // Batch a cookie addition.
   void AddCookie(const std::string& key,
                  const net::CookieMonster::CanonicalCookie& cc);
@@ -85,6 +110,12 @@ class SQLitePersistentCookieStore::Backend
   // Close() executed on the background thread.
   void InternalBackgroundClose();
 
+  // Reads the cookies of the next domain, on the background thread.
+  void LoadNextDomain();
+  // Reads the cookies with the host keys |keys|.  |db_lock_| must be held.
+  void ReadCookies(const std::vector<std::string>& keys,
+                   KeyedCookieList* cookies);
+
   sqlite3* db_;
   MessageLoop* background_loop_;
   SqliteStatementCache* cache_;
@@ -94,6 +125,15 @@ class SQLitePersistentCookieStore::Backend
   PendingOperationsList::size_type num_pending_;
   Lock pending_lock_;  // Guard pending_ and num_pending_
 
+  // The domains whose cookies were not read yet.
+  DomainKeysMap unread_domains_;
+  // The cookies read on the background thread that were not handed over yet.
+  typedef std::map<std::string, KeyedCookieList> DomainCookiesMap;
+  DomainCookiesMap read_domains_;
+  // Guard db_, unread_domains_ and read_domains_, since the cookies of a
+  // domain may be read from the calling thread.
+  Lock db_lock_;
+
   DISALLOW_EVIL_CONSTRUCTORS(Backend);
 };
 
@@ -155,6 +195,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
     num_pending_ = 0;
   }
 
+  AutoLock locked(db_lock_);
   // Maybe an old timer fired or we are already Close()'ed.
   if (!db_ || ops.empty())
     return;
@@ -248,11 +289,127 @@ void SQLitePersistentCookieStore::Backend::InternalBackgroundClose() {
   DCHECK(MessageLoop::current() == background_loop_);
   // Commit any pending operations
   Commit();
+
+  AutoLock locked(db_lock_);
   // We must destroy the cache before closing the database.
   delete cache_;
   cache_ = NULL;
   sqlite3_close(db_);
   db_ = NULL;
+
+  // Drop the cookies that were never handed over.
+  unread_domains_.clear();
+  for (DomainCookiesMap::iterator it = read_domains_.begin();
+       it != read_domains_.end(); ++it) {
+    STLDeleteContainerPairSecondPointers(it->second.begin(),
+                                         it->second.end());
+  }
+  read_domains_.clear();
+}
+
+void SQLitePersistentCookieStore::Backend::StartLoading(
+    DomainKeysMap* domain_keys) {
+  {
+    AutoLock locked(db_lock_);
+    unread_domains_.swap(*domain_keys);
+  }
+  background_loop_->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &Backend::LoadNextDomain));
+}
+
+void SQLitePersistentCookieStore::Backend::LoadNextDomain() {
+  DCHECK(MessageLoop::current() == background_loop_);
+  {
+    AutoLock locked(db_lock_);
+    if (!db_ || unread_domains_.empty())
+      return;
+
+    DomainKeysMap::iterator it = unread_domains_.begin();
+    ReadCookies(it->second, &read_domains_[it->first]);
+    unread_domains_.erase(it);
+  }
+
+  // One domain per task, so commits and the calling threads don't wait long.
+  background_loop_->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &Backend::LoadNextDomain));
+}
+
+void SQLitePersistentCookieStore::Backend::LoadCookiesForDomain(
+    const std::string& domain,
+    KeyedCookieList* cookies) {
+  AutoLock locked(db_lock_);
+  DomainCookiesMap::iterator read = read_domains_.find(domain);
+  if (read != read_domains_.end()) {
+    cookies->insert(cookies->end(), read->second.begin(), read->second.end());
+    read_domains_.erase(read);
+    return;
+  }
+
+  DomainKeysMap::iterator unread = unread_domains_.find(domain);
+  if (unread == unread_domains_.end())
+    return;
+  if (db_)
+    ReadCookies(unread->second, cookies);
+  unread_domains_.erase(unread);
+}
+
+void SQLitePersistentCookieStore::Backend::LoadRemainingCookies(
+    KeyedCookieList* cookies) {
+  AutoLock locked(db_lock_);
+  for (DomainCookiesMap::iterator it = read_domains_.begin();
+       it != read_domains_.end(); ++it) {
+    cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+  }
+  read_domains_.clear();
+
+  if (db_) {
+    for (DomainKeysMap::iterator it = unread_domains_.begin();
+         it != unread_domains_.end(); ++it) {
+      ReadCookies(it->second, cookies);
+    }
+  }
+  unread_domains_.clear();
+}
+
+void SQLitePersistentCookieStore::Backend::ReadCookies(
+    const std::vector<std::string>& keys,
+    KeyedCookieList* cookies) {
+  // The statement cache is only used on the background thread.
+  SQLStatement smt;
+  if (smt.prepare(db_,
+      "SELECT creation_utc, host_key, name, value, path, expires_utc, secure, "
+      "httponly, last_access_utc FROM cookies WHERE host_key = ?") !=
+      SQLITE_OK) {
+    NOTREACHED() << "select statement prep failed";
+    return;
+  }
+
+  for (std::vector<std::string>::const_iterator key = keys.begin();
+       key != keys.end(); ++key) {
+    smt.reset();
+    smt.bind_string(0, *key);
+    while (smt.step() == SQLITE_ROW) {
+      scoped_ptr<net::CookieMonster::CanonicalCookie> cc(
+          new net::CookieMonster::CanonicalCookie(
+              smt.column_string(2),                            // name
+              smt.column_string(3),                            // value
+              smt.column_string(4),                            // path
+              smt.column_int(6) != 0,                          // secure
+              smt.column_int(7) != 0,                          // httponly
+              Time::FromInternalValue(smt.column_int64(0)),    // creation_utc
+              Time::FromInternalValue(smt.column_int64(8)),    // last_access
+              true,                                            // has_expires
+              Time::FromInternalValue(smt.column_int64(5))));  // expires_utc
+      // Memory allocation failed.
+      if (!cc.get())
+        return;
+
+      DLOG_IF(WARNING,
+              cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
+      cookies->push_back(
+          net::CookieMonster::KeyedCanonicalCookie(*key, cc.release()));
+    }
+  }
 }
 
 SQLitePersistentCookieStore::SQLitePersistentCookieStore(
@@ -295,10 +452,13 @@ bool InitTable(sqlite3* db) {
       return false;
   }
 
-  // Try to create the index every time. Older versions did not have this index,
-  // so we want those people to get it. Ignore errors, since it may exist.
+  // Try to create the indexes every time. Older versions did not have them,
+  // so we want those people to get them. Ignore errors, since they may exist.
   sqlite3_exec(db, "CREATE INDEX cookie_times ON cookies (creation_utc)",
                NULL, NULL, NULL);
+  // The cookies are read by host when they are loaded incrementally.
+  sqlite3_exec(db, "CREATE INDEX cookie_hosts ON cookies (host_key)",
+               NULL, NULL, NULL);
 
   return true;
 }
@@ -322,46 +482,42 @@ bool SQLitePersistentCookieStore::Load(
 
   MetaTableHelper::PrimeCache(std::string(), db);
 
-  // Slurp all the cookies into the out-vector.
+  // Only read the hosts now, grouped by domain.  Their cookies are read on
+  // the background thread, or when the CookieMonster needs them first.
   SQLStatement smt;
-  if (smt.prepare(db,
-      "SELECT creation_utc, host_key, name, value, path, expires_utc, secure, "
-      "httponly, last_access_utc FROM cookies") != SQLITE_OK) {
+  if (smt.prepare(db, "SELECT DISTINCT host_key FROM cookies") != SQLITE_OK) {
     NOTREACHED() << "select statement prep failed";
     sqlite3_close(db);
     return false;
   }
 
+  DomainKeysMap domain_keys;
   while (smt.step() == SQLITE_ROW) {
-    std::string key = smt.column_string(1);
-    scoped_ptr<net::CookieMonster::CanonicalCookie> cc(
-        new net::CookieMonster::CanonicalCookie(
-            smt.column_string(2),                            // name
-            smt.column_string(3),                            // value
-            smt.column_string(4),                            // path
-            smt.column_int(6) != 0,                          // secure
-            smt.column_int(7) != 0,                          // httponly
-            Time::FromInternalValue(smt.column_int64(0)),    // creation_utc
-            Time::FromInternalValue(smt.column_int64(8)),    // last_access_utc
-            true,                                            // has_expires
-            Time::FromInternalValue(smt.column_int64(5))));  // expires_utc
-    // Memory allocation failed.
-    if (!cc.get())
-      break;
-
-    DLOG_IF(WARNING,
-            cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
-    cookies->push_back(
-        net::CookieMonster::KeyedCanonicalCookie(smt.column_string(1),
-                                                 cc.release()));
+    std::string key = smt.column_string(0);
+    domain_keys[net::CookieMonster::GetKeyDomain(key)].push_back(key);
   }
+  smt.finalize();
 
   // Create the backend, this will take ownership of the db pointer.
   backend_ = new Backend(db, background_loop_);
+  backend_->StartLoading(&domain_keys);
 
   return true;
 }
 
+void SQLitePersistentCookieStore::LoadCookiesForDomain(
+    const std::string& domain,
+    std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+  if (backend_.get())
+    backend_->LoadCookiesForDomain(domain, cookies);
+}
+
+void SQLitePersistentCookieStore::LoadRemainingCookies(
+    std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+  if (backend_.get())
+    backend_->LoadRemainingCookies(cookies);
+}
+
 bool SQLitePersistentCookieStore::EnsureDatabaseVersion(sqlite3* db) {
   // Version check.
   if (!meta_table_.Init(std::string(), kCurrentVersionNumber,
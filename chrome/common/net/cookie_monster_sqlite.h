@@ -2,7 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// A sqlite implementation of a cookie monster persistent store.
+// A sqlite implementation of a cookie monster persistent store.  The cookies
+// are loaded incrementally: Load() only reads the list of hosts, and the
+// cookies are read one domain at a time on the background thread, or right
+// away when the CookieMonster needs a domain first.
 
 #ifndef CHROME_COMMON_NET_COOKIE_MONSTER_SQLITE_H__
 #define CHROME_COMMON_NET_COOKIE_MONSTER_SQLITE_H__
@@ -26,6 +29,12 @@ class SQLitePersistentCookieStore
   ~SQLitePersistentCookieStore();
 
   virtual bool Load(std::vector<net::CookieMonster::KeyedCanonicalCookie>*);
+  virtual bool LoadsIncrementally() { return true; }
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
 
   virtual void AddCookie(const std::string&,
                          const net::CookieMonster::CanonicalCookie&);
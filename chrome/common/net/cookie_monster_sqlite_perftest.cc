@@ -0,0 +1,89 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/perftimer.h"
+#include "base/string_util.h"
+#include "base/thread.h"
+#include "chrome/common/net/cookie_monster_sqlite.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/cookie_monster.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// A cookie jar close to the total limit of CookieMonster.
+const int kNumDomains = 300;
+const int kCookiesPerDomain = 10;
+
+GURL DomainURL(int i) {
+  return GURL(StringPrintf("http://www.domain%03d.izzle", i));
+}
+
+class CookieMonsterSqliteTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    FilePath path;
+    ASSERT_TRUE(file_util::GetTempDir(&path));
+    db_path_ = path.AppendASCII("CookieMonsterSqlitePerfTest").ToWStringHack();
+    file_util::Delete(db_path_, false);
+
+    // Write the cookies to the database.
+    base::Thread db_thread("db");
+    ASSERT_TRUE(db_thread.Start());
+    {
+      SQLitePersistentCookieStore store(db_path_, db_thread.message_loop());
+      net::CookieMonster cm(&store);
+      for (int i = 0; i < kNumDomains; ++i) {
+        for (int j = 0; j < kCookiesPerDomain; ++j) {
+          EXPECT_TRUE(cm.SetCookie(DomainURL(i),
+                                   StringPrintf("a%d=b; max-age=86400", j)));
+        }
+      }
+    }
+    // Stopping the thread runs the commit of the closing store.
+    db_thread.Stop();
+  }
+
+  virtual void TearDown() {
+    file_util::Delete(db_path_, false);
+  }
+
+  std::wstring db_path_;
+};
+
+}  // namespace
+
+// The time until the cookies of the first request are known, which is what
+// delays the first request of a session.
+TEST_F(CookieMonsterSqliteTest, TimeToFirstRequest) {
+  base::Thread db_thread("db");
+  ASSERT_TRUE(db_thread.Start());
+  SQLitePersistentCookieStore store(db_path_, db_thread.message_loop());
+  net::CookieMonster cm(&store);
+
+  PerfTimeLogger timer("Cookie_monster_sqlite_first_request");
+  EXPECT_FALSE(cm.GetCookies(DomainURL(kNumDomains / 2)).empty());
+  timer.Done();
+
+  PerfTimeLogger timer2("Cookie_monster_sqlite_load_remaining");
+  EXPECT_EQ(static_cast<size_t>(kNumDomains * kCookiesPerDomain),
+            cm.GetAllCookies().size());
+  timer2.Done();
+}
+
+// The time to read the whole jar before the first request, as it was done
+// before the store loaded incrementally.
+TEST_F(CookieMonsterSqliteTest, TimeToLoadAll) {
+  base::Thread db_thread("db");
+  ASSERT_TRUE(db_thread.Start());
+  SQLitePersistentCookieStore store(db_path_, db_thread.message_loop());
+  net::CookieMonster cm(&store);
+
+  PerfTimeLogger timer("Cookie_monster_sqlite_load_all");
+  EXPECT_EQ(static_cast<size_t>(kNumDomains * kCookiesPerDomain),
+            cm.GetAllCookies().size());
+  timer.Done();
+}
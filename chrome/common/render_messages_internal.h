@@ -222,11 +222,20 @@ IPC_BEGIN_MESSAGES(View)
                       int /* request_id */,
                       GURL /* new_url */)
 
-  // Sent when some data from a resource request is ready. The handle should
-  // already be mapped into the process that receives this message.
+  // Sent once for a resource request, before its first DataReceived message,
+  // with the shared memory buffer the response data is passed in. The handle
+  // should already be mapped into the process that receives this message.
+  IPC_MESSAGE_ROUTED3(ViewMsg_Resource_SetDataBuffer,
+                      int /* request_id */,
+                      base::SharedMemoryHandle /* data buffer */,
+                      int /* buffer_size */)
+
+  // Sent when some data from a resource request is ready. The data is at
+  // |data_offset| in the buffer of ViewMsg_Resource_SetDataBuffer, and is
+  // only valid until the message is acknowledged.
   IPC_MESSAGE_ROUTED3(ViewMsg_Resource_DataReceived,
                       int /* request_id */,
-                      base::SharedMemoryHandle /* data */,
+                      int /* data_offset */,
                       int /* data_len */)
 
   // Sent when the request has been completed.
@@ -1220,7 +1229,8 @@ IPC_BEGIN_MESSAGES(ViewHost)
                               uint32 /* context */)
 
   // Sent when the renderer process is done processing a DataReceived
-  // message.
+  // message. The browser may then reuse the part of the data buffer that the
+  // message pointed to.
   IPC_MESSAGE_ROUTED1(ViewHostMsg_DataReceived_ACK,
                       int /* request_id */)
 
@@ -347,34 +347,52 @@ void ResourceDispatcher::OnReceivedResponse(
   peer->OnReceivedResponse(response_head, false);
 }
 
+void ResourceDispatcher::OnSetDataBuffer(int request_id,
+                                         base::SharedMemoryHandle shm_handle,
+                                         int shm_size) {
+  PendingRequestList::iterator it = pending_requests_.find(request_id);
+  if (it == pending_requests_.end()) {
+    base::SharedMemory::CloseHandle(shm_handle);
+    return;
+  }
+
+  PendingRequestInfo& request_info = it->second;
+  DCHECK(!request_info.buffer.get());
+  linked_ptr<base::SharedMemory> buffer(
+      new base::SharedMemory(shm_handle, true));  // read only
+  if (shm_size <= 0 || !buffer->Map(shm_size)) {
+    DLOG(WARNING) << "Could not map the data buffer of a request";
+    return;
+  }
+  request_info.buffer = buffer;
+  request_info.buffer_size = shm_size;
+}
+
 void ResourceDispatcher::OnReceivedData(const IPC::Message& message,
                                         int request_id,
-                                        base::SharedMemoryHandle shm_handle,
+                                        int data_offset,
                                         int data_len) {
-  // Acknowlegde the reception of this data.
-  message_sender()->Send(
-      new ViewHostMsg_DataReceived_ACK(message.routing_id(), request_id));
-
-  const bool shm_valid = base::SharedMemory::IsHandleValid(shm_handle);
-  DCHECK((shm_valid && data_len > 0) || (!shm_valid && !data_len));
-  base::SharedMemory shared_mem(shm_handle, true);  // read only
-
   PendingRequestList::iterator it = pending_requests_.find(request_id);
   if (it == pending_requests_.end()) {
     // this might happen for kill()ed requests on the webkit end, so perhaps
     // it shouldn't be a warning...
     DLOG(WARNING) << "Got data for a nonexistant or finished request";
-    return;
+  } else {
+    PendingRequestInfo& request_info = it->second;
+    if (request_info.buffer.get() && data_len > 0 && data_offset >= 0 &&
+        data_offset <= request_info.buffer_size - data_len) {
+      RESOURCE_LOG("Dispatching " << data_len << " bytes for " <<
+                   request_info.peer->GetURLForDebugging());
+      const char* data =
+          static_cast<char*>(request_info.buffer->memory()) + data_offset;
+      request_info.peer->OnReceivedData(data, data_len);
+    }
   }
 
-  PendingRequestInfo& request_info = it->second;
-
-  if (data_len > 0 && shared_mem.Map(data_len)) {
-    RESOURCE_LOG("Dispatching " << data_len << " bytes for " <<
-                 request_info.peer->GetURLForDebugging());
-    const char* data = static_cast<char*>(shared_mem.memory());
-    request_info.peer->OnReceivedData(data, data_len);
-  }
+  // Acknowledge the data only once it was consumed, since the browser writes
+  // more data to the same place of the buffer afterwards.
+  message_sender()->Send(
+      new ViewHostMsg_DataReceived_ACK(message.routing_id(), request_id));
 }
 
 void ResourceDispatcher::OnReceivedRedirect(int request_id,
@@ -483,6 +501,7 @@ void ResourceDispatcher::DispatchMessage(const IPC::Message& message) {
     IPC_MESSAGE_HANDLER(ViewMsg_Resource_UploadProgress, OnUploadProgress)
     IPC_MESSAGE_HANDLER(ViewMsg_Resource_ReceivedResponse, OnReceivedResponse)
     IPC_MESSAGE_HANDLER(ViewMsg_Resource_ReceivedRedirect, OnReceivedRedirect)
+    IPC_MESSAGE_HANDLER(ViewMsg_Resource_SetDataBuffer, OnSetDataBuffer)
     IPC_MESSAGE_HANDLER(ViewMsg_Resource_DataReceived, OnReceivedData)
     IPC_MESSAGE_HANDLER(ViewMsg_Resource_RequestComplete, OnRequestComplete)
   IPC_END_MESSAGE_MAP()
@@ -538,6 +557,7 @@ bool ResourceDispatcher::IsResourceDispatcherMessage(
     case ViewMsg_Resource_UploadProgress::ID:
     case ViewMsg_Resource_ReceivedResponse::ID:
     case ViewMsg_Resource_ReceivedRedirect::ID:
+    case ViewMsg_Resource_SetDataBuffer::ID:
     case ViewMsg_Resource_DataReceived::ID:
     case ViewMsg_Resource_RequestComplete::ID:
       return true;
@@ -560,7 +580,7 @@ void ResourceDispatcher::ReleaseResourcesInDataMessage(
 
   // If the message contains a shared memory handle, we should close the
   // handle or there will be a memory leak.
-  if (message.type() == ViewMsg_Resource_DataReceived::ID) {
+  if (message.type() == ViewMsg_Resource_SetDataBuffer::ID) {
     base::SharedMemoryHandle shm_handle;
     if (IPC::ParamTraits<base::SharedMemoryHandle>::Read(&message,
                                                          &iter,
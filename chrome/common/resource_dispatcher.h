@@ -11,6 +11,7 @@
 #include <string>
 
 #include "base/hash_tables.h"
+#include "base/linked_ptr.h"
 #include "base/shared_memory.h"
 #include "base/task.h"
 #include "chrome/common/filter_policy.h"
@@ -75,7 +76,8 @@ class ResourceDispatcher {
         : peer(peer),
           resource_type(resource_type),
           filter_policy(FilterPolicy::DONT_FILTER),
-          is_deferred(false) {
+          is_deferred(false),
+          buffer_size(0) {
     }
     ~PendingRequestInfo() { }
     webkit_glue::ResourceLoaderBridge::Peer* peer;
@@ -83,6 +85,9 @@ class ResourceDispatcher {
     FilterPolicy::Type filter_policy;
     MessageQueue deferred_message_queue;
     bool is_deferred;
+    // The shared memory the data messages point into, mapped read only.
+    linked_ptr<base::SharedMemory> buffer;
+    int buffer_size;
   };
   typedef base::hash_map<int, PendingRequestInfo> PendingRequestList;
 
@@ -93,9 +98,12 @@ class ResourceDispatcher {
                         int64 size);
   void OnReceivedResponse(int request_id, const ResourceResponseHead&);
   void OnReceivedRedirect(int request_id, const GURL& new_url);
+  void OnSetDataBuffer(int request_id,
+                       base::SharedMemoryHandle shm_handle,
+                       int shm_size);
   void OnReceivedData(const IPC::Message& message,
                       int request_id,
-                      base::SharedMemoryHandle data,
+                      int data_offset,
                       int data_len);
   void OnRequestComplete(int request_id,
                          const URLRequestStatus& status,
@@ -111,10 +119,10 @@ class ResourceDispatcher {
   // Returns true if the message passed in is a resource related message.
   static bool IsResourceDispatcherMessage(const IPC::Message& message);
 
-  // ViewHostMsg_Resource_DataReceived is not POD, it has a shared memory
+  // ViewMsg_Resource_SetDataBuffer is not POD, it has a shared memory
   // handle in it that we should cleanup it up nicely. This method accepts any
   // message and determine whether the message is
-  // ViewHostMsg_Resource_DataReceived and clean up the shared memory handle.
+  // ViewMsg_Resource_SetDataBuffer and clean up the shared memory handle.
   void ReleaseResourcesInDataMessage(const IPC::Message& message);
 
   IPC::Message::Sender* message_sender_;
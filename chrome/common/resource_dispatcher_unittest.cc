@@ -104,18 +104,24 @@ class ResourceDispatcherTest : public testing::Test,
       response.filter_policy = FilterPolicy::DONT_FILTER;
       dispatcher_->OnReceivedResponse(request_id, response);
 
-      // received data message with the test contents
+      // set the data buffer, and put the test contents in its second half
+      const int buffer_size = test_page_contents_len * 2;
       base::SharedMemory shared_mem;
       EXPECT_TRUE(shared_mem.Create(std::wstring(),
-          false, false, test_page_contents_len));
-      EXPECT_TRUE(shared_mem.Map(test_page_contents_len));
-      char* put_data_here = static_cast<char*>(shared_mem.memory());
+          false, false, buffer_size));
+      EXPECT_TRUE(shared_mem.Map(buffer_size));
+      char* put_data_here = static_cast<char*>(shared_mem.memory()) +
+                            test_page_contents_len;
       memcpy(put_data_here, test_page_contents, test_page_contents_len);
       base::SharedMemoryHandle dup_handle;
       EXPECT_TRUE(shared_mem.GiveToProcess(
           base::Process::Current().handle(), &dup_handle));
-      dispatcher_->OnReceivedData(
-          message_queue_[0], request_id, dup_handle, test_page_contents_len);
+      dispatcher_->OnSetDataBuffer(request_id, dup_handle, buffer_size);
+
+      // received data message with the test contents
+      dispatcher_->OnReceivedData(message_queue_[0], request_id,
+                                  test_page_contents_len,
+                                  test_page_contents_len);
 
       message_queue_.erase(message_queue_.begin());
 
@@ -164,10 +170,11 @@ TEST_F(ResourceDispatcherTest, RoundTrip) {
 
   ProcessMessages();
 
+  EXPECT_STREQ(test_page_contents, callback.data().c_str());
+
   // FIXME(brettw) when the request complete messages are actually handledo
   // and dispatched, uncomment this.
   //EXPECT_TRUE(callback.complete());
-  //EXPECT_STREQ(test_page_contents, callback.data().c_str());
 
   delete bridge;
 }
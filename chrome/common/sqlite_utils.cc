@@ -4,6 +4,8 @@
 
 #include "chrome/common/sqlite_utils.h"
 
+#include <algorithm>
+
 #include "base/file_path.h"
 #include "base/logging.h"
 #include "base/string16.h"
@@ -83,6 +85,34 @@ bool DoesSqliteTableHaveRow(sqlite3* db, const char* table_name) {
   return s.step() == SQLITE_ROW;
 }
 
+bool ExecuteSqliteForIDs(sqlite3* db,
+                         const std::string& sql_prefix,
+                         const std::vector<int64>& ids) {
+  // Keeps the statements well under the SQLite statement length limit.
+  const size_t kMaxIDsPerStatement = 1000;
+
+  for (size_t begin = 0; begin < ids.size(); begin += kMaxIDsPerStatement) {
+    size_t end = std::min(ids.size(), begin + kMaxIDsPerStatement);
+    std::string sql(sql_prefix);
+    sql.push_back('(');
+    for (size_t i = begin; i < end; i++) {
+      if (i != begin)
+        sql.push_back(',');
+      sql.append(Int64ToString(ids[i]));
+    }
+    sql.push_back(')');
+
+    SQLStatement s;
+    if (s.prepare(db, sql.c_str()) != SQLITE_OK) {
+      NOTREACHED() << "statement prep failed";
+      return false;
+    }
+    if (s.step() != SQLITE_DONE)
+      return false;
+  }
+  return true;
+}
+
 SQLTransaction::SQLTransaction(sqlite3* db) : db_(db), began_(false) {
 }
 
@@ -349,4 +349,12 @@ inline bool DoesSqliteColumnExist(sqlite3* db,
 // has one or more rows and false if the table is empty or doesn't exist.
 bool DoesSqliteTableHaveRow(sqlite3* db, const char* table_name);
 
+// Executes |sql_prefix| followed by a parenthesized, comma separated list of
+// |ids|, for example "DELETE FROM urls WHERE id IN " to delete the rows of all
+// the IDs with one statement rather than one statement per row. Long lists are
+// split across several statements. Returns true on success.
+bool ExecuteSqliteForIDs(sqlite3* db,
+                         const std::string& sql_prefix,
+                         const std::vector<int64>& ids);
+
 #endif  // CHROME_COMMON_SQLITEUTILS_H_
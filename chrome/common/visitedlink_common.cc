@@ -18,8 +18,6 @@ VisitedLinkCommon::VisitedLinkCommon() :
 VisitedLinkCommon::~VisitedLinkCommon() {
 }
 
-// FIXME: this uses linear probing, it should be replaced with quadratic
-// probing or something better. See VisitedLinkMaster::AddFingerprint
 bool VisitedLinkCommon::IsVisited(const char* canonical_url,
                                   size_t url_len) const {
   if (url_len == 0)
@@ -30,30 +28,40 @@ bool VisitedLinkCommon::IsVisited(const char* canonical_url,
 }
 
 bool VisitedLinkCommon::IsVisited(Fingerprint fingerprint) const {
-  // Go through the table until we find the item or an empty spot (meaning it
-  // wasn't found). This loop will terminate as long as the table isn't full,
-  // which should be enforced by AddFingerprint.
-  Hash first_hash = HashFingerprint(fingerprint);
-  Hash cur_hash = first_hash;
-  while (true) {
+  return FindFingerprint(fingerprint) != null_hash_;
+}
+
+VisitedLinkCommon::Hash VisitedLinkCommon::FindFingerprint(
+    Fingerprint fingerprint) const {
+  if (!hash_table_ || table_length_ == 0)
+    return null_hash_;
+
+  // Go through the table until we find the item, an empty spot, or an item
+  // closer to its hash value than we are to ours (meaning it wasn't found,
+  // since the master keeps the runs sorted by hash value). This loop will
+  // terminate as long as the table isn't full, which should be enforced by
+  // AddFingerprint.
+  Hash cur_hash = HashFingerprint(fingerprint);
+  for (int32 distance = 0; distance < table_length_; distance++) {
     Fingerprint cur_fingerprint = FingerprintAt(cur_hash);
     if (cur_fingerprint == null_fingerprint_)
-      return false;  // End of probe sequence found.
+      return null_hash_;  // End of probe sequence found.
     if (cur_fingerprint == fingerprint)
-      return true;  // Found a match.
+      return cur_hash;  // Found a match.
+    if (ProbeDistance(cur_fingerprint, cur_hash, table_length_) < distance)
+      return null_hash_;  // We would have been stored before this item.
 
     // This spot was taken, but not by the item we're looking for, search in
     // the next position.
     cur_hash++;
     if (cur_hash == table_length_)
       cur_hash = 0;
-    if (cur_hash == first_hash) {
-      // Wrapped around and didn't find an empty space, this means we're in an
-      // infinite loop because AddFingerprint didn't do its job resizing.
-      NOTREACHED();
-      return false;
-    }
   }
+
+  // Wrapped around and didn't find an empty space, this means AddFingerprint
+  // didn't do its job resizing.
+  NOTREACHED();
+  return null_hash_;
 }
 
 // Uses the top 64 bits of the MD5 sum of the canonical URL as the fingerprint,
@@ -41,6 +41,14 @@
 // memory (which could get to be more than we want to have in memory). We use
 // a salt value for the links on one computer so that an attacker can not
 // manually create a link that causes a collision.
+//
+// The table uses linear probing with Robin Hood ordering: the fingerprints of
+// a run of full entries are sorted by their hash value, so no entry is farther
+// from its hash value than an entry it passed. A lookup can therefore stop as
+// soon as it reaches an entry that is closer to its own hash value than the
+// lookup is, instead of scanning to the end of the run. The readers don't
+// take any lock; the master orders its writes so that a reader never misses
+// an entry which is being moved (see VisitedLinkMaster::AddFingerprint).
 class VisitedLinkCommon {
  public:
   // A number that identifies the URL.
@@ -121,6 +129,21 @@ class VisitedLinkCommon {
     return HashFingerprint(fingerprint, table_length_);
   }
 
+  // Returns how far |fingerprint|, stored at |hash|, is from its own hash
+  // value, accounting for the wrap around at the end of the table.
+  static int32 ProbeDistance(Fingerprint fingerprint,
+                             Hash hash,
+                             int32 table_length) {
+    int32 distance = hash - HashFingerprint(fingerprint, table_length);
+    if (distance < 0)
+      distance += table_length;
+    return distance;
+  }
+
+  // Returns the index of |fingerprint| in the current hashtable, or
+  // null_hash_ if it is not there.
+  Hash FindFingerprint(Fingerprint fingerprint) const;
+
   // pointer to the first item
   VisitedLinkCommon::Fingerprint* hash_table_;
 
@@ -97,3 +97,7 @@ Filter::FilterStatus BZip2Filter::ReadFilteredData(char* dest_buffer,
 
   return status;
 }
+
+bool BZip2Filter::IsPassThrough() const {
+  return DECODING_DONE == decoding_status_;
+}
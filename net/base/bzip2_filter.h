@@ -59,6 +59,9 @@ class BZip2Filter : public Filter {
   // but not produce output yet.
   virtual FilterStatus ReadFilteredData(char* dest_buffer, int* dest_len);
 
+ protected:
+  virtual bool IsPassThrough() const;
+
  private:
   enum DecodingStatus {
     DECODING_UNINITIALIZED,
@@ -50,6 +50,7 @@
 #include "base/format_macros.h"
 #include "base/logging.h"
 #include "base/scoped_ptr.h"
+#include "base/stl_util-inl.h"
 #include "base/string_tokenizer.h"
 #include "base/string_util.h"
 #include "googleurl/src/gurl.h"
@@ -91,7 +92,9 @@ void CookieMonster::EnableFileScheme() {
 }
 
 CookieMonster::CookieMonster()
-    : initialized_(false),
+    : num_cookies_(0),
+      initialized_(0),
+      loading_incrementally_(0),
       store_(NULL),
       last_access_threshold_(
           TimeDelta::FromSeconds(kDefaultAccessUpdateThresholdSeconds)) {
@@ -99,7 +102,9 @@ CookieMonster::CookieMonster()
 }
 
 CookieMonster::CookieMonster(PersistentCookieStore* store)
-    : initialized_(false),
+    : num_cookies_(0),
+      initialized_(0),
+      loading_incrementally_(0),
       store_(store),
       last_access_threshold_(
           TimeDelta::FromSeconds(kDefaultAccessUpdateThresholdSeconds)) {
@@ -107,11 +112,21 @@ CookieMonster::CookieMonster(PersistentCookieStore* store)
 }
 
 CookieMonster::~CookieMonster() {
-  DeleteAll(false);
+  // The cookies left in the store don't need to be read.
+  for (int i = 0; i < kNumShards; ++i) {
+    STLDeleteContainerPairSecondPointers(shards_[i].cookies.begin(),
+                                         shards_[i].cookies.end());
+  }
 }
 
-void CookieMonster::InitStore() {
-  DCHECK(store_) << "Store must exist to initialize";
+void CookieMonster::InitStoreOnce() {
+  AutoLock autolock(lock_);
+  if (initialized_)
+    return;
+  if (!store_) {
+    base::subtle::Release_Store(&initialized_, 1);
+    return;
+  }
 
   // Initialize the store and sync in any saved persistent cookies.  We don't
   // care if it's expired, insert it so it can be garbage collected, removed,
@@ -121,12 +136,87 @@ void CookieMonster::InitStore() {
   // This prevents multiple vector growth / copies as we append cookies.
   cookies.reserve(kNumCookiesTotal);
   store_->Load(&cookies);
+  if (store_->LoadsIncrementally())
+    loading_incrementally_ = 1;
+  LockAllShards();
+  InsertLoadedCookies(cookies);
+  UnlockAllShards();
+  base::subtle::Release_Store(&initialized_, 1);
+}
+
+void CookieMonster::InsertLoadedCookies(
+    const std::vector<KeyedCanonicalCookie>& cookies) {
   for (std::vector<KeyedCanonicalCookie>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it) {
-    InternalInsertCookie(it->first, it->second, false);
+    InternalInsertCookie(GetShard(GetKeyDomain(it->first)), it->first,
+                         it->second, false);
   }
 }
 
+void CookieMonster::EnsureDomainLoaded(Shard* shard,
+                                       const std::string& domain) {
+  if (!loading_incrementally_ ||
+      !shard->loaded_domains.insert(domain).second)
+    return;
+
+  std::vector<KeyedCanonicalCookie> cookies;
+  store_->LoadCookiesForDomain(domain, &cookies);
+  InsertLoadedCookies(cookies);
+}
+
+void CookieMonster::LoadAllDomains() {
+  if (!loading_incrementally_)
+    return;
+
+  std::vector<KeyedCanonicalCookie> cookies;
+  store_->LoadRemainingCookies(&cookies);
+  InsertLoadedCookies(cookies);
+  for (int i = 0; i < kNumShards; ++i)
+    shards_[i].loaded_domains.clear();
+  base::subtle::Release_Store(&loading_incrementally_, 0);
+}
+
+void CookieMonster::LoadAllDomainsIfNecessary() {
+  if (!base::subtle::Acquire_Load(&loading_incrementally_))
+    return;
+
+  AutoLock autolock(lock_);
+  LockAllShards();
+  LoadAllDomains();
+  UnlockAllShards();
+}
+
+// static
+std::string CookieMonster::GetKeyDomain(const std::string& key) {
+  // Domain keys have a leading dot.  All the keys probed for a host by
+  // FindCookiesForHostAndDomain() share its registry-controlled domain.
+  const bool is_domain_key = !key.empty() && key[0] == '.';
+  const std::string host(key, is_domain_key ? 1 : 0);
+  const std::string domain(
+      RegistryControlledDomainService::GetDomainAndRegistry(host));
+  return domain.empty() ? host : domain;
+}
+
+CookieMonster::Shard* CookieMonster::GetShard(const std::string& domain) {
+  size_t hash = 0;
+  for (std::string::const_iterator it = domain.begin(); it != domain.end();
+       ++it)
+    hash = hash * 31 + static_cast<unsigned char>(*it);
+  return &shards_[hash % kNumShards];
+}
+
+// The locks of the shards are always taken in the same order, after |lock_|,
+// so that this can't deadlock with another thread doing the same.
+void CookieMonster::LockAllShards() {
+  for (int i = 0; i < kNumShards; ++i)
+    shards_[i].lock.Acquire();
+}
+
+void CookieMonster::UnlockAllShards() {
+  for (int i = kNumShards - 1; i >= 0; --i)
+    shards_[i].lock.Release();
+}
+
 void CookieMonster::SetDefaultCookieableSchemes() {
   // Note: file must be the last scheme.
   static const char* kDefaultCookieableSchemes[] = { "http", "https", "file" };
@@ -433,7 +523,6 @@ bool CookieMonster::SetCookieWithCreationTimeWithOptions(
     return false;
   }
 
-  AutoLock autolock(lock_);
   InitIfNecessary();
 
   COOKIE_DLOG(INFO) << "SetCookie() line: " << cookie_line;
@@ -471,26 +560,38 @@ bool CookieMonster::SetCookieWithCreationTimeWithOptions(
     return false;
   }
 
-  if (DeleteAnyEquivalentCookie(cookie_domain,
-                                *cc,
-                                options.exclude_httponly())) {
-    COOKIE_DLOG(INFO) << "SetCookie() not clobbering httponly cookie";
-    return false;
-  }
+  {
+    const std::string domain(GetKeyDomain(cookie_domain));
+    Shard* shard = GetShard(domain);
+    AutoLock shard_lock(shard->lock);
+    EnsureDomainLoaded(shard, domain);
+
+    if (DeleteAnyEquivalentCookie(shard,
+                                  cookie_domain,
+                                  *cc,
+                                  options.exclude_httponly())) {
+      COOKIE_DLOG(INFO) << "SetCookie() not clobbering httponly cookie";
+      return false;
+    }
 
-  COOKIE_DLOG(INFO) << "SetCookie() cc: " << cc->DebugString();
+    COOKIE_DLOG(INFO) << "SetCookie() cc: " << cc->DebugString();
 
-  // Realize that we might be setting an expired cookie, and the only point
-  // was to delete the cookie which we've already done.
-  if (!cc->IsExpired(creation_time))
-    InternalInsertCookie(cookie_domain, cc.release(), true);
+    // Realize that we might be setting an expired cookie, and the only point
+    // was to delete the cookie which we've already done.
+    if (!cc->IsExpired(creation_time))
+      InternalInsertCookie(shard, cookie_domain, cc.release(), true);
 
-  // We assume that hopefully setting a cookie will be less common than
-  // querying a cookie.  Since setting a cookie can put us over our limits,
-  // make sure that we garbage collect...  We can also make the assumption that
-  // if a cookie was set, in the common case it will be used soon after,
-  // and we will purge the expired cookies in GetCookies().
-  GarbageCollect(creation_time, cookie_domain);
+    // We assume that hopefully setting a cookie will be less common than
+    // querying a cookie.  Since setting a cookie can put us over our limits,
+    // make sure that we garbage collect...  We can also make the assumption
+    // that if a cookie was set, in the common case it will be used soon after,
+    // and we will purge the expired cookies in GetCookies().
+    GarbageCollect(creation_time, shard, cookie_domain);
+  }
+
+  // The limit on the total number of cookies is enforced once the lock of the
+  // shard is released, since it needs the locks of all the shards.
+  GarbageCollectAllShards(creation_time);
 
   return true;
 }
@@ -510,12 +611,14 @@ void CookieMonster::SetCookiesWithOptions(
     SetCookieWithOptions(url, *iter, options);
 }
 
-void CookieMonster::InternalInsertCookie(const std::string& key,
+void CookieMonster::InternalInsertCookie(Shard* shard,
+                                         const std::string& key,
                                          CanonicalCookie* cc,
                                          bool sync_to_store) {
   if (cc->IsPersistent() && store_ && sync_to_store)
     store_->AddCookie(key, *cc);
-  cookies_.insert(CookieMap::value_type(key, cc));
+  shard->cookies.insert(CookieMap::value_type(key, cc));
+  base::subtle::NoBarrier_AtomicIncrement(&num_cookies_, 1);
 }
 
 void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc) {
@@ -532,22 +635,25 @@ void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc) {
     store_->UpdateCookieAccessTime(*cc);
 }
 
-void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
+void CookieMonster::InternalDeleteCookie(Shard* shard,
+                                         CookieMap::iterator it,
                                          bool sync_to_store) {
   CanonicalCookie* cc = it->second;
   COOKIE_DLOG(INFO) << "InternalDeleteCookie() cc: " << cc->DebugString();
   if (cc->IsPersistent() && store_ && sync_to_store)
     store_->DeleteCookie(*cc);
-  cookies_.erase(it);
+  shard->cookies.erase(it);
+  base::subtle::NoBarrier_AtomicIncrement(&num_cookies_, -1);
   delete cc;
 }
 
-bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
+bool CookieMonster::DeleteAnyEquivalentCookie(Shard* shard,
+                                              const std::string& key,
                                               const CanonicalCookie& ecc,
                                               bool skip_httponly) {
   bool found_equivalent_cookie = false;
   bool skipped_httponly = false;
-  for (CookieMapItPair its = cookies_.equal_range(key);
+  for (CookieMapItPair its = shard->cookies.equal_range(key);
        its.first != its.second; ) {
     CookieMap::iterator curit = its.first;
     CanonicalCookie* cc = curit->second;
@@ -561,7 +667,7 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
       if (skip_httponly && cc->IsHttpOnly()) {
         skipped_httponly = true;
       } else {
-        InternalDeleteCookie(curit, true);
+        InternalDeleteCookie(shard, curit, true);
       }
       found_equivalent_cookie = true;
 #ifdef NDEBUG
@@ -575,79 +681,118 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
 }
 
 int CookieMonster::GarbageCollect(const Time& current,
+                                  Shard* shard,
                                   const std::string& key) {
   int num_deleted = 0;
 
   // Collect garbage for this key.
-  if (cookies_.count(key) > kNumCookiesPerHost) {
+  if (shard->cookies.count(key) > kNumCookiesPerHost) {
     COOKIE_DLOG(INFO) << "GarbageCollect() key: " << key;
-    num_deleted += GarbageCollectRange(current, cookies_.equal_range(key),
-        kNumCookiesPerHost, kNumCookiesPerHostPurge);
+    num_deleted += GarbageCollectRange(current, shard,
+        shard->cookies.equal_range(key), kNumCookiesPerHost,
+        kNumCookiesPerHostPurge);
   }
 
-  // Collect garbage for everything.
-  if (cookies_.size() > kNumCookiesTotal) {
+  return num_deleted;
+}
+
+int CookieMonster::GarbageCollectAllShards(const Time& current) {
+  if (base::subtle::NoBarrier_Load(&num_cookies_) <=
+      static_cast<int>(kNumCookiesTotal))
+    return 0;
+
+  AutoLock autolock(lock_);
+  LockAllShards();
+
+  // Another thread may have collected the garbage while we were waiting.
+  int num_deleted = 0;
+  if (base::subtle::NoBarrier_Load(&num_cookies_) >
+      static_cast<int>(kNumCookiesTotal)) {
     COOKIE_DLOG(INFO) << "GarbageCollect() everything";
-    num_deleted += GarbageCollectRange(current,
-        CookieMapItPair(cookies_.begin(), cookies_.end()), kNumCookiesTotal,
-        kNumCookiesTotalPurge);
+    // The least recently used cookies may not be read yet.
+    LoadAllDomains();
+    std::vector<CookieRef> cookie_refs;
+    for (int i = 0; i < kNumShards; ++i) {
+      CookieMap& cookies = shards_[i].cookies;
+      num_deleted += GarbageCollectExpired(current, &shards_[i],
+          CookieMapItPair(cookies.begin(), cookies.end()), &cookie_refs);
+    }
+    num_deleted += PurgeLeastRecentlyUsed(&cookie_refs, kNumCookiesTotal,
+                                          kNumCookiesTotalPurge);
   }
 
+  UnlockAllShards();
   return num_deleted;
 }
 
-static bool LRUCookieSorter(const CookieMonster::CookieMap::iterator& it1,
-                            const CookieMonster::CookieMap::iterator& it2) {
+// static
+bool CookieMonster::LRUCookieSorter(const CookieRef& ref1,
+                                    const CookieRef& ref2) {
+  const CanonicalCookie* cc1 = ref1.second->second;
+  const CanonicalCookie* cc2 = ref2.second->second;
+
   // Cookies accessed less recently should be deleted first.
-  if (it1->second->LastAccessDate() != it2->second->LastAccessDate())
-    return it1->second->LastAccessDate() < it2->second->LastAccessDate();
+  if (cc1->LastAccessDate() != cc2->LastAccessDate())
+    return cc1->LastAccessDate() < cc2->LastAccessDate();
 
   // In rare cases we might have two cookies with identical last access times.
   // To preserve the stability of the sort, in these cases prefer to delete
   // older cookies over newer ones.  CreationDate() is guaranteed to be unique.
-  return it1->second->CreationDate() < it2->second->CreationDate();
+  return cc1->CreationDate() < cc2->CreationDate();
 }
 
 int CookieMonster::GarbageCollectRange(const Time& current,
+                                       Shard* shard,
                                        const CookieMapItPair& itpair,
                                        size_t num_max,
                                        size_t num_purge) {
   // First, delete anything that's expired.
-  std::vector<CookieMap::iterator> cookie_its;
-  int num_deleted = GarbageCollectExpired(current, itpair, &cookie_its);
+  std::vector<CookieRef> cookie_refs;
+  int num_deleted = GarbageCollectExpired(current, shard, itpair,
+                                          &cookie_refs);
 
   // If the range still has too many cookies, delete the least recently used.
-  if (cookie_its.size() > num_max) {
-    COOKIE_DLOG(INFO) << "GarbageCollectRange() Deep Garbage Collect.";
-    // Purge down to (|num_max| - |num_purge|) total cookies.
-    DCHECK(num_purge <= num_max);
-    num_purge += cookie_its.size() - num_max;
-
-    std::partial_sort(cookie_its.begin(), cookie_its.begin() + num_purge,
-                      cookie_its.end(), LRUCookieSorter);
-    for (size_t i = 0; i < num_purge; ++i)
-      InternalDeleteCookie(cookie_its[i], true);
-
-    num_deleted += num_purge;
-  }
+  num_deleted += PurgeLeastRecentlyUsed(&cookie_refs, num_max, num_purge);
 
   return num_deleted;
 }
 
+int CookieMonster::PurgeLeastRecentlyUsed(std::vector<CookieRef>* cookie_refs,
+                                          size_t num_max,
+                                          size_t num_purge) {
+  if (cookie_refs->size() <= num_max)
+    return 0;
+
+  COOKIE_DLOG(INFO) << "PurgeLeastRecentlyUsed() Deep Garbage Collect.";
+  // Purge down to (|num_max| - |num_purge|) total cookies.
+  DCHECK(num_purge <= num_max);
+  num_purge += cookie_refs->size() - num_max;
+
+  std::partial_sort(cookie_refs->begin(), cookie_refs->begin() + num_purge,
+                    cookie_refs->end(), LRUCookieSorter);
+  for (size_t i = 0; i < num_purge; ++i) {
+    const CookieRef& ref = (*cookie_refs)[i];
+    InternalDeleteCookie(ref.first, ref.second, true);
+  }
+
+  return num_purge;
+}
+
 int CookieMonster::GarbageCollectExpired(
     const Time& current,
+    Shard* shard,
     const CookieMapItPair& itpair,
-    std::vector<CookieMap::iterator>* cookie_its) {
+    std::vector<CookieRef>* cookie_refs) {
   int num_deleted = 0;
   for (CookieMap::iterator it = itpair.first, end = itpair.second; it != end;) {
     CookieMap::iterator curit = it;
     ++it;
 
     if (curit->second->IsExpired(current)) {
-      InternalDeleteCookie(curit, true);
+      InternalDeleteCookie(shard, curit, true);
       ++num_deleted;
-    } else if (cookie_its) {
-      cookie_its->push_back(curit);
+    } else if (cookie_refs) {
+      cookie_refs->push_back(CookieRef(shard, curit));
     }
   }
 
@@ -655,15 +800,20 @@ int CookieMonster::GarbageCollectExpired(
 }
 
 int CookieMonster::DeleteAll(bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllDomainsIfNecessary();
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    ++it;
-    InternalDeleteCookie(curit, sync_to_store);
-    ++num_deleted;
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock shard_lock(shard->lock);
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end();) {
+      CookieMap::iterator curit = it;
+      ++it;
+      InternalDeleteCookie(shard, curit, sync_to_store);
+      ++num_deleted;
+    }
   }
 
   return num_deleted;
@@ -672,19 +822,24 @@ int CookieMonster::DeleteAll(bool sync_to_store) {
 int CookieMonster::DeleteAllCreatedBetween(const Time& delete_begin,
                                            const Time& delete_end,
                                            bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllDomainsIfNecessary();
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock shard_lock(shard->lock);
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end();) {
+      CookieMap::iterator curit = it;
+      CanonicalCookie* cc = curit->second;
+      ++it;
 
-    if (cc->CreationDate() >= delete_begin &&
-        (delete_end.is_null() || cc->CreationDate() < delete_end)) {
-      InternalDeleteCookie(curit, sync_to_store);
-      ++num_deleted;
+      if (cc->CreationDate() >= delete_begin &&
+          (delete_end.is_null() || cc->CreationDate() < delete_end)) {
+        InternalDeleteCookie(shard, curit, sync_to_store);
+        ++num_deleted;
+      }
     }
   }
 
@@ -699,14 +854,17 @@ int CookieMonster::DeleteAllCreatedAfter(const Time& delete_begin,
 bool CookieMonster::DeleteCookie(const std::string& domain,
                                  const CanonicalCookie& cookie,
                                  bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
 
-  for (CookieMapItPair its = cookies_.equal_range(domain);
+  const std::string key_domain(GetKeyDomain(domain));
+  Shard* shard = GetShard(key_domain);
+  AutoLock shard_lock(shard->lock);
+  EnsureDomainLoaded(shard, key_domain);
+  for (CookieMapItPair its = shard->cookies.equal_range(domain);
        its.first != its.second; ++its.first) {
     // The creation date acts as our unique index...
     if (its.first->second->CreationDate() == cookie.CreationDate()) {
-      InternalDeleteCookie(its.first, sync_to_store);
+      InternalDeleteCookie(shard, its.first, sync_to_store);
       return true;
     }
   }
@@ -746,9 +904,18 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
     return std::string();
   }
 
-  // Get the cookies for this host and its domain(s).
+  InitIfNecessary();
+
+  // All the cookies for this host and its domain(s) are in the same shard.
+  // Its lock is held until the cookie line is built, since other threads may
+  // delete the cookies.
+  const std::string domain(GetKeyDomain(url.host()));
+  Shard* shard = GetShard(domain);
+  AutoLock shard_lock(shard->lock);
+  EnsureDomainLoaded(shard, domain);
+
   std::vector<CanonicalCookie*> cookies;
-  FindCookiesForHostAndDomain(url, options, &cookies);
+  FindCookiesForHostAndDomain(shard, url, options, &cookies);
   std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line;
@@ -769,9 +936,15 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
   return cookie_line;
 }
 
+// Sorts the cookies by key, as they would be in a single CookieMap.
+static bool CookieListSorter(const CookieMonster::CookieListPair& pair1,
+                             const CookieMonster::CookieListPair& pair2) {
+  return pair1.first < pair2.first;
+}
+
 CookieMonster::CookieList CookieMonster::GetAllCookies() {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllDomainsIfNecessary();
 
   // This function is being called to scrape the cookie list for management UI
   // or similar.  We shouldn't show expired cookies in this list since it will
@@ -781,29 +954,33 @@ CookieMonster::CookieList CookieMonster::GetAllCookies() {
   //
   // Note that this does not prune cookies to be below our limits (if we've
   // exceeded them) the way that calling GarbageCollect() would.
-  GarbageCollectExpired(Time::Now(),
-                        CookieMapItPair(cookies_.begin(), cookies_.end()),
-                        NULL);
-
+  const Time current_time(Time::Now());
   CookieList cookie_list;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end(); ++it)
-    cookie_list.push_back(CookieListPair(it->first, *it->second));
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock shard_lock(shard->lock);
+    GarbageCollectExpired(current_time, shard,
+        CookieMapItPair(shard->cookies.begin(), shard->cookies.end()), NULL);
+
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end(); ++it)
+      cookie_list.push_back(CookieListPair(it->first, *it->second));
+  }
+  std::stable_sort(cookie_list.begin(), cookie_list.end(), CookieListSorter);
 
   return cookie_list;
 }
 
 void CookieMonster::FindCookiesForHostAndDomain(
+    Shard* shard,
     const GURL& url,
     const CookieOptions& options,
     std::vector<CanonicalCookie*>* cookies) {
-  AutoLock autolock(lock_);
-  InitIfNecessary();
-
-  const Time current_time(CurrentTime());
+  const Time current_time(Time::Now());
 
   // Query for the full host, For example: 'a.c.blah.com'.
   std::string key(url.host());
-  FindCookiesForKey(key, url, options, current_time, cookies);
+  FindCookiesForKey(shard, key, url, options, current_time, cookies);
 
   // See if we can search for domain cookies, i.e. if the host has a TLD + 1.
   const std::string domain(
@@ -820,13 +997,14 @@ void CookieMonster::FindCookiesForHostAndDomain(
   // registrars other domains can, in which case we don't want to read their
   // cookies.
   for (key = "." + key; key.length() > domain.length(); ) {
-    FindCookiesForKey(key, url, options, current_time, cookies);
+    FindCookiesForKey(shard, key, url, options, current_time, cookies);
     const size_t next_dot = key.find('.', 1);  // Skip over leading dot.
     key.erase(0, next_dot);
   }
 }
 
 void CookieMonster::FindCookiesForKey(
+    Shard* shard,
     const std::string& key,
     const GURL& url,
     const CookieOptions& options,
@@ -834,7 +1012,7 @@ void CookieMonster::FindCookiesForKey(
     std::vector<CanonicalCookie*>* cookies) {
   bool secure = url.SchemeIsSecure();
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
+  for (CookieMapItPair its = shard->cookies.equal_range(key);
        its.first != its.second; ) {
     CookieMap::iterator curit = its.first;
     CanonicalCookie* cc = curit->second;
@@ -842,7 +1020,7 @@ void CookieMonster::FindCookiesForKey(
 
     // If the cookie is expired, delete it.
     if (cc->IsExpired(current)) {
-      InternalDeleteCookie(curit, true);
+      InternalDeleteCookie(shard, curit, true);
       continue;
     }
 
@@ -8,10 +8,12 @@
 #define NET_BASE_COOKIE_MONSTER_H_
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/lock.h"
 #include "base/time.h"
@@ -26,7 +28,9 @@ namespace net {
 // interface.
 //
 // This class IS thread-safe. Normally, it is only used on the I/O thread, but
-// is also accessed directly through Automation for UI testing.
+// is also accessed directly through Automation for UI testing.  The cookies
+// are split in shards by registry-controlled domain, each with its own lock,
+// so that requests for different sites don't wait on each other.
 //
 // TODO(deanm) Implement CookieMonster, the cookie database.
 //  - Verify that our domain enforcement and non-dotted handling is correct
@@ -72,7 +76,9 @@ class CookieMonster {
 
 #ifdef UNIT_TEST
   CookieMonster(int last_access_threshold_seconds)
-      : initialized_(false),
+      : num_cookies_(0),
+        initialized_(0),
+        loading_incrementally_(0),
         store_(NULL),
         last_access_threshold_(
             base::TimeDelta::FromSeconds(last_access_threshold_seconds)) {
@@ -146,30 +152,77 @@ class CookieMonster {
   static void EnableFileScheme();
   static bool enable_file_scheme_;
 
+  // Returns the registry-controlled domain of the cookie key |key| (a host, or
+  // a domain with a leading dot), or the host itself if it has none.  All the
+  // cookies that can match a URL have the same domain.
+  static std::string GetKeyDomain(const std::string& key);
+
  private:
+  // The cookies whose keys have the same registry-controlled domain (see
+  // RegistryControlledDomainService), which are all the cookies that can
+  // match a given URL.
+  struct Shard {
+    CookieMap cookies;
+
+    // The domains whose cookies were read from the store, while it loads
+    // incrementally.
+    std::set<std::string> loaded_domains;
+
+    // Guards |cookies|, |loaded_domains| and the cookies themselves.
+    Lock lock;
+  };
+
+  // A cookie, with the shard that holds it.
+  typedef std::pair<Shard*, CookieMap::iterator> CookieRef;
+
+  static const int kNumShards = 16;
+
   // Called by all non-static functions to ensure that the cookies store has
   // been initialized. This is not done during creating so it doesn't block
   // the window showing.
-  // Note: this method should always be called with lock_ held.
+  // Note: this method must not be called with a lock held.
   void InitIfNecessary() {
-    if (!initialized_) {
-      if (store_)
-        InitStore();
-      initialized_ = true;
-    }
+    if (!base::subtle::Acquire_Load(&initialized_))
+      InitStoreOnce();
   }
 
-  // Initializes the backing store and reads existing cookies from it.
-  // Should only be called by InitIfNecessary().
-  void InitStore();
+  // Initializes the backing store and reads existing cookies from it, unless
+  // another thread already did.  Should only be called by InitIfNecessary().
+  void InitStoreOnce();
 
   void SetDefaultCookieableSchemes();
 
-  void FindCookiesForHostAndDomain(const GURL& url,
+  // Returns the shard for the cookies of |domain|, as returned by
+  // GetKeyDomain().
+  Shard* GetShard(const std::string& domain);
+
+  void LockAllShards();
+  void UnlockAllShards();
+
+  // Inserts cookies read from the store.  The locks of their shards must be
+  // held.
+  void InsertLoadedCookies(const std::vector<KeyedCanonicalCookie>& cookies);
+
+  // Reads the cookies left in the store, if it loads incrementally.  Must be
+  // called with |lock_| and the locks of all the shards held.
+  void LoadAllDomains();
+
+  // Same as above, but takes the locks.  Must be called without any lock held.
+  void LoadAllDomainsIfNecessary();
+
+  // The following functions must be called with the lock of |shard| held.
+
+  // Reads the cookies of |domain| from the store, if it loads incrementally
+  // and they were not read yet.
+  void EnsureDomainLoaded(Shard* shard, const std::string& domain);
+
+  void FindCookiesForHostAndDomain(Shard* shard,
+                                   const GURL& url,
                                    const CookieOptions& options,
                                    std::vector<CanonicalCookie*>* cookies);
 
-  void FindCookiesForKey(const std::string& key,
+  void FindCookiesForKey(Shard* shard,
+                         const std::string& key,
                          const GURL& url,
                          const CookieOptions& options,
                          const base::Time& current,
@@ -179,25 +232,30 @@ class CookieMonster {
   // If |skip_httponly| is true, httponly cookies will not be deleted.  The
   // return value with be true if |skip_httponly| skipped an httponly cookie.
   // NOTE: There should never be more than a single matching equivalent cookie.
-  bool DeleteAnyEquivalentCookie(const std::string& key,
+  bool DeleteAnyEquivalentCookie(Shard* shard,
+                                 const std::string& key,
                                  const CanonicalCookie& ecc,
                                  bool skip_httponly);
 
-  void InternalInsertCookie(const std::string& key,
+  void InternalInsertCookie(Shard* shard,
+                            const std::string& key,
                             CanonicalCookie* cc,
                             bool sync_to_store);
 
   void InternalUpdateCookieAccessTime(CanonicalCookie* cc);
 
-  void InternalDeleteCookie(CookieMap::iterator it, bool sync_to_store);
+  void InternalDeleteCookie(Shard* shard,
+                            CookieMap::iterator it,
+                            bool sync_to_store);
 
-  // If the number of cookies for host |key|, or globally, are over preset
-  // maximums, garbage collects, first for the host and then globally, as
-  // described by GarbageCollectRange().  The limits can be found as constants
-  // at the top of the function body.
+  // If the number of cookies for host |key| is over the preset maximum,
+  // garbage collects as described by GarbageCollectRange().  The limits can be
+  // found as constants at the top of cookie_monster.cc.
   //
   // Returns the number of cookies deleted (useful for debugging).
-  int GarbageCollect(const base::Time& current, const std::string& key);
+  int GarbageCollect(const base::Time& current,
+                     Shard* shard,
+                     const std::string& key);
 
   // Deletes all expired cookies in |itpair|;
   // then, if the number of remaining cookies is greater than |num_max|,
@@ -206,31 +264,61 @@ class CookieMonster {
   //
   // Returns the number of cookies deleted.
   int GarbageCollectRange(const base::Time& current,
+                          Shard* shard,
                           const CookieMapItPair& itpair,
                           size_t num_max,
                           size_t num_purge);
 
   // Helper for GarbageCollectRange(); can be called directly as well.  Deletes
-  // all expired cookies in |itpair|.  If |cookie_its| is non-NULL, it is
+  // all expired cookies in |itpair|.  If |cookie_refs| is non-NULL, it is
   // populated with all the non-expired cookies from |itpair|.
   //
   // Returns the number of cookies deleted.
   int GarbageCollectExpired(const base::Time& current,
+                            Shard* shard,
                             const CookieMapItPair& itpair,
-                            std::vector<CookieMap::iterator>* cookie_its);
+                            std::vector<CookieRef>* cookie_refs);
+
+  // If |cookie_refs| holds more than |num_max| cookies, deletes the least
+  // recently accessed ones until (|num_max| - |num_purge|) remain.  The locks
+  // of all their shards must be held.
+  //
+  // Returns the number of cookies deleted.
+  int PurgeLeastRecentlyUsed(std::vector<CookieRef>* cookie_refs,
+                             size_t num_max,
+                             size_t num_purge);
+
+  // Orders the cookies from the least recently accessed to the most recently
+  // accessed.
+  static bool LRUCookieSorter(const CookieRef& ref1, const CookieRef& ref2);
+
+  // If the total number of cookies is over the preset maximum, garbage
+  // collects all the shards as described by GarbageCollectRange().  Must be
+  // called without any lock held.
+  //
+  // Returns the number of cookies deleted.
+  int GarbageCollectAllShards(const base::Time& current);
 
   bool HasCookieableScheme(const GURL& url);
 
-  CookieMap cookies_;
+  Shard shards_[kNumShards];
+
+  // The number of cookies in all the shards.
+  base::subtle::Atomic32 num_cookies_;
 
   // Indicates whether the cookie store has been initialized. This happens
-  // lazily in InitStoreIfNecessary().
-  bool initialized_;
+  // lazily in InitIfNecessary().  Set once, with |lock_| held.
+  base::subtle::Atomic32 initialized_;
+
+  // Indicates whether some cookies are still in the store.  Set during the
+  // initialization, and cleared with all the locks held.
+  base::subtle::Atomic32 loading_incrementally_;
 
   PersistentCookieStore* store_;
 
   // The resolution of our time isn't enough, so we do something
   // ugly and increment when we've seen the same time twice.
+  // Note: must be called with |lock_| held.
   base::Time CurrentTime();
   base::Time last_time_seen_;
 
@@ -240,7 +328,8 @@ class CookieMonster {
 
   std::vector<std::string> cookieable_schemes_;
 
-  // Lock for thread-safety
+  // Guards the initialization, |last_time_seen_| and the garbage collection of
+  // all the shards.  It must be acquired before the lock of any shard.
   Lock lock_;
 
   DISALLOW_COPY_AND_ASSIGN(CookieMonster);
@@ -386,9 +475,25 @@ class CookieMonster::PersistentCookieStore {
   virtual ~PersistentCookieStore() { }
 
   // Initializes the store and retrieves the existing cookies. This will be
-  // called only once at startup.
+  // called only once at startup.  A store that loads incrementally may
+  // retrieve only some of the cookies here.
   virtual bool Load(std::vector<CookieMonster::KeyedCanonicalCookie>*) = 0;
 
+  // Returns true if the store hands over the cookies that Load() did not
+  // retrieve one domain (see CookieMonster::GetKeyDomain()) at a time, through
+  // the functions below.  Called after Load().
+  virtual bool LoadsIncrementally() { return false; }
+
+  // Retrieves the cookies of |domain|, blocking until they are read.  Each
+  // cookie is retrieved only once.
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<CookieMonster::KeyedCanonicalCookie>* cookies) {}
+
+  // Retrieves all the cookies that were not retrieved yet.
+  virtual void LoadRemainingCookies(
+      std::vector<CookieMonster::KeyedCanonicalCookie>* cookies) {}
+
   virtual void AddCookie(const std::string&, const CanonicalCookie&) = 0;
   virtual void UpdateCookieAccessTime(const CanonicalCookie&) = 0;
   virtual void DeleteCookie(const CanonicalCookie&) = 0;
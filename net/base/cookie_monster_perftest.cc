@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "base/perftimer.h"
+#include "base/platform_thread.h"
 #include "base/string_util.h"
 #include "net/base/cookie_monster.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -11,6 +12,29 @@
 namespace {
   class ParsedCookieTest : public testing::Test { };
   class CookieMonsterTest : public testing::Test { };
+
+  // Reads the cookies of every URL in |urls|, |num_passes| times.
+  class CookieReaderThread : public PlatformThread::Delegate {
+   public:
+    CookieReaderThread(net::CookieMonster* cm,
+                       const std::vector<GURL>* urls,
+                       int num_passes)
+        : cm_(cm), urls_(urls), num_passes_(num_passes) {}
+
+    virtual void ThreadMain() {
+      for (int i = 0; i < num_passes_; ++i) {
+        for (std::vector<GURL>::const_iterator it = urls_->begin();
+             it != urls_->end(); ++it) {
+          cm_->GetCookies(*it);
+        }
+      }
+    }
+
+   private:
+    net::CookieMonster* cm_;
+    const std::vector<GURL>* urls_;
+    int num_passes_;
+  };
 }
 
 static const int kNumCookies = 20000;
@@ -93,3 +117,44 @@ TEST(CookieMonsterTest, TestAddCookieOnManyHosts) {
   cm.DeleteAll(false);
   timer3.Done();
 }
+
+static const int kNumReaderThreads = 4;
+
+TEST(CookieMonsterTest, TestQueryManyDomainsFromManyThreads) {
+  net::CookieMonster cm;
+  std::string cookie(kCookieLine);
+  // 10000 hosts in 100 registry-controlled domains, so the cookies are spread
+  // over the shards.  The store only keeps the most recently used ~3000.
+  std::vector<GURL> gurls;
+  for (int i = 0; i < 10000; ++i) {
+    gurls.push_back(GURL(StringPrintf("http://a%03d.b%02d.izzle",
+                                      i / 100, i % 100)));
+  }
+
+  PerfTimeLogger timer("Cookie_monster_add_many_domains");
+  for (std::vector<GURL>::const_iterator it = gurls.begin();
+       it != gurls.end(); ++it) {
+    EXPECT_TRUE(cm.SetCookie(*it, cookie));
+  }
+  timer.Done();
+
+  // The same amount of reads, first from one thread and then split between
+  // several threads.
+  PerfTimeLogger timer2("Cookie_monster_query_many_domains_one_thread");
+  CookieReaderThread reader(&cm, &gurls, kNumReaderThreads);
+  reader.ThreadMain();
+  timer2.Done();
+
+  PerfTimeLogger timer3("Cookie_monster_query_many_domains_many_threads");
+  CookieReaderThread thread_reader(&cm, &gurls, 1);
+  PlatformThreadHandle handles[kNumReaderThreads];
+  for (int i = 0; i < kNumReaderThreads; ++i)
+    ASSERT_TRUE(PlatformThread::Create(0, &thread_reader, &handles[i]));
+  for (int i = 0; i < kNumReaderThreads; ++i)
+    PlatformThread::Join(handles[i]);
+  timer3.Done();
+
+  PerfTimeLogger timer4("Cookie_monster_deleteall_many_domains");
+  cm.DeleteAll(false);
+  timer4.Done();
+}
@@ -8,6 +8,7 @@
 
 #include "base/basictypes.h"
 #include "base/platform_thread.h"
+#include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/time.h"
 #include "googleurl/src/gurl.h"
@@ -945,4 +946,157 @@ TEST(CookieMonsterTest, SetCookieableSchemes) {
   EXPECT_FALSE(cm_foo.SetCookie(http_url, "x=1"));
 }
 
+namespace {
+
+// Sets and reads cookies on its own domain.
+class CookieWriterThread : public PlatformThread::Delegate {
+ public:
+  CookieWriterThread(net::CookieMonster* cm, int index)
+      : cm_(cm), index_(index), num_errors_(0) {}
+
+  virtual void ThreadMain() {
+    GURL url(StringPrintf("http://www.thread%d.izzle", index_));
+    GURL subdomain_url(StringPrintf("http://a.www.thread%d.izzle", index_));
+    for (int i = 0; i < 50; ++i) {
+      std::string cookie = StringPrintf("a%02d=b", i);
+      if (!cm_->SetCookie(url, cookie + "; domain=.thread" +
+                               IntToString(index_) + ".izzle"))
+        num_errors_++;
+      if (cm_->GetCookies(subdomain_url).find(cookie) == std::string::npos)
+        num_errors_++;
+    }
+  }
+
+  int num_errors() const { return num_errors_; }
+
+ private:
+  net::CookieMonster* cm_;
+  int index_;
+  int num_errors_;
+};
+
+}  // namespace
+
+TEST(CookieMonsterTest, ConcurrentDomains) {
+  net::CookieMonster cm;
+  const int kNumThreads = 4;
+  CookieWriterThread* writers[kNumThreads];
+  PlatformThreadHandle handles[kNumThreads];
+  for (int i = 0; i < kNumThreads; ++i) {
+    writers[i] = new CookieWriterThread(&cm, i);
+    ASSERT_TRUE(PlatformThread::Create(0, writers[i], &handles[i]));
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(handles[i]);
+    EXPECT_EQ(0, writers[i]->num_errors());
+    delete writers[i];
+  }
+
+  EXPECT_EQ(static_cast<size_t>(kNumThreads * 50), cm.GetAllCookies().size());
+  // The cookies of each domain stay separate.
+  GURL url("http://www.thread0.izzle");
+  EXPECT_EQ(50, CountInString(cm.GetCookies(url), '='));
+  EXPECT_EQ(kNumThreads * 50, cm.DeleteAll(false));
+}
+
+namespace {
+
+// A store that hands over its cookies one domain at a time, and records the
+// domains it was asked for.
+class IncrementalCookieStore
+    : public net::CookieMonster::PersistentCookieStore {
+ public:
+  IncrementalCookieStore() : loaded_remaining_(false) {}
+
+  virtual ~IncrementalCookieStore() {
+    STLDeleteContainerPairSecondPointers(cookies_.begin(), cookies_.end());
+  }
+
+  void AddStoredCookie(const std::string& key, const std::string& name,
+                       const Time& creation) {
+    cookies_.push_back(net::CookieMonster::KeyedCanonicalCookie(key,
+        new net::CookieMonster::CanonicalCookie(
+            name, "1", "/", false, false, creation, creation, true,
+            creation + TimeDelta::FromDays(1))));
+  }
+
+  virtual bool Load(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    return true;
+  }
+  virtual bool LoadsIncrementally() { return true; }
+
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    loaded_domains_.push_back(domain);
+    std::vector<net::CookieMonster::KeyedCanonicalCookie> remaining;
+    for (size_t i = 0; i < cookies_.size(); ++i) {
+      if (net::CookieMonster::GetKeyDomain(cookies_[i].first) == domain)
+        cookies->push_back(cookies_[i]);
+      else
+        remaining.push_back(cookies_[i]);
+    }
+    cookies_.swap(remaining);
+  }
+
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    loaded_remaining_ = true;
+    cookies->insert(cookies->end(), cookies_.begin(), cookies_.end());
+    cookies_.clear();
+  }
+
+  virtual void AddCookie(const std::string&,
+                         const net::CookieMonster::CanonicalCookie&) {}
+  virtual void UpdateCookieAccessTime(
+      const net::CookieMonster::CanonicalCookie&) {}
+  virtual void DeleteCookie(const net::CookieMonster::CanonicalCookie&) {}
+
+  const std::vector<std::string>& loaded_domains() const {
+    return loaded_domains_;
+  }
+  bool loaded_remaining() const { return loaded_remaining_; }
+
+ private:
+  std::vector<net::CookieMonster::KeyedCanonicalCookie> cookies_;
+  std::vector<std::string> loaded_domains_;
+  bool loaded_remaining_;
+};
+
+}  // namespace
+
+TEST(CookieMonsterTest, IncrementalLoad) {
+  IncrementalCookieStore store;
+  Time now = Time::Now();
+  store.AddStoredCookie("www.google.izzle", "A", now);
+  store.AddStoredCookie(".google.izzle", "B", now + TimeDelta::FromSeconds(1));
+  store.AddStoredCookie("www.other.izzle", "C", now);
+
+  {
+    net::CookieMonster cm(&store);
+
+    // Only the domain of the URL is read.
+    EXPECT_EQ("A=1; B=1", cm.GetCookies(GURL(kUrlGoogle)));
+    ASSERT_EQ(1u, store.loaded_domains().size());
+    EXPECT_EQ("google.izzle", store.loaded_domains()[0]);
+
+    // It is read only once.
+    EXPECT_EQ("B=1", cm.GetCookies(GURL("http://mail.google.izzle")));
+    EXPECT_EQ(1u, store.loaded_domains().size());
+
+    // Setting a cookie reads the existing ones first.
+    EXPECT_TRUE(cm.SetCookie(GURL("http://www.other.izzle"), "C=2"));
+    EXPECT_EQ(2u, store.loaded_domains().size());
+    EXPECT_EQ("C=2", cm.GetCookies(GURL("http://www.other.izzle")));
+    EXPECT_FALSE(store.loaded_remaining());
+
+    // Listing the cookies reads all of them.
+    EXPECT_EQ(3u, cm.GetAllCookies().size());
+    EXPECT_TRUE(store.loaded_remaining());
+    EXPECT_EQ("A=1; B=1", cm.GetCookies(GURL(kUrlGoogle)));
+    EXPECT_EQ(2u, store.loaded_domains().size());
+  }
+}
+
 // TODO test overwrite cookie
@@ -0,0 +1,118 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_TRANSACTION_H_
+#define NET_BASE_DNS_TRANSACTION_H_
+
+#include <string>
+#include <vector>
+
+#include "build/build_config.h"
+
+#include "base/basictypes.h"
+#include "base/message_loop.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "net/base/address_list.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+// DnsTransaction resolves a hostname without blocking a thread: it sends the
+// A and AAAA queries in parallel to a nameserver over UDP, and waits for the
+// answers on the current MessageLoopForIO.  It is a stub resolver: the
+// nameserver has to do the recursion, and there is no support for search
+// domains, the hosts file or truncated answers.  Callers are expected to fall
+// back to getaddrinfo() when the transaction fails, including with
+// ERR_NAME_NOT_RESOLVED, since the name may be known to the hosts file.
+//
+// Only available on POSIX.
+class DnsTransaction : public MessageLoopForIO::Watcher {
+ public:
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // Called when the transaction completes.  On success, |result| is OK and
+    // |addrlist| holds the IPv4 addresses followed by the IPv6 ones.  |ttl| is
+    // how long the result (including an ERR_NAME_NOT_RESOLVED failure) may be
+    // cached.  The delegate may delete |transaction|.
+    virtual void OnDnsTransactionComplete(DnsTransaction* transaction,
+                                          int result,
+                                          const AddressList& addrlist,
+                                          base::TimeDelta ttl) = 0;
+  };
+
+  // The time to wait for the answers before sending the queries again, and
+  // the number of times they are sent before giving up with ERR_TIMED_OUT.
+  static const int kTimeoutMs;
+  static const int kMaxAttempts;
+
+  // |nameserver| is the address of the server to query, including its port.
+  DnsTransaction(const std::string& hostname, const AddressList& nameserver,
+                 Delegate* delegate);
+  virtual ~DnsTransaction();
+
+  // Sends the queries.  Returns ERR_IO_PENDING if the delegate will be called,
+  // or a network error if the queries could not be sent.
+  int Start();
+
+  const std::string& hostname() const { return hostname_; }
+
+  // MessageLoopForIO::Watcher methods:
+  virtual void OnFileCanReadWithoutBlocking(int fd);
+  virtual void OnFileCanWriteWithoutBlocking(int fd) {}
+
+ private:
+  struct Query {
+    explicit Query(uint16 qtype)
+        : qtype(qtype), id(0), result(ERR_IO_PENDING) {}
+
+    uint16 qtype;
+    uint16 id;
+    std::string packet;
+
+    // ERR_IO_PENDING until the answer is received.
+    int result;
+    std::vector<std::string> addresses;
+    base::TimeDelta ttl;
+  };
+
+  // Sends the queries that are not answered yet.
+  int SendQueries();
+
+  void OnTimeout();
+
+  // Runs the delegate once all the queries are answered, or one of them
+  // failed.
+  void MaybeComplete();
+  void Complete(int result, const AddressList& addrlist, base::TimeDelta ttl);
+
+  void CloseSocket();
+
+  const std::string hostname_;
+  const AddressList nameserver_;
+  Delegate* delegate_;
+
+  int socket_;
+  MessageLoopForIO::FileDescriptorWatcher read_watcher_;
+  base::OneShotTimer<DnsTransaction> timer_;
+  int attempts_;
+
+  std::vector<Query> queries_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsTransaction);
+};
+
+#if defined(OS_LINUX)
+// Returns the address of the first nameserver of the system configuration
+// (/etc/resolv.conf), with its port, or false if there is none.  The other
+// platforms don't keep their configuration there, so the asynchronous
+// resolver is only used on Linux.
+bool GetSystemNameserver(AddressList* nameserver);
+#endif
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_TRANSACTION_H_
@@ -0,0 +1,268 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_transaction.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(OS_LINUX)
+#include <resolv.h>
+#endif
+
+#include <algorithm>
+
+#include "base/eintr_wrapper.h"
+#include "base/logging.h"
+#include "base/rand_util.h"
+#include "net/base/dns_util.h"
+
+namespace net {
+
+namespace {
+
+// Without EDNS, answers over UDP are limited to 512 bytes.
+const int kMaxPacketSize = 512;
+
+int SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (-1 == flags)
+    return flags;
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Returns an AddressList for |addresses|, which are raw IPv4 or IPv6
+// addresses as returned by ParseDnsResponse().
+AddressList CreateAddressList(const std::vector<std::string>& addresses) {
+  std::vector<struct addrinfo> infos(addresses.size());
+  std::vector<struct sockaddr_in> ipv4_addrs(addresses.size());
+  std::vector<struct sockaddr_in6> ipv6_addrs(addresses.size());
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    struct addrinfo* ai = &infos[i];
+    memset(ai, 0, sizeof(*ai));
+    ai->ai_socktype = SOCK_STREAM;
+    ai->ai_protocol = IPPROTO_TCP;
+    if (addresses[i].size() == sizeof(struct in_addr)) {
+      struct sockaddr_in* addr = &ipv4_addrs[i];
+      memset(addr, 0, sizeof(*addr));
+      addr->sin_family = AF_INET;
+      memcpy(&addr->sin_addr, addresses[i].data(), addresses[i].size());
+      ai->ai_family = AF_INET;
+      ai->ai_addrlen = sizeof(*addr);
+      ai->ai_addr = reinterpret_cast<struct sockaddr*>(addr);
+    } else {
+      DCHECK_EQ(sizeof(struct in6_addr), addresses[i].size());
+      struct sockaddr_in6* addr = &ipv6_addrs[i];
+      memset(addr, 0, sizeof(*addr));
+      addr->sin6_family = AF_INET6;
+      memcpy(&addr->sin6_addr, addresses[i].data(), addresses[i].size());
+      ai->ai_family = AF_INET6;
+      ai->ai_addrlen = sizeof(*addr);
+      ai->ai_addr = reinterpret_cast<struct sockaddr*>(addr);
+    }
+    if (i > 0)
+      infos[i - 1].ai_next = ai;
+  }
+
+  AddressList addrlist;
+  if (!infos.empty())
+    addrlist.Copy(&infos[0]);
+  return addrlist;
+}
+
+}  // namespace
+
+// static
+const int DnsTransaction::kTimeoutMs = 1000;
+
+// static
+const int DnsTransaction::kMaxAttempts = 2;
+
+DnsTransaction::DnsTransaction(const std::string& hostname,
+                               const AddressList& nameserver,
+                               Delegate* delegate)
+    : hostname_(hostname),
+      nameserver_(nameserver),
+      delegate_(delegate),
+      socket_(-1),
+      attempts_(0) {
+  DCHECK(delegate_);
+  queries_.push_back(Query(kDNS_A));
+  queries_.push_back(Query(kDNS_AAAA));
+}
+
+DnsTransaction::~DnsTransaction() {
+  CloseSocket();
+}
+
+int DnsTransaction::Start() {
+  DCHECK_EQ(-1, socket_);
+
+  for (size_t i = 0; i < queries_.size(); ++i) {
+    Query& query = queries_[i];
+    // A random ID makes it harder to spoof the answers.
+    query.id = static_cast<uint16>(base::RandInt(0, kuint16max));
+    if (!BuildDnsQuery(query.id, hostname_, query.qtype, &query.packet))
+      return ERR_INVALID_ARGUMENT;
+  }
+
+  // Connecting the socket makes the kernel drop datagrams from other hosts.
+  const struct addrinfo* ai = nameserver_.head();
+  socket_ = socket(ai->ai_family, SOCK_DGRAM, 0);
+  if (socket_ < 0)
+    return ERR_FAILED;
+  if (SetNonBlocking(socket_) ||
+      HANDLE_EINTR(connect(socket_, ai->ai_addr, ai->ai_addrlen)) ||
+      !MessageLoopForIO::current()->WatchFileDescriptor(
+          socket_, true, MessageLoopForIO::WATCH_READ, &read_watcher_, this)) {
+    DLOG(INFO) << "Could not set up the DNS socket: " << errno;
+    CloseSocket();
+    return ERR_FAILED;
+  }
+
+  int rv = SendQueries();
+  if (rv != ERR_IO_PENDING)
+    CloseSocket();
+  return rv;
+}
+
+void DnsTransaction::OnFileCanReadWithoutBlocking(int fd) {
+  char packet[kMaxPacketSize];
+  for (;;) {
+    int len = HANDLE_EINTR(recv(socket_, packet, sizeof(packet), 0));
+    if (len < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      // Most likely an ICMP port unreachable from the nameserver.
+      Complete(ERR_FAILED, AddressList(), base::TimeDelta());
+      return;
+    }
+
+    // Datagrams that don't answer a pending query are dropped.
+    for (size_t i = 0; i < queries_.size(); ++i) {
+      Query& query = queries_[i];
+      if (query.result != ERR_IO_PENDING)
+        continue;
+      int rv = ParseDnsResponse(packet, len, query.id, hostname_, query.qtype,
+                                &query.addresses, &query.ttl);
+      if (rv != ERR_INVALID_RESPONSE) {
+        query.result = rv;
+        break;
+      }
+    }
+  }
+
+  MaybeComplete();
+}
+
+int DnsTransaction::SendQueries() {
+  attempts_++;
+  for (size_t i = 0; i < queries_.size(); ++i) {
+    const Query& query = queries_[i];
+    if (query.result != ERR_IO_PENDING)
+      continue;
+    int rv = HANDLE_EINTR(send(socket_, query.packet.data(),
+                               query.packet.size(), 0));
+    if (rv < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      DLOG(INFO) << "Could not send a DNS query: " << errno;
+      return ERR_FAILED;
+    }
+    // A query that could not be sent right away is sent again on timeout.
+  }
+
+  timer_.Start(base::TimeDelta::FromMilliseconds(kTimeoutMs), this,
+               &DnsTransaction::OnTimeout);
+  return ERR_IO_PENDING;
+}
+
+void DnsTransaction::OnTimeout() {
+  int rv = ERR_TIMED_OUT;
+  if (attempts_ < kMaxAttempts)
+    rv = SendQueries();
+  if (rv != ERR_IO_PENDING)
+    Complete(rv, AddressList(), base::TimeDelta());
+}
+
+void DnsTransaction::MaybeComplete() {
+  // An error for one of the queries decides the result, because the name
+  // doesn't exist or the server can't be trusted with it.
+  for (size_t i = 0; i < queries_.size(); ++i) {
+    const Query& query = queries_[i];
+    if (query.result == ERR_IO_PENDING || query.result == OK)
+      continue;
+    Complete(query.result, AddressList(), query.ttl);
+    return;
+  }
+
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  base::TimeDelta negative_ttl;
+  bool has_negative_ttl = false;
+  for (size_t i = 0; i < queries_.size(); ++i) {
+    const Query& query = queries_[i];
+    if (query.result == ERR_IO_PENDING)
+      return;
+    if (query.addresses.empty()) {
+      negative_ttl = has_negative_ttl ? std::min(negative_ttl, query.ttl) :
+                                        query.ttl;
+      has_negative_ttl = true;
+      continue;
+    }
+    ttl = addresses.empty() ? query.ttl : std::min(ttl, query.ttl);
+    addresses.insert(addresses.end(), query.addresses.begin(),
+                     query.addresses.end());
+  }
+
+  // The name exists, but has no address.
+  if (addresses.empty()) {
+    Complete(ERR_NAME_NOT_RESOLVED, AddressList(), negative_ttl);
+    return;
+  }
+
+  Complete(OK, CreateAddressList(addresses), ttl);
+}
+
+void DnsTransaction::Complete(int result, const AddressList& addrlist,
+                              base::TimeDelta ttl) {
+  timer_.Stop();
+  CloseSocket();
+  delegate_->OnDnsTransactionComplete(this, result, addrlist, ttl);
+  // |this| may be deleted.
+}
+
+void DnsTransaction::CloseSocket() {
+  if (socket_ < 0)
+    return;
+  read_watcher_.StopWatchingFileDescriptor();
+  HANDLE_EINTR(close(socket_));
+  socket_ = -1;
+}
+
+#if defined(OS_LINUX)
+bool GetSystemNameserver(AddressList* nameserver) {
+  struct __res_state res;
+  memset(&res, 0, sizeof(res));
+  if (res_ninit(&res))
+    return false;
+
+  bool found = res.nscount > 0;
+  if (found) {
+    struct addrinfo ai;
+    memset(&ai, 0, sizeof(ai));
+    ai.ai_family = AF_INET;
+    ai.ai_socktype = SOCK_DGRAM;
+    ai.ai_addrlen = sizeof(res.nsaddr_list[0]);
+    ai.ai_addr = reinterpret_cast<struct sockaddr*>(&res.nsaddr_list[0]);
+    nameserver->Copy(&ai);
+  }
+  res_nclose(&res);
+  return found;
+}
+#endif
+
+}  // namespace net
@@ -0,0 +1,235 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_transaction.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/eintr_wrapper.h"
+#include "base/message_loop.h"
+#include "base/ref_counted.h"
+#include "net/base/address_list.h"
+#include "net/base/dns_util.h"
+#include "net/base/dns_util_unittest.h"
+#include "net/base/host_resolver.h"
+#include "net/base/host_resolver_unittest.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/test_completion_callback.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// Returns an AddressList for 127.0.0.1:|port|.
+AddressList LocalAddress(int port) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  struct addrinfo ai;
+  memset(&ai, 0, sizeof(ai));
+  ai.ai_family = AF_INET;
+  ai.ai_socktype = SOCK_DGRAM;
+  ai.ai_addrlen = sizeof(addr);
+  ai.ai_addr = reinterpret_cast<struct sockaddr*>(&addr);
+
+  AddressList addrlist;
+  addrlist.Copy(&ai);
+  return addrlist;
+}
+
+// Returns a UDP socket bound to an ephemeral port of the loopback interface,
+// and sets |port| to that port.
+int BindLocalSocket(int* port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  EXPECT_GE(fd, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(0, bind(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                    sizeof(addr)));
+  socklen_t addr_len = sizeof(addr);
+  EXPECT_EQ(0, getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                           &addr_len));
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+// A nameserver that knows two names: "www.example.com", which has one IPv4
+// and one IPv6 address, and "nx.example.com", which does not exist.
+class FakeDnsServer : public MessageLoopForIO::Watcher {
+ public:
+  FakeDnsServer() : query_count_(0) {
+    socket_ = BindLocalSocket(&port_);
+    MessageLoopForIO::current()->WatchFileDescriptor(
+        socket_, true, MessageLoopForIO::WATCH_READ, &watcher_, this);
+  }
+
+  virtual ~FakeDnsServer() {
+    watcher_.StopWatchingFileDescriptor();
+    HANDLE_EINTR(close(socket_));
+  }
+
+  AddressList address() const { return LocalAddress(port_); }
+  int query_count() const { return query_count_; }
+
+  virtual void OnFileCanReadWithoutBlocking(int fd) {
+    char buf[512];
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    int len = HANDLE_EINTR(recvfrom(socket_, buf, sizeof(buf), 0,
+                                    reinterpret_cast<struct sockaddr*>(&from),
+                                    &from_len));
+    if (len < 16)
+      return;
+    query_count_++;
+
+    std::string query(buf, len);
+    std::string response = Answer(query);
+    HANDLE_EINTR(sendto(socket_, response.data(), response.size(), 0,
+                        reinterpret_cast<struct sockaddr*>(&from), from_len));
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int fd) {}
+
+ private:
+  static std::string Answer(const std::string& query) {
+    // The question name sits between the header and the type and class.
+    std::string qname = query.substr(12, query.size() - 16);
+    uint16 qtype = static_cast<uint8>(query[query.size() - 3]);
+
+    std::string www;
+    EXPECT_TRUE(DNSDomainFromDot("www.example.com", &www));
+    if (qname != www) {
+      return MakeDnsResponse(query, 3, 0, 1, MakeDnsSOARecord(900, 600));
+    }
+    if (qtype == kDNS_A) {
+      return MakeDnsResponse(query, 0, 1, 0, MakeDnsRecord(
+          kDNS_A, 120, std::string("\x0a\x00\x00\x01", 4)));
+    }
+    std::string ipv6("\x20\x01\x0d\xb8", 4);  // 2001:db8::1
+    ipv6.append(11, '\0');
+    ipv6.push_back(1);
+    return MakeDnsResponse(query, 0, 1, 0, MakeDnsRecord(kDNS_AAAA, 60, ipv6));
+  }
+
+  int socket_;
+  int port_;
+  MessageLoopForIO::FileDescriptorWatcher watcher_;
+  int query_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeDnsServer);
+};
+
+class DnsTransactionTest : public testing::Test,
+                           public DnsTransaction::Delegate {
+ public:
+  DnsTransactionTest() : result_(ERR_UNEXPECTED) {}
+
+  virtual void OnDnsTransactionComplete(DnsTransaction* transaction,
+                                        int result,
+                                        const AddressList& addrlist,
+                                        base::TimeDelta ttl) {
+    result_ = result;
+    addrlist_ = addrlist;
+    ttl_ = ttl;
+    MessageLoop::current()->Quit();
+  }
+
+ protected:
+  int result_;
+  AddressList addrlist_;
+  base::TimeDelta ttl_;
+};
+
+TEST_F(DnsTransactionTest, Resolve) {
+  FakeDnsServer server;
+  DnsTransaction transaction("www.example.com", server.address(), this);
+  EXPECT_EQ(ERR_IO_PENDING, transaction.Start());
+  MessageLoop::current()->Run();
+
+  EXPECT_EQ(OK, result_);
+  EXPECT_EQ(2, server.query_count());
+  EXPECT_EQ(60, ttl_.InSeconds());
+
+  // The IPv4 address comes first.
+  const struct addrinfo* ai = addrlist_.head();
+  ASSERT_TRUE(ai != NULL);
+  EXPECT_EQ("10.0.0.1", NetAddressToString(ai));
+  ASSERT_TRUE(ai->ai_next != NULL);
+  EXPECT_EQ("2001:db8::1", NetAddressToString(ai->ai_next));
+  EXPECT_TRUE(ai->ai_next->ai_next == NULL);
+}
+
+TEST_F(DnsTransactionTest, NameError) {
+  FakeDnsServer server;
+  DnsTransaction transaction("nx.example.com", server.address(), this);
+  EXPECT_EQ(ERR_IO_PENDING, transaction.Start());
+  MessageLoop::current()->Run();
+
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, result_);
+  EXPECT_EQ(600, ttl_.InSeconds());
+  EXPECT_TRUE(addrlist_.head() == NULL);
+}
+
+TEST_F(DnsTransactionTest, InvalidName) {
+  FakeDnsServer server;
+  DnsTransaction transaction("www..example.com", server.address(), this);
+  EXPECT_EQ(ERR_INVALID_ARGUMENT, transaction.Start());
+}
+
+TEST_F(DnsTransactionTest, ServerUnreachable) {
+  // Nobody listens on the port once the socket is closed, so the queries get
+  // an ICMP port unreachable back.
+  int port;
+  int fd = BindLocalSocket(&port);
+  HANDLE_EINTR(close(fd));
+
+  DnsTransaction transaction("www.example.com", LocalAddress(port), this);
+  EXPECT_EQ(ERR_IO_PENDING, transaction.Start());
+  MessageLoop::current()->Run();
+
+  EXPECT_EQ(ERR_FAILED, result_);
+}
+
+// Checks that HostResolver caches NXDOMAIN answers of the DNS server, once
+// getaddrinfo() has failed to resolve the name as well.
+TEST_F(DnsTransactionTest, HostResolverCachesNameError) {
+  // The test suite maps every host to 127.0.0.1, which disables DNS queries.
+  scoped_refptr<HostMapper> old_mapper = SetHostMapper(NULL);
+
+  FakeDnsServer server;
+  scoped_refptr<HostResolver> resolver(new HostResolver);
+  resolver->set_async_dns_server(server.address());
+
+  HostResolver::RequestInfo info("nx.example.com", 80);
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  int rv = resolver->Resolve(info, &addrlist, &callback, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, callback.WaitForResult());
+  int query_count = server.query_count();
+  EXPECT_GT(query_count, 0);
+
+  // The second lookup is answered by the cache.
+  rv = resolver->Resolve(info, &addrlist, &callback, NULL);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, rv);
+  EXPECT_EQ(query_count, server.query_count());
+
+  SetHostMapper(old_mapper.get());
+}
+
+}  // namespace
+
+}  // namespace net
@@ -0,0 +1,220 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_util.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+const int kHeaderSize = 12;
+const int kMaxLabelLength = 63;
+const int kMaxNameLength = 255;
+
+// Size of the type, class, TTL and data length fields of a resource record.
+const int kRecordFixedSize = 10;
+
+const uint16 kClassIN = 1;
+
+// Header flags.
+const uint16 kFlagResponse = 0x8000;
+const uint16 kFlagTruncated = 0x0200;
+const uint16 kFlagRecursionDesired = 0x0100;
+const uint16 kRcodeMask = 0x000f;
+
+// Response codes.
+const uint16 kRcodeNoError = 0;
+const uint16 kRcodeNameError = 3;
+
+uint16 ReadUInt16(const char* p) {
+  const uint8* u = reinterpret_cast<const uint8*>(p);
+  return static_cast<uint16>((u[0] << 8) | u[1]);
+}
+
+uint32 ReadUInt32(const char* p) {
+  const uint8* u = reinterpret_cast<const uint8*>(p);
+  return (static_cast<uint32>(u[0]) << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+void AppendUInt16(uint16 value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xff));
+}
+
+// Returns the offset just past the (possibly compressed) name that starts at
+// |offset| in |packet|, or -1 if the name is malformed.
+int SkipName(const char* packet, int packet_len, int offset) {
+  while (offset < packet_len) {
+    uint8 length = static_cast<uint8>(packet[offset]);
+    if ((length & 0xc0) == 0xc0) {
+      // A pointer ends the name.
+      return offset + 2 <= packet_len ? offset + 2 : -1;
+    }
+    if (length & 0xc0)
+      return -1;
+    if (length == 0)
+      return offset + 1;
+    offset += 1 + length;
+  }
+  return -1;
+}
+
+// Returns true if the |len| bytes at |a| and |b| are the same, regardless of
+// case.  DNS names are case-insensitive.
+bool NamesEqual(const char* a, const char* b, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) !=
+        tolower(static_cast<unsigned char>(b[i])))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool DNSDomainFromDot(const std::string& dotted, std::string* out) {
+  std::string name;
+  size_t start = 0;
+  while (start < dotted.size()) {
+    size_t end = dotted.find('.', start);
+    if (end == std::string::npos)
+      end = dotted.size();
+    size_t label_length = end - start;
+    if (label_length == 0 || label_length > kMaxLabelLength)
+      return false;
+    name.push_back(static_cast<char>(label_length));
+    name.append(dotted, start, label_length);
+    start = end + 1;
+  }
+  if (name.empty())
+    return false;
+  name.push_back('\0');
+  if (name.size() > kMaxNameLength)
+    return false;
+
+  out->swap(name);
+  return true;
+}
+
+bool BuildDnsQuery(uint16 id, const std::string& hostname, uint16 qtype,
+                   std::string* packet) {
+  std::string qname;
+  if (!DNSDomainFromDot(hostname, &qname))
+    return false;
+
+  packet->clear();
+  AppendUInt16(id, packet);
+  AppendUInt16(kFlagRecursionDesired, packet);
+  AppendUInt16(1, packet);  // Question count.
+  AppendUInt16(0, packet);  // Answer count.
+  AppendUInt16(0, packet);  // Authority count.
+  AppendUInt16(0, packet);  // Additional count.
+  packet->append(qname);
+  AppendUInt16(qtype, packet);
+  AppendUInt16(kClassIN, packet);
+  return true;
+}
+
+int ParseDnsResponse(const char* packet, int packet_len, uint16 id,
+                     const std::string& hostname, uint16 qtype,
+                     std::vector<std::string>* addresses,
+                     base::TimeDelta* ttl) {
+  std::string qname;
+  if (!DNSDomainFromDot(hostname, &qname))
+    return ERR_INVALID_RESPONSE;
+
+  if (packet_len < kHeaderSize || ReadUInt16(packet) != id)
+    return ERR_INVALID_RESPONSE;
+  uint16 flags = ReadUInt16(packet + 2);
+  if (!(flags & kFlagResponse))
+    return ERR_INVALID_RESPONSE;
+
+  // The question must be the one we asked.
+  if (ReadUInt16(packet + 4) != 1)
+    return ERR_INVALID_RESPONSE;
+  int offset = kHeaderSize;
+  int qname_len = static_cast<int>(qname.size());
+  if (packet_len < offset + qname_len + 4 ||
+      !NamesEqual(packet + offset, qname.data(), qname_len) ||
+      ReadUInt16(packet + offset + qname_len) != qtype ||
+      ReadUInt16(packet + offset + qname_len + 2) != kClassIN) {
+    return ERR_INVALID_RESPONSE;
+  }
+  offset += qname_len + 4;
+
+  // A truncated answer would need a retry over TCP, which we don't do.
+  if (flags & kFlagTruncated)
+    return ERR_FAILED;
+  uint16 rcode = flags & kRcodeMask;
+  if (rcode != kRcodeNoError && rcode != kRcodeNameError)
+    return ERR_FAILED;
+
+  int answer_count = ReadUInt16(packet + 6);
+  int authority_count = ReadUInt16(packet + 8);
+  size_t expected_size = qtype == kDNS_A ? 4 : 16;
+
+  std::vector<std::string> found;
+  uint32 min_ttl = kuint32max;
+  // Without an SOA record, negative answers are not to be cached.
+  uint32 negative_ttl = 0;
+  bool has_soa = false;
+  for (int i = 0; i < answer_count + authority_count; ++i) {
+    offset = SkipName(packet, packet_len, offset);
+    if (offset < 0 || offset + kRecordFixedSize > packet_len)
+      return ERR_INVALID_RESPONSE;
+    uint16 type = ReadUInt16(packet + offset);
+    uint16 record_class = ReadUInt16(packet + offset + 2);
+    uint32 record_ttl = ReadUInt32(packet + offset + 4);
+    int data_len = ReadUInt16(packet + offset + 8);
+    offset += kRecordFixedSize;
+    if (offset + data_len > packet_len)
+      return ERR_INVALID_RESPONSE;
+
+    // CNAME records that lead to the addresses are skipped, since the
+    // recursive server follows the chain for us.
+    if (record_class == kClassIN) {
+      if (i < answer_count && type == qtype) {
+        if (static_cast<size_t>(data_len) != expected_size)
+          return ERR_INVALID_RESPONSE;
+        found.push_back(std::string(packet + offset, data_len));
+        min_ttl = std::min(min_ttl, record_ttl);
+      } else if (i >= answer_count && type == kDNS_SOA && data_len >= 4) {
+        // The negative caching TTL is the smaller of the TTL of the SOA
+        // record and its MINIMUM field, which ends its data (RFC 2308).
+        uint32 minimum = ReadUInt32(packet + offset + data_len - 4);
+        negative_ttl = std::min(record_ttl, minimum);
+        has_soa = true;
+      }
+    }
+    offset += data_len;
+  }
+
+  if (has_soa) {
+    negative_ttl = std::min(std::max(negative_ttl, kDnsMinTtlSeconds),
+                            kDnsMaxNegativeTtlSeconds);
+  }
+
+  if (rcode == kRcodeNameError) {
+    *ttl = base::TimeDelta::FromSeconds(negative_ttl);
+    return ERR_NAME_NOT_RESOLVED;
+  }
+
+  if (found.empty()) {
+    *ttl = base::TimeDelta::FromSeconds(negative_ttl);
+  } else {
+    min_ttl = std::min(std::max(min_ttl, kDnsMinTtlSeconds), kDnsMaxTtlSeconds);
+    *ttl = base::TimeDelta::FromSeconds(min_ttl);
+    addresses->insert(addresses->end(), found.begin(), found.end());
+  }
+  return OK;
+}
+
+}  // namespace net
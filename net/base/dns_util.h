@@ -0,0 +1,66 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_UTIL_H_
+#define NET_BASE_DNS_UTIL_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+
+namespace net {
+
+// Helpers to build DNS queries and parse the answers, as described in
+// RFC 1035.  Only what a stub resolver needs for address lookups is
+// supported.
+
+// DNS record types.
+static const uint16 kDNS_A = 1;
+static const uint16 kDNS_CNAME = 5;
+static const uint16 kDNS_SOA = 6;
+static const uint16 kDNS_AAAA = 28;
+
+// The TTLs of the answers are kept within these bounds, in seconds, so that a
+// server can neither make us query it for every request nor keep a stale
+// answer around for days.  RFC 2308 recommends caching negative answers for
+// three hours at most.
+static const uint32 kDnsMinTtlSeconds = 10;
+static const uint32 kDnsMaxTtlSeconds = 24 * 60 * 60;
+static const uint32 kDnsMaxNegativeTtlSeconds = 3 * 60 * 60;
+
+// Converts a dotted hostname, like "www.google.com", into the sequence of
+// length-prefixed labels used by DNS.  Returns false if |dotted| is not a valid
+// DNS name.
+bool DNSDomainFromDot(const std::string& dotted, std::string* out);
+
+// Builds the packet of a recursive query for the |qtype| records of
+// |hostname|, using |id| as the query ID.  Returns false if |hostname| is not
+// a valid DNS name.
+bool BuildDnsQuery(uint16 id, const std::string& hostname, uint16 qtype,
+                   std::string* packet);
+
+// Parses |packet|, which is a response to the query built by BuildDnsQuery()
+// with the same |id|, |hostname| and |qtype|.  Returns:
+//   OK on a successful answer.  The addresses of the records of type |qtype|
+//       are appended to |addresses|, in network order (4 bytes for A records,
+//       16 bytes for AAAA records), and |ttl| is set to their smallest TTL.
+//       If there is no such record, |ttl| is set to the negative caching TTL
+//       of RFC 2308.
+//   ERR_NAME_NOT_RESOLVED if the name does not exist.  |ttl| is set to the
+//       negative caching TTL.
+// The TTLs are clamped to the bounds above.  A negative answer without an SOA
+// record gets a zero TTL, since it must not be cached.
+//   ERR_INVALID_RESPONSE if the packet is malformed, or is not a response to
+//       this query.  It should be ignored.
+//   ERR_FAILED if the server could not answer.
+int ParseDnsResponse(const char* packet, int packet_len, uint16 id,
+                     const std::string& hostname, uint16 qtype,
+                     std::vector<std::string>* addresses,
+                     base::TimeDelta* ttl);
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_UTIL_H_
@@ -0,0 +1,165 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_util.h"
+
+#include "net/base/dns_util_unittest.h"
+#include "net/base/net_errors.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const uint16 kQueryId = 0x1234;
+
+int Parse(const std::string& response, uint16 qtype,
+          std::vector<std::string>* addresses, base::TimeDelta* ttl) {
+  return ParseDnsResponse(response.data(), static_cast<int>(response.size()),
+                          kQueryId, "www.google.com", qtype, addresses, ttl);
+}
+
+std::string BuildQuery(uint16 qtype) {
+  std::string query;
+  EXPECT_TRUE(BuildDnsQuery(kQueryId, "www.google.com", qtype, &query));
+  return query;
+}
+
+}  // namespace
+
+TEST(DnsUtilTest, DNSDomainFromDot) {
+  std::string out;
+  EXPECT_TRUE(DNSDomainFromDot("www.google.com", &out));
+  EXPECT_EQ(std::string("\003www\006google\003com", 16), out);
+
+  EXPECT_TRUE(DNSDomainFromDot("localhost", &out));
+  EXPECT_EQ(std::string("\011localhost", 11), out);
+
+  EXPECT_FALSE(DNSDomainFromDot("", &out));
+  EXPECT_FALSE(DNSDomainFromDot(".", &out));
+  EXPECT_FALSE(DNSDomainFromDot("www..google.com", &out));
+  EXPECT_FALSE(DNSDomainFromDot(std::string(64, 'a') + ".com", &out));
+  EXPECT_TRUE(DNSDomainFromDot(std::string(63, 'a') + ".com", &out));
+}
+
+TEST(DnsUtilTest, BuildDnsQuery) {
+  std::string query = BuildQuery(kDNS_AAAA);
+  const char kExpected[] =
+      "\x12\x34"  // ID.
+      "\x01\x00"  // Recursion desired.
+      "\x00\x01\x00\x00\x00\x00\x00\x00"  // One question.
+      "\003www\006google\003com\000"
+      "\x00\x1c"  // AAAA.
+      "\x00\x01";  // IN.
+  EXPECT_EQ(std::string(kExpected, sizeof(kExpected) - 1), query);
+
+  EXPECT_FALSE(BuildDnsQuery(kQueryId, "www..google.com", kDNS_A, &query));
+}
+
+TEST(DnsUtilTest, ParseAddresses) {
+  std::string records =
+      MakeDnsRecord(kDNS_CNAME, 300, std::string("\003www\300\020", 6)) +
+      MakeDnsRecord(kDNS_A, 120, std::string("\x0a\x00\x00\x01", 4)) +
+      MakeDnsRecord(kDNS_A, 60, std::string("\x0a\x00\x00\x02", 4));
+  std::string response = MakeDnsResponse(BuildQuery(kDNS_A), 0, 3, 0, records);
+
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(OK, Parse(response, kDNS_A, &addresses, &ttl));
+  ASSERT_EQ(2u, addresses.size());
+  EXPECT_EQ(std::string("\x0a\x00\x00\x01", 4), addresses[0]);
+  EXPECT_EQ(std::string("\x0a\x00\x00\x02", 4), addresses[1]);
+  EXPECT_EQ(60, ttl.InSeconds());
+}
+
+TEST(DnsUtilTest, ParseNameError) {
+  std::string response = MakeDnsResponse(BuildQuery(kDNS_A), 3, 0, 1,
+                                         MakeDnsSOARecord(900, 600));
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_TRUE(addresses.empty());
+  EXPECT_EQ(600, ttl.InSeconds());
+
+  // Without an SOA record, the failure must not be cached.
+  response = MakeDnsResponse(BuildQuery(kDNS_A), 3, 0, 0, std::string());
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(0, ttl.InSeconds());
+}
+
+TEST(DnsUtilTest, ParseClampsTtl) {
+  std::string response = MakeDnsResponse(
+      BuildQuery(kDNS_A), 0, 1, 0,
+      MakeDnsRecord(kDNS_A, 0, std::string("\x0a\x00\x00\x01", 4)));
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(OK, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(static_cast<int64>(kDnsMinTtlSeconds), ttl.InSeconds());
+
+  response = MakeDnsResponse(
+      BuildQuery(kDNS_A), 0, 1, 0,
+      MakeDnsRecord(kDNS_A, kuint32max, std::string("\x0a\x00\x00\x01", 4)));
+  EXPECT_EQ(OK, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(static_cast<int64>(kDnsMaxTtlSeconds), ttl.InSeconds());
+
+  response = MakeDnsResponse(BuildQuery(kDNS_A), 3, 0, 1,
+                             MakeDnsSOARecord(0, 0));
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(static_cast<int64>(kDnsMinTtlSeconds), ttl.InSeconds());
+
+  response = MakeDnsResponse(BuildQuery(kDNS_A), 3, 0, 1,
+                             MakeDnsSOARecord(kuint32max, kuint32max));
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, Parse(response, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(static_cast<int64>(kDnsMaxNegativeTtlSeconds), ttl.InSeconds());
+}
+
+TEST(DnsUtilTest, ParseNoData) {
+  std::string response = MakeDnsResponse(BuildQuery(kDNS_AAAA), 0, 0, 1,
+                                         MakeDnsSOARecord(30, 600));
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(OK, Parse(response, kDNS_AAAA, &addresses, &ttl));
+  EXPECT_TRUE(addresses.empty());
+  EXPECT_EQ(30, ttl.InSeconds());
+}
+
+TEST(DnsUtilTest, ParseInvalidResponses) {
+  std::string query = BuildQuery(kDNS_A);
+  std::string records =
+      MakeDnsRecord(kDNS_A, 60, std::string("\x0a\x00\x00\x01", 4));
+  std::string response = MakeDnsResponse(query, 0, 1, 0, records);
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+
+  // Answer to another query.
+  std::string other_id(response);
+  other_id[1] = 0x35;
+  EXPECT_EQ(ERR_INVALID_RESPONSE, Parse(other_id, kDNS_A, &addresses, &ttl));
+  EXPECT_EQ(ERR_INVALID_RESPONSE, Parse(response, kDNS_AAAA, &addresses,
+                                        &ttl));
+
+  // The query itself.
+  EXPECT_EQ(ERR_INVALID_RESPONSE, Parse(query, kDNS_A, &addresses, &ttl));
+
+  // Truncated packet.
+  EXPECT_EQ(ERR_INVALID_RESPONSE,
+            Parse(response.substr(0, response.size() - 2), kDNS_A,
+                  &addresses, &ttl));
+  EXPECT_TRUE(addresses.empty());
+}
+
+TEST(DnsUtilTest, ParseServerFailure) {
+  std::string response = MakeDnsResponse(BuildQuery(kDNS_A), 2, 0, 0,
+                                         std::string());
+  std::vector<std::string> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(ERR_FAILED, Parse(response, kDNS_A, &addresses, &ttl));
+
+  // Truncated answers need TCP, which is not supported.
+  response = MakeDnsResponse(BuildQuery(kDNS_A), 0, 0, 0, std::string());
+  response[2] |= 0x02;
+  EXPECT_EQ(ERR_FAILED, Parse(response, kDNS_A, &addresses, &ttl));
+}
+
+}  // namespace net
@@ -0,0 +1,67 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_UTIL_UNITTEST_H_
+#define NET_BASE_DNS_UTIL_UNITTEST_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "net/base/dns_util.h"
+
+namespace net {
+
+// Helpers to build the DNS answers of fake servers in unit tests.
+
+inline void AppendDnsUInt16(uint16 value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xff));
+}
+
+inline void AppendDnsUInt32(uint32 value, std::string* out) {
+  AppendDnsUInt16(static_cast<uint16>(value >> 16), out);
+  AppendDnsUInt16(static_cast<uint16>(value & 0xffff), out);
+}
+
+// Returns a resource record for the name of the question, with |data| as its
+// content.
+inline std::string MakeDnsRecord(uint16 type, uint32 ttl,
+                                 const std::string& data) {
+  std::string record("\xc0\x0c", 2);  // Pointer to the question name.
+  AppendDnsUInt16(type, &record);
+  AppendDnsUInt16(1, &record);  // Class IN.
+  AppendDnsUInt32(ttl, &record);
+  AppendDnsUInt16(static_cast<uint16>(data.size()), &record);
+  record.append(data);
+  return record;
+}
+
+// Returns an SOA record, whose MINIMUM field is |minimum|.
+inline std::string MakeDnsSOARecord(uint32 ttl, uint32 minimum) {
+  // Root names for MNAME and RNAME, then SERIAL, REFRESH, RETRY and EXPIRE.
+  std::string data(2 + 4 * 4, '\0');
+  AppendDnsUInt32(minimum, &data);
+  return MakeDnsRecord(kDNS_SOA, ttl, data);
+}
+
+// Returns the response to |query| with the response code |rcode|.  |records|
+// holds |answer_count| answer records followed by |authority_count| authority
+// records.
+inline std::string MakeDnsResponse(const std::string& query, uint8 rcode,
+                                   int answer_count, int authority_count,
+                                   const std::string& records) {
+  std::string response(query);
+  response[2] = static_cast<char>(0x81);  // Response, recursion desired.
+  response[3] = static_cast<char>(0x80 | rcode);  // Recursion available.
+  std::string counts;
+  AppendDnsUInt16(static_cast<uint16>(answer_count), &counts);
+  AppendDnsUInt16(static_cast<uint16>(authority_count), &counts);
+  response.replace(6, 4, counts);
+  response.append(records);
+  return response;
+}
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_UTIL_UNITTEST_H_
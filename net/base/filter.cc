@@ -371,6 +371,10 @@ Filter::FilterStatus Filter::ReadData(char* dest_buffer, int* dest_len) {
 }
 
 void Filter::PushDataIntoNextFilter() {
+  if (HandDataToNextFilter()) {
+    last_status_ = FILTER_NEED_MORE_DATA;
+    return;
+  }
   net::IOBuffer* next_buffer = next_filter_->stream_buffer();
   int next_size = next_filter_->stream_buffer_size();
   last_status_ = ReadFilteredData(next_buffer->data(), &next_size);
@@ -378,6 +382,20 @@ void Filter::PushDataIntoNextFilter() {
     next_filter_->FlushStreamBuffer(next_size);
 }
 
+bool Filter::HandDataToNextFilter() {
+  // The buffers of a chain all have the size given by the filter context, so
+  // the next filter can take any slice of ours.
+  if (!IsPassThrough() || !stream_data_len_ || next_filter_->stream_data_len_ ||
+      next_filter_->stream_buffer_size_ != stream_buffer_size_)
+    return false;
+
+  stream_buffer_.swap(next_filter_->stream_buffer_);
+  next_filter_->next_stream_data_ = next_stream_data_;
+  next_filter_->stream_data_len_ = stream_data_len_;
+  next_stream_data_ = NULL;
+  stream_data_len_ = 0;
+  return true;
+}
 
 bool Filter::FlushStreamBuffer(int stream_data_len) {
   DCHECK(stream_data_len <= stream_buffer_size_);
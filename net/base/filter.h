@@ -218,6 +218,11 @@ class Filter {
   // Copy pre-filter data directly to destination buffer without decoding.
   FilterStatus CopyOut(char* dest_buffer, int* dest_len);
 
+  // Returns true if the filter would only CopyOut the rest of its pre-filter
+  // data, so that the data can be handed to the next filter of the chain
+  // without being copied.
+  virtual bool IsPassThrough() const { return false; }
+
   FilterStatus last_status() const { return last_status_; }
 
   const FilterContext& filter_context() const { return filter_context_; }
@@ -252,6 +257,10 @@ class Filter {
   // Helper function to empty our output into the next filter's input.
   void PushDataIntoNextFilter();
 
+  // Hands the rest of our pre-filter data to the next filter, by swapping our
+  // stream_buffer_ with its empty one.  Returns false if that is not possible.
+  bool HandDataToNextFilter();
+
   // An optional filter to process output from this filter.
   scoped_ptr<Filter> next_filter_;
   // Remember what status or local filter last returned so we can better handle
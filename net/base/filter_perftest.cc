@@ -0,0 +1,140 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/perftimer.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/filter.h"
+#include "net/base/filter_unittest.h"
+#include "net/base/io_buffer.h"
+#include "net/base/sdch_manager.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+// The size of the filter buffers, and of the reads of URLRequestJob.
+const int kBufferSize = 32 * 1024;
+
+// The number of table rows in the test page, which makes about 16MB of html.
+const int kNumRows = 250000;
+
+class FilterPerfTest : public testing::Test {
+ protected:
+  FilterPerfTest() : sdch_manager_(new SdchManager) {
+    sdch_manager_->EnableSdchSupport("");
+  }
+
+  virtual void SetUp() {
+    html_ = "<html><body><table>\n";
+    for (int i = 0; i < kNumRows; ++i) {
+      html_.append(StringPrintf(
+          "<tr><td class=\"name\">row %d</td><td>%d</td></tr>\n", i, i * 7));
+    }
+    html_.append("</table></body></html>\n");
+    gzipped_html_ = GZipCompress(html_);
+  }
+
+  // Compresses |input| with a gzip header and footer.
+  static std::string GZipCompress(const std::string& input) {
+    z_stream zlib_stream;
+    memset(&zlib_stream, 0, sizeof(zlib_stream));
+    int code = deflateInit2(&zlib_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                            MAX_WBITS + 16,  // Add a gzip wrapper.
+                            8,  // DEF_MEM_LEVEL
+                            Z_DEFAULT_STRATEGY);
+    CHECK(code == Z_OK);
+
+    std::string output(MOZ_Z_deflateBound(&zlib_stream, input.size()) + 32,
+                       '\0');
+    zlib_stream.next_in = bit_cast<Bytef*>(input.data());
+    zlib_stream.avail_in = input.size();
+    zlib_stream.next_out = bit_cast<Bytef*>(&output[0]);
+    zlib_stream.avail_out = output.size();
+    code = MOZ_Z_deflate(&zlib_stream, Z_FINISH);
+    CHECK(code == Z_STREAM_END);
+    output.resize(output.size() - zlib_stream.avail_out);
+    MOZ_Z_deflateEnd(&zlib_stream);
+    return output;
+  }
+
+  // Feeds |input| through a chain of |filter_types| the way URLRequestJob
+  // does, and logs the throughput of the chain in MB/s of output.
+  void RunFilterChain(const char* test_name,
+                      const std::vector<Filter::FilterType>& filter_types,
+                      const std::string& input) {
+    MockFilterContext filter_context(kBufferSize);
+    filter_context.SetURL(GURL("http://www.example.com/page.html"));
+    filter_context.SetMimeType("text/html");
+    filter_context.SetResponseCode(200);
+    scoped_ptr<Filter> filter(Filter::Factory(filter_types, filter_context));
+    ASSERT_TRUE(filter.get());
+
+    scoped_array<char> output_buffer(new char[kBufferSize]);
+    size_t input_index = 0;
+    size_t output_size = 0;
+    Filter::FilterStatus status = Filter::FILTER_NEED_MORE_DATA;
+
+    PerfTimer timer;
+    while (status != Filter::FILTER_DONE && status != Filter::FILTER_ERROR) {
+      if (!filter->stream_data_len()) {
+        if (input_index == input.size())
+          break;
+        int amount = std::min(static_cast<size_t>(filter->stream_buffer_size()),
+                              input.size() - input_index);
+        memcpy(filter->stream_buffer()->data(), input.data() + input_index,
+               amount);
+        filter->FlushStreamBuffer(amount);
+        input_index += amount;
+      }
+      int output_len = kBufferSize;
+      status = filter->ReadData(output_buffer.get(), &output_len);
+      output_size += output_len;
+    }
+    double seconds = timer.Elapsed().InSecondsF();
+
+    EXPECT_NE(Filter::FILTER_ERROR, status);
+    EXPECT_EQ(html_.size(), output_size);
+    LogPerfResult(test_name,
+                  output_size / (1024.0 * 1024.0) / std::max(seconds, 0.001),
+                  "MB/s");
+  }
+
+  scoped_ptr<SdchManager> sdch_manager_;  // A singleton database.
+  std::string html_;
+  std::string gzipped_html_;
+};
+
+}  // namespace
+
+TEST_F(FilterPerfTest, GZip) {
+  std::vector<Filter::FilterType> filter_types;
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP);
+  RunFilterChain("Filter_gzip", filter_types, gzipped_html_);
+}
+
+// The chain of a response to a request that advertised an SDCH dictionary,
+// where the server only used gzip, so that the SDCH filter passes the gzip
+// output through.
+TEST_F(FilterPerfTest, SdchGZip) {
+  std::vector<Filter::FilterType> filter_types;
+  filter_types.push_back(Filter::FILTER_TYPE_SDCH);
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP);
+  RunFilterChain("Filter_sdch_gzip", filter_types, gzipped_html_);
+}
+
+// The same chain for an uncompressed response, where both filters pass the
+// data through, and the gzip filter hands its buffers to the SDCH filter.
+TEST_F(FilterPerfTest, SdchGZipPassThrough) {
+  std::vector<Filter::FilterType> filter_types;
+  filter_types.push_back(Filter::FILTER_TYPE_SDCH);
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP_HELPING_SDCH);
+  RunFilterChain("Filter_sdch_gzip_pass_through", filter_types, html_);
+}
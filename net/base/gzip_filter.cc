@@ -259,6 +259,14 @@ Filter::FilterStatus GZipFilter::DoInflate(char* dest_buffer, int* dest_len) {
   return status;
 }
 
+bool GZipFilter::IsPassThrough() const {
+  // Once decoding is done, only the footer is skipped before the extra data
+  // is copied out.
+  return decoding_status_ == DECODING_DONE &&
+      (GZIP_GET_INVALID_HEADER == gzip_header_status_ ||
+       gzip_footer_bytes_ >= kGZipFooterSize);
+}
+
 bool GZipFilter::InsertZlibHeader() {
   static char dummy_head[2] = { 0x78, 0x1 };
 
@@ -49,11 +49,22 @@ HostCache::Entry* HostCache::Set(const std::string& hostname,
                                  int error,
                                  const AddressList addrlist,
                                  base::TimeTicks now) {
+  // We don't know why the resolution failed, so don't reuse the failure.
+  base::TimeDelta ttl;
+  if (error == OK)
+    ttl = base::TimeDelta::FromMilliseconds(cache_duration_ms_);
+  return Set(hostname, error, addrlist, now, ttl);
+}
+
+HostCache::Entry* HostCache::Set(const std::string& hostname,
+                                 int error,
+                                 const AddressList addrlist,
+                                 base::TimeTicks now,
+                                 base::TimeDelta ttl) {
   if (caching_is_disabled())
     return NULL;
 
-  base::TimeTicks expiration = now +
-      base::TimeDelta::FromMilliseconds(cache_duration_ms_);
+  base::TimeTicks expiration = now + ttl;
 
   scoped_refptr<Entry>& entry = entries_[hostname];
   if (!entry) {
@@ -77,7 +88,7 @@ HostCache::Entry* HostCache::Set(const std::string& hostname,
 
 // static
 bool HostCache::CanUseEntry(const Entry* entry, const base::TimeTicks now) {
-  return entry->error == OK && entry->expiration > now;
+  return entry->expiration > now;
 }
 
 void HostCache::Compact(base::TimeTicks now, const Entry* pinned_entry) {
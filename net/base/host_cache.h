@@ -44,12 +44,22 @@ class HostCache {
   // Overwrites or creates an entry for |hostname|. Returns the pointer to the
   // entry, or NULL on failure (fails if caching is disabled).
   // (|error|, |addrlist|) is the value to set, and |now| is the current
-  // timestamp.
+  // timestamp.  The entry expires after the cache duration, unless it is a
+  // failure, which is never returned by Lookup().
   Entry* Set(const std::string& hostname,
              int error,
              const AddressList addrlist,
              base::TimeTicks now);
 
+  // Same as above, but the entry expires after |ttl|, even if it is a
+  // failure.  This is used for results that come with their own time to live,
+  // such as DNS records and NXDOMAIN answers.
+  Entry* Set(const std::string& hostname,
+             int error,
+             const AddressList addrlist,
+             base::TimeTicks now,
+             base::TimeDelta ttl);
+
   // Returns true if this HostCache can contain no entries.
   bool caching_is_disabled() const {
     return max_entries_ == 0;
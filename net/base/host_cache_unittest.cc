@@ -96,6 +96,36 @@ TEST(HostCacheTest, NegativeEntry) {
   EXPECT_EQ(NULL, cache.Lookup("foobar.com", now));
 }
 
+// Entries with an explicit TTL expire after it, even if they are failures.
+TEST(HostCacheTest, EntryWithTTL) {
+  HostCache cache(kMaxCacheEntries, kCacheDurationMs);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  cache.Set("foobar.com", ERR_NAME_NOT_RESOLVED, AddressList(), now,
+            base::TimeDelta::FromSeconds(3));
+  cache.Set("foobar2.com", OK, AddressList(), now,
+            base::TimeDelta::FromSeconds(30));
+  EXPECT_EQ(2U, cache.size());
+
+  const HostCache::Entry* entry1 = cache.Lookup("foobar.com", now);
+  ASSERT_FALSE(NULL == entry1);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, entry1->error);
+
+  // Advance to t=3; the negative entry is now expired.
+  now += base::TimeDelta::FromSeconds(3);
+  EXPECT_EQ(NULL, cache.Lookup("foobar.com", now));
+
+  // Advance to t=20; the TTL outlives the cache duration.
+  now += base::TimeDelta::FromSeconds(17);
+  EXPECT_FALSE(NULL == cache.Lookup("foobar2.com", now));
+
+  // A zero TTL makes the entry unusable right away.
+  cache.Set("foobar2.com", OK, AddressList(), now, base::TimeDelta());
+  EXPECT_EQ(NULL, cache.Lookup("foobar2.com", now));
+}
+
 TEST(HostCacheTest, Compact) {
   // Initial entries limit is big enough to accomadate everything we add.
   net::HostCache cache(kMaxCacheEntries, kCacheDurationMs);
@@ -8,6 +8,7 @@
 #include <ws2tcpip.h>
 #include <wspiapi.h>  // Needed for Win2k compat.
 #elif defined(OS_POSIX)
+#include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #endif
@@ -33,6 +34,10 @@
 #include "net/base/winsock_init.h"
 #endif
 
+#if defined(OS_POSIX)
+#include "net/base/dns_transaction.h"
+#endif
+
 namespace net {
 
 //-----------------------------------------------------------------------------
@@ -174,6 +179,15 @@ static int ResolveAddrInfo(HostMapper* mapper, const std::string& host,
   }
 }
 
+#if defined(OS_POSIX)
+// Returns true if |host| is an IPv4 or IPv6 address literal.
+static bool IsIPAddressLiteral(const std::string& host) {
+  struct in6_addr addr;
+  return inet_pton(AF_INET, host.c_str(), &addr) == 1 ||
+         inet_pton(AF_INET6, host.c_str(), &addr) == 1;
+}
+#endif
+
 //-----------------------------------------------------------------------------
 
 class HostResolver::Request {
@@ -244,8 +258,14 @@ class HostResolver::Request {
 //-----------------------------------------------------------------------------
 
 // This class represents a request to the worker pool for a "getaddrinfo()"
-// call.
-class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
+// call, or a DnsTransaction when the resolver uses asynchronous DNS.
+class HostResolver::Job
+#if defined(OS_POSIX)
+    : public base::RefCountedThreadSafe<HostResolver::Job>,
+      public DnsTransaction::Delegate {
+#else
+    : public base::RefCountedThreadSafe<HostResolver::Job> {
+#endif
  public:
   Job(HostResolver* resolver, const std::string& host)
       : host_(host),
@@ -253,7 +273,8 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
         origin_loop_(MessageLoop::current()),
         host_mapper_(host_mapper),
         error_(OK),
-        results_(NULL) {
+        results_(NULL),
+        has_ttl_(false) {
   }
 
   ~Job() {
@@ -273,7 +294,20 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
 
   // Called from origin loop.
   void Start() {
-    // Dispatch the job to a worker thread.
+#if defined(OS_POSIX)
+    if (resolver_->ShouldUseAsyncDns(host_)) {
+      transaction_.reset(
+          new DnsTransaction(host_, resolver_->async_dns_server_, this));
+      if (transaction_->Start() == ERR_IO_PENDING)
+        return;
+      transaction_.reset();
+    }
+#endif
+    StartLookup();
+  }
+
+  // Dispatches the job to a worker thread for a "getaddrinfo()" call.
+  void StartLookup() {
     if (!WorkerPool::PostTask(FROM_HERE,
             NewRunnableMethod(this, &Job::DoLookup), true)) {
       NOTREACHED();
@@ -292,6 +326,10 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
     HostResolver* resolver = resolver_;
     resolver_ = NULL;
 
+#if defined(OS_POSIX)
+    transaction_.reset();
+#endif
+
     // Mark the job as cancelled, so when worker thread completes it will
     // not try to post completion to origin loop.
     {
@@ -326,6 +364,52 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
     return requests_;
   }
 
+  // Called from origin thread.  Returns true if the result comes with its own
+  // time to live, |ttl()|, rather than the cache default.
+  bool has_ttl() const {
+    return has_ttl_;
+  }
+
+  base::TimeDelta ttl() const {
+    return ttl_;
+  }
+
+#if defined(OS_POSIX)
+  // DnsTransaction::Delegate methods:
+  virtual void OnDnsTransactionComplete(DnsTransaction* transaction,
+                                        int result,
+                                        const AddressList& addrlist,
+                                        base::TimeDelta ttl) {
+    DCHECK_EQ(transaction_.get(), transaction);
+    transaction_.reset();
+
+    if (result != OK) {
+      // The nameserver couldn't answer, but getaddrinfo() may know better.
+      // That includes names that don't exist in DNS, since the hosts file and
+      // the other NSS sources have the last word.  If getaddrinfo() fails as
+      // well, the failure is cached for the negative TTL of the answer.
+      if (result == ERR_NAME_NOT_RESOLVED)
+        negative_ttl_ = ttl;
+      StartLookup();
+      return;
+    }
+
+    DCHECK(!was_cancelled());
+    DCHECK(!requests_.empty());
+    has_ttl_ = true;
+    ttl_ = ttl;
+
+    // Use the port number of the first request, as OnLookupComplete() does.
+    AddressList result_addrlist;
+    if (result == OK)
+      result_addrlist.SetFrom(addrlist, requests_[0]->port());
+
+    // The resolver drops its reference to |this| in OnJobComplete().
+    scoped_refptr<Job> keep_alive(this);
+    resolver_->OnJobComplete(this, result, result_addrlist);
+  }
+#endif
+
  private:
   void DoLookup() {
     // Running on the worker thread
@@ -360,6 +444,14 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
 
     DCHECK(!requests_.empty());
 
+    // The DNS server said that the name doesn't exist, and getaddrinfo()
+    // agrees.
+    if (error_ == ERR_NAME_NOT_RESOLVED &&
+        negative_ttl_ > base::TimeDelta()) {
+      has_ttl_ = true;
+      ttl_ = negative_ttl_;
+    }
+
      // Adopt the address list using the port number of the first request.
     AddressList addrlist;
     if (error_ == OK) {
@@ -392,6 +484,14 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
   int error_;
   struct addrinfo* results_;
 
+  // Only used on the origin thread.
+  bool has_ttl_;
+  base::TimeDelta ttl_;
+  base::TimeDelta negative_ttl_;  // From an NXDOMAIN answer, if any.
+#if defined(OS_POSIX)
+  scoped_ptr<DnsTransaction> transaction_;
+#endif
+
   DISALLOW_COPY_AND_ASSIGN(Job);
 };
 
@@ -399,7 +499,7 @@ class HostResolver::Job : public base::RefCountedThreadSafe<HostResolver::Job> {
 
 HostResolver::HostResolver(int max_cache_entries, int cache_duration_ms)
     : cache_(max_cache_entries, cache_duration_ms), next_request_id_(0),
-      shutdown_(false) {
+      shutdown_(false), use_async_dns_(false) {
 #if defined(OS_WIN)
   EnsureWinsockInit();
 #endif
@@ -436,8 +536,9 @@ int HostResolver::Resolve(const RequestInfo& info,
     const HostCache::Entry* cache_entry = cache_.Lookup(
         info.hostname(), base::TimeTicks::Now());
     if (cache_entry) {
-      addresses->SetFrom(cache_entry->addrlist, info.port());
-      int error = OK;
+      int error = cache_entry->error;
+      if (error == OK)
+        addresses->SetFrom(cache_entry->addrlist, info.port());
 
       // Notify registered observers.
       NotifyObserversFinishRequest(request_id, info, error);
@@ -530,6 +631,25 @@ void HostResolver::Shutdown() {
   jobs_.clear();
 }
 
+#if defined(OS_POSIX)
+void HostResolver::set_async_dns_server(const AddressList& nameserver) {
+  use_async_dns_ = true;
+  async_dns_server_ = nameserver;
+}
+#endif
+
+bool HostResolver::ShouldUseAsyncDns(const std::string& hostname) const {
+#if defined(OS_POSIX)
+  // Names without a dot may need the search domains, and the host mapper of
+  // the unit tests only applies to getaddrinfo().
+  return use_async_dns_ && !host_mapper &&
+         hostname.find('.') != std::string::npos &&
+         !IsIPAddressLiteral(hostname);
+#else
+  return false;
+#endif
+}
+
 void HostResolver::AddOutstandingJob(Job* job) {
   scoped_refptr<Job>& found_job = jobs_[job->host()];
   DCHECK(!found_job);
@@ -557,7 +677,12 @@ void HostResolver::OnJobComplete(Job* job,
   RemoveOutstandingJob(job);
 
   // Write result to the cache.
-  cache_.Set(job->host(), error, addrlist, base::TimeTicks::Now());
+  if (job->has_ttl()) {
+    cache_.Set(job->host(), error, addrlist, base::TimeTicks::Now(),
+               job->ttl());
+  } else {
+    cache_.Set(job->host(), error, addrlist, base::TimeTicks::Now());
+  }
 
   // Make a note that we are executing within OnJobComplete() in case the
   // HostResolver is deleted by a callback invocation.
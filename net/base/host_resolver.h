@@ -12,6 +12,7 @@
 #include "base/lock.h"
 #include "base/ref_counted.h"
 #include "googleurl/src/gurl.h"
+#include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
 #include "net/base/host_cache.h"
 
@@ -19,7 +20,6 @@ class MessageLoop;
 
 namespace net {
 
-class AddressList;
 class HostMapper;
 
 // This class represents the task of resolving hostnames (or IP address
@@ -54,6 +54,10 @@ class HostMapper;
 // When a HostResolver::Job finishes its work in the threadpool, the callbacks
 // of each waiting request are run on the origin thread.
 //
+// On POSIX, the resolver can instead send the DNS queries itself, without
+// using a thread, once set_async_dns_server() is called.  The jobs fall back
+// to getaddrinfo() for the names this stub resolver can't handle.
+//
 // Thread safety: This class is not threadsafe, and must only be called
 // from one thread!
 //
@@ -165,6 +169,14 @@ class HostResolver : public base::RefCounted<HostResolver> {
   // TODO(eroman): temp hack for http://crbug.com/15513
   void Shutdown();
 
+#if defined(OS_POSIX)
+  // Resolves hostnames with asynchronous DNS queries sent to |nameserver|.
+  // The results are cached for the TTL of their records.  NXDOMAIN answers
+  // are checked with getaddrinfo(), which also reads the hosts file, and are
+  // cached for their negative TTL if it fails too.
+  void set_async_dns_server(const AddressList& nameserver);
+#endif
+
  private:
   class Job;
   typedef std::vector<Request*> RequestsList;
@@ -183,6 +195,9 @@ class HostResolver : public base::RefCounted<HostResolver> {
   // Callback for when |job| has completed with |error| and |addrlist|.
   void OnJobComplete(Job* job, int error, const AddressList& addrlist);
 
+  // Returns true if jobs should resolve |hostname| with DnsTransaction.
+  bool ShouldUseAsyncDns(const std::string& hostname) const;
+
   // Notify all observers of the start of a resolve request.
   void NotifyObserversStartRequest(int request_id,
                                    const RequestInfo& info);
@@ -216,6 +231,10 @@ class HostResolver : public base::RefCounted<HostResolver> {
   // TODO(eroman): temp hack for http://crbug.com/15513
   bool shutdown_;
 
+  // The nameserver that DNS queries are sent to, when |use_async_dns_| is set.
+  bool use_async_dns_;
+  AddressList async_dns_server_;
+
   DISALLOW_COPY_AND_ASSIGN(HostResolver);
 };
 
@@ -250,6 +250,10 @@ NET_ERROR(PAC_SCRIPT_FAILED, -327)
 // satisfy the range requested.
 NET_ERROR(REQUEST_RANGE_NOT_SATISFIABLE, -328)
 
+// The request was sent on a pipelined connection that was closed before its
+// response could be read.  The request can be retried on a new connection.
+NET_ERROR(PIPELINE_EVICTED, -329)
+
 // The cache does not have the requested entry.
 NET_ERROR(CACHE_MISS, -400)
 
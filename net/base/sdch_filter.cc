@@ -286,6 +286,11 @@ Filter::FilterStatus SdchFilter::ReadFilteredData(char* dest_buffer,
   return FILTER_NEED_MORE_DATA;
 }
 
+bool SdchFilter::IsPassThrough() const {
+  // The scanned dictionary hash is output before the rest of the data.
+  return PASS_THROUGH == decoding_status_ && dest_buffer_excess_.empty();
+}
+
 Filter::FilterStatus SdchFilter::InitializeDictionary() {
   const size_t kServerIdLength = 9;  // Dictionary hash plus null from server.
   size_t bytes_needed = kServerIdLength - dictionary_hash_.size();
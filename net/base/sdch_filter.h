@@ -43,6 +43,9 @@ class SdchFilter : public Filter {
   // written into the destination buffer.
   virtual FilterStatus ReadFilteredData(char* dest_buffer, int* dest_len);
 
+ protected:
+  virtual bool IsPassThrough() const;
+
  private:
   // Internal status.  Once we enter an error state, we stop processing data.
   enum DecodingStatus {
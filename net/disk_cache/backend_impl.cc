@@ -4,6 +4,10 @@
 
 #include "net/disk_cache/backend_impl.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/histogram.h"
@@ -13,6 +17,7 @@
 #include "base/sys_info.h"
 #include "base/timer.h"
 #include "base/worker_pool.h"
+#include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/entry_impl.h"
 #include "net/disk_cache/errors.h"
@@ -37,8 +42,21 @@ const int kMaxOldFolders = 100;
 // Seems like ~240 MB correspond to less than 50k entries for 99% of the people.
 const int k64kEntriesStore = 240 * 1000 * 1000;
 const int kBaseTableLen = 64 * 1024;
+const int kMaxTableLen = kBaseTableLen * 16;
 const int kDefaultCacheSize = 80 * 1024 * 1024;
 
+// Number of buckets of the index table to split with every cache operation (and
+// with every timer tick) while the table is being resized.
+const int kBucketsPerOperation = 4;
+const int kBucketsPerTimer = 256;
+
+// Time to wait before trying to grow the index file again, after a failure.
+const int kIndexResizeRetryMinutes = 30;
+
+// Maximum number of entries of a hash bucket that a shared reader will look at.
+// The chain may be modified by the owner of the cache while we walk it.
+const int kMaxSharedChainLength = 256;
+
 int DesiredIndexTableLen(int32 storage_size) {
   if (storage_size <= k64kEntriesStore)
     return kBaseTableLen;
@@ -249,6 +267,16 @@ bool BackendImpl::Init() {
   user_flags_ |= kNewEviction;
 #endif
 
+  if ((user_flags_ & kMultiProcess) &&
+      owner_lock_ == base::kInvalidPlatformFileValue) {
+    file_util::CreateDirectory(path_);
+    owner_lock_ = AcquireCacheOwnership(path_);
+    shared_reader_ = (owner_lock_ == base::kInvalidPlatformFileValue);
+  }
+
+  if (shared_reader_)
+    return InitSharedReader();
+
   bool create_files = false;
   if (!InitBackingStore(&create_files)) {
     ReportError(ERR_STORAGE_ERROR);
@@ -256,6 +284,7 @@ bool BackendImpl::Init() {
   }
 
   num_refs_ = num_pending_io_ = max_refs_ = 0;
+  background_queue_.Init(path_);
 
   if (!restarted_) {
     trace_object_ = TraceObject::GetTraceObject();
@@ -302,22 +331,30 @@ bool BackendImpl::Init() {
 
   disabled_ = !rankings_.Init(this, new_eviction_);
   eviction_.Init(this);
+  journal_.Init(&eviction_);
+  content_store_.Init(this);
 
   return !disabled_;
 }
 
 BackendImpl::~BackendImpl() {
   Trace("Backend destructor");
-  if (!init_)
+  if (!init_) {
+    ReleaseCacheOwnership(owner_lock_);
     return;
+  }
 
-  if (data_)
+  if (data_ && !shared_reader_) {
+    journal_.FlushAll();
     data_->header.crash = 0;
+  }
 
   timer_.Stop();
+  background_queue_.CancelAll();
 
   WaitForPendingIO(&num_pending_io_);
   DCHECK(!num_refs_);
+  ReleaseCacheOwnership(owner_lock_);
 }
 
 // ------------------------------------------------------------------------
@@ -341,6 +378,10 @@ bool BackendImpl::OpenEntry(const std::string& key, Entry** entry) {
   if (disabled_)
     return false;
 
+  if (shared_reader_ && !RefreshSharedIndex())
+    return false;
+
+  ContinueIndexResize(kBucketsPerOperation);
   Time start = Time::Now();
   uint32 hash = Hash(key);
 
@@ -357,7 +398,8 @@ bool BackendImpl::OpenEntry(const std::string& key, Entry** entry) {
     return false;
   }
 
-  eviction_.OnOpenEntry(cache_entry);
+  if (!shared_reader_)
+    eviction_.OnOpenEntry(cache_entry);
   DCHECK(entry);
   *entry = cache_entry;
 
@@ -367,17 +409,18 @@ bool BackendImpl::OpenEntry(const std::string& key, Entry** entry) {
 }
 
 bool BackendImpl::CreateEntry(const std::string& key, Entry** entry) {
-  if (disabled_ || key.empty())
+  if (disabled_ || shared_reader_ || key.empty())
     return false;
 
   DCHECK(entry);
   *entry = NULL;
 
+  ContinueIndexResize(kBucketsPerOperation);
   Time start = Time::Now();
   uint32 hash = Hash(key);
 
   scoped_refptr<EntryImpl> parent;
-  Addr entry_address(data_->table[hash & mask_]);
+  Addr entry_address(data_->table[HashBucket(hash)]);
   if (entry_address.is_initialized()) {
     // We have an entry already. It could be the one we are looking for, or just
     // a hash conflict.
@@ -438,10 +481,13 @@ bool BackendImpl::CreateEntry(const std::string& key, Entry** entry) {
   IncreaseNumEntries();
   eviction_.OnCreateEntry(cache_entry);
   if (!parent.get())
-    data_->table[hash & mask_] = entry_address.value();
+    data_->table[HashBucket(hash)] = entry_address.value();
 
   cache_entry.swap(reinterpret_cast<EntryImpl**>(entry));
 
+  if (ShouldGrowIndex())
+    StartIndexResize();
+
   CACHE_UMA(AGE_MS, "CreateTime", GetSizeGroup(), start);
   stats_.OnEvent(Stats::CREATE_HIT);
   Trace("create entry hit ");
@@ -449,7 +495,7 @@ bool BackendImpl::CreateEntry(const std::string& key, Entry** entry) {
 }
 
 bool BackendImpl::DoomEntry(const std::string& key) {
-  if (disabled_)
+  if (disabled_ || shared_reader_)
     return false;
 
   Entry* entry;
@@ -464,7 +510,43 @@ bool BackendImpl::DoomEntry(const std::string& key) {
   return true;
 }
 
+int BackendImpl::OpenEntry(const std::string& key, Entry** entry,
+                           net::CompletionCallback* callback) {
+  if (!callback)
+    return OpenEntry(key, entry) ? net::OK : net::ERR_FAILED;
+
+  if (disabled_)
+    return net::ERR_FAILED;
+
+  return background_queue_.OpenEntry(key, entry, callback);
+}
+
+int BackendImpl::CreateEntry(const std::string& key, Entry** entry,
+                             net::CompletionCallback* callback) {
+  if (!callback)
+    return CreateEntry(key, entry) ? net::OK : net::ERR_FAILED;
+
+  if (disabled_ || key.empty())
+    return net::ERR_FAILED;
+
+  return background_queue_.CreateEntry(key, entry, callback);
+}
+
+int BackendImpl::DoomEntry(const std::string& key,
+                           net::CompletionCallback* callback) {
+  if (!callback)
+    return DoomEntry(key) ? net::OK : net::ERR_FAILED;
+
+  if (disabled_)
+    return net::ERR_FAILED;
+
+  return background_queue_.DoomEntry(key, callback);
+}
+
 bool BackendImpl::DoomAllEntries() {
+  if (shared_reader_)
+    return false;
+
   if (!num_refs_) {
     PrepareForRestart();
     DeleteCache(path_.c_str(), false);
@@ -486,7 +568,7 @@ bool BackendImpl::DoomEntriesBetween(const Time initial_time,
 
   DCHECK(end_time >= initial_time);
 
-  if (disabled_)
+  if (disabled_ || shared_reader_)
     return false;
 
   Entry* node, *next;
@@ -518,7 +600,7 @@ bool BackendImpl::DoomEntriesBetween(const Time initial_time,
 // We use OpenNextEntry to retrieve elements from the cache, until we get
 // entries that are too old.
 bool BackendImpl::DoomEntriesSince(const Time initial_time) {
-  if (disabled_)
+  if (disabled_ || shared_reader_)
     return false;
 
   for (;;) {
@@ -543,6 +625,17 @@ bool BackendImpl::OpenNextEntry(void** iter, Entry** next_entry) {
   return OpenFollowingEntry(true, iter, next_entry);
 }
 
+int BackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
+                               net::CompletionCallback* callback) {
+  if (!callback)
+    return OpenNextEntry(iter, next_entry) ? net::OK : net::ERR_FAILED;
+
+  if (disabled_ || shared_reader_)
+    return net::ERR_FAILED;
+
+  return background_queue_.OpenNextEntry(iter, next_entry, callback);
+}
+
 void BackendImpl::EndEnumeration(void** iter) {
   scoped_ptr<Rankings::Iterator> iterator(
       reinterpret_cast<Rankings::Iterator*>(*iter));
@@ -664,10 +757,15 @@ LruData* BackendImpl::GetLruData() {
 
 void BackendImpl::UpdateRank(EntryImpl* entry, bool modified) {
   if (!read_only_) {
-    eviction_.UpdateRank(entry, modified);
+    journal_.Add(entry, modified);
   }
 }
 
+void BackendImpl::FlushRank(EntryImpl* entry) {
+  if (!read_only_)
+    journal_.Flush(entry);
+}
+
 void BackendImpl::RecoveredEntry(CacheRankingsBlock* rankings) {
   Addr address(rankings->Data()->contents);
   EntryImpl* cache_entry = NULL;
@@ -679,10 +777,10 @@ void BackendImpl::RecoveredEntry(CacheRankingsBlock* rankings) {
   cache_entry->Release();
 
   // Anything on the table means that this entry is there.
-  if (data_->table[hash & mask_])
+  if (data_->table[HashBucket(hash)])
     return;
 
-  data_->table[hash & mask_] = address.value();
+  data_->table[HashBucket(hash)] = address.value();
 }
 
 void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
@@ -693,6 +791,7 @@ void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
 
   Trace("Doom entry 0x%p", entry);
 
+  journal_.Remove(entry);
   eviction_.OnDoomEntry(entry);
   entry->InternalDoom();
 
@@ -700,7 +799,7 @@ void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
     parent_entry->SetNextAddress(Addr(child));
     parent_entry->Release();
   } else {
-    data_->table[hash & mask_] = child;
+    data_->table[HashBucket(hash)] = child;
   }
 
   if (!new_eviction_) {
@@ -840,6 +939,12 @@ void BackendImpl::CriticalError(int error) {
   if (disabled_)
     return;
 
+  if (shared_reader_) {
+    // The owner of the cache has to deal with this.
+    disabled_ = true;
+    return;
+  }
+
   LogStats();
   ReportError(error);
 
@@ -888,6 +993,12 @@ void BackendImpl::OnStatsTimer() {
       ReportStats();
   }
 
+  if (data_ && !disabled_) {
+    // Apply the delayed updates of the lists, sorted by address.
+    journal_.FlushAll();
+    ContinueIndexResize(kBucketsPerTimer);
+  }
+
   // Save stats to disk at 5 min intervals.
   if (time % 10 == 0)
     stats_.Store();
@@ -916,10 +1027,74 @@ void BackendImpl::SetNewEviction() {
   new_eviction_ = true;
 }
 
+void BackendImpl::SetMultiProcessMode() {
+  user_flags_ |= kMultiProcess;
+}
+
+void BackendImpl::SetSharedDataMode() {
+  user_flags_ |= kSharedData;
+}
+
+void BackendImpl::OnSharedData(int32 size) {
+  stats_.OnEvent(Stats::SHARED_DATA);
+  stats_.SetCounter(Stats::SHARED_BYTES,
+                    stats_.GetCounter(Stats::SHARED_BYTES) + size);
+}
+
+void BackendImpl::OnSharedDataFormat() {
+  if (data_->header.shared_data)
+    return;
+
+  // While the table is being resized, the version is updated at the end.
+  data_->header.shared_data = 1;
+  if (!data_->header.resize_len) {
+    data_->header.version = kSharedDataVersion |
+                            (data_->header.version & 0xffff);
+  }
+}
+
+EntryImpl* BackendImpl::OpenIdleEntry(Addr address, const std::string& key) {
+  if (disabled_ || open_entries_.count(address.value()))
+    return NULL;
+
+  bool dirty;
+  EntryImpl* tmp = NULL;
+  if (NewEntry(address, &tmp, &dirty))
+    return NULL;
+
+  scoped_refptr<EntryImpl> cache_entry;
+  cache_entry.swap(&tmp);
+  if (dirty || ENTRY_NORMAL != cache_entry->entry()->Data()->state ||
+      cache_entry->GetKey() != key)
+    return NULL;
+
+  cache_entry.swap(&tmp);
+  return tmp;
+}
+
 void BackendImpl::ClearRefCountForTest() {
   num_refs_ = 0;
 }
 
+void BackendImpl::ResizeIndexForTest(int num_buckets) {
+  if (!data_->header.resize_len)
+    StartIndexResize();
+  ContinueIndexResize(num_buckets);
+}
+
+void BackendImpl::InterruptIndexResizeForTest(int num_moves) {
+  if (!data_->header.resize_len)
+    StartIndexResize();
+
+  while (data_->header.resize_len) {
+    if (!SplitBucket(data_->header.resize_bucket, &num_moves))
+      return;
+    data_->header.resize_bucket++;
+    if (data_->header.resize_bucket == data_->header.table_len)
+      FinishIndexResize();
+  }
+}
+
 int BackendImpl::SelfCheck() {
   if (!init_) {
     LOG(ERROR) << "Init failed";
@@ -999,6 +1174,80 @@ bool BackendImpl::InitBackingStore(bool* file_created) {
   return true;
 }
 
+// A shared reader maps the files of a cache owned by another instance, but it
+// never writes to them: there is no crash recovery, no stats and no eviction,
+// and the rankings lists are not used at all.
+bool BackendImpl::InitSharedReader() {
+  read_only_ = true;
+
+  std::wstring index_name(path_);
+  file_util::AppendToPath(&index_name, kIndexName);
+  if (!file_util::PathExists(index_name))
+    return false;
+
+  index_ = new MappedFile();
+  data_ = reinterpret_cast<Index*>(index_->Init(index_name, 0));
+  if (!data_) {
+    LOG(ERROR) << "Unable to map Index file";
+    return false;
+  }
+
+  uint32 major_version = data_->header.version >> 16;
+  if (kIndexMagic != data_->header.magic ||
+      (kCurrentVersion >> 16 != major_version &&
+       kIndexResizeVersion >> 16 != major_version &&
+       kSharedDataVersion >> 16 != major_version)) {
+    LOG(ERROR) << "Invalid file version or magic";
+    return false;
+  }
+
+  num_refs_ = num_pending_io_ = max_refs_ = 0;
+  background_queue_.Init(path_);
+  content_store_.Init(this);
+  trace_object_ = TraceObject::GetTraceObject();
+  init_ = true;
+
+  disabled_ = false;
+  if (!RefreshSharedIndex())
+    return false;
+
+  // Follow the eviction algorithm selected by the owner.
+  new_eviction_ = (data_->header.version & 0xffff) != 0;
+
+  block_files_.SetReadOnlyMode();
+  return block_files_.Init(false);
+}
+
+bool BackendImpl::RefreshSharedIndex() {
+  DCHECK(shared_reader_);
+  int table_len = data_->header.table_len;
+  if (!table_len || table_len & (kBaseTableLen - 1)) {
+    // The owner is re-creating the cache.
+    disabled_ = true;
+    return false;
+  }
+
+  int needed_len = std::max(table_len, data_->header.resize_len);
+  if (index_->GetLength() < GetIndexSize(needed_len)) {
+    std::wstring index_name(path_);
+    file_util::AppendToPath(&index_name, kIndexName);
+
+    scoped_refptr<MappedFile> index(new MappedFile());
+    Index* data = reinterpret_cast<Index*>(index->Init(index_name, 0));
+    if (!data || index->GetLength() < GetIndexSize(needed_len)) {
+      LOG(ERROR) << "Unable to map Index file";
+      disabled_ = true;
+      return false;
+    }
+    index_.swap(index);
+    data_ = data;
+  }
+
+  if (!(user_flags_ & kMask))
+    mask_ = data_->header.table_len - 1;
+  return true;
+}
+
 // The maximum cache size will be either set explicitly by the caller, or
 // calculated by this code.
 void BackendImpl::AdjustMaxCacheSize(int table_len) {
@@ -1025,15 +1274,213 @@ void BackendImpl::AdjustMaxCacheSize(int table_len) {
   if (max_size_ > kDefaultCacheSize * 4)
     max_size_ = kDefaultCacheSize * 4;
 
-  if (!table_len)
+  // If the table cannot grow, adjust the size to it. Otherwise the table will
+  // be resized when it holds too many entries.
+  if (!table_len || !(user_flags_ & kMask))
     return;
 
-  // If we already have a table, adjust the size to it.
   int current_max_size = MaxStorageSizeForTable(table_len);
   if (max_size_ > current_max_size)
     max_size_= current_max_size;
 }
 
+uint32 BackendImpl::HashBucket(uint32 hash) const {
+  uint32 bucket = hash & mask_;
+  if (data_->header.resize_len &&
+      bucket < static_cast<uint32>(data_->header.resize_bucket)) {
+    // This bucket was already split. Note that a shared reader may not have
+    // mapped the new part of the table yet.
+    uint32 new_bucket = hash & (data_->header.resize_len - 1);
+    if (!shared_reader_ || GetIndexSize(new_bucket + 1) <= index_->GetLength())
+      bucket = new_bucket;
+  }
+  return bucket;
+}
+
+// We want an average of less than one entry per bucket. Note that the table
+// doesn't grow when the mask is set by the user (for tests).
+bool BackendImpl::ShouldGrowIndex() const {
+  if (user_flags_ & kMask || read_only_ || data_->header.resize_len)
+    return false;
+
+  int table_len = data_->header.table_len;
+  if (table_len >= kMaxTableLen || data_->header.num_entries <= table_len)
+    return false;
+
+  // Don't retry a failed resize with every new entry.
+  return next_resize_attempt_.is_null() || Time::Now() >= next_resize_attempt_;
+}
+
+void BackendImpl::StartIndexResize() {
+  int new_len = data_->header.table_len * 2;
+  Trace("Index resize to %d", new_len);
+  if (!GrowIndexFile(new_len)) {
+    LOG(ERROR) << "Unable to grow the index file";
+    next_resize_attempt_ = Time::Now() +
+        TimeDelta::FromMinutes(kIndexResizeRetryMinutes);
+    return;
+  }
+  next_resize_attempt_ = Time();
+
+  // The new half of the table is zero filled. From now on the file cannot be
+  // used by older versions of the code, until the resize finishes.
+  data_->header.resize_bucket = 0;
+  data_->header.resize_len = new_len;
+  data_->header.version = kIndexResizeVersion |
+                          (data_->header.version & 0xffff);
+  CACHE_UMA(COUNTS, "IndexResize", 0, new_len / kBaseTableLen);
+}
+
+void BackendImpl::ContinueIndexResize(int num_buckets) {
+  if (read_only_)
+    return;
+
+  for (int i = 0; i < num_buckets && data_->header.resize_len; i++) {
+    if (disabled_)
+      return;
+
+    SplitBucket(data_->header.resize_bucket, NULL);
+    data_->header.resize_bucket++;
+    if (data_->header.resize_bucket == data_->header.table_len)
+      FinishIndexResize();
+  }
+}
+
+// The entries of |bucket| that belong to |bucket| + table_len are moved to the
+// new bucket one at a time: each entry is linked from the new list before it
+// is removed from the old one. If we crash in the middle, every entry is still
+// reachable from one of the buckets (the new list may end with a part of the
+// old one), and the split of this bucket is simply performed again. For tests,
+// |max_moves| limits the number of entries moved: the split stops (returning
+// false) right after linking one more entry from the new bucket.
+bool BackendImpl::SplitBucket(uint32 bucket, int* max_moves) {
+  uint32 new_bucket = bucket + data_->header.table_len;
+  uint32 new_mask = data_->header.resize_len - 1;
+
+  std::vector<scoped_refptr<EntryImpl> > entries;
+  std::vector<bool> dirty_entries;
+  std::set<CacheAddr> old_list;
+  Addr address(data_->table[bucket]);
+  while (address.is_initialized() && !old_list.count(address.value())) {
+    bool dirty;
+    EntryImpl* tmp;
+    int error = NewEntry(address, &tmp, &dirty);
+    scoped_refptr<EntryImpl> cache_entry;
+    cache_entry.swap(&tmp);
+
+    if (error) {
+      // We cannot follow this list anymore.
+      Trace("NewEntry failed on SplitBucket 0x%x", address.value());
+      break;
+    }
+
+    old_list.insert(address.value());
+    entries.push_back(cache_entry);
+    dirty_entries.push_back(dirty);
+    address.set_value(cache_entry->GetNextAddress());
+  }
+
+  // Find the last entry that is only linked from the new bucket.
+  scoped_refptr<EntryImpl> tail;
+  std::set<CacheAddr> new_list;
+  address.set_value(data_->table[new_bucket]);
+  while (address.is_initialized() && !old_list.count(address.value()) &&
+         !new_list.count(address.value())) {
+    bool dirty;
+    EntryImpl* tmp;
+    int error = NewEntry(address, &tmp, &dirty);
+    scoped_refptr<EntryImpl> cache_entry;
+    cache_entry.swap(&tmp);
+
+    if (error) {
+      Trace("NewEntry failed on SplitBucket 0x%x", address.value());
+      break;
+    }
+
+    new_list.insert(address.value());
+    tail = cache_entry;
+    address.set_value(cache_entry->GetNextAddress());
+  }
+
+  scoped_refptr<EntryImpl> prev;
+  for (size_t i = 0; i < entries.size(); i++) {
+    EntryImpl* cache_entry = entries[i];
+    bool move = (cache_entry->GetHash() & new_mask) != bucket;
+    if (!move && !dirty_entries[i]) {
+      prev = cache_entry;
+      continue;
+    }
+
+    Addr entry_address(cache_entry->entry()->address());
+    if (!dirty_entries[i]) {
+      if (!tail) {
+        data_->table[new_bucket] = entry_address.value();
+      } else if (tail->GetNextAddress() != entry_address.value()) {
+        tail->SetNextAddress(entry_address);
+      }
+      tail = cache_entry;
+
+      if (max_moves && --*max_moves < 0)
+        return false;
+    }
+
+    Addr next(cache_entry->GetNextAddress());
+    if (prev) {
+      prev->SetNextAddress(next);
+    } else {
+      data_->table[bucket] = next.value();
+    }
+
+    // Dirty entries will not be linked again.
+    if (dirty_entries[i])
+      DestroyInvalidEntry(entry_address, cache_entry);
+  }
+
+  if (tail && tail->GetNextAddress())
+    tail->SetNextAddress(Addr(0));
+  return true;
+}
+
+void BackendImpl::FinishIndexResize() {
+  DCHECK(!(user_flags_ & kMask));
+  data_->header.table_len = data_->header.resize_len;
+  data_->header.resize_len = 0;
+  data_->header.resize_bucket = 0;
+  uint32 version = data_->header.shared_data ? kSharedDataVersion :
+                                               kCurrentVersion;
+  data_->header.version = version | (data_->header.version & 0xffff);
+  mask_ = data_->header.table_len - 1;
+  Trace("Index resize done");
+}
+
+bool BackendImpl::GrowIndexFile(int table_len) {
+  std::wstring index_name(path_);
+  file_util::AppendToPath(&index_name, kIndexName);
+
+  // The file cannot be extended while it is mapped (on Windows).
+  data_ = NULL;
+  index_ = NULL;
+
+  scoped_refptr<disk_cache::File> file(new disk_cache::File(true));
+  bool success = file->Init(index_name) &&
+                 file->SetLength(GetIndexSize(table_len));
+  file = NULL;
+
+  index_ = new MappedFile();
+  data_ = reinterpret_cast<Index*>(index_->Init(index_name, 0));
+  if (!data_) {
+    LOG(ERROR) << "Unable to map Index file";
+    index_ = NULL;
+    disabled_ = true;
+    return false;
+  }
+
+  // Other objects keep pointers to the mapped header.
+  rankings_.OnIndexRemapped();
+  eviction_.OnIndexRemapped();
+  return success;
+}
+
 void BackendImpl::RestartCache() {
   PrepareForRestart();
   DelayedCacheCleanup(path_);
@@ -1060,7 +1507,10 @@ void BackendImpl::PrepareForRestart() {
   index_ = NULL;
   data_ = NULL;
   block_files_.CloseFiles();
+  ReleaseCacheOwnership(owner_lock_);
+  owner_lock_ = base::kInvalidPlatformFileValue;
   rankings_.Reset();
+  journal_.Reset();
   init_ = false;
   restarted_ = true;
 }
@@ -1115,10 +1565,11 @@ int BackendImpl::NewEntry(Addr address, EntryImpl** entry, bool* dirty) {
 
 EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
                                    bool find_parent) {
-  Addr address(data_->table[hash & mask_]);
+  Addr address(data_->table[HashBucket(hash)]);
   scoped_refptr<EntryImpl> cache_entry, parent_entry;
   EntryImpl* tmp = NULL;
   bool found = false;
+  int chain_length = 0;
 
   for (;;) {
     if (disabled_)
@@ -1130,10 +1581,26 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
       break;
     }
 
+    chain_length++;
+    if (shared_reader_ && chain_length > kMaxSharedChainLength)
+      break;
+
     bool dirty;
     int error = NewEntry(address, &tmp, &dirty);
     cache_entry.swap(&tmp);
 
+    if (shared_reader_ && (error || dirty)) {
+      // This entry may be in use by the owner of the cache, so we just skip it
+      // (without fixing anything).
+      if (error || cache_entry->IsSameEntry(key, hash)) {
+        cache_entry = NULL;
+        break;
+      }
+      address.set_value(cache_entry->GetNextAddress());
+      cache_entry = NULL;
+      continue;
+    }
+
     if (error || dirty) {
       // This entry is dirty on disk (it was not properly closed): we cannot
       // trust it.
@@ -1145,7 +1612,7 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
         parent_entry->SetNextAddress(child);
         parent_entry = NULL;
       } else {
-        data_->table[hash & mask_] = child.value();
+        data_->table[HashBucket(hash)] = child.value();
       }
 
       if (!error) {
@@ -1158,7 +1625,7 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
       }
 
       // Restart the search.
-      address.set_value(data_->table[hash & mask_]);
+      address.set_value(data_->table[HashBucket(hash)]);
       continue;
     }
 
@@ -1178,6 +1645,9 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
     address.set_value(parent_entry->GetNextAddress());
   }
 
+  if (!find_parent)
+    stats_.OnChainLength(chain_length);
+
   if (parent_entry && (!find_parent || !found))
     parent_entry = NULL;
 
@@ -1188,10 +1658,51 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
   return tmp;
 }
 
-// This is the actual implementation for OpenNextEntry and OpenPrevEntry.
+// A new enumeration starts at the head of each list, and an existing one
+// continues with the node that follows the last entry returned.
+void BackendImpl::GetEnumerationHints(void* iter,
+                                      std::vector<CacheAddr>* nodes) {
+  if (disabled_ || shared_reader_)
+    return;
+
+  Rankings::Iterator* iterator = reinterpret_cast<Rankings::Iterator*>(iter);
+  if (iterator) {
+    CacheRankingsBlock* node = iterator->nodes[iterator->list];
+    if (node)
+      nodes->push_back(node->Data()->next);
+    return;
+  }
+
+  const int kListsToSearch = 3;
+  for (int i = 0; i < kListsToSearch; i++) {
+    if (!new_eviction_ && Rankings::NO_USE != i)
+      continue;
+    nodes->push_back(data_->header.lru.heads[i]);
+  }
+}
+
+// Content entries store data on behalf of other entries (see ContentStore), so
+// they are not visible to the user of the cache.
 bool BackendImpl::OpenFollowingEntry(bool forward, void** iter,
                                      Entry** next_entry) {
-  if (disabled_)
+  for (;;) {
+    if (!OpenFollowingEntryImpl(forward, iter, next_entry))
+      return false;
+
+    EntryImpl* entry = reinterpret_cast<EntryImpl*>(*next_entry);
+    if (!(entry->entry()->Data()->flags & CONTENT_ENTRY))
+      return true;
+
+    entry->Close();
+    *next_entry = NULL;
+  }
+}
+
+// This is the actual implementation for OpenNextEntry and OpenPrevEntry.
+bool BackendImpl::OpenFollowingEntryImpl(bool forward, void** iter,
+                                         Entry** next_entry) {
+  // Shared readers cannot trust the lists.
+  if (disabled_ || shared_reader_)
     return false;
 
   DCHECK(iter);
@@ -1352,6 +1863,7 @@ void BackendImpl::DestroyInvalidEntry(Addr address, EntryImpl* entry) {
 
   entry->SetPointerForInvalidEntry(GetCurrentEntryId());
 
+  journal_.Remove(entry);
   eviction_.OnDoomEntry(entry);
   entry->InternalDoom();
 
@@ -1383,7 +1895,7 @@ void BackendImpl::DecreaseNumRefs() {
   DCHECK(num_refs_);
   num_refs_--;
 
-  if (!num_refs_ && disabled_)
+  if (!num_refs_ && disabled_ && !shared_reader_)
     RestartCache();
 }
 
@@ -1474,8 +1986,8 @@ void BackendImpl::ReportStats() {
 void BackendImpl::UpgradeTo2_1() {
   // 2.1 is basically the same as 2.0, except that new fields are actually
   // updated by the new eviction algorithm.
-  DCHECK(0x20000 == data_->header.version);
-  data_->header.version = 0x20001;
+  DCHECK(!(data_->header.version & 0xffff));
+  data_->header.version |= 1;
   data_->header.lru.sizes[Rankings::NO_USE] = data_->header.num_entries;
 }
 
@@ -1488,23 +2000,31 @@ bool BackendImpl::CheckIndex() {
     return false;
   }
 
+  // Version 3.x is the same as 2.x, while the table is being resized, and 4.x
+  // is used when there are entries with shared data.
+  uint32 major_version = data_->header.version >> 16;
+  bool resizing = (kIndexResizeVersion >> 16 == major_version);
+  bool shared_data = (kSharedDataVersion >> 16 == major_version);
+  if (kIndexMagic != data_->header.magic ||
+      (kCurrentVersion >> 16 != major_version && !resizing && !shared_data)) {
+    LOG(ERROR) << "Invalid file version or magic";
+    return false;
+  }
+
+  if (shared_data != (data_->header.shared_data != 0) && !resizing) {
+    LOG(ERROR) << "Invalid shared data state";
+    return false;
+  }
+
   if (new_eviction_) {
     // We support versions 2.0 and 2.1, upgrading 2.0 to 2.1.
-    if (kIndexMagic != data_->header.magic ||
-        kCurrentVersion >> 16 != data_->header.version >> 16) {
-      LOG(ERROR) << "Invalid file version or magic";
-      return false;
-    }
-    if (kCurrentVersion == data_->header.version) {
+    if (!(data_->header.version & 0xffff)) {
       // We need file version 2.1 for the new eviction algorithm.
       UpgradeTo2_1();
     }
-  } else {
-    if (kIndexMagic != data_->header.magic ||
-        kCurrentVersion != data_->header.version) {
-      LOG(ERROR) << "Invalid file version or magic";
-      return false;
-    }
+  } else if (data_->header.version & 0xffff) {
+    LOG(ERROR) << "Invalid file version or magic";
+    return false;
   }
 
   if (!data_->header.table_len) {
@@ -1518,6 +2038,20 @@ bool BackendImpl::CheckIndex() {
     return false;
   }
 
+  if (resizing != (data_->header.resize_len != 0)) {
+    LOG(ERROR) << "Invalid resize state";
+    return false;
+  }
+
+  if (resizing && (data_->header.resize_len != data_->header.table_len * 2 ||
+                   data_->header.resize_bucket < 0 ||
+                   data_->header.resize_bucket >= data_->header.table_len ||
+                   current_size < GetIndexSize(data_->header.resize_len) ||
+                   user_flags_ & kMask)) {
+    LOG(ERROR) << "Corrupt Index file";
+    return false;
+  }
+
   AdjustMaxCacheSize(data_->header.table_len);
 
   // We need to avoid integer overflows.
@@ -1543,7 +2077,11 @@ int BackendImpl::CheckAllEntries() {
   int num_dirty = 0;
   int num_entries = 0;
   DCHECK(mask_ < kuint32max);
-  for (int i = 0; i <= static_cast<int>(mask_); i++) {
+  int num_buckets = static_cast<int>(mask_) + 1;
+  if (data_->header.resize_len)
+    num_buckets += data_->header.resize_bucket;
+
+  for (int i = 0; i < num_buckets; i++) {
     Addr address(data_->table[i]);
     if (!address.is_initialized())
       continue;
@@ -7,12 +7,17 @@
 #ifndef NET_DISK_CACHE_BACKEND_IMPL_H_
 #define NET_DISK_CACHE_BACKEND_IMPL_H_
 
+#include "base/compiler_specific.h"
 #include "base/hash_tables.h"
+#include "base/platform_file.h"
 #include "base/timer.h"
 #include "net/disk_cache/block_files.h"
+#include "net/disk_cache/content_store.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/eviction.h"
+#include "net/disk_cache/in_flight_backend_io.h"
 #include "net/disk_cache/rankings.h"
+#include "net/disk_cache/rankings_journal.h"
 #include "net/disk_cache/stats.h"
 #include "net/disk_cache/trace.h"
 
@@ -23,25 +28,32 @@ enum BackendFlags {
   kMaxSize = 1 << 1,
   kUnitTestMode = 1 << 2,
   kUpgradeMode = 1 << 3,
-  kNewEviction = 1 << 4
+  kNewEviction = 1 << 4,
+  kMultiProcess = 1 << 5,
+  kSharedData = 1 << 6
 };
 
 // This class implements the Backend interface. An object of this
 // class handles the operations of the cache for a particular profile.
 class BackendImpl : public Backend {
   friend class Eviction;
+  friend class InFlightBackendIO;
  public:
   explicit BackendImpl(const std::wstring& path)
       : path_(path), block_files_(path), mask_(0), max_size_(0),
+        ALLOW_THIS_IN_INITIALIZER_LIST(background_queue_(this)),
         cache_type_(net::DISK_CACHE), uma_report_(0), user_flags_(0),
-        init_(false), restarted_(false), unit_test_(false), read_only_(false),
-        new_eviction_(false), first_timer_(true) {}
+        owner_lock_(base::kInvalidPlatformFileValue), init_(false),
+        restarted_(false), unit_test_(false), read_only_(false),
+        shared_reader_(false), new_eviction_(false), first_timer_(true) {}
   // mask can be used to limit the usable size of the hash table, for testing.
   BackendImpl(const std::wstring& path, uint32 mask)
       : path_(path), block_files_(path), mask_(mask), max_size_(0),
+        ALLOW_THIS_IN_INITIALIZER_LIST(background_queue_(this)),
         cache_type_(net::DISK_CACHE), uma_report_(0), user_flags_(kMask),
-        init_(false), restarted_(false), unit_test_(false), read_only_(false),
-        new_eviction_(false), first_timer_(true) {}
+        owner_lock_(base::kInvalidPlatformFileValue), init_(false),
+        restarted_(false), unit_test_(false), read_only_(false),
+        shared_reader_(false), new_eviction_(false), first_timer_(true) {}
   ~BackendImpl();
 
   // Performs general initialization for this current instance of the cache.
@@ -52,11 +64,19 @@ class BackendImpl : public Backend {
   virtual bool OpenEntry(const std::string& key, Entry** entry);
   virtual bool CreateEntry(const std::string& key, Entry** entry);
   virtual bool DoomEntry(const std::string& key);
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        net::CompletionCallback* callback);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          net::CompletionCallback* callback);
+  virtual int DoomEntry(const std::string& key,
+                        net::CompletionCallback* callback);
   virtual bool DoomAllEntries();
   virtual bool DoomEntriesBetween(const base::Time initial_time,
                                   const base::Time end_time);
   virtual bool DoomEntriesSince(const base::Time initial_time);
   virtual bool OpenNextEntry(void** iter, Entry** next_entry);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            net::CompletionCallback* callback);
   virtual void EndEnumeration(void** iter);
   virtual void GetStats(StatsItems* stats);
 
@@ -86,9 +106,14 @@ class BackendImpl : public Backend {
   // Retrieves a pointer to the lru-related data.
   LruData* GetLruData();
 
-  // Updates the ranking information for an entry.
+  // Updates the ranking information for an entry. The update may be delayed
+  // while the entry is open (see RankingsJournal).
   void UpdateRank(EntryImpl* entry, bool modified);
 
+  // Performs any delayed update of the ranking information for an entry. This
+  // is called when the entry is about to be closed.
+  void FlushRank(EntryImpl* entry);
+
   // A node was recovered from a crash, it may not be on the index, so this
   // method checks it and takes the appropriate action.
   void RecoveredEntry(CacheRankingsBlock* rankings);
@@ -167,9 +192,50 @@ class BackendImpl : public Backend {
   // Sets the eviction algorithm to version 2.
   void SetNewEviction();
 
+  // Allows the cache files to be shared by multiple processes. The first
+  // instance to be initialized becomes the owner of the cache, and any other
+  // instance can only open (and read) the entries that are not being used by
+  // the owner.
+  void SetMultiProcessMode();
+
+  // Returns true if this instance is reading a cache owned by someone else.
+  bool IsSharedReader() const { return shared_reader_; }
+
+  // Enables the de-duplication of the data stream of the entries (see
+  // ContentStore).
+  void SetSharedDataMode();
+
+  // Returns true if entries with the same data should share it.
+  bool ShouldShareData() const {
+    return (user_flags_ & kSharedData) && !read_only_;
+  }
+
+  ContentStore* content_store() { return &content_store_; }
+
+  // Called when the data of an entry is replaced by a reference to a content
+  // entry, saving |size| bytes.
+  void OnSharedData(int32 size);
+
+  // Called before the data of an entry is moved to a content entry, to mark
+  // the index with the version that supports shared data.
+  void OnSharedDataFormat();
+
+  // Returns the entry stored at |address| if it is still the entry for |key|,
+  // and it is not being used. The rankings of the entry are not updated. The
+  // caller must Close the entry.
+  EntryImpl* OpenIdleEntry(Addr address, const std::string& key);
+
   // Clears the counter of references to test handling of corruptions.
   void ClearRefCountForTest();
 
+  // Starts doubling the index table (unless it is already being resized), and
+  // splits up to |num_buckets| buckets.
+  void ResizeIndexForTest(int num_buckets);
+
+  // Splits buckets until |num_moves| entries have been moved, and leaves the
+  // next entry linked from both buckets, as if we crashed in the middle.
+  void InterruptIndexResizeForTest(int num_moves);
+
   // Peforms a simple self-check, and returns the number of dirty items
   // or an error code (negative value).
   int SelfCheck();
@@ -183,8 +249,34 @@ class BackendImpl : public Backend {
   // Creates a new backing file for the cache index.
   bool CreateBackingStore(disk_cache::File* file);
   bool InitBackingStore(bool* file_created);
+
+  // Initialization for an instance that doesn't own the cache files.
+  bool InitSharedReader();
+
+  // Maps again the index if it was extended by the owner of the cache.
+  bool RefreshSharedIndex();
   void AdjustMaxCacheSize(int table_len);
 
+  // Returns the bucket of the index table that stores entries with |hash|.
+  uint32 HashBucket(uint32 hash) const;
+
+  // Returns the addresses of the rankings nodes that are likely to be read by
+  // the next call to OpenNextEntry with |iter|.
+  void GetEnumerationHints(void* iter, std::vector<CacheAddr>* nodes);
+
+  // Support for growing the index table. The table is doubled when it holds
+  // too many entries, and the buckets are split a few at a time from
+  // ContinueIndexResize (called while performing other operations), so the
+  // cache never stops to rehash the whole table.
+  bool ShouldGrowIndex() const;
+  void StartIndexResize();
+  void ContinueIndexResize(int num_buckets);
+  bool SplitBucket(uint32 bucket, int* max_moves);
+  void FinishIndexResize();
+
+  // Extends the index file to hold |table_len| buckets and maps it again.
+  bool GrowIndexFile(int table_len);
+
   // Deletes the cache and starts again.
   void RestartCache();
   void PrepareForRestart();
@@ -198,8 +290,10 @@ class BackendImpl : public Backend {
   // on the list of entries with the same hash (or bucket).
   EntryImpl* MatchEntry(const std::string& key, uint32 hash, bool find_parent);
 
-  // Opens the next or previous entry on a cache iteration.
+  // Opens the next or previous entry on a cache iteration. Content entries are
+  // skipped (OpenFollowingEntryImpl returns them too).
   bool OpenFollowingEntry(bool forward, void** iter, Entry** next_entry);
+  bool OpenFollowingEntryImpl(bool forward, void** iter, Entry** next_entry);
 
   // Opens the next or previous entry on a single list. If successfull,
   // |from_entry| will be updated to point to the new entry, otherwise it will
@@ -251,7 +345,10 @@ class BackendImpl : public Backend {
   Rankings rankings_;  // Rankings to be able to trim the cache.
   uint32 mask_;  // Binary mask to map a hash to the hash table.
   int32 max_size_;  // Maximum data size for this instance.
+  InFlightBackendIO background_queue_;  // Queue of async operations.
   Eviction eviction_;  // Handler of the eviction algorithm.
+  RankingsJournal journal_;  // Delayed updates of the rankings lists.
+  ContentStore content_store_;  // Shared data of the entries.
   EntriesMap open_entries_;  // Map of open entries.
   int num_refs_;  // Number of referenced cache entries.
   int max_refs_;  // Max number of referenced cache entries.
@@ -259,13 +356,16 @@ class BackendImpl : public Backend {
   net::CacheType cache_type_;
   int uma_report_;  // Controls transmision of UMA data.
   uint32 user_flags_;  // Flags set by the user.
+  base::PlatformFile owner_lock_;  // Ownership of the files (multi-process).
   bool init_;  // controls the initialization of the system.
   bool restarted_;
   bool unit_test_;
   bool read_only_;  // Prevents updates of the rankings data (used by tools).
+  bool shared_reader_;  // The cache files are owned by another instance.
   bool disabled_;
   bool new_eviction_;  // What eviction algorithm should be used.
   bool first_timer_;  // True if the timer has not been called.
+  base::Time next_resize_attempt_;  // Backoff after failing to grow the index.
 
   Stats stats_;  // Usage statistcs.
   base::RepeatingTimer<BackendImpl> timer_;  // Usage timer.
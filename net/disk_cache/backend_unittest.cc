@@ -17,6 +17,8 @@
 
 using base::Time;
 
+extern volatile int g_cache_tests_received;
+
 namespace {
 
 // Copies a set of cache files from the data folder to the test folder.
@@ -34,6 +36,23 @@ bool CopyTestCache(const std::wstring& name) {
   return file_util::CopyDirectory(path, FilePath::FromWStringHack(dest), false);
 }
 
+// Deletes the backend when the operation completes.
+class DeleteBackendCallback : public CallbackTest {
+ public:
+  explicit DeleteBackendCallback(disk_cache::Backend** cache)
+      : CallbackTest(false), cache_(cache) {}
+
+  virtual void RunWithParams(const Tuple1<int>& params) {
+    delete *cache_;
+    *cache_ = NULL;
+    CallbackTest::RunWithParams(params);
+  }
+
+ private:
+  disk_cache::Backend** cache_;
+  DISALLOW_COPY_AND_ASSIGN(DeleteBackendCallback);
+};
+
 }  // namespace
 
 // Tests that can run with different types of caches.
@@ -41,14 +60,19 @@ class DiskCacheBackendTest : public DiskCacheTestWithCache {
  protected:
   void BackendBasics();
   void BackendKeying();
+  void BackendAsyncBasics();
   void BackendSetSize();
   void BackendLoad();
+  void BackendResizeIndex();
+  void BackendInterruptedResize();
   void BackendValidEntry();
   void BackendInvalidEntry();
   void BackendInvalidEntryRead();
   void BackendInvalidEntryWithLoad();
   void BackendTrimInvalidEntry();
   void BackendEnumerations();
+  void BackendDelayedRankings();
+  void BackendSharedData();
   void BackendInvalidEntryEnumeration();
   void BackendFixEnumerators();
   void BackendDoomRecent();
@@ -182,6 +206,147 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyKeying) {
   BackendKeying();
 }
 
+void DiskCacheBackendTest::BackendAsyncBasics() {
+  InitCache();
+  SimpleCallbackTest callback;
+  disk_cache::Entry *entry1 = NULL, *entry2 = NULL;
+  EXPECT_EQ(net::ERR_FAILED, callback.GetResult(
+      cache_->OpenEntry("the first key", &entry1, &callback)));
+  ASSERT_EQ(net::OK, callback.GetResult(
+      cache_->CreateEntry("the first key", &entry1, &callback)));
+  ASSERT_TRUE(NULL != entry1);
+  EXPECT_EQ(net::ERR_FAILED, callback.GetResult(
+      cache_->CreateEntry("the first key", &entry2, &callback)));
+
+  ASSERT_EQ(net::OK, callback.GetResult(
+      cache_->OpenEntry("the first key", &entry2, &callback)));
+  EXPECT_TRUE(entry1 == entry2);
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  entry2->Close();
+
+  void* iter = NULL;
+  ASSERT_EQ(net::OK, callback.GetResult(
+      cache_->OpenNextEntry(&iter, &entry2, &callback)));
+  EXPECT_TRUE(entry1 == entry2);
+  entry2->Close();
+  EXPECT_EQ(net::ERR_FAILED, callback.GetResult(
+      cache_->OpenNextEntry(&iter, &entry2, &callback)));
+
+  EXPECT_EQ(net::OK, callback.GetResult(
+      cache_->DoomEntry("the first key", &callback)));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  EXPECT_EQ(net::ERR_FAILED, callback.GetResult(
+      cache_->DoomEntry("the first key", &callback)));
+  entry1->Close();
+}
+
+TEST_F(DiskCacheBackendTest, AsyncBasics) {
+  BackendAsyncBasics();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionAsyncBasics) {
+  SetNewEviction();
+  BackendAsyncBasics();
+}
+
+TEST_F(DiskCacheBackendTest, MemoryOnlyAsyncBasics) {
+  SetMemoryOnlyMode();
+  BackendAsyncBasics();
+}
+
+// Tests that asynchronous operations complete in the order they were issued.
+TEST_F(DiskCacheBackendTest, AsyncOperationsOrder) {
+  InitCache();
+  MessageLoopHelper helper;
+  CallbackTest callback1(false);
+  CallbackTest callback2(false);
+  CallbackTest callback3(false);
+  g_cache_tests_received = 0;
+
+  disk_cache::Entry *entry1 = NULL, *entry2 = NULL;
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            cache_->CreateEntry("some key", &entry1, &callback1));
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            cache_->OpenEntry("some key", &entry2, &callback2));
+  EXPECT_EQ(net::ERR_IO_PENDING, cache_->DoomEntry("some key", &callback3));
+  EXPECT_TRUE(helper.WaitUntilCacheIoFinished(3));
+
+  EXPECT_EQ(net::OK, callback1.result());
+  EXPECT_EQ(net::OK, callback2.result());
+  EXPECT_EQ(net::OK, callback3.result());
+  ASSERT_TRUE(NULL != entry1);
+  EXPECT_TRUE(entry1 == entry2);
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  entry1->Close();
+  entry2->Close();
+}
+
+// Destroying the backend should cancel any pending operation, even from the
+// callback of a previous operation.
+TEST_F(DiskCacheBackendTest, AsyncOperationsCancel) {
+  InitCache();
+  MessageLoopHelper helper;
+  DeleteBackendCallback callback1(&cache_);
+  CallbackTest callback2(false);
+  g_cache_tests_received = 0;
+
+  disk_cache::Entry* entry = NULL;
+  EXPECT_EQ(net::ERR_IO_PENDING, cache_->DoomEntry("some key", &callback1));
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            cache_->CreateEntry("some key", &entry, &callback2));
+  cache_impl_ = NULL;
+
+  EXPECT_TRUE(helper.WaitUntilCacheIoFinished(1));
+  EXPECT_TRUE(NULL == cache_);
+  EXPECT_EQ(net::ERR_FAILED, callback1.result());
+
+  // Issue an operation to a new backend and wait for it: the worker task of
+  // the canceled operation is not waited for, but it may complete meanwhile.
+  InitCache();
+  disk_cache::Entry* entry2 = NULL;
+  CallbackTest callback3(false);
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            cache_->CreateEntry("other key", &entry2, &callback3));
+  EXPECT_TRUE(helper.WaitUntilCacheIoFinished(2));
+  MessageLoop::current()->RunAllPending();
+
+  EXPECT_EQ(2, g_cache_tests_received);
+  EXPECT_EQ(-1, callback2.result());
+  EXPECT_TRUE(NULL == entry);
+  ASSERT_TRUE(NULL != entry2);
+  entry2->Close();
+}
+
+// Tests that an asynchronous enumeration returns the same entries as the
+// synchronous version.
+TEST_F(DiskCacheBackendTest, AsyncEnumerations) {
+  SetNewEviction();
+  InitCache();
+  const int kNumEntries = 10;
+  for (int i = 0; i < kNumEntries; i++) {
+    std::string key = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->CreateEntry(key, &entry));
+    entry->Close();
+  }
+
+  SimpleCallbackTest callback;
+  void* iter1 = NULL;
+  void* iter2 = NULL;
+  disk_cache::Entry *entry1, *entry2;
+  int count = 0;
+  while (net::OK == callback.GetResult(
+             cache_->OpenNextEntry(&iter1, &entry1, &callback))) {
+    ASSERT_TRUE(cache_->OpenNextEntry(&iter2, &entry2));
+    EXPECT_TRUE(entry1 == entry2);
+    entry1->Close();
+    entry2->Close();
+    count++;
+  }
+  EXPECT_EQ(kNumEntries, count);
+  EXPECT_FALSE(cache_->OpenNextEntry(&iter2, &entry2));
+}
+
 TEST_F(DiskCacheBackendTest, ExternalFiles) {
   InitCache();
   // First, lets create a file on the folder.
@@ -317,6 +482,111 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyLoad) {
   BackendLoad();
 }
 
+// Tests that the index table can be doubled while in use, and that the state of
+// the resize is preserved when the cache is re-opened.
+void DiskCacheBackendTest::BackendResizeIndex() {
+  SetDirectMode();
+  InitCache();
+
+  const int kNumEntries = 200;
+  std::string keys[kNumEntries];
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  // Split part of the table.
+  cache_impl_->ResizeIndexForTest(20000);
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+
+  // Add more entries while in the middle of the resize.
+  for (int i = 0; i < kNumEntries / 2; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->DoomEntry(keys[i]));
+    keys[i] = GenerateKey(true);
+    ASSERT_TRUE(cache_->CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  delete cache_;
+  cache_ = cache_impl_ = new disk_cache::BackendImpl(GetCachePath());
+  if (new_eviction_)
+    cache_impl_->SetNewEviction();
+  ASSERT_TRUE(cache_impl_->Init());
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+
+  // Now finish the resize.
+  cache_impl_->ResizeIndexForTest(kint32max);
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+  EXPECT_EQ(0, cache_impl_->SelfCheck());
+}
+
+TEST_F(DiskCacheBackendTest, ResizeIndex) {
+  BackendResizeIndex();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionResizeIndex) {
+  SetNewEviction();
+  BackendResizeIndex();
+}
+
+// Tests that no entry is lost if the split of a bucket is interrupted.
+void DiskCacheBackendTest::BackendInterruptedResize() {
+  SetDirectMode();
+  InitCache();
+
+  const int kNumEntries = 200;
+  std::string keys[kNumEntries];
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  cache_impl_->InterruptIndexResizeForTest(kNumEntries / 4);
+
+  delete cache_;
+  cache_ = cache_impl_ = new disk_cache::BackendImpl(GetCachePath());
+  if (new_eviction_)
+    cache_impl_->SetNewEviction();
+  ASSERT_TRUE(cache_impl_->Init());
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+
+  cache_impl_->ResizeIndexForTest(kint32max);
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache_->OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+  EXPECT_EQ(0, cache_impl_->SelfCheck());
+}
+
+TEST_F(DiskCacheBackendTest, InterruptedResize) {
+  BackendInterruptedResize();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionInterruptedResize) {
+  SetNewEviction();
+  BackendInterruptedResize();
+}
+
 // Before looking for invalid entries, let's check a valid entry.
 void DiskCacheBackendTest::BackendValidEntry() {
   SetDirectMode();
@@ -594,6 +864,151 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyEnumerations) {
   BackendEnumerations();
 }
 
+// Tests that the updates to the rankings of an open entry are performed when
+// the entry is closed.
+void DiskCacheBackendTest::BackendDelayedRankings() {
+  InitCache();
+
+  const int kSize = 100;
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  std::string keys[] = { "first", "second", "third" };
+  disk_cache::Entry* entry;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(cache_->CreateEntry(keys[i], &entry));
+    EXPECT_EQ(kSize, entry->WriteData(0, 0, buffer, kSize, NULL, false));
+    entry->Close();
+  }
+
+  // Read the first entry many times.
+  ASSERT_TRUE(cache_->OpenEntry(keys[0], &entry));
+  Time before_read = entry->GetLastUsed();
+  PlatformThread::Sleep(20);
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ(kSize, entry->ReadData(0, 0, buffer, kSize, NULL));
+  EXPECT_TRUE(before_read < entry->GetLastUsed());
+  entry->Close();
+
+  // Now use the second entry and doom it before closing it.
+  disk_cache::Entry* entry2;
+  ASSERT_TRUE(cache_->OpenEntry(keys[1], &entry2));
+  EXPECT_EQ(kSize, entry2->ReadData(0, 0, buffer, kSize, NULL));
+  entry2->Doom();
+  entry2->Close();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  // The most recently used entry goes first.
+  void* iter = NULL;
+  ASSERT_TRUE(cache_->OpenNextEntry(&iter, &entry));
+  EXPECT_EQ(keys[0], entry->GetKey());
+  entry->Close();
+  ASSERT_TRUE(cache_->OpenNextEntry(&iter, &entry));
+  EXPECT_EQ(keys[2], entry->GetKey());
+  entry->Close();
+  EXPECT_FALSE(cache_->OpenNextEntry(&iter, &entry));
+  cache_->EndEnumeration(&iter);
+}
+
+TEST_F(DiskCacheBackendTest, DelayedRankings) {
+  BackendDelayedRankings();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionDelayedRankings) {
+  SetNewEviction();
+  BackendDelayedRankings();
+}
+
+TEST_F(DiskCacheBackendTest, MemoryOnlyDelayedRankings) {
+  SetMemoryOnlyMode();
+  BackendDelayedRankings();
+}
+
+// Tests that entries with the same data share the storage.
+void DiskCacheBackendTest::BackendSharedData() {
+  SetDirectMode();
+  InitCache();
+  cache_impl_->SetSharedDataMode();
+
+  // The data has to be stored on a separate file.
+  const int kSize = 20000;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  std::string keys[] = { "the first key", "the second key" };
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(cache_->CreateEntry(keys[i], &entry));
+    EXPECT_EQ(kSize, entry->WriteData(1, 0, buffer1, kSize, NULL, false));
+    entry->Close();
+  }
+
+  // The data is hashed on a worker thread after the entries are closed.
+  SimpleCallbackTest callback;
+  disk_cache::ContentStore* store = cache_impl_->content_store();
+  EXPECT_EQ(net::OK, callback.GetResult(store->FlushForTest(&callback)));
+
+  // There is a third entry with the actual data.
+  EXPECT_EQ(3, cache_->GetEntryCount());
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(cache_->OpenEntry(keys[i], &entry));
+    EXPECT_EQ(kSize, entry->GetDataSize(1));
+    memset(buffer2->data(), 0, kSize);
+    EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+    EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+    entry->Close();
+  }
+
+  // The content entry is not visible through an enumeration.
+  void* iter = NULL;
+  int count = 0;
+  while (cache_->OpenNextEntry(&iter, &entry)) {
+    EXPECT_TRUE(keys[0] == entry->GetKey() || keys[1] == entry->GetKey());
+    entry->Close();
+    count++;
+  }
+  EXPECT_EQ(2, count);
+
+  // Deleting one of the entries doesn't affect the other one.
+  EXPECT_TRUE(cache_->DoomEntry(keys[0]));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  // Modifying the data gives a private copy to the entry, and the old shared
+  // data is deleted. When the entry is closed, the new body is hashed again
+  // and moved to its own content entry, so there are still two entries.
+  ASSERT_TRUE(cache_->OpenEntry(keys[1], &entry));
+  EXPECT_EQ(100, entry->WriteData(1, 500, buffer1, 100, NULL, false));
+  memcpy(buffer1->data() + 500, buffer1->data(), 100);
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+  EXPECT_EQ(net::OK, callback.GetResult(store->FlushForTest(&callback)));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  ASSERT_TRUE(cache_->OpenEntry(keys[1], &entry));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+  EXPECT_EQ(0, cache_impl_->SelfCheck());
+
+  // Dooming the user entries also removes the content.
+  EXPECT_TRUE(cache_->DoomEntriesSince(base::Time()));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCacheBackendTest, SharedData) {
+  BackendSharedData();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionSharedData) {
+  SetNewEviction();
+  BackendSharedData();
+}
+
 // Verify handling of invalid entries while doing enumerations.
 // We'll be leaking memory from this test.
 void DiskCacheBackendTest::BackendInvalidEntryEnumeration() {
@@ -1337,6 +1752,60 @@ TEST_F(DiskCacheTest, MultipleInstances) {
   }
 }
 
+// Tests that a second instance can read the entries of a cache owned by another
+// instance.
+TEST_F(DiskCacheTest, SharedInstances) {
+  ScopedTestCache store;
+  scoped_ptr<disk_cache::BackendImpl> owner(
+      new disk_cache::BackendImpl(store.path_wstring()));
+  owner->SetMultiProcessMode();
+  ASSERT_TRUE(owner->Init());
+  EXPECT_FALSE(owner->IsSharedReader());
+
+  const int kSize = 200;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry *entry1, *entry2;
+  ASSERT_TRUE(owner->CreateEntry("the first key", &entry1));
+  EXPECT_EQ(kSize, entry1->WriteData(0, 0, buffer1, kSize, NULL, false));
+  entry1->Close();
+  ASSERT_TRUE(owner->CreateEntry("the second key", &entry1));
+
+  scoped_ptr<disk_cache::BackendImpl> reader(
+      new disk_cache::BackendImpl(store.path_wstring()));
+  reader->SetMultiProcessMode();
+  ASSERT_TRUE(reader->Init());
+  EXPECT_TRUE(reader->IsSharedReader());
+  EXPECT_EQ(2, reader->GetEntryCount());
+
+  ASSERT_TRUE(reader->OpenEntry("the first key", &entry2));
+  EXPECT_EQ(kSize, entry2->ReadData(0, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  EXPECT_EQ(net::ERR_ACCESS_DENIED,
+            entry2->WriteData(0, 0, buffer1, kSize, NULL, false));
+  entry2->Close();
+
+  // The reader cannot modify the cache, or use an entry that is open by the
+  // owner.
+  EXPECT_FALSE(reader->CreateEntry("some other key", &entry2));
+  EXPECT_FALSE(reader->DoomEntry("the first key"));
+  EXPECT_FALSE(reader->OpenEntry("the second key", &entry2));
+  entry1->Close();
+  ASSERT_TRUE(reader->OpenEntry("the second key", &entry2));
+  entry2->Close();
+
+  // Once the owner goes away, the files can be owned by another instance.
+  reader.reset();
+  owner.reset();
+  owner.reset(new disk_cache::BackendImpl(store.path_wstring()));
+  owner->SetMultiProcessMode();
+  ASSERT_TRUE(owner->Init());
+  EXPECT_FALSE(owner->IsSharedReader());
+  EXPECT_EQ(2, owner->GetEntryCount());
+}
+
 // Test the four regions of the curve that determines the max cache size.
 TEST_F(DiskCacheTest, AutomaticMaxSize) {
   const int kDefaultSize = 80 * 1024 * 1024;
@@ -252,7 +252,7 @@ bool BlockFiles::OpenBlockFile(int index) {
     return false;
   }
 
-  if (header->updating) {
+  if (header->updating && !read_only_) {
     // Last instance was not properly shutdown.
     if (!FixBlockFileHeader(file))
       return false;
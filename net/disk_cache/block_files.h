@@ -20,13 +20,17 @@ class EntryImpl;
 class BlockFiles {
  public:
   explicit BlockFiles(const std::wstring& path)
-      : init_(false), zero_buffer_(NULL), path_(path) {}
+      : init_(false), read_only_(false), zero_buffer_(NULL), path_(path) {}
   ~BlockFiles();
 
   // Performs the object initialization. create_files indicates if the backing
   // files should be created or just open.
   bool Init(bool create_files);
 
+  // Prevents any modification of the headers of the files while they are open.
+  // This is used when the files are owned by another process.
+  void SetReadOnlyMode() { read_only_ = true; }
+
   // Returns the file that stores a given address.
   MappedFile* GetFile(Addr address);
 
@@ -68,6 +72,7 @@ class BlockFiles {
   std::wstring Name(int index);
 
   bool init_;
+  bool read_only_;
   char* zero_buffer_;  // Buffer to speed-up cleaning deleted entries.
   std::wstring path_;  // Path to the backing folder.
   std::vector<MappedFile*> block_files_;  // The actual files.
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/platform_file.h"
 
 namespace disk_cache {
 
@@ -25,6 +26,15 @@ bool DeleteCacheFile(const std::wstring& name);
 // Blocks until |num_pending_io| IO operations complete.
 void WaitForPendingIO(int* num_pending_io);
 
+// Attempts to take ownership of the cache stored on |path|, when the cache is
+// shared by multiple processes. Returns a handle that has to be kept open while
+// the ownership is needed, or base::kInvalidPlatformFileValue if the cache is
+// already owned by another instance.
+base::PlatformFile AcquireCacheOwnership(const std::wstring& path);
+
+// Releases the ownership obtained with AcquireCacheOwnership.
+void ReleaseCacheOwnership(base::PlatformFile lock);
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_CACHE_UTIL_H_
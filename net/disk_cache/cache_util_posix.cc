@@ -4,6 +4,11 @@
 
 #include "net/disk_cache/cache_util.h"
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "base/eintr_wrapper.h"
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/string_util.h"
@@ -40,4 +45,24 @@ void WaitForPendingIO(int* num_pending_io) {
   }
 }
 
+// We lock the folder itself, so the lock is not lost when the files of the
+// cache are deleted.
+base::PlatformFile AcquireCacheOwnership(const std::wstring& path) {
+  std::string name = WideToUTF8(path);
+  int lock = HANDLE_EINTR(open(name.c_str(), O_RDONLY));
+  if (lock < 0)
+    return base::kInvalidPlatformFileValue;
+
+  if (HANDLE_EINTR(flock(lock, LOCK_EX | LOCK_NB))) {
+    close(lock);
+    return base::kInvalidPlatformFileValue;
+  }
+  return lock;
+}
+
+void ReleaseCacheOwnership(base::PlatformFile lock) {
+  if (lock != base::kInvalidPlatformFileValue)
+    close(lock);
+}
+
 }  // namespace disk_cache
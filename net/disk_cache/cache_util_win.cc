@@ -72,4 +72,23 @@ void WaitForPendingIO(int* num_pending_io) {
   }
 }
 
+// The lock file cannot be deleted while it is open, so it stays on the folder
+// while the cache is owned by someone.
+base::PlatformFile AcquireCacheOwnership(const std::wstring& path) {
+  std::wstring name(path);
+  file_util::AppendToPath(&name, L"lock");
+
+  int flags = base::PLATFORM_FILE_OPEN_ALWAYS |
+              base::PLATFORM_FILE_READ |
+              base::PLATFORM_FILE_WRITE |
+              base::PLATFORM_FILE_EXCLUSIVE_READ |
+              base::PLATFORM_FILE_EXCLUSIVE_WRITE;
+  return base::CreatePlatformFile(name, flags, NULL);
+}
+
+void ReleaseCacheOwnership(base::PlatformFile lock) {
+  if (lock != base::kInvalidPlatformFileValue)
+    CloseHandle(lock);
+}
+
 }  // namespace disk_cache
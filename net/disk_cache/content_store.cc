@@ -0,0 +1,302 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/content_store.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/sha2.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "base/worker_pool.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/entry_impl.h"
+#include "net/disk_cache/file.h"
+#include "net/disk_cache/histogram_macros.h"
+
+using base::Time;
+using base::TimeDelta;
+
+namespace {
+
+// Stream that stores the ContentHeader of a content entry.
+const int kHeaderIndex = 0;
+
+// Number of bytes of the hash that identify the data.
+const int kContentIdLength = 16;
+
+}  // namespace
+
+namespace disk_cache {
+
+ContentHasher::ContentHasher(ContentStore* store, EntryImpl* entry, int index,
+                             const std::wstring& file_name)
+    : store_(store), store_loop_(MessageLoop::current()),
+      key_(entry->GetKey()), address_(entry->entry()->address()),
+      data_address_(entry->entry()->Data()->data_addr[index]),
+      size_(entry->GetDataSize(index)),
+      last_modified_(entry->GetLastModified()), file_name_(file_name),
+      success_(false) {
+  memset(id_, 0, sizeof(id_));
+}
+
+// The file is read through a private handle. If the entry is modified while we
+// read it, the result is discarded by the store.
+void ContentHasher::HashOnWorker() {
+  Time start = Time::Now();
+  scoped_refptr<File> file(new File(true));
+  std::string data;
+  data.resize(size_);
+  if (file->Init(file_name_) && file->Read(&data[0], size_, 0)) {
+    COMPILE_ASSERT(sizeof(id_) == kContentIdLength, bad_id_length);
+    base::SHA256HashString(data, id_, kContentIdLength);
+    success_ = true;
+  }
+  file = NULL;
+  hash_time_ = Time::Now() - start;
+
+  store_loop_->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &ContentHasher::OnHashDone));
+}
+
+void ContentHasher::OnHashDone() {
+  if (store_)
+    store_->OnDataHashed(this);
+}
+
+// ------------------------------------------------------------------------
+
+ContentStore::~ContentStore() {
+  for (HashersList::iterator it = pending_.begin(); it != pending_.end(); ++it)
+    (*it)->Cancel();
+}
+
+void ContentStore::Init(BackendImpl* backend) {
+  backend_ = backend;
+}
+
+// Note that this is only called for entries that wrote their data stream, and
+// only for data stored on a separate file, so there's no need to hash small
+// bodies over and over again.
+void ContentStore::ShareData(EntryImpl* entry) {
+  const uint32 kNotSharedFlags = PARENT_ENTRY | CHILD_ENTRY | CONTENT_ENTRY |
+                                 SHARED_DATA;
+  EntryStore* store = entry->entry()->Data();
+  if (store->flags & kNotSharedFlags)
+    return;
+
+  Addr address(store->data_addr[kDataIndex]);
+  int size = store->data_size[kDataIndex];
+  if (!address.is_initialized() || !address.is_separate_file() || !size)
+    return;
+
+  scoped_refptr<ContentHasher> hasher(
+      new ContentHasher(this, entry, kDataIndex,
+                        backend_->GetFileName(address)));
+  pending_.push_back(hasher);
+
+  if (!WorkerPool::PostTask(FROM_HERE,
+          NewRunnableMethod(hasher.get(), &ContentHasher::HashOnWorker),
+          false)) {
+    // We still have to complete the operation asynchronously.
+    hasher->HashOnWorker();
+  }
+}
+
+// The entry may have been used after it was closed, so we only move the data
+// if the entry is not in use, and it still stores the data that was hashed.
+void ContentStore::OnDataHashed(ContentHasher* hasher) {
+  scoped_refptr<ContentHasher> protect(hasher);
+  HashersList::iterator it = std::find(pending_.begin(), pending_.end(),
+                                       protect);
+  DCHECK(it != pending_.end());
+  pending_.erase(it);
+
+  CACHE_UMA(TIMES, "HashTime", 0, hasher->hash_time());
+  EntryImpl* entry = NULL;
+  if (hasher->success() && backend_->ShouldShareData())
+    entry = backend_->OpenIdleEntry(hasher->address(), hasher->key());
+
+  if (entry) {
+    const uint32 kNotSharedFlags = PARENT_ENTRY | CHILD_ENTRY | CONTENT_ENTRY |
+                                   SHARED_DATA;
+    EntryStore* store = entry->entry()->Data();
+    if (!(store->flags & kNotSharedFlags) &&
+        store->data_addr[kDataIndex] == hasher->data_address() &&
+        store->data_size[kDataIndex] == hasher->size() &&
+        entry->GetLastModified() == hasher->last_modified()) {
+      MoveDataToContent(entry, hasher->id());
+    }
+    entry->Close();
+  }
+
+  if (pending_.empty() && flush_callback_) {
+    net::CompletionCallback* callback = flush_callback_;
+    flush_callback_ = NULL;
+    callback->Run(net::OK);
+  }
+}
+
+void ContentStore::MoveDataToContent(EntryImpl* entry, const uint32* id) {
+  EntryStore* store = entry->entry()->Data();
+  Addr address(store->data_addr[kDataIndex]);
+  int size = store->data_size[kDataIndex];
+
+  std::string name = GenerateContentName(id);
+  Entry* tmp;
+  if (backend_->OpenEntry(name, &tmp)) {
+    // Note that we don't trust an entry of a different size.
+    EntryImpl* content = reinterpret_cast<EntryImpl*>(tmp);
+    bool success = content->GetDataSize(kDataIndex) == size &&
+                   AddReferences(content, 1) > 0;
+    content->Close();
+    if (!success)
+      return;
+
+    // Our copy is not needed anymore.
+    backend_->OnSharedDataFormat();
+    entry->DeleteData(address, kDataIndex);
+    backend_->ModifyStorageSize(size, 0);
+    backend_->OnSharedData(size);
+  } else {
+    if (!backend_->CreateEntry(name, &tmp))
+      return;
+
+    EntryImpl* content = reinterpret_cast<EntryImpl*>(tmp);
+    if (AddReferences(content, 1) != 1) {
+      content->Doom();
+      content->Close();
+      return;
+    }
+
+    // Give our data to the new entry.
+    backend_->OnSharedDataFormat();
+    content->SetEntryFlags(CONTENT_ENTRY);
+    content->entry()->Data()->data_addr[kDataIndex] = address.value();
+    content->entry()->Data()->data_size[kDataIndex] = size;
+    content->entry()->Store();
+    entry->files_[kDataIndex] = NULL;
+    content->Close();
+  }
+
+  store->data_addr[kDataIndex] = 0;
+  memcpy(store->content_id, id, kContentIdLength);
+  entry->SetEntryFlags(SHARED_DATA);
+  entry->entry()->Store();
+}
+
+int ContentStore::ReadData(EntryImpl* entry, int offset, net::IOBuffer* buf,
+                           int buf_len, net::CompletionCallback* callback) {
+  DCHECK(entry->GetEntryFlags() & SHARED_DATA);
+  if (!entry->content_) {
+    Entry* content;
+    std::string name = GenerateContentName(entry->entry()->Data()->content_id);
+    if (!backend_->OpenEntry(name, &content)) {
+      // The data was evicted from the cache.
+      return net::ERR_FAILED;
+    }
+
+    if (content->GetDataSize(kDataIndex) != entry->GetDataSize(kDataIndex)) {
+      content->Close();
+      return net::ERR_FAILED;
+    }
+    entry->content_ = content;
+  }
+
+  return entry->content_->ReadData(kDataIndex, offset, buf, buf_len, callback);
+}
+
+bool ContentStore::UnshareData(EntryImpl* entry, bool copy_data) {
+  int size = entry->GetDataSize(kDataIndex);
+  scoped_refptr<net::IOBuffer> buffer;
+  if (copy_data && size) {
+    buffer = new net::IOBuffer(size);
+    if (size != ReadData(entry, 0, buffer, size, NULL))
+      return false;
+  }
+
+  ReleaseData(entry);
+  entry->entry()->Store();
+
+  if (!buffer)
+    return true;
+
+  return size == entry->WriteData(kDataIndex, 0, buffer, size, NULL, false);
+}
+
+void ContentStore::ReleaseData(EntryImpl* entry) {
+  EntryStore* store = entry->entry()->Data();
+  DCHECK(store->flags & SHARED_DATA);
+  if (entry->content_) {
+    entry->content_->Close();
+    entry->content_ = NULL;
+  }
+
+  std::string name = GenerateContentName(store->content_id);
+  store->flags &= ~SHARED_DATA;
+  store->data_size[kDataIndex] = 0;
+  memset(store->content_id, 0, sizeof(store->content_id));
+  entry->entry()->set_modified();
+
+  // Updating the content entry may end up deleting it, and we may be in the
+  // middle of deleting entries already.
+  MessageLoop::current()->PostTask(FROM_HERE,
+      factory_.NewRunnableMethod(&ContentStore::ReleaseContent, name));
+}
+
+// Static.
+std::string ContentStore::GenerateContentName(const uint32* id) {
+  return StringPrintf("Content_%08x%08x%08x%08x", id[0], id[1], id[2], id[3]);
+}
+
+int ContentStore::FlushForTest(net::CompletionCallback* callback) {
+  if (pending_.empty())
+    return net::OK;
+
+  flush_callback_ = callback;
+  return net::ERR_IO_PENDING;
+}
+
+int ContentStore::AddReferences(EntryImpl* content, int delta) {
+  ContentHeader header;
+  int header_size = static_cast<int>(sizeof(header));
+  scoped_refptr<net::WrappedIOBuffer> buf =
+      new net::WrappedIOBuffer(reinterpret_cast<char*>(&header));
+
+  int current_size = content->GetDataSize(kHeaderIndex);
+  if (!current_size) {
+    memset(&header, 0, sizeof(header));
+    header.magic = kIndexMagic;
+  } else if (current_size != header_size ||
+             header_size != content->ReadData(kHeaderIndex, 0, buf,
+                                              header_size, NULL) ||
+             header.magic != kIndexMagic) {
+    LOG(WARNING) << "Invalid content entry.";
+    return -1;
+  }
+
+  header.num_refs += delta;
+  if (header_size != content->WriteData(kHeaderIndex, 0, buf, header_size,
+                                        NULL, true)) {
+    return -1;
+  }
+  return header.num_refs;
+}
+
+void ContentStore::ReleaseContent(const std::string& name) {
+  Entry* tmp;
+  if (!backend_->OpenEntry(name, &tmp))
+    return;
+
+  EntryImpl* content = reinterpret_cast<EntryImpl*>(tmp);
+  if (AddReferences(content, -1) <= 0)
+    content->Doom();
+  content->Close();
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,153 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_CONTENT_STORE_H_
+#define NET_DISK_CACHE_CONTENT_STORE_H_
+
+#include <list>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/ref_counted.h"
+#include "base/task.h"
+#include "base/time.h"
+#include "net/base/completion_callback.h"
+#include "net/disk_cache/addr.h"
+
+class MessageLoop;
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+class BackendImpl;
+class ContentStore;
+class EntryImpl;
+
+// This class hashes the data stream of an entry on a worker thread. It keeps a
+// copy of whatever is needed to find the entry again, and to tell if it was
+// modified while the data was being hashed.
+class ContentHasher : public base::RefCountedThreadSafe<ContentHasher> {
+ public:
+  ContentHasher(ContentStore* store, EntryImpl* entry, int index,
+                const std::wstring& file_name);
+
+  // Reads and hashes the data. Runs on a worker thread.
+  void HashOnWorker();
+
+  // Notifies the store that the hash is ready (on the thread of the cache).
+  void OnHashDone();
+
+  // Prevents any further notification to the store.
+  void Cancel() { store_ = NULL; }
+
+  const std::string& key() const { return key_; }
+  Addr address() const { return address_; }
+  CacheAddr data_address() const { return data_address_; }
+  int size() const { return size_; }
+  base::Time last_modified() const { return last_modified_; }
+  base::TimeDelta hash_time() const { return hash_time_; }
+  bool success() const { return success_; }
+  const uint32* id() const { return id_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<ContentHasher>;
+  ~ContentHasher() {}
+
+  ContentStore* store_;  // Only valid on the thread of the cache.
+  MessageLoop* store_loop_;
+  std::string key_;
+  Addr address_;  // Address of the entry.
+  CacheAddr data_address_;
+  int size_;
+  base::Time last_modified_;
+  std::wstring file_name_;
+  base::TimeDelta hash_time_;
+  bool success_;
+  uint32 id_[4];
+
+  DISALLOW_COPY_AND_ASSIGN(ContentHasher);
+};
+
+// This class implements the de-duplication of the data stream (stream 1) of
+// the entries stored by the cache, and it is tightly integrated with EntryImpl.
+//
+// When an entry that stores its data on a separate file is closed, the data is
+// hashed (SHA-256) on a worker thread. If the entry is not in use (and was not
+// modified) when the hash is ready, the data is moved to a content entry, named
+// after the hash, that can be shared by all the entries that store the same
+// data. Content entries are not returned by enumerations. The content entry
+// keeps track (on stream 0) of the number of entries that point to it, and it
+// is doomed when the last one goes away. Content entries are regular entries
+// from the point of view of the eviction code: they are evicted when they are
+// not used, and an entry that points to missing content just fails to read its
+// data.
+class ContentStore {
+ public:
+  // The stream that can be shared.
+  static const int kDataIndex = 1;
+
+  ContentStore()
+      : backend_(NULL), flush_callback_(NULL),
+        ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)) {}
+  ~ContentStore();
+
+  void Init(BackendImpl* backend);
+
+  // Starts hashing the data of |entry|, so that it can be moved to the store
+  // later on. This is called when the entry is being closed.
+  void ShareData(EntryImpl* entry);
+
+  // Called when |hasher| is done.
+  void OnDataHashed(ContentHasher* hasher);
+
+  // Reads the shared data of |entry|. Returns the same values as
+  // Entry::ReadData.
+  int ReadData(EntryImpl* entry, int offset, net::IOBuffer* buf, int buf_len,
+               net::CompletionCallback* callback);
+
+  // Stops sharing the data of |entry|, because the data is about to be
+  // modified. If |copy_data| is true, |entry| receives a private copy of the
+  // data. Returns false on failure.
+  bool UnshareData(EntryImpl* entry, bool copy_data);
+
+  // Releases the shared data of |entry| (that is being deleted).
+  void ReleaseData(EntryImpl* entry);
+
+  // Generates the key of a content entry from the hash of the data.
+  static std::string GenerateContentName(const uint32* id);
+
+  // Returns net::OK if no data is being hashed, or ERR_IO_PENDING if |callback|
+  // will be invoked when all the pending hashes are processed.
+  int FlushForTest(net::CompletionCallback* callback);
+
+ private:
+  typedef std::list<scoped_refptr<ContentHasher> > HashersList;
+
+  // Moves the data of |entry| to the content entry identified by |id|.
+  void MoveDataToContent(EntryImpl* entry, const uint32* id);
+
+  // Adds |delta| references to |content|. Returns the number of references, or
+  // -1 on failure.
+  int AddReferences(EntryImpl* content, int delta);
+
+  // Removes one reference from the content entry called |name|.
+  void ReleaseContent(const std::string& name);
+
+  BackendImpl* backend_;
+  HashersList pending_;  // Hashes in progress.
+  net::CompletionCallback* flush_callback_;
+  ScopedRunnableMethodFactory<ContentStore> factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContentStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_CONTENT_STORE_H_
@@ -67,6 +67,20 @@ class Backend {
   // Marks the entry, specified by the given key, for deletion.
   virtual bool DoomEntry(const std::string& key) = 0;
 
+  // Asynchronous versions of OpenEntry, CreateEntry and DoomEntry. These
+  // methods return net::OK on success and net::ERR_FAILED on failure. If the
+  // operation cannot be completed synchronously, ERR_IO_PENDING is returned and
+  // |callback| will be invoked (with one of the previous values) on the current
+  // thread when the operation completes. |entry| must remain valid until the
+  // callback is invoked. Note that destroying the backend cancels any pending
+  // operation without invoking its callback.
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        net::CompletionCallback* callback) = 0;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          net::CompletionCallback* callback) = 0;
+  virtual int DoomEntry(const std::string& key,
+                        net::CompletionCallback* callback) = 0;
+
   // Marks all entries for deletion.
   virtual bool DoomAllEntries() = 0;
 
@@ -89,6 +103,12 @@ class Backend {
   // and therefore it does not impact the eviction ranking of the entry.
   virtual bool OpenNextEntry(void** iter, Entry** next_entry) = 0;
 
+  // Asynchronous version of OpenNextEntry. Returns net::OK when |next_entry|
+  // is available, ERR_FAILED when there are no more entries to enumerate, or
+  // ERR_IO_PENDING if |callback| will be invoked when the operation completes.
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            net::CompletionCallback* callback) = 0;
+
   // Releases iter without returning the next entry. Whenever OpenNextEntry()
   // returns true, but the caller is not interested in continuing the
   // enumeration by calling OpenNextEntry() again, the enumeration must be
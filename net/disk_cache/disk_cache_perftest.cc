@@ -8,11 +8,13 @@
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/perftimer.h"
+#include "base/sha2.h"
 #include "base/string_util.h"
 #include "base/test_file_util.h"
 #include "base/timer.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/block_files.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
@@ -137,6 +139,47 @@ int BlockSize() {
   return (rand() & 0x3) + 1;
 }
 
+// Returns the number of bytes stored by |cache|, as reported by GetStats().
+int GetCacheSize(disk_cache::Backend* cache) {
+  std::vector<std::pair<std::string, std::string> > stats;
+  cache->GetStats(&stats);
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Current size")
+      return StringToInt(stats[i].second);
+  }
+  return 0;
+}
+
+// Creates num_entries on |cache|, with data on a separate file. Only
+// num_bodies different bodies are used for all the entries. Returns the size of
+// the cache when all the entries are closed.
+int WriteDuplicatedBodies(int num_entries, int num_bodies,
+                          disk_cache::BackendImpl* cache) {
+  const int kBodySize = 64 * 1024;
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kBodySize);
+  CacheTestFillBuffer(buffer->data(), kBodySize, false);
+
+  for (int i = 0; i < num_entries; i++) {
+    disk_cache::Entry* cache_entry;
+    if (!cache->CreateEntry(GenerateKey(true), &cache_entry))
+      break;
+
+    // Each body is identified by the first bytes of the buffer.
+    int body = i % num_bodies;
+    memcpy(buffer->data(), &body, sizeof(body));
+    int ret = cache_entry->WriteData(1, 0, buffer, kBodySize, NULL, false);
+    cache_entry->Close();
+    if (kBodySize != ret)
+      break;
+  }
+
+  // Wait until the bodies are hashed and moved to the content entries.
+  SimpleCallbackTest callback;
+  callback.GetResult(cache->content_store()->FlushForTest(&callback));
+  MessageLoop::current()->RunAllPending();
+  return GetCacheSize(cache);
+}
+
 }  // namespace
 
 TEST_F(DiskCacheTest, Hash) {
@@ -151,6 +194,52 @@ TEST_F(DiskCacheTest, Hash) {
   timer.Done();
 }
 
+TEST_F(DiskCacheTest, HashContent) {
+  const int kSize = 64 * 1024;
+  std::string data(kSize, 0);
+  CacheTestFillBuffer(&data[0], kSize, false);
+  uint32 id[4];
+
+  const int kIterations = 2000;
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; i++) {
+    data[0] = static_cast<char>(i);
+    base::SHA256HashString(data, id, sizeof(id));
+  }
+  double seconds = timer.Elapsed().InSecondsF();
+  if (seconds > 0) {
+    LogPerfResult("Hash disk cache data", kIterations * (kSize / 1024.0) /
+                  1024.0 / seconds, "MB/s");
+  }
+}
+
+// Measures the cost and benefit of sharing the data of entries with the same
+// body.
+TEST_F(DiskCacheTest, SharedDataPerformance) {
+  MessageLoopForIO message_loop;
+
+  const int kNumEntries = 400;
+  const int kNumBodies = 40;
+  int sizes[2];
+  for (int i = 0; i < 2; i++) {
+    ScopedTestCache test_cache;
+    disk_cache::BackendImpl* cache =
+        new disk_cache::BackendImpl(test_cache.path_wstring());
+    ASSERT_TRUE(NULL != cache);
+    ASSERT_TRUE(cache->Init());
+    if (i)
+      cache->SetSharedDataMode();
+
+    PerfTimeLogger timer(i ? "Write duplicated entries (shared data)" :
+                         "Write duplicated entries");
+    sizes[i] = WriteDuplicatedBodies(kNumEntries, kNumBodies, cache);
+    timer.Done();
+    delete cache;
+  }
+
+  LogPerfResult("Shared data bytes saved", sizes[0] - sizes[1], "bytes");
+}
+
 TEST_F(DiskCacheTest, CacheBackendPerformance) {
   MessageLoopForIO message_loop;
 
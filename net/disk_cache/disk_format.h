@@ -65,6 +65,17 @@ const int kIndexTablesize = 0x10000;
 const uint32 kIndexMagic = 0xC103CAC3;
 const uint32 kCurrentVersion = 0x20000;  // Version 2.0.
 
+// Version 3 is used only while the hash table of the index is being doubled.
+// The minor version has the same meaning as for version 2, and the file goes
+// back to version 2 (or 4) when all the buckets have been split.
+const uint32 kIndexResizeVersion = 0x30000;
+
+// Version 4 is used from the moment the data of an entry is shared with other
+// entries (see ContentStore), because older versions of the code would not be
+// able to read that entry. The minor version has the same meaning as for
+// version 2. The block files are not affected.
+const uint32 kSharedDataVersion = 0x40000;
+
 struct LruData {
   int32     pad1[2];
   int32     filled;          // Flag to tell when we filled the cache.
@@ -90,7 +101,10 @@ struct IndexHeader {
   int32       crash;         // Signals a previous crash.
   int32       experiment;    // Id of an ongoing test.
   uint64      create_time;   // Creation time for this set of files.
-  int32       pad[52];
+  int32       resize_len;    // New size of the table while resizing, or 0.
+  int32       resize_bucket; // Next bucket to be split while resizing.
+  int32       shared_data;   // Set when entries may share data (version 4).
+  int32       pad[49];
   LruData     lru;           // Eviction control data.
   IndexHeader() {
     memset(this, 0, sizeof(*this));
@@ -100,6 +114,11 @@ struct IndexHeader {
 };
 
 // The structure of the whole index file.
+//
+// The table is doubled in place, one bucket at a time: while resize_len is not
+// zero, buckets lower than resize_bucket are addressed with the mask for the
+// new table (so their entries may be on bucket + table_len), and the rest of
+// the buckets keep using the mask for table_len.
 struct Index {
   IndexHeader header;
   CacheAddr   table[kIndexTablesize];  // Default size. Actual size controlled
@@ -124,7 +143,8 @@ struct EntryStore {
   int32       data_size[4];       // We can store up to 4 data streams for each
   CacheAddr   data_addr[4];       // entry.
   uint32      flags;              // Any combination of EntryFlags.
-  int32       pad[5];
+  uint32      content_id[4];      // Hash of the data stream, if shared.
+  int32       pad;
   char        key[256 - 24 * 4];  // null terminated
 };
 
@@ -142,7 +162,9 @@ enum EntryState {
 // Flags that can be applied to an entry.
 enum EntryFlags {
   PARENT_ENTRY = 1,         // This entry has children (sparse) entries.
-  CHILD_ENTRY = 1 << 1      // Child entry that stores sparse data.
+  CHILD_ENTRY = 1 << 1,     // Child entry that stores sparse data.
+  CONTENT_ENTRY = 1 << 2,   // Entry that stores data shared by other entries.
+  SHARED_DATA = 1 << 3      // The data stream is stored by a content entry.
 };
 
 #pragma pack(push, 4)
@@ -256,6 +278,20 @@ const int kNumSparseBits = 1024;
 COMPILE_ASSERT(sizeof(SparseData) == sizeof(SparseHeader) + kNumSparseBits / 8,
                Invalid_SparseData_bitmap);
 
+// -------------------------------------------------------------------------
+// The data stream (index 1) of an entry may be shared with other entries that
+// store exactly the same data. In that case, the data is actually stored by a
+// content entry (named after the SHA-256 hash of the data), and the entry has
+// the SHARED_DATA flag, no data address for that stream and the first 16 bytes
+// of the hash on content_id.
+
+// This structure is stored at offset 0 of stream 0 of a content entry.
+struct ContentHeader {
+  uint32 magic;             // Structure identifier (equal to kIndexMagic).
+  int32 num_refs;           // Number of entries sharing this data.
+  int32 dummy[2];
+};
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_DISK_FORMAT_H_
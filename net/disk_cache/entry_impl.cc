@@ -12,6 +12,7 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/bitmap.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/content_store.h"
 #include "net/disk_cache/histogram_macros.h"
 #include "net/disk_cache/sparse_control.h"
 
@@ -80,6 +81,8 @@ EntryImpl::EntryImpl(BackendImpl* backend, Addr address)
     : entry_(NULL, Addr(0)), node_(NULL, Addr(0)) {
   entry_.LazyInit(backend->File(address), address);
   doomed_ = false;
+  data_modified_ = false;
+  content_ = NULL;
   backend_ = backend;
   for (int i = 0; i < kNumStreams; i++) {
     unreported_size_[i] = 0;
@@ -96,9 +99,17 @@ EntryImpl::~EntryImpl() {
   // Save the sparse info to disk before deleting this entry.
   sparse_.reset();
 
+  if (content_) {
+    content_->Close();
+    content_ = NULL;
+  }
+
   if (doomed_) {
     DeleteEntryData(true);
-  } else {
+  } else if (!backend_->IsSharedReader()) {
+    // Move this entry to its final place on the rankings lists.
+    backend_->FlushRank(this);
+
     bool ret = true;
     for (int index = 0; index < kNumStreams; index++) {
       if (user_buffers_[index].get()) {
@@ -110,6 +121,12 @@ EntryImpl::~EntryImpl() {
             entry_.Data()->data_size[index]);
       }
     }
+
+    // The data is not going to change anymore, so this is a good time to look
+    // for other entries with the same data.
+    if (ret && data_modified_ && backend_->ShouldShareData())
+      backend_->content_store()->ShareData(this);
+
     if (node_.HasData() && this == node_.Data()->pointer) {
       // We have to do this after Flush because we may trigger a cache trim from
       // there, and technically this entry should be "in use".
@@ -132,7 +149,7 @@ EntryImpl::~EntryImpl() {
 }
 
 void EntryImpl::Doom() {
-  if (doomed_)
+  if (doomed_ || backend_->IsSharedReader())
     return;
 
   SetPointerForInvalidEntry(backend_->GetCurrentEntryId());
@@ -202,10 +219,20 @@ int EntryImpl::ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
   if (offset + buf_len > entry_size)
     buf_len = entry_size - offset;
 
+  // The owner of a shared cache may be deleting this entry.
+  bool shared_reader = backend_->IsSharedReader();
+  if (shared_reader && !IsUnchangedOnDisk())
+    return net::ERR_FAILED;
+
   UpdateRank(false);
 
   backend_->OnEvent(Stats::READ_DATA);
 
+  if (ContentStore::kDataIndex == index && (GetEntryFlags() & SHARED_DATA)) {
+    return backend_->content_store()->ReadData(this, offset, buf, buf_len,
+                                               completion_callback);
+  }
+
   if (user_buffers_[index].get()) {
     // Complete the operation locally.
     DCHECK(kMaxBlockSize >= offset + buf_len);
@@ -242,6 +269,12 @@ int EntryImpl::ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
   if (io_callback && completed)
     io_callback->Discard();
 
+  // Make sure that we didn't read data from a block reused by the owner.
+  if (shared_reader && (completed || !completion_callback) &&
+      !IsUnchangedOnDisk()) {
+    return net::ERR_FAILED;
+  }
+
   ReportIOTime(kRead, start);
   return (completed || !completion_callback) ? buf_len : net::ERR_IO_PENDING;
 }
@@ -256,6 +289,19 @@ int EntryImpl::WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
   if (offset < 0 || buf_len < 0)
     return net::ERR_INVALID_ARGUMENT;
 
+  if (backend_->IsSharedReader())
+    return net::ERR_ACCESS_DENIED;
+
+  if (ContentStore::kDataIndex == index) {
+    // The data may be shared with other entries, but not anymore.
+    if (GetEntryFlags() & SHARED_DATA) {
+      bool copy_data = offset || !truncate;
+      if (!backend_->content_store()->UnshareData(this, copy_data))
+        return net::ERR_FAILED;
+    }
+    data_modified_ = true;
+  }
+
   int max_file_size = backend_->MaxFileSize();
 
   // offset of buf_len could be negative numbers.
@@ -458,6 +504,9 @@ void EntryImpl::DeleteEntryData(bool everything) {
     SparseControl::DeleteChildren(this);
   }
 
+  if (GetEntryFlags() & SHARED_DATA)
+    backend_->content_store()->ReleaseData(this);
+
   if (GetDataSize(0))
     CACHE_UMA(COUNTS, "DeleteHeader", 0, GetDataSize(0));
   if (GetDataSize(1))
@@ -515,6 +564,13 @@ bool EntryImpl::Update() {
   DCHECK(node_.HasData());
 
   RankingsNode* rankings = node_.Data();
+  if (backend_->IsSharedReader()) {
+    // We only keep a private copy of the node, so it can be marked as in use
+    // without telling anybody else.
+    rankings->dirty = backend_->GetCurrentEntryId();
+    return true;
+  }
+
   if (rankings->pointer) {
     // Nothing to do here, the entry was in memory.
     DCHECK(rankings->pointer == this);
@@ -627,17 +683,28 @@ void EntryImpl::DeleteData(Addr address, int index) {
 }
 
 void EntryImpl::UpdateRank(bool modified) {
-  if (!doomed_) {
-    // Everything is handled by the backend.
-    backend_->UpdateRank(this, true);
-    return;
-  }
-
+  // The backend may delay updating the lists until this entry is closed, so the
+  // times are always updated here.
   Time current = Time::Now();
   node_.Data()->last_used = current.ToInternalValue();
 
   if (modified)
     node_.Data()->last_modified = current.ToInternalValue();
+
+  if (!doomed_)
+    backend_->UpdateRank(this, true);
+}
+
+bool EntryImpl::IsUnchangedOnDisk() {
+  CacheEntryBlock entry(backend_->File(entry_.address()), entry_.address());
+  CacheRankingsBlock node(backend_->File(node_.address()), node_.address());
+  if (!entry.Load() || !node.Load())
+    return false;
+
+  // Our copy of the node is marked as in use.
+  return !memcmp(entry.Data(), entry_.Data(), sizeof(EntryStore)) &&
+         node.Data()->contents == entry_.address().value() &&
+         !node.Data()->pointer && !node.Data()->dirty;
 }
 
 File* EntryImpl::GetBackingFile(Addr address, int index) {
@@ -832,6 +899,10 @@ int EntryImpl::InitSparseData() {
   if (sparse_.get())
     return net::OK;
 
+  // Sparse entries are not supported by shared readers.
+  if (backend_->IsSharedReader())
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+
   sparse_.reset(new SparseControl(this));
   int result = sparse_->Init();
   if (net::OK != result)
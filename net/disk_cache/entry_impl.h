@@ -13,12 +13,14 @@
 namespace disk_cache {
 
 class BackendImpl;
+class ContentStore;
 class SparseControl;
 
 // This class implements the Entry interface. An object of this
 // class represents a single entry on the cache.
 class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   friend class base::RefCounted<EntryImpl>;
+  friend class ContentStore;
   friend class SparseControl;
  public:
   EntryImpl(BackendImpl* backend, Addr address);
@@ -125,6 +127,10 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   // Updates ranking information.
   void UpdateRank(bool modified);
 
+  // Returns true if the owner of the cache has not modified this entry since it
+  // was loaded by a shared reader.
+  bool IsUnchangedOnDisk();
+
   // Returns a pointer to the file that stores the given address.
   File* GetBackingFile(Addr address, int index);
 
@@ -180,6 +186,8 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
                                                   // user data and key.
   int unreported_size_[kNumStreams];  // Bytes not reported yet to the backend.
   bool doomed_;               // True if this entry was removed from the cache.
+  bool data_modified_;        // True if the data stream (1) was written.
+  Entry* content_;            // Entry that stores our data, if shared.
   scoped_ptr<SparseControl> sparse_;  // Support for sparse entries.
 
   DISALLOW_EVIL_CONSTRUCTORS(EntryImpl);
@@ -69,6 +69,10 @@ void Eviction::Init(BackendImpl* backend) {
   delay_trim_ = false;
 }
 
+void Eviction::OnIndexRemapped() {
+  header_ = &backend_->data_->header;
+}
+
 void Eviction::TrimCache(bool empty) {
   if (new_eviction_)
     return TrimCacheV2(empty);
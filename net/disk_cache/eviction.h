@@ -17,7 +17,8 @@ class BackendImpl;
 class EntryImpl;
 
 // This class implements the eviction algorithm for the cache and it is tightly
-// integrated with BackendImpl.
+// integrated with BackendImpl. See eviction_policy.h for the models used to
+// compare different policies offline.
 class Eviction {
  public:
   Eviction() : backend_(NULL), ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)) {}
@@ -25,6 +26,9 @@ class Eviction {
 
   void Init(BackendImpl* backend);
 
+  // The index file was mapped again, at a different address.
+  void OnIndexRemapped();
+
   // Deletes entries from the cache until the current size is below the limit.
   // If empty is true, the whole cache will be trimmed, regardless of being in
   // use.
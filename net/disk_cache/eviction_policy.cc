@@ -0,0 +1,381 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/eviction_policy.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+// Reuse count to be on the HIGH_USE list (same as eviction.cc).
+const int kHighUse = 10;
+
+// Expected size of an entry, used to size the frequency sketch.
+const int kAverageEntrySize = 16 * 1024;
+
+// Percentage of the cache used by the protected segment of TinyLFU.
+const int kProtectedPercent = 80;
+
+typedef disk_cache::SimulatedList::Node Node;
+
+Node NewNode(uint32 hash, int size) {
+  Node node;
+  node.hash = hash;
+  node.size = size;
+  node.reuse_count = 0;
+  node.refetch_count = 0;
+  return node;
+}
+
+// The original eviction algorithm: a single list with pure LRU.
+class LruPolicy : public disk_cache::EvictionPolicy {
+ public:
+  explicit LruPolicy(int64 max_bytes) : max_bytes_(max_bytes) {}
+  virtual ~LruPolicy() {}
+
+  virtual const char* name() const { return "LRU"; }
+
+  virtual bool Lookup(uint32 hash) {
+    if (!list_.Find(hash))
+      return false;
+    list_.MoveToFront(hash);
+    return true;
+  }
+
+  virtual bool Insert(uint32 hash, int size) {
+    if (size > max_bytes_)
+      return false;
+
+    list_.Push(NewNode(hash, size));
+    while (list_.num_bytes() > max_bytes_)
+      list_.Remove(list_.Back().hash, NULL);
+    return true;
+  }
+
+  virtual void Remove(uint32 hash) {
+    list_.Remove(hash, NULL);
+  }
+
+  virtual int64 current_bytes() const { return list_.num_bytes(); }
+  virtual int num_entries() const { return list_.size(); }
+
+ private:
+  int64 max_bytes_;
+  disk_cache::SimulatedList list_;
+
+  DISALLOW_COPY_AND_ASSIGN(LruPolicy);
+};
+
+// The eviction algorithm used with kNewEviction: entries are kept on separate
+// lists depending on how often they are reused, and evicted entries are
+// remembered for a while. See eviction.cc for the details. The time targets of
+// the real implementation are not modeled (the logs don't record time), so the
+// list to evict from is always selected by length.
+class ReusePolicy : public disk_cache::EvictionPolicy {
+ public:
+  explicit ReusePolicy(int64 max_bytes) : max_bytes_(max_bytes) {}
+  virtual ~ReusePolicy() {}
+
+  virtual const char* name() const { return "Reuse lists"; }
+
+  virtual bool Lookup(uint32 hash) {
+    for (int i = 0; i < kNumLists; i++) {
+      Node* node = lists_[i].Find(hash);
+      if (!node)
+        continue;
+
+      if (node->reuse_count < kint32max)
+        node->reuse_count++;
+
+      int list = GetListForNode(*node);
+      if (list == i) {
+        lists_[i].MoveToFront(hash);
+      } else {
+        Node tmp;
+        lists_[i].Remove(hash, &tmp);
+        lists_[list].Push(tmp);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  virtual bool Insert(uint32 hash, int size) {
+    if (size > max_bytes_)
+      return false;
+
+    Node node = NewNode(hash, size);
+    Node old_node;
+    if (deleted_.Remove(hash, &old_node)) {
+      // This entry was evicted before.
+      node.refetch_count = old_node.refetch_count;
+      node.reuse_count = old_node.reuse_count;
+      if (node.refetch_count < kint32max)
+        node.refetch_count++;
+
+      if (node.refetch_count > kHighUse && node.reuse_count < kHighUse) {
+        node.reuse_count = kHighUse;
+      } else {
+        node.reuse_count++;
+      }
+    }
+    lists_[GetListForNode(node)].Push(node);
+    TrimCache();
+    return true;
+  }
+
+  virtual void Remove(uint32 hash) {
+    for (int i = 0; i < kNumLists; i++) {
+      if (lists_[i].Remove(hash, NULL))
+        return;
+    }
+    deleted_.Remove(hash, NULL);
+  }
+
+  virtual int64 current_bytes() const {
+    int64 bytes = 0;
+    for (int i = 0; i < kNumLists; i++)
+      bytes += lists_[i].num_bytes();
+    return bytes;
+  }
+
+  virtual int num_entries() const {
+    int entries = 0;
+    for (int i = 0; i < kNumLists; i++)
+      entries += lists_[i].size();
+    return entries;
+  }
+
+ private:
+  enum List {
+    NO_USE = 0,
+    LOW_USE,
+    HIGH_USE,
+    kNumLists
+  };
+
+  int GetListForNode(const Node& node) const {
+    if (!node.reuse_count)
+      return NO_USE;
+    if (node.reuse_count < kHighUse)
+      return LOW_USE;
+    return HIGH_USE;
+  }
+
+  // Each list should have roughly the same number of entries.
+  int SelectListByLength() const {
+    int data_entries = num_entries();
+    for (int i = 0; i < kNumLists - 1; i++) {
+      if (lists_[i].size() > data_entries / 3)
+        return i;
+    }
+    return HIGH_USE;
+  }
+
+  void TrimCache() {
+    while (current_bytes() > max_bytes_) {
+      int list = SelectListByLength();
+      while (lists_[list].empty())
+        list = (list + 1) % kNumLists;
+
+      Node node;
+      lists_[list].Remove(lists_[list].Back().hash, &node);
+      node.size = 0;
+      deleted_.Push(node);
+    }
+
+    // The real cache discards the oldest evicted entries when they are more
+    // than a quarter of all the entries (including the evicted ones).
+    while (deleted_.size() > num_entries() / 3)
+      deleted_.Remove(deleted_.Back().hash, NULL);
+  }
+
+  int64 max_bytes_;
+  disk_cache::SimulatedList lists_[kNumLists];
+  disk_cache::SimulatedList deleted_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReusePolicy);
+};
+
+// A segmented LRU with a probation and a protected segment, where new entries
+// are only admitted if they are requested more often than the entry that would
+// be evicted to make room for them (TinyLFU). Entries are promoted to the
+// protected segment when they are reused.
+class TinyLfuPolicy : public disk_cache::EvictionPolicy {
+ public:
+  explicit TinyLfuPolicy(int64 max_bytes)
+      : max_bytes_(max_bytes),
+        max_protected_bytes_(max_bytes / 100 * kProtectedPercent),
+        sketch_(static_cast<int>(std::max(max_bytes / kAverageEntrySize,
+                                          static_cast<int64>(1024)))) {}
+  virtual ~TinyLfuPolicy() {}
+
+  virtual const char* name() const { return "TinyLFU"; }
+
+  virtual bool Lookup(uint32 hash) {
+    sketch_.Increment(hash);
+    if (protected_.Find(hash)) {
+      protected_.MoveToFront(hash);
+      return true;
+    }
+
+    Node node;
+    if (!probation_.Remove(hash, &node))
+      return false;
+
+    protected_.Push(node);
+    while (protected_.num_bytes() > max_protected_bytes_) {
+      protected_.Remove(protected_.Back().hash, &node);
+      probation_.Push(node);
+    }
+    return true;
+  }
+
+  virtual bool Insert(uint32 hash, int size) {
+    if (size > max_bytes_)
+      return false;
+
+    if (current_bytes() + size > max_bytes_) {
+      // Only the first victim is considered for the admission decision.
+      const Node& victim = probation_.empty() ? protected_.Back() :
+                                                probation_.Back();
+      if (sketch_.Estimate(hash) <= sketch_.Estimate(victim.hash))
+        return false;
+    }
+
+    probation_.Push(NewNode(hash, size));
+    while (current_bytes() > max_bytes_) {
+      // Don't evict the new entry.
+      if (probation_.size() > 1)
+        probation_.Remove(probation_.Back().hash, NULL);
+      else
+        protected_.Remove(protected_.Back().hash, NULL);
+    }
+    return true;
+  }
+
+  virtual void Remove(uint32 hash) {
+    if (!probation_.Remove(hash, NULL))
+      protected_.Remove(hash, NULL);
+  }
+
+  virtual int64 current_bytes() const {
+    return probation_.num_bytes() + protected_.num_bytes();
+  }
+
+  virtual int num_entries() const {
+    return probation_.size() + protected_.size();
+  }
+
+ private:
+  int64 max_bytes_;
+  int64 max_protected_bytes_;
+  disk_cache::SimulatedList probation_;
+  disk_cache::SimulatedList protected_;
+  disk_cache::FrequencySketch sketch_;
+
+  DISALLOW_COPY_AND_ASSIGN(TinyLfuPolicy);
+};
+
+}  // namespace
+
+namespace disk_cache {
+
+// Static.
+EvictionPolicy* EvictionPolicy::Create(Type type, int64 max_bytes) {
+  switch (type) {
+    case LRU:
+      return new LruPolicy(max_bytes);
+    case REUSE:
+      return new ReusePolicy(max_bytes);
+    case TINY_LFU:
+      return new TinyLfuPolicy(max_bytes);
+    default:
+      NOTREACHED();
+      return NULL;
+  }
+}
+
+// ------------------------------------------------------------------------
+
+SimulatedList::Node* SimulatedList::Find(uint32 hash) {
+  NodeMap::iterator it = index_.find(hash);
+  if (it == index_.end())
+    return NULL;
+  return &(*it->second);
+}
+
+void SimulatedList::Push(const Node& node) {
+  DCHECK(index_.find(node.hash) == index_.end());
+  nodes_.push_front(node);
+  index_[node.hash] = nodes_.begin();
+  num_bytes_ += node.size;
+}
+
+void SimulatedList::MoveToFront(uint32 hash) {
+  NodeMap::iterator it = index_.find(hash);
+  DCHECK(it != index_.end());
+  nodes_.splice(nodes_.begin(), nodes_, it->second);
+}
+
+bool SimulatedList::Remove(uint32 hash, Node* node) {
+  NodeMap::iterator it = index_.find(hash);
+  if (it == index_.end())
+    return false;
+
+  if (node)
+    *node = *it->second;
+  num_bytes_ -= it->second->size;
+  nodes_.erase(it->second);
+  index_.erase(it);
+  return true;
+}
+
+// ------------------------------------------------------------------------
+
+FrequencySketch::FrequencySketch(int num_entries)
+    : width_(16), sample_size_(10 * num_entries), additions_(0) {
+  while (width_ < num_entries)
+    width_ *= 2;
+  counters_.resize(kNumRows * width_);
+}
+
+void FrequencySketch::Increment(uint32 hash) {
+  for (int i = 0; i < kNumRows; i++) {
+    uint8& counter = counters_[GetIndex(hash, i)];
+    if (counter < kMaxCount)
+      counter++;
+  }
+
+  if (++additions_ >= sample_size_)
+    Reset();
+}
+
+int FrequencySketch::Estimate(uint32 hash) const {
+  int estimate = kMaxCount;
+  for (int i = 0; i < kNumRows; i++) {
+    int count = counters_[GetIndex(hash, i)];
+    estimate = std::min(estimate, count);
+  }
+  return estimate;
+}
+
+int FrequencySketch::GetIndex(uint32 hash, int row) const {
+  static const uint32 kSeeds[kNumRows] = {
+    0x97cb3127, 0xab5cb8f1, 0xc6cb7d6b, 0x8f48f7a7
+  };
+  uint32 value = (hash ^ (hash >> 16)) * kSeeds[row];
+  value ^= value >> 15;
+  return row * width_ + (value & (width_ - 1));
+}
+
+void FrequencySketch::Reset() {
+  for (size_t i = 0; i < counters_.size(); i++)
+    counters_[i] /= 2;
+  additions_ /= 2;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,129 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file defines a simple model of the eviction policies used by (or being
+// considered for) the disk cache, so that they can be compared offline by
+// replaying access logs. The models only track keys and sizes; they don't
+// store any data and they don't share code with the actual Eviction class,
+// that works directly on the rankings lists stored on disk.
+
+#ifndef NET_DISK_CACHE_EVICTION_POLICY_H_
+#define NET_DISK_CACHE_EVICTION_POLICY_H_
+
+#include <list>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+
+namespace disk_cache {
+
+// The interface of a simulated eviction policy. Entries are identified by the
+// hash of the key, and the capacity of the cache is measured in bytes.
+class EvictionPolicy {
+ public:
+  enum Type {
+    LRU = 0,    // The original eviction algorithm.
+    REUSE,      // The multi-list algorithm enabled by kNewEviction.
+    TINY_LFU,   // Segmented LRU with frequency-based admission.
+    NUM_TYPES
+  };
+
+  virtual ~EvictionPolicy() {}
+
+  // Returns a new policy of the given |type|, for a cache of |max_bytes|.
+  static EvictionPolicy* Create(Type type, int64 max_bytes);
+
+  // Returns a short description of the policy.
+  virtual const char* name() const = 0;
+
+  // Looks for an entry. Returns true (and records the access) if the entry is
+  // stored by the cache.
+  virtual bool Lookup(uint32 hash) = 0;
+
+  // Stores a new entry, evicting other entries as needed. Returns false if the
+  // policy decides not to admit the entry.
+  virtual bool Insert(uint32 hash, int size) = 0;
+
+  // Removes an entry (it was deleted by the user).
+  virtual void Remove(uint32 hash) = 0;
+
+  virtual int64 current_bytes() const = 0;
+  virtual int num_entries() const = 0;
+};
+
+// A list of entries sorted by last use, with the most recently used entry at
+// the front, that keeps track of the number of bytes stored.
+class SimulatedList {
+ public:
+  struct Node {
+    uint32 hash;
+    int size;
+    int reuse_count;
+    int refetch_count;
+  };
+
+  SimulatedList() : num_bytes_(0) {}
+  ~SimulatedList() {}
+
+  // Returns the node for |hash|, or NULL.
+  Node* Find(uint32 hash);
+
+  // Adds |node| to the front of the list.
+  void Push(const Node& node);
+
+  // Moves the node for |hash| to the front of the list.
+  void MoveToFront(uint32 hash);
+
+  // Removes the node for |hash|. Returns false if the node is not found.
+  bool Remove(uint32 hash, Node* node);
+
+  // Returns the least recently used node. The list must not be empty.
+  const Node& Back() const { return nodes_.back(); }
+
+  int64 num_bytes() const { return num_bytes_; }
+  int size() const { return static_cast<int>(index_.size()); }
+  bool empty() const { return nodes_.empty(); }
+
+ private:
+  typedef std::list<Node> NodeList;
+  typedef base::hash_map<uint32, NodeList::iterator> NodeMap;
+
+  NodeList nodes_;
+  NodeMap index_;
+  int64 num_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimulatedList);
+};
+
+// A count-min sketch with small counters, used to estimate how often an entry
+// was requested recently, for a cache that stores about |num_entries|. All
+// counters are halved after 10 * |num_entries| increments, so old popularity
+// fades away over time.
+class FrequencySketch {
+ public:
+  explicit FrequencySketch(int num_entries);
+  ~FrequencySketch() {}
+
+  void Increment(uint32 hash);
+  int Estimate(uint32 hash) const;
+
+ private:
+  static const int kNumRows = 4;
+  static const int kMaxCount = 15;
+
+  int GetIndex(uint32 hash, int row) const;
+  void Reset();
+
+  std::vector<uint8> counters_;
+  int width_;
+  int sample_size_;
+  int additions_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrequencySketch);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_EVICTION_POLICY_H_
@@ -0,0 +1,119 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/scoped_ptr.h"
+#include "net/disk_cache/eviction_policy.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using disk_cache::EvictionPolicy;
+
+TEST(EvictionPolicyTest, SimulatedList) {
+  disk_cache::SimulatedList list;
+  disk_cache::SimulatedList::Node node = {1, 100, 0, 0};
+  list.Push(node);
+  node.hash = 2;
+  node.size = 50;
+  list.Push(node);
+
+  EXPECT_EQ(2, list.size());
+  EXPECT_EQ(150, list.num_bytes());
+  EXPECT_EQ(1U, list.Back().hash);
+
+  list.MoveToFront(1);
+  EXPECT_EQ(2U, list.Back().hash);
+
+  ASSERT_TRUE(NULL != list.Find(2));
+  EXPECT_TRUE(NULL == list.Find(3));
+
+  EXPECT_TRUE(list.Remove(2, &node));
+  EXPECT_EQ(50, node.size);
+  EXPECT_FALSE(list.Remove(2, NULL));
+  EXPECT_EQ(100, list.num_bytes());
+}
+
+TEST(EvictionPolicyTest, FrequencySketch) {
+  disk_cache::FrequencySketch sketch(100);
+  EXPECT_EQ(0, sketch.Estimate(1));
+
+  for (int i = 0; i < 5; i++)
+    sketch.Increment(1);
+  sketch.Increment(2);
+  EXPECT_EQ(5, sketch.Estimate(1));
+  EXPECT_EQ(1, sketch.Estimate(2));
+
+  // The counters saturate.
+  for (int i = 0; i < 20; i++)
+    sketch.Increment(1);
+  EXPECT_EQ(15, sketch.Estimate(1));
+
+  // And they age.
+  for (int i = 0; i < 1000; i++)
+    sketch.Increment(i + 1000);
+  EXPECT_GT(15, sketch.Estimate(1));
+}
+
+TEST(EvictionPolicyTest, Lru) {
+  scoped_ptr<EvictionPolicy> policy(
+      EvictionPolicy::Create(EvictionPolicy::LRU, 300));
+
+  EXPECT_FALSE(policy->Lookup(1));
+  EXPECT_TRUE(policy->Insert(1, 100));
+  EXPECT_TRUE(policy->Insert(2, 100));
+  EXPECT_TRUE(policy->Insert(3, 100));
+  EXPECT_EQ(300, policy->current_bytes());
+
+  // Entry 2 is the least recently used one.
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_TRUE(policy->Insert(4, 100));
+  EXPECT_FALSE(policy->Lookup(2));
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_EQ(3, policy->num_entries());
+
+  EXPECT_FALSE(policy->Insert(5, 400));
+  policy->Remove(1);
+  EXPECT_FALSE(policy->Lookup(1));
+  EXPECT_EQ(200, policy->current_bytes());
+}
+
+TEST(EvictionPolicyTest, Reuse) {
+  scoped_ptr<EvictionPolicy> policy(
+      EvictionPolicy::Create(EvictionPolicy::REUSE, 300));
+
+  EXPECT_TRUE(policy->Insert(1, 100));
+  EXPECT_TRUE(policy->Insert(2, 100));
+  EXPECT_TRUE(policy->Insert(3, 100));
+
+  // Entry 1 is reused so it is not evicted, even if it is the oldest one.
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_TRUE(policy->Insert(4, 100));
+  EXPECT_TRUE(policy->Insert(5, 100));
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_FALSE(policy->Lookup(2));
+  EXPECT_EQ(300, policy->current_bytes());
+}
+
+TEST(EvictionPolicyTest, TinyLfu) {
+  scoped_ptr<EvictionPolicy> policy(
+      EvictionPolicy::Create(EvictionPolicy::TINY_LFU, 300));
+
+  for (int i = 1; i <= 3; i++) {
+    EXPECT_FALSE(policy->Lookup(i));
+    EXPECT_TRUE(policy->Insert(i, 100));
+  }
+
+  // A new entry is not admitted if it is less popular than the victim.
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_TRUE(policy->Lookup(2));
+  EXPECT_FALSE(policy->Lookup(4));
+  EXPECT_FALSE(policy->Insert(4, 100));
+
+  // But it is admitted after being requested enough times.
+  EXPECT_FALSE(policy->Lookup(4));
+  EXPECT_FALSE(policy->Lookup(4));
+  EXPECT_TRUE(policy->Insert(4, 100));
+  EXPECT_FALSE(policy->Lookup(3));
+  EXPECT_TRUE(policy->Lookup(1));
+  EXPECT_TRUE(policy->Lookup(2));
+  EXPECT_EQ(300, policy->current_bytes());
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This is a simple application that compares the eviction policies of the disk
+// cache by replaying a log of cache accesses, and reports the hit ratio and the
+// byte hit ratio of each policy.
+//
+// Each line of the log has the form "<key> <size>", where size is the size of
+// the response in bytes. A negative size means that the entry was deleted.
+// Lines that start with '#' are ignored. When no log is provided, a random
+// workload similar to the one used by stress_cache is generated.
+//
+// Usage: eviction_simulator <cache size in MB> [log file]
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/file_util.h"
+#include "base/scoped_vector.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/eviction_policy.h"
+#include "net/disk_cache/hash.h"
+
+using base::Time;
+
+namespace {
+
+const int kError = -1;
+
+struct Results {
+  int64 requests;
+  int64 hits;
+  int64 bytes;
+  int64 hit_bytes;
+  int64 rejected;
+};
+
+class Simulator {
+ public:
+  explicit Simulator(int64 max_bytes);
+  ~Simulator() {}
+
+  // Processes a request for |key|, of |size| bytes.
+  void Request(const std::string& key, int size);
+
+  // Processes the removal of |key|.
+  void Delete(const std::string& key);
+
+  void PrintResults() const;
+
+ private:
+  ScopedVector<disk_cache::EvictionPolicy> policies_;
+  std::vector<Results> results_;
+
+  DISALLOW_COPY_AND_ASSIGN(Simulator);
+};
+
+Simulator::Simulator(int64 max_bytes) {
+  for (int i = 0; i < disk_cache::EvictionPolicy::NUM_TYPES; i++) {
+    policies_.push_back(disk_cache::EvictionPolicy::Create(
+        static_cast<disk_cache::EvictionPolicy::Type>(i), max_bytes));
+    Results results = {0};
+    results_.push_back(results);
+  }
+}
+
+void Simulator::Request(const std::string& key, int size) {
+  uint32 hash = disk_cache::Hash(key);
+  for (size_t i = 0; i < policies_.size(); i++) {
+    Results& results = results_[i];
+    results.requests++;
+    results.bytes += size;
+    if (policies_[i]->Lookup(hash)) {
+      results.hits++;
+      results.hit_bytes += size;
+    } else if (!policies_[i]->Insert(hash, size)) {
+      results.rejected++;
+    }
+  }
+}
+
+void Simulator::Delete(const std::string& key) {
+  uint32 hash = disk_cache::Hash(key);
+  for (size_t i = 0; i < policies_.size(); i++)
+    policies_[i]->Remove(hash);
+}
+
+void Simulator::PrintResults() const {
+  printf("%-12s %10s %10s %10s %10s\n", "Policy", "Requests", "Hit ratio",
+         "Byte ratio", "Rejected");
+  for (size_t i = 0; i < policies_.size(); i++) {
+    const Results& results = results_[i];
+    double hit_ratio = results.requests ?
+        100.0 * results.hits / results.requests : 0;
+    double byte_ratio = results.bytes ?
+        100.0 * results.hit_bytes / results.bytes : 0;
+    printf("%-12s %10s %9.2f%% %9.2f%% %10s\n", policies_[i]->name(),
+           Int64ToString(results.requests).c_str(), hit_ratio, byte_ratio,
+           Int64ToString(results.rejected).c_str());
+  }
+}
+
+// Replays the log stored at |path|.
+bool ReplayLog(const std::string& path, Simulator* simulator) {
+  FILE* file = file_util::OpenFile(path, "r");
+  if (!file) {
+    printf("Unable to open %s\n", path.c_str());
+    return false;
+  }
+
+  char line[4096];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), file)) {
+    line_number++;
+    std::string text;
+    TrimWhitespaceASCII(line, TRIM_ALL, &text);
+    if (text.empty() || text[0] == '#')
+      continue;
+
+    size_t separator = text.find_last_of(' ');
+    int size;
+    if (separator == std::string::npos ||
+        !StringToInt(text.substr(separator + 1), &size)) {
+      printf("Invalid line %d\n", line_number);
+      continue;
+    }
+
+    std::string key = text.substr(0, separator);
+    if (size < 0)
+      simulator->Delete(key);
+    else
+      simulator->Request(key, size);
+  }
+
+  file_util::CloseFile(file);
+  return true;
+}
+
+// Generates a random workload with a few popular keys and a long tail of keys
+// that are seen only once or twice, and some deletions (like stress_cache).
+void GenerateWorkload(Simulator* simulator) {
+  const int kNumKeys = 50000;
+  const int kNumRequests = 500000;
+  const int kMaxSize = 64 * 1024;
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  std::vector<std::string> keys(kNumKeys);
+  std::vector<int> sizes(kNumKeys);
+  for (int i = 0; i < kNumKeys; i++) {
+    keys[i] = GenerateKey(true);
+    sizes[i] = rand() % kMaxSize;
+  }
+
+  for (int i = 0; i < kNumRequests; i++) {
+    // Skew the distribution towards the first keys.
+    int key = rand() % kNumKeys;
+    key = rand() % (key + 1);
+
+    if (rand() % 100 > 97)
+      simulator->Delete(keys[key]);
+    else
+      simulator->Request(keys[key], sizes[key]);
+  }
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  // Setup an AtExitManager so Singleton objects will be destructed.
+  base::AtExitManager at_exit_manager;
+
+  int cache_size;
+  if (argc < 2 || !StringToInt(argv[1], &cache_size) || cache_size <= 0) {
+    printf("Usage: eviction_simulator <cache size in MB> [log file]\n");
+    return kError;
+  }
+
+  Simulator simulator(static_cast<int64>(cache_size) * 1024 * 1024);
+  if (argc > 2) {
+    if (!ReplayLog(argv[2], &simulator))
+      return kError;
+  } else {
+    GenerateWorkload(&simulator);
+  }
+
+  simulator.PrintResults();
+  return 0;
+}
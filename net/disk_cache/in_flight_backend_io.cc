@@ -0,0 +1,272 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/in_flight_backend_io.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/string_util.h"
+#include "base/worker_pool.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/disk_format.h"
+#include "net/disk_cache/file.h"
+#include "net/disk_cache/hash.h"
+
+namespace {
+
+const wchar_t* kIndexName = L"index";
+const wchar_t* kBlockName = L"data_";
+
+// Maximum number of entries of a hash bucket that will be read from the worker
+// thread. Long chains should be rare, and walking them is still correct (just
+// slower) when the pages are not in memory.
+const int kMaxChainLength = 16;
+
+}  // namespace
+
+namespace disk_cache {
+
+BackendIO::BackendIO(InFlightBackendIO* controller, Operation operation,
+                     const std::string& key, uint32 hash, uint32 bucket,
+                     Entry** entry, net::CompletionCallback* callback)
+    : controller_(controller), controller_loop_(controller->callback_loop()),
+      operation_(operation), key_(key), hash_(hash),
+      path_(controller->path()), iter_(NULL), entry_(entry),
+      callback_(callback), result_(net::ERR_IO_PENDING), ready_(false) {
+  bucket_offset_ = offsetof(Index, table) + bucket * sizeof(CacheAddr);
+}
+
+BackendIO::BackendIO(InFlightBackendIO* controller, void** iter,
+                     const std::vector<CacheAddr>& nodes, Entry** entry,
+                     net::CompletionCallback* callback)
+    : controller_(controller), controller_loop_(controller->callback_loop()),
+      operation_(OP_OPEN_NEXT), hash_(0), path_(controller->path()),
+      bucket_offset_(0), iter_(iter), nodes_(nodes), entry_(entry),
+      callback_(callback), result_(net::ERR_IO_PENDING), ready_(false) {
+}
+
+// Note that we read the files through private handles, without looking at the
+// state of the backend (that may be changing at the same time on the other
+// thread). Whatever we read is only used as a hint of what to load next, so
+// any inconsistency just means that some of the pages will have to be faulted
+// in later on.
+void BackendIO::ExecuteOnWorker() {
+  if (operation_ == OP_OPEN_NEXT)
+    ReadRankings();
+  else
+    ReadBucket();
+
+  files_.clear();
+
+  controller_loop_->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &BackendIO::OnWorkerDone));
+}
+
+void BackendIO::ReadBucket() {
+  std::wstring index_name(path_);
+  file_util::AppendToPath(&index_name, kIndexName);
+
+  scoped_refptr<File> index(new File(true));
+  CacheAddr value;
+  if (!index->Init(index_name) ||
+      !index->Read(&value, sizeof(value), bucket_offset_))
+    return;
+
+  Addr address(value);
+  for (int i = 0; i < kMaxChainLength && address.is_initialized(); i++) {
+    if (address.is_separate_file() || address.file_type() != BLOCK_256)
+      break;
+
+    EntryStore entry_store;
+    if (!ReadBlock(address, &entry_store, sizeof(entry_store)))
+      break;
+
+    // The rankings node is always loaded together with the entry.
+    Addr node_address(entry_store.rankings_node);
+    if (node_address.is_initialized() &&
+        node_address.file_type() == RANKINGS) {
+      RankingsNode node;
+      ReadBlock(node_address, &node, sizeof(node));
+    }
+
+    if (entry_store.hash == hash_)
+      break;
+
+    address.set_value(entry_store.next);
+  }
+}
+
+void BackendIO::ReadRankings() {
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    Addr node_address(nodes_[i]);
+    if (!node_address.is_initialized() ||
+        node_address.file_type() != RANKINGS)
+      continue;
+
+    RankingsNode node;
+    if (!ReadBlock(node_address, &node, sizeof(node)))
+      continue;
+
+    Addr address(node.contents);
+    if (address.is_initialized() && !address.is_separate_file() &&
+        address.file_type() == BLOCK_256) {
+      EntryStore entry_store;
+      ReadBlock(address, &entry_store, sizeof(entry_store));
+    }
+  }
+}
+
+void BackendIO::ExecuteOnBackend(BackendImpl* backend) {
+  bool success = false;
+  switch (operation_) {
+    case OP_OPEN:
+      success = backend->OpenEntry(key_, entry_);
+      break;
+    case OP_CREATE:
+      success = backend->CreateEntry(key_, entry_);
+      break;
+    case OP_DOOM:
+      success = backend->DoomEntry(key_);
+      break;
+    case OP_OPEN_NEXT:
+      success = backend->OpenNextEntry(iter_, entry_);
+      break;
+    default:
+      NOTREACHED();
+  }
+  result_ = success ? net::OK : net::ERR_FAILED;
+}
+
+void BackendIO::RunCallback() {
+  if (callback_)
+    callback_->Run(result_);
+}
+
+void BackendIO::Cancel() {
+  controller_ = NULL;
+}
+
+bool BackendIO::ReadBlock(Addr address, void* buffer, size_t buffer_len) {
+  File* file = GetBlockFile(address.FileNumber());
+  if (!file)
+    return false;
+
+  size_t offset = address.start_block() * address.BlockSize() +
+                  kBlockHeaderSize;
+  return file->Read(buffer, buffer_len, offset);
+}
+
+File* BackendIO::GetBlockFile(int file_number) {
+  std::map<int, scoped_refptr<File> >::iterator it = files_.find(file_number);
+  if (it != files_.end())
+    return it->second;
+
+  std::wstring name(path_);
+  file_util::AppendToPath(&name, StringPrintf(L"%ls%d", kBlockName,
+                                              file_number));
+  scoped_refptr<File> file(new File(true));
+  if (!file->Init(name))
+    file = NULL;
+
+  files_[file_number] = file;
+  return file;
+}
+
+// This may be called more than once for a given operation, as the controller
+// completes the operations in order.
+void BackendIO::OnWorkerDone() {
+  ready_ = true;
+  if (controller_)
+    controller_->OnOperationReady(this);
+}
+
+// ------------------------------------------------------------------------
+
+InFlightBackendIO::~InFlightBackendIO() {
+  CancelAll();
+}
+
+void InFlightBackendIO::Init(const std::wstring& path) {
+  path_ = path;
+  callback_loop_ = MessageLoop::current();
+}
+
+void InFlightBackendIO::CancelAll() {
+  for (OperationsList::iterator it = pending_.begin(); it != pending_.end();
+       ++it) {
+    (*it)->Cancel();
+  }
+  pending_.clear();
+}
+
+int InFlightBackendIO::OpenEntry(const std::string& key, Entry** entry,
+                                 net::CompletionCallback* callback) {
+  return PostOperation(BackendIO::OP_OPEN, key, entry, callback);
+}
+
+int InFlightBackendIO::CreateEntry(const std::string& key, Entry** entry,
+                                   net::CompletionCallback* callback) {
+  return PostOperation(BackendIO::OP_CREATE, key, entry, callback);
+}
+
+int InFlightBackendIO::DoomEntry(const std::string& key,
+                                 net::CompletionCallback* callback) {
+  return PostOperation(BackendIO::OP_DOOM, key, NULL, callback);
+}
+
+// The position of the enumeration is only known when the previous operations
+// complete, so the nodes read by the worker are just a guess based on the
+// current state of |iter|.
+int InFlightBackendIO::OpenNextEntry(void** iter, Entry** next_entry,
+                                     net::CompletionCallback* callback) {
+  DCHECK(callback_loop_ == MessageLoop::current());
+  std::vector<CacheAddr> nodes;
+  backend_->GetEnumerationHints(*iter, &nodes);
+  return PostOperation(new BackendIO(this, iter, nodes, next_entry, callback));
+}
+
+void InFlightBackendIO::OnOperationReady(BackendIO* operation) {
+  // Wait for the previous operations to complete.
+  if (pending_.empty() || pending_.front() != operation)
+    return;
+
+  scoped_refptr<BackendIO> current = pending_.front();
+  pending_.pop_front();
+  current->ExecuteOnBackend(backend_);
+
+  // The callback may delete the backend (and this object), so the next
+  // operation has to be processed from the message loop.
+  if (!pending_.empty() && pending_.front()->ready()) {
+    callback_loop_->PostTask(FROM_HERE,
+        NewRunnableMethod(pending_.front().get(), &BackendIO::OnWorkerDone));
+  }
+
+  current->RunCallback();
+}
+
+int InFlightBackendIO::PostOperation(BackendIO::Operation operation,
+                                     const std::string& key, Entry** entry,
+                                     net::CompletionCallback* callback) {
+  DCHECK(callback_loop_ == MessageLoop::current());
+  uint32 hash = Hash(key);
+  return PostOperation(new BackendIO(this, operation, key, hash,
+                                     backend_->HashBucket(hash), entry,
+                                     callback));
+}
+
+int InFlightBackendIO::PostOperation(BackendIO* operation) {
+  scoped_refptr<BackendIO> io(operation);
+  pending_.push_back(io);
+
+  if (!WorkerPool::PostTask(FROM_HERE,
+          NewRunnableMethod(io.get(), &BackendIO::ExecuteOnWorker), false)) {
+    // We still have to complete the operation asynchronously.
+    io->ExecuteOnWorker();
+  }
+  return net::ERR_IO_PENDING;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,164 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_IN_FLIGHT_BACKEND_IO_H_
+#define NET_DISK_CACHE_IN_FLIGHT_BACKEND_IO_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/ref_counted.h"
+#include "net/base/completion_callback.h"
+#include "net/disk_cache/addr.h"
+
+class MessageLoop;
+
+namespace disk_cache {
+
+class BackendImpl;
+class Entry;
+class File;
+class InFlightBackendIO;
+
+// This class represents a single asynchronous operation on the backend. The
+// disk access required to locate the entry (reading the hash bucket from the
+// index and walking the chain of entries stored on the block files) is
+// performed first on a worker thread, through private file handles. That brings
+// the relevant pages of the memory mapped index and block files into memory, so
+// that completing the operation on the thread that owns the backend doesn't
+// have to wait for the disk. Enumerations read the next rankings nodes (and
+// their entries) instead. The worker never touches the state of the backend.
+class BackendIO : public base::RefCountedThreadSafe<BackendIO> {
+ public:
+  enum Operation {
+    OP_NONE = 0,
+    OP_OPEN,
+    OP_CREATE,
+    OP_DOOM,
+    OP_OPEN_NEXT
+  };
+
+  BackendIO(InFlightBackendIO* controller, Operation operation,
+            const std::string& key, uint32 hash, uint32 bucket, Entry** entry,
+            net::CompletionCallback* callback);
+
+  // Constructor for OP_OPEN_NEXT. |nodes| are the addresses of the rankings
+  // nodes that are likely to be read by the enumeration.
+  BackendIO(InFlightBackendIO* controller, void** iter,
+            const std::vector<CacheAddr>& nodes, Entry** entry,
+            net::CompletionCallback* callback);
+
+  // Reads the data used by this operation from disk. Runs on a worker thread.
+  void ExecuteOnWorker();
+
+  // Notifies the controller that the worker is done (on the backend thread).
+  void OnWorkerDone();
+
+  // Completes the operation on the thread that owns the backend.
+  void ExecuteOnBackend(BackendImpl* backend);
+
+  // Invokes the user callback, if any.
+  void RunCallback();
+
+  // Prevents any further notification to the controller.
+  void Cancel();
+
+  // Returns true when the worker is done with this operation.
+  bool ready() const { return ready_; }
+
+  Operation operation() const { return operation_; }
+  int result() const { return result_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<BackendIO>;
+  ~BackendIO() {}
+
+  // Reads the hash bucket of the key, and the entries chained from it.
+  void ReadBucket();
+
+  // Reads the rankings nodes of an enumeration, and the entries they point to.
+  void ReadRankings();
+
+  // Reads |buffer_len| bytes from the block file that stores |address|.
+  bool ReadBlock(Addr address, void* buffer, size_t buffer_len);
+
+  // Returns the file used to read from the block file |file_number|.
+  File* GetBlockFile(int file_number);
+
+  InFlightBackendIO* controller_;  // Only valid on the backend thread.
+  MessageLoop* controller_loop_;
+  Operation operation_;
+  std::string key_;
+  uint32 hash_;
+  std::wstring path_;  // The cache folder.
+  size_t bucket_offset_;  // Offset of the hash bucket on the index file.
+  void** iter_;  // Enumeration state, owned by the caller.
+  std::vector<CacheAddr> nodes_;  // Rankings nodes to read (enumerations).
+  Entry** entry_;
+  net::CompletionCallback* callback_;
+  int result_;
+  bool ready_;
+  std::map<int, scoped_refptr<File> > files_;  // Only used by the worker.
+
+  DISALLOW_COPY_AND_ASSIGN(BackendIO);
+};
+
+// This class keeps track of the asynchronous operations issued to a given
+// backend. Operations are completed (and their callbacks invoked) in the same
+// order in which they were issued, regardless of the order in which the worker
+// threads finish with them.
+class InFlightBackendIO {
+ public:
+  explicit InFlightBackendIO(BackendImpl* backend)
+      : backend_(backend), callback_loop_(NULL) {}
+  ~InFlightBackendIO();
+
+  // Sets the location of the backing files.
+  void Init(const std::wstring& path);
+
+  // Cancels all pending operations. No callbacks will be invoked.
+  void CancelAll();
+
+  // Queues a new operation. Returns ERR_IO_PENDING.
+  int OpenEntry(const std::string& key, Entry** entry,
+                net::CompletionCallback* callback);
+  int CreateEntry(const std::string& key, Entry** entry,
+                  net::CompletionCallback* callback);
+  int DoomEntry(const std::string& key, net::CompletionCallback* callback);
+  int OpenNextEntry(void** iter, Entry** next_entry,
+                    net::CompletionCallback* callback);
+
+  // Called by an operation when the worker is done with it.
+  void OnOperationReady(BackendIO* operation);
+
+  // Returns true if there are operations waiting to be completed.
+  bool HasPendingOperations() const { return !pending_.empty(); }
+
+  // Returns the path used by the worker threads.
+  const std::wstring& path() const { return path_; }
+  MessageLoop* callback_loop() const { return callback_loop_; }
+
+ private:
+  typedef std::deque<scoped_refptr<BackendIO> > OperationsList;
+
+  // Posts a new operation to the worker pool.
+  int PostOperation(BackendIO::Operation operation, const std::string& key,
+                    Entry** entry, net::CompletionCallback* callback);
+  int PostOperation(BackendIO* operation);
+
+  BackendImpl* backend_;
+  MessageLoop* callback_loop_;  // The thread that owns the backend.
+  std::wstring path_;
+  OperationsList pending_;  // Operations in the same order they were issued.
+
+  DISALLOW_COPY_AND_ASSIGN(InFlightBackendIO);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_IN_FLIGHT_BACKEND_IO_H_
@@ -6,6 +6,7 @@
 
 #include "base/logging.h"
 #include "base/sys_info.h"
+#include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/mem_entry_impl.h"
 
@@ -141,6 +142,23 @@ void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
   entry->InternalDoom();
 }
 
+// There is no IO involved with this backend, so all the asynchronous
+// operations complete synchronously.
+int MemBackendImpl::OpenEntry(const std::string& key, Entry** entry,
+                              net::CompletionCallback* callback) {
+  return OpenEntry(key, entry) ? net::OK : net::ERR_FAILED;
+}
+
+int MemBackendImpl::CreateEntry(const std::string& key, Entry** entry,
+                                net::CompletionCallback* callback) {
+  return CreateEntry(key, entry) ? net::OK : net::ERR_FAILED;
+}
+
+int MemBackendImpl::DoomEntry(const std::string& key,
+                              net::CompletionCallback* callback) {
+  return DoomEntry(key) ? net::OK : net::ERR_FAILED;
+}
+
 bool MemBackendImpl::DoomAllEntries() {
   TrimCache(true);
   return true;
@@ -201,6 +219,11 @@ bool MemBackendImpl::OpenNextEntry(void** iter, Entry** next_entry) {
   return NULL != node;
 }
 
+int MemBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
+                                  net::CompletionCallback* callback) {
+  return OpenNextEntry(iter, next_entry) ? net::OK : net::ERR_FAILED;
+}
+
 void MemBackendImpl::EndEnumeration(void** iter) {
   *iter = NULL;
 }
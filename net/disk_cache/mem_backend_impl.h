@@ -31,11 +31,19 @@ class MemBackendImpl : public Backend {
   virtual bool OpenEntry(const std::string& key, Entry** entry);
   virtual bool CreateEntry(const std::string& key, Entry** entry);
   virtual bool DoomEntry(const std::string& key);
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        net::CompletionCallback* callback);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          net::CompletionCallback* callback);
+  virtual int DoomEntry(const std::string& key,
+                        net::CompletionCallback* callback);
   virtual bool DoomAllEntries();
   virtual bool DoomEntriesBetween(const base::Time initial_time,
                                   const base::Time end_time);
   virtual bool DoomEntriesSince(const base::Time initial_time);
   virtual bool OpenNextEntry(void** iter, Entry** next_entry);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            net::CompletionCallback* callback);
   virtual void EndEnumeration(void** iter);
   virtual void GetStats(
       std::vector<std::pair<std::string, std::string> >* stats) {}
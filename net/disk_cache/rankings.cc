@@ -203,6 +203,10 @@ void Rankings::Reset() {
   control_data_ = NULL;
 }
 
+void Rankings::OnIndexRemapped() {
+  control_data_ = backend_->GetLruData();
+}
+
 bool Rankings::GetRanking(CacheRankingsBlock* rankings) {
   Time start = Time::Now();
   if (!rankings->address().is_initialized())
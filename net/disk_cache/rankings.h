@@ -113,6 +113,9 @@ class Rankings {
   // Restores original state, leaving the object ready for initialization.
   void Reset();
 
+  // The index file was mapped again, at a different address.
+  void OnIndexRemapped();
+
   // Inserts a given entry at the head of the queue.
   void Insert(CacheRankingsBlock* node, bool modified, List list);
 
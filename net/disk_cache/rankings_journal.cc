@@ -0,0 +1,77 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/rankings_journal.h"
+
+#include "base/logging.h"
+#include "net/disk_cache/entry_impl.h"
+#include "net/disk_cache/eviction.h"
+
+namespace disk_cache {
+
+void RankingsJournal::Init(Eviction* eviction) {
+  eviction_ = eviction;
+  pending_.clear();
+}
+
+void RankingsJournal::Reset() {
+  pending_.clear();
+}
+
+void RankingsJournal::Add(EntryImpl* entry, bool modified) {
+  CacheAddr key = GetKey(entry);
+  if (!key) {
+    // There is nothing we can do to delay this one.
+    eviction_->UpdateRank(entry, modified);
+    return;
+  }
+
+  PendingUpdates::iterator it = pending_.find(key);
+  if (it != pending_.end()) {
+    DCHECK(it->second.entry == entry);
+    it->second.modified |= modified;
+    return;
+  }
+
+  PendingUpdate update = { entry, modified };
+  pending_[key] = update;
+}
+
+void RankingsJournal::Remove(EntryImpl* entry) {
+  CacheAddr key = GetKey(entry);
+  if (key)
+    pending_.erase(key);
+}
+
+void RankingsJournal::Flush(EntryImpl* entry) {
+  CacheAddr key = GetKey(entry);
+  if (!key)
+    return;
+
+  PendingUpdates::iterator it = pending_.find(key);
+  if (it == pending_.end())
+    return;
+
+  bool modified = it->second.modified;
+  pending_.erase(it);
+  eviction_->UpdateRank(entry, modified);
+}
+
+void RankingsJournal::FlushAll() {
+  // Updating the lists never adds new items to the journal, but we don't want
+  // to depend on that while iterating.
+  PendingUpdates updates;
+  updates.swap(pending_);
+
+  for (PendingUpdates::iterator it = updates.begin(); it != updates.end();
+       ++it) {
+    eviction_->UpdateRank(it->second.entry, it->second.modified);
+  }
+}
+
+CacheAddr RankingsJournal::GetKey(EntryImpl* entry) const {
+  return entry->rankings()->address().value();
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,74 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_RANKINGS_JOURNAL_H_
+#define NET_DISK_CACHE_RANKINGS_JOURNAL_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "net/disk_cache/disk_format.h"
+
+namespace disk_cache {
+
+class EntryImpl;
+class Eviction;
+
+// This class buffers the updates to the rankings lists of open entries, so that
+// an entry that is read (or written) many times while it is open is moved to
+// the head of its list only once, instead of dirtying the pages of the rankings
+// lists with every read. The pending updates are applied when the entry is
+// closed, or in batches (sorted by rankings node address) from the backend's
+// timer. Only open entries can have pending updates, and every update is
+// performed through the regular Rankings methods, so the crash recovery of the
+// lists (the transaction info stored on LruData) is not affected: a crash just
+// loses some recency information.
+class RankingsJournal {
+ public:
+  RankingsJournal() : eviction_(NULL) {}
+  ~RankingsJournal() {}
+
+  // The updates will be performed through |eviction|.
+  void Init(Eviction* eviction);
+
+  // Discards all pending updates (the cache is being restarted).
+  void Reset();
+
+  // Records that |entry| was used. |modified| is true if the entry was written.
+  void Add(EntryImpl* entry, bool modified);
+
+  // Removes any pending update for |entry| (that is being doomed).
+  void Remove(EntryImpl* entry);
+
+  // Applies the pending update for |entry|, if any.
+  void Flush(EntryImpl* entry);
+
+  // Applies all pending updates.
+  void FlushAll();
+
+  // Returns the number of entries with pending updates.
+  int size() const { return static_cast<int>(pending_.size()); }
+
+ private:
+  struct PendingUpdate {
+    EntryImpl* entry;
+    bool modified;
+  };
+  // The updates are sorted by the address of the rankings node.
+  typedef std::map<CacheAddr, PendingUpdate> PendingUpdates;
+
+  // Returns the key used by |entry|, or zero if it cannot be on the journal.
+  CacheAddr GetKey(EntryImpl* entry) const;
+
+  Eviction* eviction_;
+  PendingUpdates pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(RankingsJournal);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_RANKINGS_JOURNAL_H_
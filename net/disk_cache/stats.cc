@@ -56,7 +56,9 @@ static const char* kCounterNames[] = {
   "Get rankings",
   "Fatal error",
   "Last report",
-  "Last report timer"
+  "Last report timer",
+  "Shared data",
+  "Shared bytes"
 };
 COMPILE_ASSERT(arraysize(kCounterNames) == disk_cache::Stats::MAX_COUNTER,
                update_the_names);
@@ -146,6 +148,10 @@ bool Stats::Init(BackendImpl* backend, uint32* storage_addr) {
   return true;
 }
 
+Stats::Stats() : backend_(NULL) {
+  memset(chain_lengths_, 0, sizeof(chain_lengths_));
+}
+
 Stats::~Stats() {
   Store();
 }
@@ -239,6 +245,13 @@ void Stats::ModifyStorageStats(int32 old_size, int32 new_size) {
     data_sizes_[old_index]--;
 }
 
+void Stats::OnChainLength(int length) {
+  DCHECK(length >= 0);
+  if (length >= kChainLengthsLength)
+    length = kChainLengthsLength - 1;
+  chain_lengths_[length]++;
+}
+
 void Stats::OnEvent(Counters an_event) {
   DCHECK(an_event > MIN_COUNTER || an_event < MAX_COUNTER);
   counters_[an_event]++;
@@ -267,6 +280,12 @@ void Stats::GetItems(StatsItems* items) {
     item.second = StringPrintf("0x%" PRIx64, counters_[i]);
     items->push_back(item);
   }
+
+  for (int i = 0; i < kChainLengthsLength; i++) {
+    item.first = StringPrintf("Chain%02d", i);
+    item.second = StringPrintf("0x%" PRIx64, chain_lengths_[i]);
+    items->push_back(item);
+  }
 }
 
 int Stats::GetHitRatio() const {
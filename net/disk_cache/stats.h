@@ -22,6 +22,7 @@ typedef std::vector<std::pair<std::string, std::string> > StatsItems;
 class Stats {
  public:
   static const int kDataSizesLength = 28;
+  static const int kChainLengthsLength = 8;
   enum Counters {
     MIN_COUNTER = 0,
     OPEN_MISS = MIN_COUNTER,
@@ -44,10 +45,12 @@ class Stats {
     FATAL_ERROR,
     LAST_REPORT,  // Time of the last time we sent a report.
     LAST_REPORT_TIMER,  // Timer count of the last time we sent a report.
+    SHARED_DATA,  // The data of an entry was replaced with shared data.
+    SHARED_BYTES,  // Bytes saved by sharing data between entries.
     MAX_COUNTER
   };
 
-  Stats() : backend_(NULL) {}
+  Stats();
   ~Stats();
 
   bool Init(BackendImpl* backend, uint32* storage_addr);
@@ -55,6 +58,11 @@ class Stats {
   // Tracks changes to the stoage space used by an entry.
   void ModifyStorageStats(int32 old_size, int32 new_size);
 
+  // Tracks the number of entries that had to be read to locate an entry (or to
+  // find out that it is not stored). The last slot counts all the lookups that
+  // read kChainLengthsLength - 1 entries or more.
+  void OnChainLength(int length);
+
   // Tracks general events.
   void OnEvent(Counters an_event);
   void SetCounter(Counters counter, int64 value);
@@ -84,6 +92,7 @@ class Stats {
   uint32 storage_addr_;
   int data_sizes_[kDataSizesLength];
   int64 counters_[MAX_COUNTER];
+  int64 chain_lengths_[kChainLengthsLength];  // Not stored on disk.
   scoped_ptr<StatsHistogram> size_histogram_;
 
   DISALLOW_COPY_AND_ASSIGN(Stats);
@@ -135,6 +135,21 @@ HttpCache::ActiveEntry::~ActiveEntry() {
     disk_entry->Close();
 }
 
+HttpCache::PendingOp::PendingOp(HttpCache* c, const std::string& k, bool cr,
+                                Transaction* t)
+    : cache(c),
+      key(k),
+      disk_entry(NULL),
+      create(cr),
+      trans(t),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          callback(this, &PendingOp::OnIOComplete)) {
+}
+
+void HttpCache::PendingOp::OnIOComplete(int result) {
+  cache->OnPendingOpComplete(this, result);
+}
+
 //-----------------------------------------------------------------------------
 
 class HttpCache::Transaction
@@ -212,6 +227,10 @@ class HttpCache::Transaction
   // to the transaction.  Returns network error code.
   int EntryAvailable(ActiveEntry* entry);
 
+  // Called by the HttpCache when the disk cache entry requested by this
+  // transaction could not be opened (or created).  Returns network error code.
+  int EntryUnavailable();
+
  private:
   // This is a helper function used to trigger a completion callback.  It may
   // only be called if callback_ is non-null.
@@ -544,43 +563,42 @@ uint64 HttpCache::Transaction::GetUploadProgress() const {
 }
 
 int HttpCache::Transaction::AddToEntry() {
-  ActiveEntry* entry = NULL;
-
   if (revoked())
     return ERR_UNEXPECTED;
 
   if (mode_ == WRITE) {
     cache_->DoomEntry(cache_key_);
-  } else {
-    entry = cache_->FindActiveEntry(cache_key_);
-    if (!entry) {
-      entry = cache_->OpenEntry(cache_key_);
-      if (!entry) {
-        if (mode_ & WRITE) {
-          mode_ = WRITE;
-        } else {
-          if (cache_->mode() == PLAYBACK)
-            DLOG(INFO) << "Playback Cache Miss: " << request_->url;
-
-          // entry does not exist, and not permitted to create a new entry, so
-          // we must fail.
-          return HandleResult(ERR_CACHE_MISS);
-        }
-      }
-    }
+    return cache_->CreateEntry(cache_key_, this);
   }
 
+  ActiveEntry* entry = cache_->FindActiveEntry(cache_key_);
+  if (entry)
+    return cache_->AddTransactionToEntry(entry, this);
+
+  return cache_->OpenEntry(cache_key_, this);
+}
+
+int HttpCache::Transaction::EntryUnavailable() {
+  if (revoked())
+    return HandleResult(ERR_UNEXPECTED);
+
   if (mode_ == WRITE) {
-    DCHECK(!entry);
-    entry = cache_->CreateEntry(cache_key_);
-    if (!entry) {
-      DLOG(WARNING) << "unable to create cache entry";
-      mode_ = NONE;
-      return BeginNetworkRequest();
-    }
+    DLOG(WARNING) << "unable to create cache entry";
+    mode_ = NONE;
+    return BeginNetworkRequest();
+  }
+
+  if (mode_ & WRITE) {
+    mode_ = WRITE;
+    return cache_->CreateEntry(cache_key_, this);
   }
 
-  return cache_->AddTransactionToEntry(entry, this);
+  if (cache_->mode() == PLAYBACK)
+    DLOG(INFO) << "Playback Cache Miss: " << request_->url;
+
+  // entry does not exist, and not permitted to create a new entry, so
+  // we must fail.
+  return HandleResult(ERR_CACHE_MISS);
 }
 
 int HttpCache::Transaction::EntryAvailable(ActiveEntry* entry) {
@@ -824,7 +842,7 @@ int HttpCache::Transaction::BeginNetworkRequest() {
 
   network_trans_.reset(cache_->network_layer_->CreateTransaction());
   if (!network_trans_.get())
-    return net::ERR_CACHE_CANNOT_CREATE_NETWORK_TRANSACTION;
+    return HandleResult(net::ERR_CACHE_CANNOT_CREATE_NETWORK_TRANSACTION);
 
   int rv = network_trans_->Start(request_, &network_info_callback_);
   if (rv != ERR_IO_PENDING)
@@ -1257,6 +1275,8 @@ HttpCache::HttpCache(HostResolver* host_resolver,
       type_(DISK_CACHE),
       network_layer_(HttpNetworkLayer::CreateFactory(
           host_resolver, proxy_service)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          doom_callback_(this, &HttpCache::OnDoomComplete)),
       ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)),
       in_memory_cache_(false),
       deleted_(false),
@@ -1270,6 +1290,8 @@ HttpCache::HttpCache(HttpNetworkSession* session,
       mode_(NORMAL),
       type_(DISK_CACHE),
       network_layer_(HttpNetworkLayer::CreateFactory(session)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          doom_callback_(this, &HttpCache::OnDoomComplete)),
       ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)),
       in_memory_cache_(false),
       deleted_(false),
@@ -1283,6 +1305,8 @@ HttpCache::HttpCache(HostResolver* host_resolver,
       type_(MEMORY_CACHE),
       network_layer_(HttpNetworkLayer::CreateFactory(
           host_resolver, proxy_service)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          doom_callback_(this, &HttpCache::OnDoomComplete)),
       ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)),
       in_memory_cache_(true),
       deleted_(false),
@@ -1295,6 +1319,8 @@ HttpCache::HttpCache(HttpTransactionFactory* network_layer,
       type_(DISK_CACHE),
       network_layer_(network_layer),
       disk_cache_(disk_cache),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          doom_callback_(this, &HttpCache::OnDoomComplete)),
       ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)),
       in_memory_cache_(false),
       deleted_(false),
@@ -1319,6 +1345,12 @@ HttpCache::~HttpCache() {
   for (; it != doomed_entries_.end(); ++it)
     delete *it;
 
+  // The disk cache is destroyed after us, and it will not invoke the callbacks
+  // of the operations that are still pending.
+  PendingOpsMap::iterator op = pending_ops_.begin();
+  for (; op != pending_ops_.end(); ++op)
+    delete op->second;
+
   // TODO(rvargas): remove this. I'm just tracking a few crashes.
   deleted_ = true;
 }
@@ -1513,7 +1545,9 @@ void HttpCache::DoomEntry(const std::string& key) {
   // all consumers are finished with the entry).
   ActiveEntriesMap::iterator it = active_entries_.find(key);
   if (it == active_entries_.end()) {
-    disk_cache_->DoomEntry(key);
+    // The operations of the disk cache complete in order, so it's fine to
+    // create a new entry before this completes.
+    disk_cache_->DoomEntry(key, &doom_callback_);
   } else {
     ActiveEntry* entry = it->second;
     active_entries_.erase(it);
@@ -1547,24 +1581,41 @@ HttpCache::ActiveEntry* HttpCache::FindActiveEntry(const std::string& key) {
   return it != active_entries_.end() ? it->second : NULL;
 }
 
-HttpCache::ActiveEntry* HttpCache::OpenEntry(const std::string& key) {
-  DCHECK(!FindActiveEntry(key));
-
-  disk_cache::Entry* disk_entry;
-  if (!disk_cache_->OpenEntry(key, &disk_entry))
-    return NULL;
+int HttpCache::OpenEntry(const std::string& key, Transaction* trans) {
+  return StartPendingOp(key, false, trans);
+}
 
-  return ActivateEntry(key, disk_entry);
+int HttpCache::CreateEntry(const std::string& key, Transaction* trans) {
+  return StartPendingOp(key, true, trans);
 }
 
-HttpCache::ActiveEntry* HttpCache::CreateEntry(const std::string& key) {
+// The transaction is notified when the entry is ready, either with
+// AddTransactionToEntry or with EntryUnavailable.
+int HttpCache::StartPendingOp(const std::string& key, bool create,
+                              Transaction* trans) {
   DCHECK(!FindActiveEntry(key));
 
-  disk_cache::Entry* disk_entry;
-  if (!disk_cache_->CreateEntry(key, &disk_entry))
-    return NULL;
+  PendingOpsMap::iterator it = pending_ops_.find(key);
+  if (it != pending_ops_.end()) {
+    it->second->waiters.push_back(trans);
+    return ERR_IO_PENDING;
+  }
+
+  PendingOp* op = new PendingOp(this, key, create, trans);
+  int rv = create ?
+      disk_cache_->CreateEntry(key, &op->disk_entry, &op->callback) :
+      disk_cache_->OpenEntry(key, &op->disk_entry, &op->callback);
+  if (rv == ERR_IO_PENDING) {
+    pending_ops_[key] = op;
+    return rv;
+  }
+
+  disk_cache::Entry* disk_entry = op->disk_entry;
+  delete op;
+  if (rv != OK)
+    return trans->EntryUnavailable();
 
-  return ActivateEntry(key, disk_entry);
+  return AddTransactionToEntry(ActivateEntry(key, disk_entry), trans);
 }
 
 void HttpCache::DestroyEntry(ActiveEntry* entry) {
@@ -1742,6 +1793,20 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
 }
 
 void HttpCache::RemovePendingTransaction(Transaction* trans) {
+  PendingOpsMap::const_iterator op = pending_ops_.find(trans->key());
+  if (op != pending_ops_.end()) {
+    if (op->second->trans == trans) {
+      op->second->trans = NULL;
+      return;
+    }
+    TransactionList& waiters = op->second->waiters;
+    TransactionList::iterator j = find(waiters.begin(), waiters.end(), trans);
+    if (j != waiters.end()) {
+      waiters.erase(j);
+      return;
+    }
+  }
+
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
   if (i == active_entries_.end())
     return;
@@ -1792,6 +1857,47 @@ void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   AddTransactionToEntry(entry, next);
 }
 
+void HttpCache::OnPendingOpComplete(PendingOp* op, int result) {
+  PendingOpsMap::iterator it = pending_ops_.find(op->key);
+  DCHECK(it != pending_ops_.end() && it->second == op);
+  pending_ops_.erase(it);
+
+  Transaction* trans = op->trans;
+  TransactionList waiters;
+  waiters.swap(op->waiters);
+
+  ActiveEntry* entry = NULL;
+  if (result == OK) {
+    if (trans) {
+      entry = ActivateEntry(op->key, op->disk_entry);
+    } else {
+      // Nobody wants this entry anymore, and a new entry has no data yet.
+      if (op->create)
+        op->disk_entry->Doom();
+      op->disk_entry->Close();
+    }
+  }
+  delete op;
+
+  if (trans) {
+    if (entry) {
+      AddTransactionToEntry(entry, trans);
+    } else {
+      trans->EntryUnavailable();
+    }
+  }
+
+  // The waiting transactions start over, now that the entry is active (or
+  // there is a new operation in progress for the same key).
+  while (!waiters.empty()) {
+    waiters.front()->AddToEntry();
+    waiters.pop_front();
+  }
+}
+
+void HttpCache::OnDoomComplete(int result) {
+}
+
 void HttpCache::CloseIdleConnections() {
   net::HttpNetworkLayer* network =
       static_cast<net::HttpNetworkLayer*>(network_layer_.get());
@@ -22,6 +22,7 @@
 #include "base/scoped_ptr.h"
 #include "base/task.h"
 #include "net/base/cache_type.h"
+#include "net/base/completion_callback.h"
 #include "net/http/http_transaction_factory.h"
 
 namespace disk_cache {
@@ -137,6 +138,25 @@ class HttpCache : public HttpTransactionFactory {
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
   typedef std::set<ActiveEntry*> ActiveEntriesSet;
 
+  // An asynchronous OpenEntry or CreateEntry of the disk cache. Only one of
+  // them is issued at a time for a given key: the transactions that ask for
+  // the same key in the meantime are kept in |waiters|.
+  struct PendingOp {
+    HttpCache*         cache;
+    std::string        key;
+    disk_cache::Entry* disk_entry;
+    bool               create;
+    Transaction*       trans;  // NULL if the transaction went away.
+    TransactionList    waiters;
+    CompletionCallbackImpl<PendingOp> callback;
+
+    PendingOp(HttpCache* cache, const std::string& key, bool create,
+              Transaction* trans);
+    void OnIOComplete(int result);
+  };
+
+  typedef base::hash_map<std::string, PendingOp*> PendingOpsMap;
+
 
   // Methods ------------------------------------------------------------------
 
@@ -146,8 +166,9 @@ class HttpCache : public HttpTransactionFactory {
   ActiveEntry* FindActiveEntry(const std::string& key);
   ActiveEntry* ActivateEntry(const std::string& key, disk_cache::Entry*);
   void DeactivateEntry(ActiveEntry* entry);
-  ActiveEntry* OpenEntry(const std::string& key);
-  ActiveEntry* CreateEntry(const std::string& cache_key);
+  int OpenEntry(const std::string& key, Transaction* trans);
+  int CreateEntry(const std::string& key, Transaction* trans);
+  int StartPendingOp(const std::string& key, bool create, Transaction* trans);
   void DestroyEntry(ActiveEntry* entry);
   int AddTransactionToEntry(ActiveEntry* entry, Transaction* trans);
   void DoneWithEntry(ActiveEntry* entry, Transaction* trans);
@@ -163,6 +184,12 @@ class HttpCache : public HttpTransactionFactory {
   void OnProcessPendingQueue(ActiveEntry* entry);
 
 
+  // Events (called from the disk cache) --------------------------------------
+
+  void OnPendingOpComplete(PendingOp* op, int result);
+  void OnDoomComplete(int result);
+
+
   // Variables ----------------------------------------------------------------
 
   // used when lazily constructing the disk_cache_
@@ -180,6 +207,11 @@ class HttpCache : public HttpTransactionFactory {
   // The set of doomed entries
   ActiveEntriesSet doomed_entries_;
 
+  // The disk cache operations in progress, indexed by cache key
+  PendingOpsMap pending_ops_;
+
+  CompletionCallbackImpl<HttpCache> doom_callback_;
+
   ScopedRunnableMethodFactory<HttpCache> task_factory_;
 
   bool in_memory_cache_;
@@ -214,7 +214,10 @@ class MockDiskEntry : public disk_cache::Entry,
 
 class MockDiskCache : public disk_cache::Backend {
  public:
-  MockDiskCache() : open_count_(0), create_count_(0), fail_requests_(0) {
+  MockDiskCache()
+      : open_count_(0), create_count_(0), fail_requests_(0),
+        async_requests_(false),
+        ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)) {
   }
 
   ~MockDiskCache() {
@@ -278,6 +281,39 @@ class MockDiskCache : public disk_cache::Backend {
     return true;
   }
 
+  virtual int OpenEntry(const std::string& key, disk_cache::Entry** entry,
+                        net::CompletionCallback* callback) {
+    if (async_requests_ && callback) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          task_factory_.NewRunnableMethod(&MockDiskCache::CompleteOpenEntry,
+                                          key, entry, callback));
+      return net::ERR_IO_PENDING;
+    }
+    return OpenEntry(key, entry) ? net::OK : net::ERR_FAILED;
+  }
+
+  virtual int CreateEntry(const std::string& key, disk_cache::Entry** entry,
+                          net::CompletionCallback* callback) {
+    if (async_requests_ && callback) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          task_factory_.NewRunnableMethod(&MockDiskCache::CompleteCreateEntry,
+                                          key, entry, callback));
+      return net::ERR_IO_PENDING;
+    }
+    return CreateEntry(key, entry) ? net::OK : net::ERR_FAILED;
+  }
+
+  virtual int DoomEntry(const std::string& key,
+                        net::CompletionCallback* callback) {
+    if (async_requests_ && callback) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          task_factory_.NewRunnableMethod(&MockDiskCache::CompleteDoomEntry,
+                                          key, callback));
+      return net::ERR_IO_PENDING;
+    }
+    return DoomEntry(key) ? net::OK : net::ERR_FAILED;
+  }
+
   virtual bool DoomAllEntries() {
     return false;
   }
@@ -295,6 +331,11 @@ class MockDiskCache : public disk_cache::Backend {
     return false;
   }
 
+  virtual int OpenNextEntry(void** iter, disk_cache::Entry** next_entry,
+                            net::CompletionCallback* callback) {
+    return net::ERR_FAILED;
+  }
+
   virtual void EndEnumeration(void** iter) {}
 
   virtual void GetStats(
@@ -310,12 +351,34 @@ class MockDiskCache : public disk_cache::Backend {
   // Fail any subsequent CreateEntry and OpenEntry.
   void set_fail_requests() { fail_requests_ = true; }
 
+  // Complete any subsequent asynchronous CreateEntry, OpenEntry and DoomEntry
+  // from the message loop, in the order they were issued.
+  void set_async_requests() { async_requests_ = true; }
+
  private:
   typedef base::hash_map<std::string, MockDiskEntry*> EntryMap;
+
+  void CompleteOpenEntry(const std::string& key, disk_cache::Entry** entry,
+                         net::CompletionCallback* callback) {
+    callback->Run(OpenEntry(key, entry) ? net::OK : net::ERR_FAILED);
+  }
+
+  void CompleteCreateEntry(const std::string& key, disk_cache::Entry** entry,
+                           net::CompletionCallback* callback) {
+    callback->Run(CreateEntry(key, entry) ? net::OK : net::ERR_FAILED);
+  }
+
+  void CompleteDoomEntry(const std::string& key,
+                         net::CompletionCallback* callback) {
+    callback->Run(DoomEntry(key) ? net::OK : net::ERR_FAILED);
+  }
+
   EntryMap entries_;
   int open_count_;
   int create_count_;
   bool fail_requests_;
+  bool async_requests_;
+  ScopedRunnableMethodFactory<MockDiskCache> task_factory_;
 };
 
 class MockHttpCache {
@@ -783,6 +846,97 @@ TEST(HttpCache, SimpleGET_ManyReaders) {
   }
 }
 
+// Tests that the cache works when the disk cache completes the operations
+// asynchronously.
+TEST(HttpCache, SimpleGET_AsyncDiskCache) {
+  MockHttpCache cache;
+  cache.disk_cache()->set_async_requests();
+
+  // write to the cache
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  // read from the cache
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  // overwrite the entry
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.load_flags |= net::LOAD_BYPASS_CACHE;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Tests that requests for the same entry wait for the disk cache operation in
+// progress instead of issuing their own.
+TEST(HttpCache, SimpleGET_ManyReaders_AsyncDiskCache) {
+  MockHttpCache cache;
+  cache.disk_cache()->set_async_requests();
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 5;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(
+        new Context(cache.http_cache()->CreateTransaction()));
+
+    Context* c = context_list[i];
+    int rv = c->trans->Start(&request, &c->callback);
+    EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  }
+
+  // nothing happens until the disk cache completes the first operation.
+  EXPECT_EQ(0, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->create_count());
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    c->result = c->callback.WaitForResult();
+    ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    delete c;
+  }
+}
+
+// Tests that deleting a transaction while the disk cache is opening the entry
+// doesn't leave the entry active.
+TEST(HttpCache, SimpleGET_CancelAsyncOpen) {
+  MockHttpCache cache;
+
+  // write to the cache
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  cache.disk_cache()->set_async_requests();
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+  Context* c = new Context(cache.http_cache()->CreateTransaction());
+  EXPECT_EQ(net::ERR_IO_PENDING, c->trans->Start(&request, &c->callback));
+  delete c;
+
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+
+  // read from the cache
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 // This is a test for http://code.google.com/p/chromium/issues/detail?id=4769.
 // If cancelling a request is racing with another request for the same resource
 // finishing, we have to make sure that we remove both transactions from the
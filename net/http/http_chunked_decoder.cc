@@ -51,7 +51,8 @@ HttpChunkedDecoder::HttpChunkedDecoder()
     : chunk_remaining_(0),
       chunk_terminator_remaining_(false),
       reached_last_chunk_(false),
-      reached_eof_(false) {
+      reached_eof_(false),
+      bytes_after_eof_(0) {
 }
 
 int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
@@ -72,6 +73,7 @@ int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
         chunk_terminator_remaining_ = true;
       continue;
     } else if (reached_eof_) {
+      bytes_after_eof_ += buf_len;
       break;  // Done!
     }
 
@@ -134,6 +134,17 @@ TEST(HttpChunkedDecoderTest, TrailersUnfinished) {
   RunTest(inputs, arraysize(inputs), "hello", false);
 }
 
+TEST(HttpChunkedDecoderTest, BytesAfterEOF) {
+  net::HttpChunkedDecoder decoder;
+  std::string input = "5\r\nhello\r\n0\r\n\r\nHTTP/1.1";
+  int n = decoder.FilterBuf(&input[0], static_cast<int>(input.size()));
+  EXPECT_EQ(5, n);
+  EXPECT_TRUE(decoder.reached_eof());
+  EXPECT_EQ(8, decoder.bytes_after_eof());
+  EXPECT_EQ("hello", input.substr(0, n));
+  EXPECT_EQ("HTTP/1.1", input.substr(n, decoder.bytes_after_eof()));
+}
+
 TEST(HttpChunkedDecoderTest, InvalidChunkSize_TooBig) {
   const char* inputs[] = {
     // This chunked body is not terminated.
@@ -8,9 +8,18 @@
 
 namespace net {
 
+// static
+int HttpNetworkSession::max_sockets_ = 256;
+
 // static
 int HttpNetworkSession::max_sockets_per_group_ = 6;
 
+// static
+void HttpNetworkSession::set_max_sockets(int socket_count) {
+  DCHECK(0 < socket_count);
+  max_sockets_ = socket_count;
+}
+
 // static
 void HttpNetworkSession::set_max_sockets_per_group(int socket_count) {
   DCHECK(0 < socket_count);
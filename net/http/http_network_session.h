@@ -10,6 +10,7 @@
 #include "net/base/ssl_client_auth_cache.h"
 #include "net/base/ssl_config_service.h"
 #include "net/http/http_auth_cache.h"
+#include "net/http/http_pipeline_manager.h"
 #include "net/socket/tcp_client_socket_pool.h"
 
 namespace net {
@@ -24,7 +25,9 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession> {
   HttpNetworkSession(HostResolver* host_resolver, ProxyService* proxy_service,
                      ClientSocketFactory* client_socket_factory)
       : connection_pool_(new TCPClientSocketPool(
-            max_sockets_per_group_, host_resolver, client_socket_factory)),
+            max_sockets_, max_sockets_per_group_, host_resolver,
+            client_socket_factory)),
+        pipeline_manager_(connection_pool_),
         host_resolver_(host_resolver),
         proxy_service_(proxy_service) {
     DCHECK(proxy_service);
@@ -35,17 +38,23 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession> {
     return &ssl_client_auth_cache_;
   }
   ClientSocketPool* connection_pool() { return connection_pool_; }
+  HttpPipelineManager* pipeline_manager() { return &pipeline_manager_; }
   HostResolver* host_resolver() { return host_resolver_; }
   ProxyService* proxy_service() { return proxy_service_; }
 #if defined(OS_WIN)
   SSLConfigService* ssl_config_service() { return &ssl_config_service_; }
 #endif
 
+  static void set_max_sockets(int socket_count);
   static void set_max_sockets_per_group(int socket_count);
 
  private:
   FRIEND_TEST(HttpNetworkTransactionTest, GroupNameForProxyConnections);
 
+  // Default to allow up to 256 connections in total, so that many tabs open
+  // on many hosts don't run out of file descriptors.
+  static int max_sockets_;
+
   // Default to allow up to 6 connections per host. Experiment and tuning may
   // try other values (greater than 0).  Too large may cause many problems, such
   // as home routers blocking the connections!?!?
@@ -54,6 +63,7 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession> {
   HttpAuthCache auth_cache_;
   SSLClientAuthCache ssl_client_auth_cache_;
   scoped_refptr<ClientSocketPool> connection_pool_;
+  HttpPipelineManager pipeline_manager_;
   scoped_refptr<HostResolver> host_resolver_;
   ProxyService* proxy_service_;
 #if defined(OS_WIN)
@@ -22,6 +22,9 @@
 #include "net/http/http_basic_stream.h"
 #include "net/http/http_chunked_decoder.h"
 #include "net/http/http_network_session.h"
+#include "net/http/http_pipeline_manager.h"
+#include "net/http/http_pipelined_connection.h"
+#include "net/http/http_pipelined_stream.h"
 #include "net/http/http_request_info.h"
 #include "net/http/http_response_headers.h"
 #include "net/http/http_util.h"
@@ -139,6 +142,8 @@ HttpNetworkTransaction::HttpNetworkTransaction(HttpNetworkSession* session,
       socket_factory_(csf),
       connection_(session->connection_pool()),
       reused_socket_(false),
+      pipelined_stream_(NULL),
+      pipelining_disabled_(false),
       using_ssl_(false),
       proxy_mode_(kDirectConnection),
       establishing_tunnel_(false),
@@ -319,13 +324,19 @@ void HttpNetworkTransaction::PrepareForAuthRestart(HttpAuth::Target target) {
 }
 
 void HttpNetworkTransaction::DidDrainBodyForAuthRestart(bool keep_alive) {
-  if (keep_alive) {
+  if (pipelined_stream_)
+    DidFinishPipelinedResponse(keep_alive, 0);
+
+  if (keep_alive && connection_.is_initialized()) {
     next_state_ = STATE_WRITE_HEADERS;
     reused_socket_ = true;
   } else {
+    // A pipelined request is sent again on a new stream.
     next_state_ = STATE_INIT_CONNECTION;
-    connection_.socket()->Disconnect();
-    connection_.Reset();
+    if (connection_.is_initialized()) {
+      connection_.socket()->Disconnect();
+      connection_.Reset();
+    }
   }
 
   // Reset the other member variables.
@@ -338,7 +349,7 @@ int HttpNetworkTransaction::Read(IOBuffer* buf, int buf_len,
   DCHECK(buf);
   DCHECK(buf_len > 0);
 
-  if (!connection_.is_initialized())
+  if (!connection_.is_initialized() && !pipelined_stream_)
     return 0;  // connection_ has been reset.  Treat like EOF.
 
   if (establishing_tunnel_) {
@@ -561,6 +572,7 @@ int HttpNetworkTransaction::DoResolveProxyComplete(int result) {
 
 int HttpNetworkTransaction::DoInitConnection() {
   DCHECK(!connection_.is_initialized());
+  DCHECK(!pipelined_stream_);
 
   next_state_ = STATE_INIT_CONNECTION_COMPLETE;
 
@@ -603,6 +615,21 @@ int HttpNetworkTransaction::DoInitConnection() {
                                    << ", Host: " << host
                                    << ", Port: " << port;
 
+  // Send the request right away if there is a pipelined connection to the
+  // server.
+  if (ShouldPipelineRequest()) {
+    HttpPipelinedConnection* pipeline =
+        session_->pipeline_manager()->GetPipeline(connection_group);
+    if (pipeline) {
+      pipelined_stream_ = pipeline->CreateStream();
+      http_stream_.reset(pipelined_stream_);
+      session_->pipeline_manager()->OnRequestPipelined();
+      reused_socket_ = true;
+      next_state_ = STATE_WRITE_HEADERS;
+      return OK;
+    }
+  }
+
   HostResolver::RequestInfo resolve_info(host, port);
 
   // The referrer is used by the DNS prefetch system to corellate resolutions
@@ -647,6 +674,19 @@ int HttpNetworkTransaction::DoInitConnectionComplete(int result) {
         establishing_tunnel_ = true;
     }
   }
+
+  // Once the server has kept a connection alive, the next requests to it can
+  // be sent on that connection without waiting for this response.
+  if (reused_socket_ && ShouldPipelineRequest()) {
+    HttpPipelinedConnection* pipeline =
+        session_->pipeline_manager()->CreatePipeline(&connection_);
+    if (pipeline) {
+      pipelined_stream_ = pipeline->CreateStream();
+      http_stream_.reset(pipelined_stream_);
+      session_->pipeline_manager()->OnRequestPipelined();
+      return OK;
+    }
+  }
   http_stream_.reset(new HttpBasicStream(&connection_));
   return OK;
 }
@@ -935,7 +975,7 @@ int HttpNetworkTransaction::DoReadHeadersComplete(int result) {
 int HttpNetworkTransaction::DoReadBody() {
   DCHECK(read_buf_);
   DCHECK_GT(read_buf_len_, 0);
-  DCHECK(connection_.is_initialized());
+  DCHECK(connection_.is_initialized() || pipelined_stream_);
   DCHECK(!header_buf_->headers() || header_buf_body_offset_ >= 0);
 
   next_state_ = STATE_READ_BODY_COMPLETE;
@@ -945,6 +985,13 @@ int HttpNetworkTransaction::DoReadBody() {
       response_body_read_ >= response_body_length_)
     return 0;
 
+  // The next response follows this one on a pipelined connection, so don't
+  // read past the end of the body.
+  if (pipelined_stream_ && response_body_length_ != -1) {
+    read_buf_len_ = static_cast<int>(std::min<int64>(
+        read_buf_len_, response_body_length_ - response_body_read_));
+  }
+
   // We may have some data remaining in the header buffer.
   if (header_buf_->headers() && header_buf_body_offset_ < header_buf_len_) {
     int n = std::min(read_buf_len_, header_buf_len_ - header_buf_body_offset_);
@@ -1007,9 +1054,13 @@ int HttpNetworkTransaction::DoReadBodyComplete(int result) {
   // Clean up connection_ if we are done.
   if (done) {
     LogTransactionMetrics();
-    if (!keep_alive)
-      connection_.socket()->Disconnect();
-    connection_.Reset();
+    if (pipelined_stream_) {
+      DidFinishPipelinedResponse(keep_alive, result);
+    } else {
+      if (!keep_alive)
+        connection_.socket()->Disconnect();
+      connection_.Reset();
+    }
     // The next Read call will return 0 (EOF).
   }
 
@@ -1072,6 +1123,8 @@ int HttpNetworkTransaction::DoDrainBodyForAuthRestartComplete(int result) {
   }
 
   if (done) {
+    if (pipelined_stream_)
+      DidFinishPipelinedResponse(keep_alive, result);
     DidDrainBodyForAuthRestart(keep_alive);
   } else {
     // Keep draining.
@@ -1283,6 +1336,11 @@ int HttpNetworkTransaction::DidReadResponseHeaders() {
     }
   }
 
+  // There is no body to wait for, and the next response on a pipelined
+  // connection may follow right away.
+  if (pipelined_stream_ && response_body_length_ == 0)
+    DidFinishPipelinedResponse(response_.headers->IsKeepAlive(), 0);
+
   int rv = HandleAuthChallenge();
   if (rv != OK)
     return rv;
@@ -1419,6 +1477,12 @@ int HttpNetworkTransaction::HandleIOError(int error) {
         error = OK;
       }
       break;
+    // The pipelined connection was closed before the server answered the
+    // request.
+    case ERR_PIPELINE_EVICTED:
+      ResetConnectionAndRequestForResend();
+      error = OK;
+      break;
   }
   return error;
 }
@@ -1454,8 +1518,17 @@ bool HttpNetworkTransaction::ShouldResendRequest() const {
 }
 
 void HttpNetworkTransaction::ResetConnectionAndRequestForResend() {
-  connection_.socket()->Disconnect();
-  connection_.Reset();
+  if (pipelined_stream_) {
+    // Send the request on a connection of its own this time.
+    pipelined_stream_->OnResponseFailed();
+    pipelined_stream_ = NULL;
+    http_stream_.reset();
+    pipelining_disabled_ = true;
+    session_->pipeline_manager()->OnRequestResent();
+  } else {
+    connection_.socket()->Disconnect();
+    connection_.Reset();
+  }
   // There are two reasons we need to clear request_headers_.  1) It contains
   // the real request headers, but we may need to resend the CONNECT request
   // first to recreate the SSL tunnel.  2) An empty request_headers_ causes
@@ -1466,6 +1539,43 @@ void HttpNetworkTransaction::ResetConnectionAndRequestForResend() {
   next_state_ = STATE_INIT_CONNECTION;  // Resend the request.
 }
 
+bool HttpNetworkTransaction::ShouldPipelineRequest() const {
+  // Only idempotent requests without a body are pipelined, so that they can be
+  // resent if the connection fails.
+  return HttpPipelineManager::enabled() && !pipelining_disabled_ &&
+         proxy_mode_ == kDirectConnection && !using_ssl_ &&
+         request_->method == "GET" && !request_->upload_data;
+}
+
+void HttpNetworkTransaction::DidFinishPipelinedResponse(bool keep_alive,
+                                                        int body_len) {
+  DCHECK(pipelined_stream_);
+
+  // The data that was read past the end of the response belongs to the next
+  // response.  It may be in the read buffer, after the end of a chunked body,
+  // and then in the header buffer.
+  std::string unread_data;
+  if (keep_alive) {
+    if (chunked_decoder_.get() && chunked_decoder_->bytes_after_eof()) {
+      unread_data.assign(read_buf_->data() + body_len,
+                         chunked_decoder_->bytes_after_eof());
+    }
+    if (header_buf_->headers() && header_buf_body_offset_ >= 0 &&
+        header_buf_body_offset_ < header_buf_len_) {
+      unread_data.append(header_buf_->headers() + header_buf_body_offset_,
+                         header_buf_len_ - header_buf_body_offset_);
+      header_buf_->Reset();
+      header_buf_capacity_ = 0;
+      header_buf_len_ = 0;
+      header_buf_body_offset_ = -1;
+    }
+  }
+
+  pipelined_stream_->OnResponseDone(keep_alive, unread_data.data(),
+                                    static_cast<int>(unread_data.size()));
+  pipelined_stream_ = NULL;
+}
+
 int HttpNetworkTransaction::ReconsiderProxyAfterError(int error) {
   DCHECK(!pac_request_);
 
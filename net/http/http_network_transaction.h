@@ -30,6 +30,7 @@ namespace net {
 class ClientSocketFactory;
 class HttpChunkedDecoder;
 class HttpNetworkSession;
+class HttpPipelinedStream;
 class HttpStream;
 class UploadDataStream;
 
@@ -194,6 +195,14 @@ class HttpNetworkTransaction : public HttpTransaction {
   // ShouldResendRequest() is true.
   void ResetConnectionAndRequestForResend();
 
+  // Returns true if the request may be sent on a pipelined connection.
+  bool ShouldPipelineRequest() const;
+
+  // Called when the response was read from a pipelined connection.  The
+  // |body_len| bytes at the start of |read_buf_| are the last bytes of the
+  // response body; any data after them is given back to the pipeline.
+  void DidFinishPipelinedResponse(bool keep_alive, int body_len);
+
   // Called when we encounter a network error that could be resolved by trying
   // a new proxy configuration.  If there is another proxy configuration to try
   // then this method sets next_state_ appropriately and returns either OK or
@@ -313,6 +322,14 @@ class HttpNetworkTransaction : public HttpTransaction {
   scoped_ptr<HttpStream> http_stream_;
   bool reused_socket_;
 
+  // Set if |http_stream_| is a stream of a pipelined connection, until the
+  // response was read.  In that case |connection_| is not used.
+  HttpPipelinedStream* pipelined_stream_;
+
+  // True if the request must not be pipelined, because it failed on a
+  // pipelined connection before.
+  bool pipelining_disabled_;
+
   bool using_ssl_;     // True if handling a HTTPS request
   ProxyMode proxy_mode_;
 
@@ -13,6 +13,7 @@
 #include "net/http/http_auth_handler_ntlm.h"
 #include "net/http/http_network_session.h"
 #include "net/http/http_network_transaction.h"
+#include "net/http/http_pipeline_manager.h"
 #include "net/http/http_transaction_unittest.h"
 #include "net/proxy/proxy_config_service_fixed.h"
 #include "net/socket/client_socket_factory.h"
@@ -635,6 +636,143 @@ TEST_F(HttpNetworkTransactionTest, NonKeepAliveConnectionEOF) {
   EXPECT_EQ(ERR_EMPTY_RESPONSE, out.rv);
 }
 
+// Once a keep-alive connection is reused, the next requests are pipelined on
+// it, and the responses are read in order even if they arrive together.
+TEST_F(HttpNetworkTransactionTest, PipelinedRequests) {
+  HttpPipelineManager::set_enabled(true);
+
+  SessionDependencies session_deps;
+  scoped_refptr<HttpNetworkSession> session = CreateSession(&session_deps);
+
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("http://www.google.com/");
+  request.load_flags = 0;
+
+  MockRead data_reads[] = {
+    MockRead("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"),
+    MockRead(false,
+             "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nworld"
+             "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+             "3\r\nfoo\r\n0\r\n\r\n"),
+    MockRead(false, OK),
+  };
+  StaticMockSocket data(data_reads, NULL);
+  session_deps.socket_factory.AddMockSocket(&data);
+
+  TestCompletionCallback callback1;
+  scoped_ptr<HttpTransaction> trans1(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  int rv = trans1->Start(&request, &callback1);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback1.WaitForResult());
+
+  std::string response_data;
+  EXPECT_EQ(OK, ReadTransaction(trans1.get(), &response_data));
+  EXPECT_EQ("hello", response_data);
+
+  // The second request reuses the connection, which becomes pipelined.
+  TestCompletionCallback callback2;
+  scoped_ptr<HttpTransaction> trans2(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  rv = trans2->Start(&request, &callback2);
+  if (rv == ERR_IO_PENDING)
+    rv = callback2.WaitForResult();
+  EXPECT_EQ(OK, rv);
+
+  // The third request is sent before the second response is read.
+  TestCompletionCallback callback3;
+  scoped_ptr<HttpTransaction> trans3(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  rv = trans3->Start(&request, &callback3);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  EXPECT_EQ(OK, ReadTransaction(trans2.get(), &response_data));
+  EXPECT_EQ("world", response_data);
+
+  EXPECT_EQ(OK, callback3.WaitForResult());
+  const HttpResponseInfo* response = trans3->GetResponseInfo();
+  EXPECT_TRUE(response != NULL);
+  EXPECT_TRUE(response->headers != NULL);
+  EXPECT_EQ("HTTP/1.1 200 OK", response->headers->GetStatusLine());
+  EXPECT_EQ(OK, ReadTransaction(trans3.get(), &response_data));
+  EXPECT_EQ("foo", response_data);
+
+  // There is only one mock socket, and the last two requests were pipelined on
+  // it.
+  EXPECT_EQ(2, session->pipeline_manager()->requests_pipelined());
+  EXPECT_EQ(0, session->pipeline_manager()->requests_resent());
+
+  HttpPipelineManager::set_enabled(false);
+}
+
+// A pipelined request whose connection is closed before it gets a response is
+// sent again on a new connection.
+TEST_F(HttpNetworkTransactionTest, PipelinedRequestResent) {
+  HttpPipelineManager::set_enabled(true);
+
+  SessionDependencies session_deps;
+  scoped_refptr<HttpNetworkSession> session = CreateSession(&session_deps);
+
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("http://www.google.com/");
+  request.load_flags = 0;
+
+  MockRead data1_reads[] = {
+    MockRead("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"),
+    MockRead(false, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nworld"),
+    MockRead(false, ERR_CONNECTION_RESET),
+  };
+  StaticMockSocket data1(data1_reads, NULL);
+  session_deps.socket_factory.AddMockSocket(&data1);
+
+  MockRead data2_reads[] = {
+    MockRead("HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nfoo"),
+    MockRead(false, OK),
+  };
+  StaticMockSocket data2(data2_reads, NULL);
+  session_deps.socket_factory.AddMockSocket(&data2);
+
+  TestCompletionCallback callback1;
+  scoped_ptr<HttpTransaction> trans1(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  int rv = trans1->Start(&request, &callback1);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback1.WaitForResult());
+
+  std::string response_data;
+  EXPECT_EQ(OK, ReadTransaction(trans1.get(), &response_data));
+  EXPECT_EQ("hello", response_data);
+
+  TestCompletionCallback callback2;
+  scoped_ptr<HttpTransaction> trans2(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  rv = trans2->Start(&request, &callback2);
+  if (rv == ERR_IO_PENDING)
+    rv = callback2.WaitForResult();
+  EXPECT_EQ(OK, rv);
+
+  TestCompletionCallback callback3;
+  scoped_ptr<HttpTransaction> trans3(
+      new HttpNetworkTransaction(session, &session_deps.socket_factory));
+  rv = trans3->Start(&request, &callback3);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  EXPECT_EQ(OK, ReadTransaction(trans2.get(), &response_data));
+  EXPECT_EQ("world", response_data);
+
+  // The connection is reset, and the third request goes to the new one.
+  EXPECT_EQ(OK, callback3.WaitForResult());
+  EXPECT_EQ(OK, ReadTransaction(trans3.get(), &response_data));
+  EXPECT_EQ("foo", response_data);
+
+  EXPECT_EQ(2, session->pipeline_manager()->requests_pipelined());
+  EXPECT_EQ(1, session->pipeline_manager()->requests_resent());
+
+  HttpPipelineManager::set_enabled(false);
+}
+
 // Test the request-challenge-retry sequence for basic auth.
 // (basic auth is the easiest to mock, because it has no randomness).
 TEST_F(HttpNetworkTransactionTest, BasicAuth) {
@@ -0,0 +1,63 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_pipeline_manager.h"
+
+#include "base/logging.h"
+#include "net/http/http_pipelined_connection.h"
+#include "net/socket/client_socket_handle.h"
+
+namespace net {
+
+// static
+bool HttpPipelineManager::enabled_ = false;
+
+HttpPipelineManager::HttpPipelineManager(ClientSocketPool* pool)
+    : pool_(pool),
+      requests_pipelined_(0),
+      requests_resent_(0) {
+}
+
+HttpPipelineManager::~HttpPipelineManager() {
+  // Pipelines are kept alive by their streams, and the transactions that own
+  // the streams hold a reference to the session.
+  DCHECK(pipelines_.empty());
+}
+
+HttpPipelinedConnection* HttpPipelineManager::GetPipeline(
+    const std::string& group_name) {
+  PipelineMap::iterator it = pipelines_.find(group_name);
+  if (it == pipelines_.end() || !it->second->CanAcceptRequests())
+    return NULL;
+  return it->second;
+}
+
+HttpPipelinedConnection* HttpPipelineManager::CreatePipeline(
+    ClientSocketHandle* connection) {
+  const std::string& group_name = connection->group_name();
+  if (IsBlacklisted(group_name) ||
+      pipelines_.find(group_name) != pipelines_.end())
+    return NULL;
+
+  HttpPipelinedConnection* pipeline =
+      new HttpPipelinedConnection(connection, pool_, this);
+  pipelines_[pipeline->group_name()] = pipeline;
+  return pipeline;
+}
+
+bool HttpPipelineManager::IsBlacklisted(const std::string& group_name) const {
+  return blacklist_.find(group_name) != blacklist_.end();
+}
+
+void HttpPipelineManager::OnPipelineClosed(HttpPipelinedConnection* pipeline,
+                                           bool server_error) {
+  PipelineMap::iterator it = pipelines_.find(pipeline->group_name());
+  if (it != pipelines_.end() && it->second == pipeline)
+    pipelines_.erase(it);
+
+  if (server_error)
+    blacklist_.insert(pipeline->group_name());
+}
+
+}  // namespace net
@@ -0,0 +1,73 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_HTTP_PIPELINE_MANAGER_H_
+#define NET_HTTP_HTTP_PIPELINE_MANAGER_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace net {
+
+class ClientSocketHandle;
+class ClientSocketPool;
+class HttpPipelinedConnection;
+
+// HttpPipelineManager keeps track of the pipelined connections of a session,
+// and of the servers that are known to not support pipelining.  There is at
+// most one pipelined connection per connection group.
+class HttpPipelineManager {
+ public:
+  explicit HttpPipelineManager(ClientSocketPool* pool);
+  ~HttpPipelineManager();
+
+  // Pipelining is disabled by default.
+  static void set_enabled(bool enabled) { enabled_ = enabled; }
+  static bool enabled() { return enabled_; }
+
+  // Returns the pipelined connection for |group_name|, if it can take another
+  // request, or NULL.
+  HttpPipelinedConnection* GetPipeline(const std::string& group_name);
+
+  // Creates a pipelined connection that takes over the socket of
+  // |connection|.  Returns NULL (and leaves |connection| untouched) if
+  // pipelining should not be used with this server.
+  HttpPipelinedConnection* CreatePipeline(ClientSocketHandle* connection);
+
+  // Returns true if pipelining failed before for |group_name|.
+  bool IsBlacklisted(const std::string& group_name) const;
+
+  // Called by HttpPipelinedConnection when it stops accepting requests.
+  // |server_error| is true if the server is to blame.
+  void OnPipelineClosed(HttpPipelinedConnection* pipeline, bool server_error);
+
+  // Called by HttpNetworkTransaction when a request is sent on a pipelined
+  // connection, and when such a request has to be sent again on a regular
+  // connection.
+  void OnRequestPipelined() { requests_pipelined_++; }
+  void OnRequestResent() { requests_resent_++; }
+
+  int requests_pipelined() const { return requests_pipelined_; }
+  int requests_resent() const { return requests_resent_; }
+
+ private:
+  typedef std::map<std::string, HttpPipelinedConnection*> PipelineMap;
+
+  static bool enabled_;
+
+  ClientSocketPool* pool_;
+  PipelineMap pipelines_;
+  std::set<std::string> blacklist_;
+  int requests_pipelined_;
+  int requests_resent_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpPipelineManager);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_PIPELINE_MANAGER_H_
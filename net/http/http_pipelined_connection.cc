@@ -0,0 +1,399 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_pipelined_connection.h"
+
+#include <algorithm>
+
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/http/http_pipeline_manager.h"
+#include "net/http/http_pipelined_stream.h"
+#include "net/socket/client_socket.h"
+
+namespace net {
+
+HttpPipelinedConnection::StreamInfo::StreamInfo()
+    : stream(NULL),
+      request_started(false),
+      request_sent(false),
+      pending_buf_len(0),
+      pending_callback(NULL),
+      pending_read(false) {
+}
+
+HttpPipelinedConnection::StreamInfo::~StreamInfo() {
+}
+
+HttpPipelinedConnection::HttpPipelinedConnection(
+    ClientSocketHandle* connection,
+    ClientSocketPool* pool,
+    HttpPipelineManager* manager)
+    : connection_(pool),
+      manager_(manager),
+      group_name_(connection->group_name()),
+      broken_(false),
+      closing_(false),
+      responses_read_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          read_callback_(this, &HttpPipelinedConnection::OnReadComplete)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          write_callback_(this, &HttpPipelinedConnection::OnWriteComplete)),
+      user_read_callback_(NULL),
+      user_write_callback_(NULL),
+      read_stream_(NULL),
+      write_stream_(NULL),
+      ALLOW_THIS_IN_INITIALIZER_LIST(method_factory_(this)) {
+  connection->TransferSocketTo(&connection_);
+}
+
+HttpPipelinedConnection::~HttpPipelinedConnection() {
+  if (connection_.is_initialized()) {
+    connection_.socket()->Disconnect();
+    connection_.Reset();
+  }
+}
+
+HttpPipelinedStream* HttpPipelinedConnection::CreateStream() {
+  if (!CanAcceptRequests())
+    return NULL;
+
+  StreamInfo info;
+  info.stream = new HttpPipelinedStream(this);
+  streams_.push_back(info);
+  return info.stream;
+}
+
+bool HttpPipelinedConnection::CanAcceptRequests() const {
+  return !broken_ && !closing_ && connection_.is_initialized() &&
+         static_cast<int>(streams_.size()) < kMaxDepth;
+}
+
+int HttpPipelinedConnection::Write(HttpPipelinedStream* stream, IOBuffer* buf,
+                                   int buf_len, CompletionCallback* callback) {
+  if (broken_)
+    return ERR_PIPELINE_EVICTED;
+
+  StreamList::iterator it = FindStream(stream);
+  DCHECK(it != streams_.end());
+  DCHECK(!it->request_sent);
+  it->request_started = true;
+
+  if (!CanWrite(it)) {
+    // Wait until the previous requests are sent.
+    it->pending_buf = buf;
+    it->pending_buf_len = buf_len;
+    it->pending_callback = callback;
+    it->pending_read = false;
+    return ERR_IO_PENDING;
+  }
+  return DoWrite(stream, buf, buf_len, callback);
+}
+
+int HttpPipelinedConnection::Read(HttpPipelinedStream* stream, IOBuffer* buf,
+                                  int buf_len, CompletionCallback* callback) {
+  if (broken_)
+    return ERR_PIPELINE_EVICTED;
+
+  StreamList::iterator it = FindStream(stream);
+  DCHECK(it != streams_.end());
+  if (!it->request_sent) {
+    // The stream is done sending its request, so the next one can go.
+    it->request_sent = true;
+    PostPendingOperations();
+  }
+
+  if (it != streams_.begin()) {
+    // Wait until the previous responses are read.
+    it->pending_buf = buf;
+    it->pending_buf_len = buf_len;
+    it->pending_callback = callback;
+    it->pending_read = true;
+    return ERR_IO_PENDING;
+  }
+  return DoRead(stream, buf, buf_len, callback);
+}
+
+void HttpPipelinedConnection::OnResponseDone(HttpPipelinedStream* stream,
+                                             bool keep_alive,
+                                             const char* unread_data,
+                                             int unread_len) {
+  DCHECK(!streams_.empty() && streams_.front().stream == stream);
+  DCHECK(!read_stream_);
+  RemoveStream(streams_.begin());
+  responses_read_++;
+
+  if (broken_)
+    return;
+
+  if (!keep_alive) {
+    // The server closes the connection after this response, which it is
+    // allowed to do.  The next requests are sent again elsewhere.
+    Break(false);
+    return;
+  }
+
+  // This data was read before the data that nobody has seen yet.
+  if (unread_len)
+    unread_data_.insert(0, unread_data, unread_len);
+
+  if (streams_.empty()) {
+    ReleaseConnection();
+  } else if (!streams_.front().stream) {
+    // Nobody is going to read the next response.
+    Break(false);
+  } else {
+    PostPendingOperations();
+  }
+}
+
+void HttpPipelinedConnection::OnResponseFailed(HttpPipelinedStream* stream) {
+  StreamList::iterator it = FindStream(stream);
+  if (it == streams_.end())
+    return;
+
+  RemoveStream(it);
+  if (!broken_)
+    Break(true);
+}
+
+void HttpPipelinedConnection::OnStreamDeleted(HttpPipelinedStream* stream) {
+  StreamList::iterator it = FindStream(stream);
+  if (it == streams_.end())
+    return;  // The stream is done with this connection.
+
+  if (broken_ || !it->request_started) {
+    RemoveStream(it);
+    if (broken_)
+      return;
+    if (streams_.empty()) {
+      ReleaseConnection();
+    } else {
+      PostPendingOperations();
+    }
+    return;
+  }
+
+  if (it == streams_.begin()) {
+    // Nobody is going to read the rest of the response.
+    RemoveStream(it);
+    Break(false);
+    return;
+  }
+
+  // The previous responses can still be read, but the response of this stream
+  // has to be skipped, which means closing the connection.  Any partial
+  // request also blocks the next requests.
+  it->stream = NULL;
+  it->pending_buf = NULL;
+  it->pending_callback = NULL;
+  if (stream == write_stream_) {
+    write_stream_ = NULL;
+    user_write_callback_ = NULL;
+  }
+  if (!closing_) {
+    closing_ = true;
+    if (manager_) {
+      manager_->OnPipelineClosed(this, false);
+      manager_ = NULL;
+    }
+  }
+}
+
+HttpPipelinedConnection::StreamList::iterator
+HttpPipelinedConnection::FindStream(HttpPipelinedStream* stream) {
+  for (StreamList::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    if (it->stream == stream)
+      return it;
+  }
+  return streams_.end();
+}
+
+bool HttpPipelinedConnection::CanWrite(StreamList::iterator it) {
+  if (write_stream_)
+    return false;
+
+  for (StreamList::iterator prev = streams_.begin(); prev != it; ++prev) {
+    if (!prev->request_sent)
+      return false;
+  }
+  return true;
+}
+
+int HttpPipelinedConnection::DoRead(HttpPipelinedStream* stream,
+                                    IOBuffer* buf, int buf_len,
+                                    CompletionCallback* callback) {
+  if (!unread_data_.empty()) {
+    int bytes = std::min(buf_len, static_cast<int>(unread_data_.size()));
+    memcpy(buf->data(), unread_data_.data(), bytes);
+    unread_data_.erase(0, bytes);
+    return bytes;
+  }
+
+  int rv = connection_.socket()->Read(buf, buf_len, &read_callback_);
+  if (rv == ERR_IO_PENDING) {
+    read_stream_ = stream;
+    user_read_callback_ = callback;
+  }
+  return rv;
+}
+
+int HttpPipelinedConnection::DoWrite(HttpPipelinedStream* stream,
+                                     IOBuffer* buf, int buf_len,
+                                     CompletionCallback* callback) {
+  int rv = connection_.socket()->Write(buf, buf_len, &write_callback_);
+  if (rv == ERR_IO_PENDING) {
+    write_stream_ = stream;
+    user_write_callback_ = callback;
+  }
+  return rv;
+}
+
+void HttpPipelinedConnection::OnReadComplete(int result) {
+  // The stream may be gone already.
+  CompletionCallback* callback = user_read_callback_;
+  read_stream_ = NULL;
+  user_read_callback_ = NULL;
+  if (callback)
+    callback->Run(result);
+}
+
+void HttpPipelinedConnection::OnWriteComplete(int result) {
+  CompletionCallback* callback = user_write_callback_;
+  write_stream_ = NULL;
+  user_write_callback_ = NULL;
+  if (!callback)
+    return;
+
+  // The next request may be waiting for this one.
+  PostPendingOperations();
+  callback->Run(result);
+}
+
+void HttpPipelinedConnection::PostPendingOperations() {
+  MessageLoop::current()->PostTask(FROM_HERE,
+      method_factory_.NewRunnableMethod(
+          &HttpPipelinedConnection::DoPendingOperations));
+}
+
+void HttpPipelinedConnection::DoPendingOperations() {
+  // Running a callback may delete streams, or this object.
+  scoped_refptr<HttpPipelinedConnection> self(this);
+  for (;;) {
+    int result;
+    CompletionCallback* callback = StartPendingOperation(&result);
+    if (!callback)
+      return;
+    callback->Run(result);
+  }
+}
+
+CompletionCallback* HttpPipelinedConnection::StartPendingOperation(
+    int* result) {
+  for (StreamList::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    if (!it->pending_callback)
+      continue;
+
+    bool can_start = broken_ ||
+                     (it->pending_read ? it == streams_.begin() : CanWrite(it));
+    if (!can_start)
+      continue;
+
+    CompletionCallback* callback = it->pending_callback;
+    scoped_refptr<IOBuffer> buf = it->pending_buf;
+    it->pending_callback = NULL;
+    it->pending_buf = NULL;
+
+    int rv;
+    if (broken_) {
+      rv = ERR_PIPELINE_EVICTED;
+    } else if (it->pending_read) {
+      rv = DoRead(it->stream, buf, it->pending_buf_len, callback);
+    } else {
+      rv = DoWrite(it->stream, buf, it->pending_buf_len, callback);
+    }
+
+    if (rv != ERR_IO_PENDING) {
+      *result = rv;
+      return callback;
+    }
+  }
+  return NULL;
+}
+
+void HttpPipelinedConnection::RemoveStream(StreamList::iterator it) {
+  if (it->stream && it->stream == read_stream_) {
+    read_stream_ = NULL;
+    user_read_callback_ = NULL;
+  }
+  if (it->stream && it->stream == write_stream_) {
+    write_stream_ = NULL;
+    user_write_callback_ = NULL;
+  }
+  streams_.erase(it);
+}
+
+void HttpPipelinedConnection::Break(bool server_error) {
+  DCHECK(!broken_);
+  broken_ = true;
+
+  // Blame the server only if it answered a request on this connection before,
+  // and there are requests waiting behind the one that failed.  Otherwise the
+  // server may have just closed an idle connection.
+  bool requests_evicted = false;
+  for (StreamList::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    if (it->stream && it->request_started)
+      requests_evicted = true;
+  }
+  if (manager_) {
+    manager_->OnPipelineClosed(
+        this, server_error && requests_evicted && responses_read_ > 0);
+    manager_ = NULL;
+  }
+
+  if (connection_.is_initialized()) {
+    connection_.socket()->Disconnect();
+    connection_.Reset();
+  }
+
+  // The operations in progress will not complete, so they fail together with
+  // the ones that are waiting.
+  for (StreamList::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+    if (!it->stream)
+      continue;
+    if (it->stream == read_stream_)
+      it->pending_callback = user_read_callback_;
+    if (it->stream == write_stream_)
+      it->pending_callback = user_write_callback_;
+  }
+  read_stream_ = NULL;
+  write_stream_ = NULL;
+  user_read_callback_ = NULL;
+  user_write_callback_ = NULL;
+  PostPendingOperations();
+}
+
+void HttpPipelinedConnection::ReleaseConnection() {
+  DCHECK(streams_.empty());
+  DCHECK(!closing_);
+  if (manager_) {
+    manager_->OnPipelineClosed(this, false);
+    manager_ = NULL;
+  }
+
+  if (!connection_.is_initialized())
+    return;
+
+  // Unexpected data means that we lost track of the responses.
+  if (!unread_data_.empty()) {
+    connection_.socket()->Disconnect();
+    unread_data_.clear();
+  }
+  connection_.Reset();
+}
+
+}  // namespace net
@@ -0,0 +1,164 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// HttpPipelinedConnection sends several requests over a single keep-alive
+// connection without waiting for the previous responses (HTTP/1.1
+// pipelining, RFC 2616 section 8.1.2.2).  Each request is handled by an
+// HttpPipelinedStream.  The requests are written in the order in which the
+// streams were created, and a stream can only read its response after all the
+// previous streams are done with theirs.
+//
+// The responses are parsed by the owner of each stream
+// (HttpNetworkTransaction), which has to report the end of the response,
+// together with any data that it read past the end, so that the data can be
+// given to the next stream.
+//
+// If a response cannot be read completely, the connection is closed and the
+// streams that are still waiting fail with ERR_PIPELINE_EVICTED, so that their
+// requests can be retried on a regular connection.
+
+#ifndef NET_HTTP_HTTP_PIPELINED_CONNECTION_H_
+#define NET_HTTP_HTTP_PIPELINED_CONNECTION_H_
+
+#include <deque>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/ref_counted.h"
+#include "base/task.h"
+#include "net/base/completion_callback.h"
+#include "net/socket/client_socket_handle.h"
+
+namespace net {
+
+class HttpPipelineManager;
+class HttpPipelinedStream;
+class IOBuffer;
+
+class HttpPipelinedConnection
+    : public base::RefCounted<HttpPipelinedConnection> {
+ public:
+  // The maximum number of requests that can be outstanding on a connection.
+  enum { kMaxDepth = 4 };
+
+  // Takes over the socket of |connection|, which must be initialized.
+  HttpPipelinedConnection(ClientSocketHandle* connection,
+                          ClientSocketPool* pool,
+                          HttpPipelineManager* manager);
+
+  // Returns a new stream for the next request, or NULL if this connection
+  // cannot take more requests.  The caller takes ownership of the stream.
+  HttpPipelinedStream* CreateStream();
+
+  // Returns true if another request can be sent on this connection.
+  bool CanAcceptRequests() const;
+
+  const std::string& group_name() const { return group_name_; }
+  int depth() const { return static_cast<int>(streams_.size()); }
+
+  // The following methods are used by HttpPipelinedStream.
+  int Write(HttpPipelinedStream* stream, IOBuffer* buf, int buf_len,
+            CompletionCallback* callback);
+  int Read(HttpPipelinedStream* stream, IOBuffer* buf, int buf_len,
+           CompletionCallback* callback);
+
+  // Called when |stream| is done reading its response.  |unread_data| points
+  // to |unread_len| bytes that were read past the end of the response.  If
+  // |keep_alive| is false, the connection cannot be used anymore.
+  void OnResponseDone(HttpPipelinedStream* stream, bool keep_alive,
+                      const char* unread_data, int unread_len);
+
+  // Called when the response of |stream| could not be read.  The connection
+  // is closed, and the server is blamed if other requests were waiting.
+  void OnResponseFailed(HttpPipelinedStream* stream);
+
+  // Called when |stream| is deleted.
+  void OnStreamDeleted(HttpPipelinedStream* stream);
+
+ private:
+  friend class base::RefCounted<HttpPipelinedConnection>;
+
+  // The state of each stream, in the order in which the requests are sent.
+  struct StreamInfo {
+    StreamInfo();
+    ~StreamInfo();
+
+    HttpPipelinedStream* stream;  // NULL if deleted before its response.
+    bool request_started;  // Some of the request was written.
+    bool request_sent;  // The stream started reading the response.
+
+    // An operation waiting for its turn.
+    scoped_refptr<IOBuffer> pending_buf;
+    int pending_buf_len;
+    CompletionCallback* pending_callback;
+    bool pending_read;
+  };
+  typedef std::deque<StreamInfo> StreamList;
+
+  ~HttpPipelinedConnection();
+
+  StreamList::iterator FindStream(HttpPipelinedStream* stream);
+
+  // Returns true if |it| can write its request now.
+  bool CanWrite(StreamList::iterator it);
+
+  int DoRead(HttpPipelinedStream* stream, IOBuffer* buf, int buf_len,
+             CompletionCallback* callback);
+  int DoWrite(HttpPipelinedStream* stream, IOBuffer* buf, int buf_len,
+              CompletionCallback* callback);
+  void OnReadComplete(int result);
+  void OnWriteComplete(int result);
+
+  // Starts the operations that were waiting for their turn.
+  void PostPendingOperations();
+  void DoPendingOperations();
+
+  // Starts the next operation that is ready to go.  Returns the callback to
+  // invoke with the value stored in |result|, or NULL if there is nothing left
+  // to do synchronously.
+  CompletionCallback* StartPendingOperation(int* result);
+
+  // Forgets about |stream|, which must be in |streams_|.
+  void RemoveStream(StreamList::iterator it);
+
+  // Closes the connection and evicts the remaining streams.  |server_error| is
+  // true if the server is to blame.
+  void Break(bool server_error);
+
+  // Returns the connection to the pool (or closes it) once there are no more
+  // streams.
+  void ReleaseConnection();
+
+  ClientSocketHandle connection_;
+  HttpPipelineManager* manager_;
+  std::string group_name_;
+  StreamList streams_;
+  bool broken_;
+
+  // Set when a stream is deleted before reading its response.  The previous
+  // responses can still be read, but the connection is closed after them.
+  bool closing_;
+
+  // The number of responses that were read completely.
+  int responses_read_;
+
+  // Data that was read from the socket but not by any stream yet.
+  std::string unread_data_;
+
+  CompletionCallbackImpl<HttpPipelinedConnection> read_callback_;
+  CompletionCallbackImpl<HttpPipelinedConnection> write_callback_;
+  CompletionCallback* user_read_callback_;
+  CompletionCallback* user_write_callback_;
+
+  // The streams that own the socket operations in progress.
+  HttpPipelinedStream* read_stream_;
+  HttpPipelinedStream* write_stream_;
+  ScopedRunnableMethodFactory<HttpPipelinedConnection> method_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpPipelinedConnection);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_PIPELINED_CONNECTION_H_
@@ -0,0 +1,227 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_pipelined_connection.h"
+
+#include <string>
+
+#include "base/message_loop.h"
+#include "base/scoped_ptr.h"
+#include "net/base/host_resolver.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_pipeline_manager.h"
+#include "net/http/http_pipelined_stream.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/socket_test_util.h"
+#include "net/socket/tcp_client_socket_pool.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const int kMaxSockets = 32;
+const int kMaxSocketsPerGroup = 6;
+const int kBufferSize = 32;
+
+class HttpPipelinedConnectionTest : public PlatformTest {
+ public:
+  HttpPipelinedConnectionTest()
+      : pool_(new TCPClientSocketPool(kMaxSockets, kMaxSocketsPerGroup,
+                                      new HostResolver, &socket_factory_)),
+        manager_(pool_) {
+  }
+
+  virtual void TearDown() {
+    // Empty the current queue.
+    MessageLoop::current()->RunAllPending();
+    PlatformTest::TearDown();
+  }
+
+ protected:
+  // Returns a new pipeline on a connection that uses |socket|.
+  HttpPipelinedConnection* CreatePipeline(MockSocket* socket) {
+    socket_factory_.AddMockSocket(socket);
+
+    ClientSocketHandle connection(pool_);
+    TestCompletionCallback callback;
+    HostResolver::RequestInfo info("www.google.com", 80);
+    int rv = connection.Init("a", info, 0, &callback);
+    if (rv == ERR_IO_PENDING)
+      rv = callback.WaitForResult();
+    EXPECT_EQ(OK, rv);
+    return manager_.CreatePipeline(&connection);
+  }
+
+  int WriteString(HttpPipelinedStream* stream, const std::string& data,
+                  CompletionCallback* callback) {
+    scoped_refptr<IOBuffer> buf = new IOBuffer(data.size());
+    memcpy(buf->data(), data.data(), data.size());
+    return stream->Write(buf, static_cast<int>(data.size()), callback);
+  }
+
+  MockClientSocketFactory socket_factory_;
+  scoped_refptr<TCPClientSocketPool> pool_;
+  HttpPipelineManager manager_;
+};
+
+}  // namespace
+
+TEST_F(HttpPipelinedConnectionTest, Ordering) {
+  MockWrite data_writes[] = {
+    MockWrite(false, "GET /a"),
+    MockWrite(false, "GET /b"),
+  };
+  MockRead data_reads[] = {
+    MockRead(false, "AAABB"),
+    MockRead(false, OK),
+  };
+  StaticMockSocket data(data_reads, data_writes);
+  HttpPipelinedConnection* pipeline = CreatePipeline(&data);
+  ASSERT_TRUE(pipeline);
+  EXPECT_EQ(pipeline, manager_.GetPipeline("a"));
+
+  scoped_ptr<HttpPipelinedStream> stream1(pipeline->CreateStream());
+  scoped_ptr<HttpPipelinedStream> stream2(pipeline->CreateStream());
+  EXPECT_EQ(2, pipeline->depth());
+
+  TestCompletionCallback callback1;
+  TestCompletionCallback callback2;
+  EXPECT_EQ(6, WriteString(stream1.get(), "GET /a", &callback1));
+
+  // The second request waits until the first one is sent.
+  EXPECT_EQ(ERR_IO_PENDING, WriteString(stream2.get(), "GET /b", &callback2));
+
+  scoped_refptr<IOBuffer> buf1 = new IOBuffer(kBufferSize);
+  EXPECT_EQ(5, stream1->Read(buf1, kBufferSize, &callback1));
+  EXPECT_EQ(6, callback2.WaitForResult());
+
+  // The second response waits until the first one is read.
+  scoped_refptr<IOBuffer> buf2 = new IOBuffer(kBufferSize);
+  EXPECT_EQ(ERR_IO_PENDING, stream2->Read(buf2, kBufferSize, &callback2));
+
+  // The first response is only "AAA".
+  stream1->OnResponseDone(true, buf1->data() + 3, 2);
+  EXPECT_EQ(2, callback2.WaitForResult());
+  EXPECT_EQ("BB", std::string(buf2->data(), 2));
+
+  stream2->OnResponseDone(true, NULL, 0);
+  EXPECT_TRUE(manager_.GetPipeline("a") == NULL);
+  EXPECT_FALSE(manager_.IsBlacklisted("a"));
+}
+
+TEST_F(HttpPipelinedConnectionTest, MaxDepth) {
+  StaticMockSocket data;
+  HttpPipelinedConnection* pipeline = CreatePipeline(&data);
+  ASSERT_TRUE(pipeline);
+
+  scoped_ptr<HttpPipelinedStream> streams[HttpPipelinedConnection::kMaxDepth];
+  for (int i = 0; i < HttpPipelinedConnection::kMaxDepth; ++i) {
+    EXPECT_TRUE(pipeline->CanAcceptRequests());
+    streams[i].reset(pipeline->CreateStream());
+    EXPECT_TRUE(streams[i].get());
+  }
+
+  EXPECT_FALSE(pipeline->CanAcceptRequests());
+  EXPECT_TRUE(pipeline->CreateStream() == NULL);
+  EXPECT_TRUE(manager_.GetPipeline("a") == NULL);
+
+  // A stream that did not send its request frees its slot.
+  streams[HttpPipelinedConnection::kMaxDepth - 1].reset();
+  EXPECT_EQ(pipeline, manager_.GetPipeline("a"));
+}
+
+// A server that answers the first request and then resets the connection
+// while other requests are waiting doesn't support pipelining.
+TEST_F(HttpPipelinedConnectionTest, EvictedRequests) {
+  MockRead data_reads[] = {
+    MockRead(false, "AAA"),
+    MockRead(false, ERR_CONNECTION_RESET),
+  };
+  StaticMockSocket data(data_reads, NULL);
+  HttpPipelinedConnection* pipeline = CreatePipeline(&data);
+  ASSERT_TRUE(pipeline);
+
+  scoped_ptr<HttpPipelinedStream> stream1(pipeline->CreateStream());
+  scoped_ptr<HttpPipelinedStream> stream2(pipeline->CreateStream());
+  scoped_ptr<HttpPipelinedStream> stream3(pipeline->CreateStream());
+
+  TestCompletionCallback callback1;
+  TestCompletionCallback callback2;
+  TestCompletionCallback callback3;
+  EXPECT_EQ(6, WriteString(stream1.get(), "GET /a", &callback1));
+  scoped_refptr<IOBuffer> buf = new IOBuffer(kBufferSize);
+  EXPECT_EQ(3, stream1->Read(buf, kBufferSize, &callback1));
+  EXPECT_EQ(6, WriteString(stream2.get(), "GET /b", &callback2));
+  EXPECT_EQ(ERR_IO_PENDING, WriteString(stream3.get(), "GET /c", &callback3));
+  stream1->OnResponseDone(true, NULL, 0);
+
+  EXPECT_EQ(ERR_CONNECTION_RESET, stream2->Read(buf, kBufferSize, &callback2));
+  stream2->OnResponseFailed();
+  EXPECT_EQ(ERR_PIPELINE_EVICTED, callback3.WaitForResult());
+
+  EXPECT_TRUE(manager_.GetPipeline("a") == NULL);
+  EXPECT_TRUE(manager_.IsBlacklisted("a"));
+}
+
+// The server may close a connection that was idle for a while.
+TEST_F(HttpPipelinedConnectionTest, IdleConnectionClosed) {
+  MockRead data_reads[] = {
+    MockRead(false, ERR_CONNECTION_RESET),
+  };
+  StaticMockSocket data(data_reads, NULL);
+  HttpPipelinedConnection* pipeline = CreatePipeline(&data);
+  ASSERT_TRUE(pipeline);
+
+  scoped_ptr<HttpPipelinedStream> stream(pipeline->CreateStream());
+  TestCompletionCallback callback;
+  EXPECT_EQ(6, WriteString(stream.get(), "GET /a", &callback));
+  scoped_refptr<IOBuffer> buf = new IOBuffer(kBufferSize);
+  EXPECT_EQ(ERR_CONNECTION_RESET, stream->Read(buf, kBufferSize, &callback));
+  stream->OnResponseFailed();
+
+  EXPECT_TRUE(manager_.GetPipeline("a") == NULL);
+  EXPECT_FALSE(manager_.IsBlacklisted("a"));
+}
+
+// A request that is canceled after it was sent prevents the next requests from
+// being read, but the previous ones are not affected.
+TEST_F(HttpPipelinedConnectionTest, CanceledRequest) {
+  MockRead data_reads[] = {
+    MockRead(false, "AAA"),
+    MockRead(false, OK),
+  };
+  StaticMockSocket data(data_reads, NULL);
+  HttpPipelinedConnection* pipeline = CreatePipeline(&data);
+  ASSERT_TRUE(pipeline);
+
+  scoped_ptr<HttpPipelinedStream> stream1(pipeline->CreateStream());
+  scoped_ptr<HttpPipelinedStream> stream2(pipeline->CreateStream());
+  scoped_ptr<HttpPipelinedStream> stream3(pipeline->CreateStream());
+
+  TestCompletionCallback callback1;
+  TestCompletionCallback callback2;
+  TestCompletionCallback callback3;
+  EXPECT_EQ(6, WriteString(stream1.get(), "GET /a", &callback1));
+  scoped_refptr<IOBuffer> buf = new IOBuffer(kBufferSize);
+  EXPECT_EQ(3, stream1->Read(buf, kBufferSize, &callback1));
+  EXPECT_EQ(6, WriteString(stream2.get(), "GET /b", &callback2));
+  EXPECT_EQ(ERR_IO_PENDING, stream2->Read(buf, kBufferSize, &callback2));
+  EXPECT_EQ(6, WriteString(stream3.get(), "GET /c", &callback3));
+
+  // Canceling the second request stops the pipeline, but not the first
+  // response.
+  stream2.reset();
+  EXPECT_FALSE(pipeline->CanAcceptRequests());
+  EXPECT_TRUE(manager_.GetPipeline("a") == NULL);
+
+  stream1->OnResponseDone(true, NULL, 0);
+  EXPECT_EQ(ERR_PIPELINE_EVICTED, stream3->Read(buf, kBufferSize, &callback3));
+  EXPECT_FALSE(manager_.IsBlacklisted("a"));
+}
+
+}  // namespace net
@@ -0,0 +1,59 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// HttpPipelinedStream is the HttpStream used by a request that shares a
+// connection with other requests.  See http_pipelined_connection.h.
+
+#ifndef NET_HTTP_HTTP_PIPELINED_STREAM_H_
+#define NET_HTTP_HTTP_PIPELINED_STREAM_H_
+
+#include "base/basictypes.h"
+#include "base/ref_counted.h"
+#include "net/http/http_pipelined_connection.h"
+#include "net/http/http_stream.h"
+
+namespace net {
+
+class HttpPipelinedStream : public HttpStream {
+ public:
+  explicit HttpPipelinedStream(HttpPipelinedConnection* pipeline)
+      : pipeline_(pipeline) {}
+  virtual ~HttpPipelinedStream() {
+    pipeline_->OnStreamDeleted(this);
+  }
+
+  // HttpStream methods:
+  virtual int Read(IOBuffer* buf,
+                   int buf_len,
+                   CompletionCallback* callback) {
+    return pipeline_->Read(this, buf, buf_len, callback);
+  }
+
+  virtual int Write(IOBuffer* buf,
+                    int buf_len,
+                    CompletionCallback* callback) {
+    return pipeline_->Write(this, buf, buf_len, callback);
+  }
+
+  // Called when the whole response was read.  See
+  // HttpPipelinedConnection::OnResponseDone.
+  void OnResponseDone(bool keep_alive, const char* unread_data,
+                      int unread_len) {
+    pipeline_->OnResponseDone(this, keep_alive, unread_data, unread_len);
+  }
+
+  // Called when the response could not be read.
+  void OnResponseFailed() {
+    pipeline_->OnResponseFailed(this);
+  }
+
+ private:
+  scoped_refptr<HttpPipelinedConnection> pipeline_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpPipelinedStream);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_PIPELINED_STREAM_H_
@@ -54,6 +54,10 @@
         'base/data_url.h',
         'base/directory_lister.cc',
         'base/directory_lister.h',
+        'base/dns_transaction.h',
+        'base/dns_transaction_posix.cc',
+        'base/dns_util.cc',
+        'base/dns_util.h',
         'base/effective_tld_names.cc',
         'base/effective_tld_names.dat',
         'base/escape.cc',
@@ -144,6 +148,8 @@
         'disk_cache/cache_util.h',
         'disk_cache/cache_util_posix.cc',
         'disk_cache/cache_util_win.cc',
+        'disk_cache/content_store.cc',
+        'disk_cache/content_store.h',
         'disk_cache/disk_cache.h',
         'disk_cache/disk_format.h',
         'disk_cache/entry_impl.cc',
@@ -151,6 +157,8 @@
         'disk_cache/errors.h',
         'disk_cache/eviction.cc',
         'disk_cache/eviction.h',
+        'disk_cache/eviction_policy.cc',
+        'disk_cache/eviction_policy.h',
         'disk_cache/file.h',
         'disk_cache/file_block.h',
         'disk_cache/file_lock.cc',
@@ -160,6 +168,8 @@
         'disk_cache/hash.cc',
         'disk_cache/hash.h',
         'disk_cache/histogram_macros.h',
+        'disk_cache/in_flight_backend_io.cc',
+        'disk_cache/in_flight_backend_io.h',
         'disk_cache/mapped_file.h',
         'disk_cache/mapped_file_posix.cc',
         'disk_cache/mapped_file_win.cc',
@@ -171,6 +181,8 @@
         'disk_cache/mem_rankings.h',
         'disk_cache/rankings.cc',
         'disk_cache/rankings.h',
+        'disk_cache/rankings_journal.cc',
+        'disk_cache/rankings_journal.h',
         'disk_cache/sparse_control.cc',
         'disk_cache/sparse_control.h',
         'disk_cache/stats.cc',
@@ -222,6 +234,11 @@
         'http/http_network_session.h',
         'http/http_network_transaction.cc',
         'http/http_network_transaction.h',
+        'http/http_pipeline_manager.cc',
+        'http/http_pipeline_manager.h',
+        'http/http_pipelined_connection.cc',
+        'http/http_pipelined_connection.h',
+        'http/http_pipelined_stream.h',
         'http/http_request_info.h',
         'http/http_response_headers.cc',
         'http/http_response_headers.h',
@@ -425,6 +442,9 @@
         'base/cookie_policy_unittest.cc',
         'base/data_url_unittest.cc',
         'base/directory_lister_unittest.cc',
+        'base/dns_transaction_posix_unittest.cc',
+        'base/dns_util_unittest.cc',
+        'base/dns_util_unittest.h',
         'base/escape_unittest.cc',
         'base/file_stream_unittest.cc',
         'base/filter_unittest.cc',
@@ -455,6 +475,7 @@
         'disk_cache/disk_cache_test_base.cc',
         'disk_cache/disk_cache_test_base.h',
         'disk_cache/entry_unittest.cc',
+        'disk_cache/eviction_policy_unittest.cc',
         'disk_cache/mapped_file_unittest.cc',
         'disk_cache/storage_block_unittest.cc',
         'ftp/ftp_auth_cache_unittest.cc',
@@ -469,6 +490,7 @@
         'http/http_chunked_decoder_unittest.cc',
         'http/http_network_layer_unittest.cc',
         'http/http_network_transaction_unittest.cc',
+        'http/http_pipelined_connection_unittest.cc',
         'http/http_response_headers_unittest.cc',
         'http/http_transaction_unittest.cc',
         'http/http_transaction_unittest.h',
@@ -543,6 +565,7 @@
       'msvs_guid': 'AAC78796-B9A2-4CD9-BF89-09B03E92BF73',
       'sources': [
         'base/cookie_monster_perftest.cc',
+        'base/filter_perftest.cc',
         'disk_cache/disk_cache_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
       ],
@@ -569,6 +592,18 @@
         'disk_cache/stress_cache.cc',
       ],
     },
+    {
+      'target_name': 'eviction_simulator',
+      'type': 'executable',
+      'dependencies': [
+        'net',
+        'net_test_support',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'disk_cache/eviction_simulator.cc',
+      ],
+    },
     {
       'target_name': 'tld_cleanup',
       'type': 'executable',
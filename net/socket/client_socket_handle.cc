@@ -61,6 +61,19 @@ void ClientSocketHandle::ResetInternal(bool cancel) {
   user_callback_ = NULL;
 }
 
+void ClientSocketHandle::TransferSocketTo(ClientSocketHandle* handle) {
+  DCHECK(is_initialized());
+  DCHECK(!handle->is_initialized());
+  DCHECK(pool_ == handle->pool_);
+  handle->ResetInternal(true);
+  handle->group_name_ = group_name_;
+  handle->is_reused_ = is_reused_;
+  handle->socket_.reset(release_socket());
+  group_name_.clear();
+  is_reused_ = false;
+  user_callback_ = NULL;
+}
+
 LoadState ClientSocketHandle::GetLoadState() const {
   CHECK(!is_initialized());
   CHECK(!group_name_.empty());
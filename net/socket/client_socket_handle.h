@@ -61,6 +61,12 @@ class ClientSocketHandle {
   // ClientSocket.
   void Reset();
 
+  // Moves the socket of this initialized handle to |handle|, which must use
+  // the same ClientSocketPool and must not be initialized.  This handle is left
+  // un-initialized, and |handle| becomes responsible for releasing the socket
+  // to the pool.
+  void TransferSocketTo(ClientSocketHandle* handle);
+
   // Used after Init() is called, but before the ClientSocketPool has
   // initialized the ClientSocketHandle.
   LoadState GetLoadState() const;
@@ -45,11 +45,18 @@ ConnectJob::ConnectJob(const std::string& group_name,
 ConnectJob::~ConnectJob() {}
 
 ClientSocketPoolBase::ClientSocketPoolBase(
+    int max_sockets,
     int max_sockets_per_group,
     ConnectJobFactory* connect_job_factory)
     : idle_socket_count_(0),
+      handed_out_socket_count_(0),
+      max_sockets_(max_sockets),
       max_sockets_per_group_(max_sockets_per_group),
-      connect_job_factory_(connect_job_factory) {}
+      next_request_sequence_(0),
+      connect_job_factory_(connect_job_factory) {
+  DCHECK_LE(0, max_sockets_per_group);
+  DCHECK_LE(max_sockets_per_group, max_sockets);
+}
 
 ClientSocketPoolBase::~ClientSocketPoolBase() {
   // Clean up any idle sockets.  Assert that we have no remaining active
@@ -83,11 +90,12 @@ int ClientSocketPoolBase::RequestSocket(
   DCHECK_GE(priority, 0);
   DCHECK(callback);
   Group& group = group_map_[group_name];
+  int64 sequence = next_request_sequence_++;
 
   // Can we make another active socket now?
   if (!group.HasAvailableSocketSlot(max_sockets_per_group_)) {
     CHECK(callback);
-    Request r(handle, callback, priority, resolve_info);
+    Request r(handle, callback, priority, resolve_info, sequence);
     InsertRequestIntoQueue(r, &group.pending_requests);
     return ERR_IO_PENDING;
   }
@@ -105,9 +113,20 @@ int ClientSocketPoolBase::RequestSocket(
   }
 
   // We couldn't find a socket to reuse, so allocate and connect a new one.
+  // The idle sockets left belong to other groups.  If we're at the total
+  // limit, give up one of them rather than waiting.
+  if (ReachedMaxSocketsLimit()) {
+    if (idle_socket_count_ == 0) {
+      CHECK(callback);
+      Request r(handle, callback, priority, resolve_info, sequence);
+      InsertRequestIntoQueue(r, &group.pending_requests);
+      return ERR_IO_PENDING;
+    }
+    CloseOneIdleSocket();
+  }
 
   CHECK(callback);
-  Request r(handle, callback, priority, resolve_info);
+  Request r(handle, callback, priority, resolve_info, sequence);
   scoped_ptr<ConnectJob> connect_job(
       connect_job_factory_->NewConnectJob(group_name, r, this));
 
@@ -138,6 +157,10 @@ void ClientSocketPoolBase::CancelRequest(const std::string& group_name,
   for (; it != group.pending_requests.end(); ++it) {
     if (it->handle == handle) {
       group.pending_requests.erase(it);
+      // A request that was only waiting for the total limit may have been the
+      // last thing left in its group.
+      if (group.IsEmpty())
+        group_map_.erase(group_name);
       return;
     }
   }
@@ -243,7 +266,6 @@ void ClientSocketPoolBase::CleanupIdleSockets(bool force) {
 
     // Delete group if no longer needed.
     if (group.IsEmpty()) {
-      CHECK(group.pending_requests.empty());
       group_map_.erase(i++);
     } else {
       ++i;
@@ -262,6 +284,38 @@ void ClientSocketPoolBase::DecrementIdleCount() {
     timer_.Stop();
 }
 
+bool ClientSocketPoolBase::ReachedMaxSocketsLimit() const {
+  int total = handed_out_socket_count_ + idle_socket_count_ +
+      static_cast<int>(connect_job_map_.size());
+  DCHECK_LE(total, max_sockets_);
+  return total >= max_sockets_;
+}
+
+void ClientSocketPoolBase::CloseOneIdleSocket() {
+  CHECK(idle_socket_count_ > 0);
+
+  // The oldest idle socket of each group is at the front of its list.
+  GroupMap::iterator oldest = group_map_.end();
+  for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end(); ++i) {
+    const std::deque<IdleSocket>& idle_sockets = i->second.idle_sockets;
+    if (idle_sockets.empty())
+      continue;
+    if (oldest == group_map_.end() ||
+        idle_sockets.front().start_time <
+            oldest->second.idle_sockets.front().start_time) {
+      oldest = i;
+    }
+  }
+  CHECK(oldest != group_map_.end());
+
+  Group& group = oldest->second;
+  delete group.idle_sockets.front().socket;
+  group.idle_sockets.pop_front();
+  DecrementIdleCount();
+  if (group.IsEmpty())
+    group_map_.erase(oldest);
+}
+
 void ClientSocketPoolBase::DoReleaseSocket(const std::string& group_name,
                                            ClientSocket* socket) {
   GroupMap::iterator i = group_map_.find(group_name);
@@ -271,6 +325,7 @@ void ClientSocketPoolBase::DoReleaseSocket(const std::string& group_name,
 
   CHECK(group.active_socket_count > 0);
   group.active_socket_count--;
+  handed_out_socket_count_--;
 
   const bool can_reuse = socket->IsConnectedAndIdle();
   if (can_reuse) {
@@ -330,22 +385,59 @@ void ClientSocketPoolBase::MaybeOnAvailableSocketSlot(
     const std::string& group_name) {
   GroupMap::iterator it = group_map_.find(group_name);
   if (it != group_map_.end()) {
-    Group& group = it->second;
-    if (group.HasAvailableSocketSlot(max_sockets_per_group_))
-      OnAvailableSocketSlot(group_name, &group);
+    OnAvailableSocketSlot(group_name, &it->second);
+  } else {
+    // The group is gone, but the slot may be used by another group.
+    ProcessPendingRequests();
   }
 }
 
 void ClientSocketPoolBase::OnAvailableSocketSlot(const std::string& group_name,
                                                  Group* group) {
-  if (!group->pending_requests.empty()) {
-    ProcessPendingRequest(group_name, group);
-    // |group| may no longer be valid after this point.  Be careful not to
-    // access it again.
-  } else if (group->IsEmpty()) {
+  if (group->IsEmpty()) {
     // Delete |group| if no longer needed.  |group| will no longer be valid.
     group_map_.erase(group_name);
   }
+
+  // The request that gets the slot is not necessarily from |group|.
+  ProcessPendingRequests();
+}
+
+void ClientSocketPoolBase::ProcessPendingRequests() {
+  for (;;) {
+    // A new socket would go over the total limit, and there is no idle socket
+    // to close in its place.
+    if (ReachedMaxSocketsLimit() && idle_socket_count_ == 0)
+      return;
+
+    GroupMap::iterator top = group_map_.end();
+    for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end();
+         ++i) {
+      const Group& group = i->second;
+      if (group.pending_requests.empty() ||
+          !group.HasAvailableSocketSlot(max_sockets_per_group_))
+        continue;
+      if (top == group_map_.end()) {
+        top = i;
+        continue;
+      }
+
+      // Ties go to the oldest request, not to the first group in the map.
+      const Request& request = group.pending_requests.front();
+      const Request& top_request = top->second.pending_requests.front();
+      if (request.priority > top_request.priority ||
+          (request.priority == top_request.priority &&
+           request.sequence < top_request.sequence)) {
+        top = i;
+      }
+    }
+    if (top == group_map_.end())
+      return;
+
+    // The group may be deleted while its request is processed.
+    const std::string group_name = top->first;
+    ProcessPendingRequest(group_name, &top->second);
+  }
 }
 
 void ClientSocketPoolBase::ProcessPendingRequest(const std::string& group_name,
@@ -375,6 +467,7 @@ void ClientSocketPoolBase::HandOutSocket(
   handle->set_socket(socket);
   handle->set_is_reused(reused);
   group->active_socket_count++;
+  handed_out_socket_count_++;
 }
 
 }  // namespace net
@@ -82,7 +82,12 @@ class ConnectJob {
 };
 
 // A ClientSocketPoolBase is used to restrict the number of sockets open at
-// a time.  It also maintains a list of idle persistent sockets.
+// a time, both per group and in total.  It also maintains a list of idle
+// persistent sockets.
+//
+// Requests that have to wait for a socket are served in priority order.  A
+// request that is only blocked by the total limit can take the place of an
+// idle socket of another group, which is closed.
 //
 class ClientSocketPoolBase
     : public base::RefCounted<ClientSocketPoolBase>,
@@ -96,20 +101,23 @@ class ClientSocketPoolBase
         : handle(NULL),
           callback(NULL),
           priority(0),
-          resolve_info(std::string(), 0) {}
+          resolve_info(std::string(), 0),
+          sequence(0) {}
 
     Request(ClientSocketHandle* handle,
             CompletionCallback* callback,
             int priority,
-            const HostResolver::RequestInfo& resolve_info)
+            const HostResolver::RequestInfo& resolve_info,
+            int64 sequence)
         : handle(handle), callback(callback), priority(priority),
-          resolve_info(resolve_info) {
+          resolve_info(resolve_info), sequence(sequence) {
     }
 
     ClientSocketHandle* handle;
     CompletionCallback* callback;
     int priority;
     HostResolver::RequestInfo resolve_info;
+    int64 sequence;  // Older requests have lower numbers.
   };
 
   class ConnectJobFactory {
@@ -126,7 +134,8 @@ class ClientSocketPoolBase
     DISALLOW_COPY_AND_ASSIGN(ConnectJobFactory);
   };
 
-  ClientSocketPoolBase(int max_sockets_per_group,
+  ClientSocketPoolBase(int max_sockets,
+                       int max_sockets_per_group,
                        ConnectJobFactory* connect_job_factory);
 
   ~ClientSocketPoolBase();
@@ -182,7 +191,7 @@ class ClientSocketPoolBase
 
     bool IsEmpty() const {
       return active_socket_count == 0 && idle_sockets.empty() &&
-          connecting_requests.empty();
+          connecting_requests.empty() && pending_requests.empty();
     }
 
     bool HasAvailableSocketSlot(int max_sockets_per_group) const {
@@ -212,6 +221,14 @@ class ClientSocketPoolBase
   void IncrementIdleCount();
   void DecrementIdleCount();
 
+  // Returns true if no new socket can be opened without going over
+  // |max_sockets_|.  Idle sockets count against the limit.
+  bool ReachedMaxSocketsLimit() const;
+
+  // Closes the idle socket that has been idle the longest, in any group.
+  // There must be at least one idle socket.
+  void CloseOneIdleSocket();
+
   // Called via PostTask by ReleaseSocket.
   void DoReleaseSocket(const std::string& group_name, ClientSocket* socket);
 
@@ -229,9 +246,14 @@ class ClientSocketPoolBase
   // it's there.
   void MaybeOnAvailableSocketSlot(const std::string& group_name);
 
-  // Might delete the Group from |group_map_|.
+  // Called when a socket slot of |group| was freed, which is also a slot under
+  // the total limit.  Might delete the Group from |group_map_|.
   void OnAvailableSocketSlot(const std::string& group_name, Group* group);
 
+  // Processes pending requests, highest priority first, as long as their
+  // groups have a socket slot available and the total limit allows it.
+  void ProcessPendingRequests();
+
   // Process a request from a group's pending_requests queue.
   void ProcessPendingRequest(const std::string& group_name, Group* group);
 
@@ -252,9 +274,20 @@ class ClientSocketPoolBase
   // The total number of idle sockets in the system.
   int idle_socket_count_;
 
+  // The total number of sockets handed out to clients.
+  int handed_out_socket_count_;
+
+  // The maximum number of sockets kept in total, which includes idle and
+  // connecting sockets.
+  const int max_sockets_;
+
   // The maximum number of sockets kept per group.
   const int max_sockets_per_group_;
 
+  // The sequence number of the next request, used to serve requests of equal
+  // priority from different groups in the order in which they were made.
+  int64 next_request_sequence_;
+
   const scoped_ptr<ConnectJobFactory> connect_job_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(ClientSocketPoolBase);
@@ -18,6 +18,8 @@ namespace net {
 
 namespace {
 
+const int kMaxSockets = 4;
+
 const int kMaxSocketsPerGroup = 2;
 
 // Note that the first and the last are the same, the first should be handled
@@ -227,10 +229,11 @@ class TestConnectJobFactory : public ClientSocketPoolBase::ConnectJobFactory {
 class TestClientSocketPool : public ClientSocketPool {
  public:
   TestClientSocketPool(
+      int max_sockets,
       int max_sockets_per_group,
       ClientSocketPoolBase::ConnectJobFactory* connect_job_factory)
       : base_(new ClientSocketPoolBase(
-          kMaxSocketsPerGroup, connect_job_factory)) {}
+          max_sockets, max_sockets_per_group, connect_job_factory)) {}
 
   virtual int RequestSocket(
       const std::string& group_name,
@@ -281,7 +284,8 @@ class ClientSocketPoolBaseTest : public testing::Test {
       : ignored_request_info_("ignored", 80),
         connect_job_factory_(
           new TestConnectJobFactory(&client_socket_factory_)),
-        pool_(new TestClientSocketPool(kMaxSocketsPerGroup,
+        pool_(new TestClientSocketPool(kMaxSockets,
+                                       kMaxSocketsPerGroup,
                                        connect_job_factory_)) {}
 
   virtual void SetUp() {
@@ -315,6 +319,16 @@ class ClientSocketPoolBaseTest : public testing::Test {
     }
   }
 
+  // Uses up all the sockets allowed by the pool with the groups "a" and "b".
+  void FillPool(scoped_ptr<TestSocketRequest>* reqs) {
+    for (int i = 0; i < kMaxSockets; ++i) {
+      reqs[i].reset(new TestSocketRequest(pool_.get(), &request_order_));
+      std::string group_name(i < kMaxSocketsPerGroup ? "a" : "b");
+      EXPECT_EQ(OK, reqs[i]->handle.Init(group_name, ignored_request_info_,
+                                         kDefaultPriority, reqs[i].get()));
+    }
+  }
+
   enum KeepAlive {
     KEEP_ALIVE,
     NO_KEEP_ALIVE,
@@ -650,6 +664,136 @@ TEST_F(ClientSocketPoolBaseTest, PendingJobCompletionOrder) {
   EXPECT_EQ(&req3, request_order_[1]);
 }
 
+TEST_F(ClientSocketPoolBaseTest, TotalLimit) {
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + 1];
+  FillPool(reqs);
+  EXPECT_EQ(kMaxSockets, client_socket_factory_.allocation_count());
+
+  // Group "c" has a free slot, but the pool doesn't.
+  reqs[kMaxSockets].reset(new TestSocketRequest(pool_.get(), &request_order_));
+  EXPECT_EQ(ERR_IO_PENDING,
+            reqs[kMaxSockets]->handle.Init("c", ignored_request_info_,
+                                           kDefaultPriority,
+                                           reqs[kMaxSockets].get()));
+  EXPECT_EQ(kMaxSockets, client_socket_factory_.allocation_count());
+
+  // Closing a socket of another group lets the request connect.
+  reqs[0]->handle.socket()->Disconnect();
+  reqs[0]->handle.Reset();
+  EXPECT_EQ(OK, reqs[kMaxSockets]->WaitForResult());
+  EXPECT_EQ(kMaxSockets + 1, client_socket_factory_.allocation_count());
+}
+
+TEST_F(ClientSocketPoolBaseTest, TotalLimitRespectsPriority) {
+  const char* const kGroups[] = { "c", "d", "e" };
+  const int kGroupPriorities[] = { 1, 3, 2 };
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + arraysize(kGroups)];
+  FillPool(reqs);
+
+  for (size_t i = 0; i < arraysize(kGroups); ++i) {
+    scoped_ptr<TestSocketRequest>& req = reqs[kMaxSockets + i];
+    req.reset(new TestSocketRequest(pool_.get(), &request_order_));
+    EXPECT_EQ(ERR_IO_PENDING,
+              req->handle.Init(kGroups[i], ignored_request_info_,
+                               kGroupPriorities[i], req.get()));
+  }
+
+  // Each released socket goes to the pending request with the highest
+  // priority, whatever its group.
+  for (int i = 0; i < kMaxSockets; ++i) {
+    reqs[i]->handle.socket()->Disconnect();
+    reqs[i]->handle.Reset();
+    MessageLoop::current()->RunAllPending();
+  }
+
+  ASSERT_EQ(3U, request_order_.size());
+  EXPECT_EQ(reqs[kMaxSockets + 1].get(), request_order_[0]);
+  EXPECT_EQ(reqs[kMaxSockets + 2].get(), request_order_[1]);
+  EXPECT_EQ(reqs[kMaxSockets].get(), request_order_[2]);
+}
+
+TEST_F(ClientSocketPoolBaseTest, TotalLimitBreaksTiesByAge) {
+  // The groups are listed in the opposite order of the group map.
+  const char* const kGroups[] = { "e", "d", "c" };
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + arraysize(kGroups)];
+  FillPool(reqs);
+
+  for (size_t i = 0; i < arraysize(kGroups); ++i) {
+    scoped_ptr<TestSocketRequest>& req = reqs[kMaxSockets + i];
+    req.reset(new TestSocketRequest(pool_.get(), &request_order_));
+    EXPECT_EQ(ERR_IO_PENDING,
+              req->handle.Init(kGroups[i], ignored_request_info_,
+                               kDefaultPriority, req.get()));
+  }
+
+  // Requests of equal priority get the released sockets in the order in
+  // which they were made.
+  for (int i = 0; i < kMaxSockets; ++i) {
+    reqs[i]->handle.socket()->Disconnect();
+    reqs[i]->handle.Reset();
+    MessageLoop::current()->RunAllPending();
+  }
+
+  ASSERT_EQ(3U, request_order_.size());
+  EXPECT_EQ(reqs[kMaxSockets].get(), request_order_[0]);
+  EXPECT_EQ(reqs[kMaxSockets + 1].get(), request_order_[1]);
+  EXPECT_EQ(reqs[kMaxSockets + 2].get(), request_order_[2]);
+}
+
+TEST_F(ClientSocketPoolBaseTest, CloseIdleSocketInOtherGroup) {
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + 1];
+  FillPool(reqs);
+
+  // Release the sockets of group "a" so that they are kept idle.
+  for (int i = 0; i < kMaxSocketsPerGroup; ++i)
+    reqs[i]->handle.Reset();
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(kMaxSocketsPerGroup, pool_->IdleSocketCount());
+
+  // A new group gets a socket right away by closing one of the idle ones.
+  reqs[kMaxSockets].reset(new TestSocketRequest(pool_.get(), &request_order_));
+  EXPECT_EQ(OK, reqs[kMaxSockets]->handle.Init("c", ignored_request_info_,
+                                               kDefaultPriority,
+                                               reqs[kMaxSockets].get()));
+  EXPECT_EQ(kMaxSocketsPerGroup - 1, pool_->IdleSocketCount());
+  EXPECT_EQ(kMaxSockets + 1, client_socket_factory_.allocation_count());
+}
+
+TEST_F(ClientSocketPoolBaseTest, StalledRequestTakesIdleSocketSlot) {
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + 1];
+  FillPool(reqs);
+
+  reqs[kMaxSockets].reset(new TestSocketRequest(pool_.get(), &request_order_));
+  EXPECT_EQ(ERR_IO_PENDING,
+            reqs[kMaxSockets]->handle.Init("c", ignored_request_info_,
+                                           kDefaultPriority,
+                                           reqs[kMaxSockets].get()));
+
+  // A socket that is released with keep-alive is closed to make room for the
+  // stalled request.
+  reqs[0]->handle.Reset();
+  EXPECT_EQ(OK, reqs[kMaxSockets]->WaitForResult());
+  EXPECT_EQ(0, pool_->IdleSocketCount());
+}
+
+TEST_F(ClientSocketPoolBaseTest, CancelStalledRequest) {
+  scoped_ptr<TestSocketRequest> reqs[kMaxSockets + 1];
+  FillPool(reqs);
+
+  reqs[kMaxSockets].reset(new TestSocketRequest(pool_.get(), &request_order_));
+  EXPECT_EQ(ERR_IO_PENDING,
+            reqs[kMaxSockets]->handle.Init("c", ignored_request_info_,
+                                           kDefaultPriority,
+                                           reqs[kMaxSockets].get()));
+  reqs[kMaxSockets]->handle.Reset();
+
+  reqs[0]->handle.socket()->Disconnect();
+  reqs[0]->handle.Reset();
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, TestSocketRequest::completion_count);
+  EXPECT_EQ(kMaxSockets, client_socket_factory_.allocation_count());
+}
+
 }  // namespace
 
 }  // namespace net
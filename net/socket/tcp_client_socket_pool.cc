@@ -4,7 +4,14 @@
 
 #include "net/socket/tcp_client_socket_pool.h"
 
+#if defined(OS_WIN)
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+
 #include "base/compiler_specific.h"
+#include "base/histogram.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/time.h"
@@ -18,6 +25,25 @@ using base::TimeDelta;
 
 namespace net {
 
+namespace {
+
+// Records whether the backup connect won the race against the first one.
+void RecordBackupConnectResult(bool backup_won) {
+  static BooleanHistogram counter("Net.TCP_Backup_Connect_Won");
+  counter.SetFlags(kUmaTargetedHistogramFlag);
+  counter.AddBoolean(backup_won);
+}
+
+}  // namespace
+
+// A lost SYN is only retransmitted after about 3 seconds.  Most connects
+// complete well within the default delay, so a slower one has likely lost it.
+const int TCPConnectJob::kDefaultBackupConnectDelayMs = 250;
+
+// static
+int TCPConnectJob::backup_connect_delay_ms_ =
+    TCPConnectJob::kDefaultBackupConnectDelayMs;
+
 TCPConnectJob::TCPConnectJob(
     const std::string& group_name,
     const HostResolver::RequestInfo& resolve_info,
@@ -31,7 +57,10 @@ TCPConnectJob::TCPConnectJob(
       ALLOW_THIS_IN_INITIALIZER_LIST(
           callback_(this,
                     &TCPConnectJob::OnIOComplete)),
-      resolver_(host_resolver) {}
+      resolver_(host_resolver),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          backup_callback_(this,
+                           &TCPConnectJob::OnBackupConnectComplete)) {}
 
 TCPConnectJob::~TCPConnectJob() {
   // We don't worry about cancelling the host resolution and TCP connect, since
@@ -43,6 +72,12 @@ int TCPConnectJob::Connect() {
   return DoLoop(OK);
 }
 
+// static
+void TCPConnectJob::set_backup_connect_delay_ms(int delay_ms) {
+  DCHECK_LE(0, delay_ms);
+  backup_connect_delay_ms_ = delay_ms;
+}
+
 void TCPConnectJob::OnIOComplete(int result) {
   int rv = DoLoop(result);
   if (rv != ERR_IO_PENDING)
@@ -99,11 +134,28 @@ int TCPConnectJob::DoTCPConnect() {
   set_load_state(LOAD_STATE_CONNECTING);
   set_socket(client_socket_factory_->CreateTCPClientSocket(addresses_));
   connect_start_time_ = base::TimeTicks::Now();
-  return socket()->Connect(&callback_);
+  int rv = socket()->Connect(&callback_);
+  if (rv == ERR_IO_PENDING && backup_connect_delay_ms_ > 0) {
+    backup_connect_timer_.Start(
+        TimeDelta::FromMilliseconds(backup_connect_delay_ms_), this,
+        &TCPConnectJob::OnBackupConnectTimer);
+  }
+  return rv;
 }
 
 int TCPConnectJob::DoTCPConnectComplete(int result) {
   DCHECK_EQ(load_state(), LOAD_STATE_CONNECTING);
+  backup_connect_timer_.Stop();
+  if (backup_socket_.get()) {
+    if (result != OK) {
+      // Wait for the backup connect, which may still succeed.
+      set_socket(NULL);
+      return ERR_IO_PENDING;
+    }
+    RecordBackupConnectResult(false);
+    backup_socket_.reset();
+  }
+
   if (result == OK) {
     DCHECK(connect_start_time_ != base::TimeTicks());
     base::TimeDelta connect_duration =
@@ -122,6 +174,47 @@ int TCPConnectJob::DoTCPConnectComplete(int result) {
   return result;
 }
 
+void TCPConnectJob::OnBackupConnectTimer() {
+  DCHECK_EQ(kStateTCPConnectComplete, next_state_);
+  DCHECK(socket());
+
+  // Prefer the next address, in case the first one is unreachable.
+  AddressList backup_addresses;
+  if (addresses_.head()->ai_next)
+    backup_addresses.Copy(addresses_.head()->ai_next);
+  else
+    backup_addresses = addresses_;
+
+  backup_socket_.reset(
+      client_socket_factory_->CreateTCPClientSocket(backup_addresses));
+  int rv = backup_socket_->Connect(&backup_callback_);
+  if (rv != ERR_IO_PENDING)
+    OnBackupConnectComplete(rv);
+}
+
+void TCPConnectJob::OnBackupConnectComplete(int result) {
+  DCHECK(backup_socket_.get());
+  if (result == OK) {
+    RecordBackupConnectResult(true);
+    UMA_HISTOGRAM_CLIPPED_TIMES("Net.TCP_Connection_Latency",
+        base::TimeTicks::Now() - connect_start_time_,
+        base::TimeDelta::FromMilliseconds(1),
+        base::TimeDelta::FromMinutes(10),
+        100);
+
+    // Deleting the first socket cancels its connect.
+    set_socket(backup_socket_.release());
+  } else {
+    backup_socket_.reset();
+    // The first connect is still pending, and may still succeed.
+    if (socket())
+      return;
+  }
+
+  next_state_ = kStateNone;
+  delegate()->OnConnectJobComplete(result, this);  // Deletes |this|
+}
+
 ConnectJob* TCPClientSocketPool::TCPConnectJobFactory::NewConnectJob(
     const std::string& group_name,
     const ClientSocketPoolBase::Request& request,
@@ -132,11 +225,12 @@ ConnectJob* TCPClientSocketPool::TCPConnectJobFactory::NewConnectJob(
 }
 
 TCPClientSocketPool::TCPClientSocketPool(
+    int max_sockets,
     int max_sockets_per_group,
     HostResolver* host_resolver,
     ClientSocketFactory* client_socket_factory)
     : base_(new ClientSocketPoolBase(
-        max_sockets_per_group,
+        max_sockets, max_sockets_per_group,
         new TCPConnectJobFactory(client_socket_factory, host_resolver))) {}
 
 TCPClientSocketPool::~TCPClientSocketPool() {}
@@ -10,6 +10,7 @@
 #include "base/basictypes.h"
 #include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
+#include "base/timer.h"
 #include "net/socket/client_socket_pool_base.h"
 #include "net/socket/client_socket_pool.h"
 
@@ -18,9 +19,14 @@ namespace net {
 class ClientSocketFactory;
 
 // TCPConnectJob handles the host resolution necessary for socket creation
-// and the tcp connect.
+// and the tcp connect.  If the connect takes longer than the backup connect
+// delay, which happens when a SYN is lost, a second connect is started on the
+// next address (or the same one if there is no other) and the first socket to
+// connect wins.
 class TCPConnectJob : public ConnectJob {
  public:
+  static const int kDefaultBackupConnectDelayMs;
+
   TCPConnectJob(const std::string& group_name,
                 const HostResolver::RequestInfo& resolve_info,
                 const ClientSocketHandle* handle,
@@ -36,6 +42,10 @@ class TCPConnectJob : public ConnectJob {
   // Otherwise, it returns a net error code.
   virtual int Connect();
 
+  // Sets the time to wait for a connect before starting a backup one.  Zero
+  // disables backup connects.
+  static void set_backup_connect_delay_ms(int delay_ms);
+
  private:
   enum State {
     kStateResolveHost,
@@ -55,6 +65,11 @@ class TCPConnectJob : public ConnectJob {
   int DoTCPConnect();
   int DoTCPConnectComplete(int result);
 
+  // Starts the backup connect, once the first one has been pending for the
+  // backup connect delay.
+  void OnBackupConnectTimer();
+  void OnBackupConnectComplete(int result);
+
   const HostResolver::RequestInfo resolve_info_;
   ClientSocketFactory* const client_socket_factory_;
   CompletionCallbackImpl<TCPConnectJob> callback_;
@@ -65,12 +80,19 @@ class TCPConnectJob : public ConnectJob {
   // The time the Connect() method was called (if it got called).
   base::TimeTicks connect_start_time_;
 
+  base::OneShotTimer<TCPConnectJob> backup_connect_timer_;
+  CompletionCallbackImpl<TCPConnectJob> backup_callback_;
+  scoped_ptr<ClientSocket> backup_socket_;
+
+  static int backup_connect_delay_ms_;
+
   DISALLOW_COPY_AND_ASSIGN(TCPConnectJob);
 };
 
 class TCPClientSocketPool : public ClientSocketPool {
  public:
-  TCPClientSocketPool(int max_sockets_per_group,
+  TCPClientSocketPool(int max_sockets,
+                      int max_sockets_per_group,
                       HostResolver* host_resolver,
                       ClientSocketFactory* client_socket_factory);
 
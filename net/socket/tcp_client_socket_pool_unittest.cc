@@ -18,6 +18,7 @@ namespace net {
 
 namespace {
 
+const int kMaxSockets = 32;
 const int kMaxSocketsPerGroup = 6;
 
 // Note that the first and the last are the same, the first should be handled
@@ -145,6 +146,37 @@ class MockPendingClientSocket : public ClientSocket {
   bool is_connected_;
 };
 
+// A socket whose connect never completes, as if its SYN was lost.
+class MockStalledClientSocket : public ClientSocket {
+ public:
+  MockStalledClientSocket() {}
+
+  // ClientSocket methods:
+  virtual int Connect(CompletionCallback* callback) {
+    return ERR_IO_PENDING;
+  }
+
+  virtual void Disconnect() {}
+
+  virtual bool IsConnected() const {
+    return false;
+  }
+  virtual bool IsConnectedAndIdle() const {
+    return false;
+  }
+
+  // Socket methods:
+  virtual int Read(IOBuffer* buf, int buf_len,
+                   CompletionCallback* callback) {
+    return ERR_FAILED;
+  }
+
+  virtual int Write(IOBuffer* buf, int buf_len,
+                    CompletionCallback* callback) {
+    return ERR_FAILED;
+  }
+};
+
 class MockClientSocketFactory : public ClientSocketFactory {
  public:
   enum ClientSocketType {
@@ -152,14 +184,22 @@ class MockClientSocketFactory : public ClientSocketFactory {
     MOCK_FAILING_CLIENT_SOCKET,
     MOCK_PENDING_CLIENT_SOCKET,
     MOCK_PENDING_FAILING_CLIENT_SOCKET,
+    MOCK_STALLED_CLIENT_SOCKET,
   };
 
   MockClientSocketFactory()
-      : allocation_count_(0), client_socket_type_(MOCK_CLIENT_SOCKET) {}
+      : allocation_count_(0), client_socket_type_(MOCK_CLIENT_SOCKET),
+        client_socket_types_(NULL), client_socket_index_(0),
+        client_socket_index_max_(0) {}
 
   virtual ClientSocket* CreateTCPClientSocket(const AddressList& addresses) {
     allocation_count_++;
-    switch (client_socket_type_) {
+
+    ClientSocketType type = client_socket_type_;
+    if (client_socket_index_ < client_socket_index_max_)
+      type = client_socket_types_[client_socket_index_++];
+
+    switch (type) {
       case MOCK_CLIENT_SOCKET:
         return new MockClientSocket();
       case MOCK_FAILING_CLIENT_SOCKET:
@@ -168,6 +208,8 @@ class MockClientSocketFactory : public ClientSocketFactory {
         return new MockPendingClientSocket(true);
       case MOCK_PENDING_FAILING_CLIENT_SOCKET:
         return new MockPendingClientSocket(false);
+      case MOCK_STALLED_CLIENT_SOCKET:
+        return new MockStalledClientSocket();
       default:
         NOTREACHED();
         return new MockClientSocket();
@@ -188,9 +230,20 @@ class MockClientSocketFactory : public ClientSocketFactory {
     client_socket_type_ = type;
   }
 
+  // Makes the next |num_types| sockets use |type_list| in order, before
+  // falling back to the type given to set_client_socket_type().
+  void set_client_socket_types(ClientSocketType* type_list, int num_types) {
+    client_socket_types_ = type_list;
+    client_socket_index_ = 0;
+    client_socket_index_max_ = num_types;
+  }
+
  private:
   int allocation_count_;
   ClientSocketType client_socket_type_;
+  ClientSocketType* client_socket_types_;
+  int client_socket_index_;
+  int client_socket_index_max_;
 };
 
 class TestSocketRequest : public CallbackRunner< Tuple1<int> > {
@@ -224,7 +277,8 @@ int TestSocketRequest::completion_count = 0;
 class TCPClientSocketPoolTest : public testing::Test {
  protected:
   TCPClientSocketPoolTest()
-      : pool_(new TCPClientSocketPool(kMaxSocketsPerGroup,
+      : pool_(new TCPClientSocketPool(kMaxSockets,
+                                      kMaxSocketsPerGroup,
                                       new HostResolver,
                                       &client_socket_factory_)) {}
 
@@ -619,6 +673,42 @@ TEST_F(TCPClientSocketPoolTest, FailingActiveRequestWithPendingRequests) {
     EXPECT_EQ(ERR_CONNECTION_FAILED, reqs[i]->WaitForResult());
 }
 
+
+// A connect that stalls is raced by a backup connect, which wins.
+TEST_F(TCPClientSocketPoolTest, BackupSocketConnect) {
+  TCPConnectJob::set_backup_connect_delay_ms(1);
+  MockClientSocketFactory::ClientSocketType types[] = {
+    MockClientSocketFactory::MOCK_STALLED_CLIENT_SOCKET,
+    MockClientSocketFactory::MOCK_PENDING_CLIENT_SOCKET,
+  };
+  client_socket_factory_.set_client_socket_types(types, arraysize(types));
+
+  TestSocketRequest req(pool_.get(), &request_order_);
+  HostResolver::RequestInfo info("www.google.com", 80);
+  EXPECT_EQ(ERR_IO_PENDING, req.handle.Init("a", info, 5, &req));
+  EXPECT_EQ(OK, req.WaitForResult());
+  EXPECT_TRUE(req.handle.socket()->IsConnected());
+  EXPECT_EQ(2, client_socket_factory_.allocation_count());
+
+  req.handle.Reset();
+  TCPConnectJob::set_backup_connect_delay_ms(
+      TCPConnectJob::kDefaultBackupConnectDelayMs);
+}
+
+// A connect that completes before the backup delay doesn't need a backup.
+TEST_F(TCPClientSocketPoolTest, NoBackupSocketWhenFast) {
+  client_socket_factory_.set_client_socket_type(
+      MockClientSocketFactory::MOCK_PENDING_CLIENT_SOCKET);
+
+  TestSocketRequest req(pool_.get(), &request_order_);
+  HostResolver::RequestInfo info("www.google.com", 80);
+  EXPECT_EQ(ERR_IO_PENDING, req.handle.Init("a", info, 5, &req));
+  EXPECT_EQ(OK, req.WaitForResult());
+  EXPECT_EQ(1, client_socket_factory_.allocation_count());
+
+  req.handle.Reset();
+}
+
 }  // namespace
 
 }  // namespace net
@@ -113,6 +113,8 @@ class TestPageHandler(BaseHTTPServer.BaseHTTPRequestHandler):
       self.ContentTypeHandler,
       self.ServerRedirectHandler,
       self.ClientRedirectHandler,
+      self.PipelineHandler,
+      self.BrokenPipelineHandler,
       self.DefaultResponseHandler]
     self._post_handlers = [
       self.WriteFile,
@@ -127,6 +129,9 @@ class TestPageHandler(BaseHTTPServer.BaseHTTPRequestHandler):
     }
     self._default_mime_type = 'text/html'
 
+    # The number of requests received on this connection.
+    self._connection_request_count = 0
+
     BaseHTTPServer.BaseHTTPRequestHandler.__init__(self, request,
                                                    client_address,
                                                    socket_server)
@@ -921,6 +926,49 @@ class TestPageHandler(BaseHTTPServer.BaseHTTPRequestHandler):
 
     return True
 
+  def _SendKeepAliveResponse(self):
+    """Sends a HTTP/1.1 keep-alive response whose body gives the path and the
+    position of the request on the connection, so that the client can tell
+    which request it answers."""
+
+    self._connection_request_count += 1
+    contents = "%s %d" % (self.path, self._connection_request_count)
+    self.protocol_version = 'HTTP/1.1'
+    self.send_response(200)
+    self.send_header('Content-type', 'text/plain')
+    self.send_header('Content-Length', len(contents))
+    self.send_header('Connection', 'keep-alive')
+    self.end_headers()
+    self.wfile.write(contents)
+    # The other handlers answer with HTTP/1.0 and close the connection.
+    del self.protocol_version
+
+  def PipelineHandler(self):
+    """Answers requests on a keep-alive connection, one after the other, which
+    is enough to support HTTP/1.1 pipelining. The syntax is '/pipeline?foo'."""
+
+    if not self._ShouldHandleRequest("/pipeline"):
+      return False
+
+    self._SendKeepAliveResponse()
+    return True
+
+  def BrokenPipelineHandler(self):
+    """Behaves like a server that breaks pipelined requests: it answers the
+    first request on a connection and keeps the connection alive, but closes
+    it without an answer when the next request comes in. The syntax is
+    '/pipeline-broken?foo'."""
+
+    if not self._ShouldHandleRequest("/pipeline-broken"):
+      return False
+
+    if self._connection_request_count:
+      self.close_connection = 1
+      return True
+
+    self._SendKeepAliveResponse()
+    return True
+
   def DefaultResponseHandler(self):
     """This is the catch-all response handler for requests that aren't handled
     by one of the special handlers above.
@@ -15,6 +15,7 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/file_util.h"
 #include "base/message_loop.h"
@@ -30,6 +31,8 @@
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/http_cache.h"
 #include "net/http/http_network_layer.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_pipeline_manager.h"
 #include "net/http/http_response_headers.h"
 #include "net/proxy/proxy_service.h"
 #include "net/socket/ssl_test_util.h"
@@ -100,6 +103,63 @@ void FillBuffer(char* buffer, size_t len) {
   }
 }
 
+// Sends |num_requests| requests to |path| at the same time, after a first
+// request that leaves a keep-alive connection to the test server, and checks
+// that each request gets its own response. All the requests are pipelined on
+// that connection. If the server is |broken|, they are all sent again on
+// connections of their own.
+void PipelineTestHelper(HTTPTestServer* server, const std::string& path,
+                        int num_requests, bool broken) {
+  net::HttpPipelineManager::set_enabled(true);
+  scoped_refptr<URLRequestContext> context = new TestURLRequestContext();
+  net::HttpPipelineManager* manager =
+      static_cast<net::HttpNetworkLayer*>(
+          context->http_transaction_factory())->GetSession()->
+          pipeline_manager();
+
+  {
+    TestDelegate d;
+    URLRequest r(server->TestServerPage(path + "?0"), &d);
+    r.set_context(context);
+    r.Start();
+    MessageLoop::current()->Run();
+    EXPECT_EQ(URLRequestStatus::SUCCESS, r.status().status());
+    EXPECT_EQ("/" + path + "?0 1", d.data_received());
+  }
+  EXPECT_EQ(0, manager->requests_pipelined());
+
+  scoped_array<TestDelegate> delegates(new TestDelegate[num_requests]);
+  std::vector<URLRequest*> requests;
+  for (int i = 0; i < num_requests; ++i) {
+    URLRequest* r = new URLRequest(
+        server->TestServerPage(StringPrintf("%s?%d", path.c_str(), i + 1)),
+        &delegates[i]);
+    r->set_context(context);
+    r->Start();
+    requests.push_back(r);
+  }
+
+  // Each completed request quits the message loop once.
+  for (int i = 0; i < num_requests; ++i) {
+    while (requests[i]->is_pending())
+      MessageLoop::current()->Run();
+  }
+
+  // The server gives the position of each request on its connection.
+  for (int i = 0; i < num_requests; ++i) {
+    EXPECT_EQ(URLRequestStatus::SUCCESS, requests[i]->status().status());
+    std::string expected = StringPrintf("/%s?%d %d", path.c_str(), i + 1,
+                                        broken ? 1 : i + 2);
+    EXPECT_EQ(expected, delegates[i].data_received());
+    delete requests[i];
+  }
+
+  EXPECT_EQ(num_requests, manager->requests_pipelined());
+  EXPECT_EQ(broken ? num_requests : 0, manager->requests_resent());
+
+  net::HttpPipelineManager::set_enabled(false);
+}
+
 }  // namespace
 
 // Inherit PlatformTest since we require the autorelease pool on Mac OS X.f
@@ -479,6 +539,22 @@ TEST_F(URLRequestTest, CancelTest5) {
 #endif
 }
 
+TEST_F(URLRequestTest, PipelinedRequests) {
+  scoped_refptr<HTTPTestServer> server =
+      HTTPTestServer::CreateServer(L"", NULL);
+  ASSERT_TRUE(NULL != server.get());
+  PipelineTestHelper(server, "pipeline", 3, false);
+}
+
+// A server that drops pipelined requests makes them fall back to regular
+// connections.
+TEST_F(URLRequestTest, BrokenPipelinedRequests) {
+  scoped_refptr<HTTPTestServer> server =
+      HTTPTestServer::CreateServer(L"", NULL);
+  ASSERT_TRUE(NULL != server.get());
+  PipelineTestHelper(server, "pipeline-broken", 3, true);
+}
+
 TEST_F(URLRequestTest, PostTest) {
   scoped_refptr<HTTPTestServer> server =
       HTTPTestServer::CreateServer(L"net/data", NULL);